@@ -67,6 +67,24 @@
 static pthread_mutex_t job_node_info_lock = PTHREAD_MUTEX_INITIALIZER;
 static node_info_msg_t *job_node_ptr = NULL;
 
+/* Packed job records from the last SHOW_DELTA response, sorted by job ID,
+ * which later responses listing only changed jobs are applied to */
+typedef struct job_cache_rec {
+	uint32_t job_id;
+	uint32_t size;
+	char *record;
+} job_cache_rec_t;
+
+static pthread_mutex_t job_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static job_cache_rec_t *job_cache = NULL;
+static uint32_t job_cache_cnt = 0, job_cache_size = 0;
+static char *job_cache_cluster = NULL;
+static time_t job_cache_time = 0;
+static uint16_t job_cache_flags = 0, job_cache_version = 0;
+/* Cluster whose controller answered a SHOW_DELTA request in full */
+static bool job_no_delta = false;
+static char *job_no_delta_cluster = NULL;
+
 /* This set of functions loads/free node information so that we can map a job's
  * core bitmap to it's CPU IDs based upon the thread count on each node. */
 static void _load_node_info(void)
@@ -1112,6 +1130,139 @@ line15:
 
 }
 
+static char *_job_cache_cluster_name(void)
+{
+	if (working_cluster_rec)
+		return working_cluster_rec->name;
+	return NULL;
+}
+
+/* Discard the job record cache, job_cache_lock must be locked */
+static void _job_cache_clear(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < job_cache_cnt; i++)
+		xfree(job_cache[i].record);
+	xfree(job_cache);
+	xfree(job_cache_cluster);
+	job_cache_cnt = job_cache_size = 0;
+	job_cache_time = 0;
+}
+
+static int _job_cache_sort(const void *x, const void *y)
+{
+	const job_cache_rec_t *rec1 = x, *rec2 = y;
+
+	if (rec1->job_id < rec2->job_id)
+		return -1;
+	if (rec1->job_id > rec2->job_id)
+		return 1;
+	return 0;
+}
+
+/* Return the cache entry for job_id among the first rec_cnt (sorted)
+ * entries or NULL if not found */
+static job_cache_rec_t *_job_cache_find(uint32_t job_id, uint32_t rec_cnt)
+{
+	job_cache_rec_t key;
+
+	key.job_id = job_id;
+	return bsearch(&key, job_cache, rec_cnt, sizeof(job_cache_rec_t),
+		       _job_cache_sort);
+}
+
+/* Apply a delta response to the job record cache, taking over its records.
+ * job_cache_lock must be locked */
+static void _job_cache_merge(job_info_delta_msg_t *delta, uint16_t show_flags,
+			     uint16_t protocol_version)
+{
+	job_cache_rec_t *rec_ptr;
+	uint32_t i, j, sorted_cnt;
+	bool added = false;
+
+	if (delta->full || (job_cache_flags != show_flags) ||
+	    (job_cache_version != protocol_version) ||
+	    xstrcmp(job_cache_cluster, _job_cache_cluster_name()))
+		_job_cache_clear();
+	job_cache_flags = show_flags;
+	job_cache_version = protocol_version;
+	if (!job_cache_cluster)
+		job_cache_cluster = xstrdup(_job_cache_cluster_name());
+
+	for (i = 0; i < delta->gone_count; i++) {
+		rec_ptr = _job_cache_find(delta->gone_ids[i], job_cache_cnt);
+		if (rec_ptr)
+			xfree(rec_ptr->record);
+	}
+
+	sorted_cnt = job_cache_cnt;
+	for (i = 0; i < delta->record_count; i++) {
+		rec_ptr = _job_cache_find(delta->job_ids[i], sorted_cnt);
+		if (!rec_ptr) {
+			if (job_cache_cnt >= job_cache_size) {
+				job_cache_size = MAX(job_cache_size * 2, 1024);
+				xrealloc(job_cache, sizeof(job_cache_rec_t) *
+					 job_cache_size);
+			}
+			rec_ptr = &job_cache[job_cache_cnt++];
+			rec_ptr->job_id = delta->job_ids[i];
+			rec_ptr->record = NULL;
+			added = true;
+		}
+		xfree(rec_ptr->record);
+		rec_ptr->record = delta->records[i];
+		rec_ptr->size = delta->record_sizes[i];
+		delta->records[i] = NULL;
+	}
+
+	/* Drop the purged jobs' entries and sort in the new ones */
+	for (i = 0, j = 0; i < job_cache_cnt; i++) {
+		if (!job_cache[i].record)
+			continue;
+		if (i != j)
+			job_cache[j] = job_cache[i];
+		j++;
+	}
+	job_cache_cnt = j;
+	if (added) {
+		qsort(job_cache, job_cache_cnt, sizeof(job_cache_rec_t),
+		      _job_cache_sort);
+	}
+	job_cache_time = delta->last_update;
+}
+
+/* Build a job information response from the cached records.
+ * job_cache_lock must be locked */
+static int _job_cache_load(job_info_msg_t **job_info_msg_pptr)
+{
+	slurm_msg_t msg;
+	Buf buffer;
+	uint32_t i;
+	int rc;
+
+	buffer = init_buf(BUF_SIZE);
+	pack32(job_cache_cnt, buffer);
+	pack_time(job_cache_time, buffer);
+	for (i = 0; i < job_cache_cnt; i++) {
+		packmem_array(job_cache[i].record, job_cache[i].size,
+			      buffer);
+	}
+	set_buf_offset(buffer, 0);
+
+	slurm_msg_t_init(&msg);
+	msg.msg_type = RESPONSE_JOB_INFO;
+	msg.protocol_version = job_cache_version;
+	rc = unpack_msg(&msg, buffer);
+	free_buf(buffer);
+	if (rc != SLURM_SUCCESS) {
+		_job_cache_clear();
+		slurm_seterrno_ret(SLURM_COMMUNICATIONS_RECEIVE_ERROR);
+	}
+	*job_info_msg_pptr = (job_info_msg_t *) msg.data;
+	return SLURM_PROTOCOL_SUCCESS;
+}
+
 /*
  * slurm_load_jobs - issue RPC to get all job configuration
  *	information if changed since update_time
@@ -1120,6 +1271,9 @@ line15:
  * IN show_flags -  job filtering option: 0, SHOW_ALL or SHOW_DETAIL
  * RET 0 or -1 on error
  * NOTE: free the response using slurm_free_job_info_msg
+ * NOTE: once called with a non-zero update_time (polling), the packed job
+ *	records are kept and later calls with the same show_flags only
+ *	transfer the records of jobs changed since the previous call
  */
 extern int
 slurm_load_jobs (time_t update_time, job_info_msg_t **job_info_msg_pptr,
@@ -1129,34 +1283,77 @@ slurm_load_jobs (time_t update_time, job_info_msg_t **job_info_msg_pptr,
 	slurm_msg_t resp_msg;
 	slurm_msg_t req_msg;
 	job_info_request_msg_t req;
+	bool delta;
 
 	slurm_msg_t_init(&req_msg);
 	slurm_msg_t_init(&resp_msg);
 
-	req.last_update  = update_time;
-	req.show_flags   = show_flags;
+	show_flags &= (~SHOW_DELTA);
+	slurm_mutex_lock(&job_cache_lock);
+	delta = (update_time != 0) || (job_cache_time != 0);
+	if (delta && job_no_delta &&
+	    !xstrcmp(job_no_delta_cluster, _job_cache_cluster_name()))
+		delta = false;
+	if (delta && ((job_cache_flags != show_flags) ||
+		      xstrcmp(job_cache_cluster, _job_cache_cluster_name())))
+		_job_cache_clear();
+
+	if (delta) {
+		req.last_update  = job_cache_time;
+		req.show_flags   = show_flags | SHOW_DELTA;
+	} else {
+		req.last_update  = update_time;
+		req.show_flags   = show_flags;
+	}
 	req_msg.msg_type = REQUEST_JOB_INFO;
 	req_msg.data     = &req;
 
-	if (slurm_send_recv_controller_msg(&req_msg, &resp_msg) < 0)
+	if (slurm_send_recv_controller_msg(&req_msg, &resp_msg) < 0) {
+		slurm_mutex_unlock(&job_cache_lock);
 		return SLURM_ERROR;
+	}
 
+	rc = SLURM_PROTOCOL_SUCCESS;
 	switch (resp_msg.msg_type) {
 	case RESPONSE_JOB_INFO:
+		/* controller without SHOW_DELTA support, stop asking it */
+		if (delta) {
+			_job_cache_clear();
+			job_no_delta = true;
+			xfree(job_no_delta_cluster);
+			job_no_delta_cluster =
+				xstrdup(_job_cache_cluster_name());
+		}
 		*job_info_msg_pptr = (job_info_msg_t *)resp_msg.data;
 		break;
+	case RESPONSE_JOB_INFO_DELTA:
+		_job_cache_merge((job_info_delta_msg_t *) resp_msg.data,
+				 show_flags, resp_msg.protocol_version);
+		slurm_free_job_info_delta_msg(resp_msg.data);
+		rc = _job_cache_load(job_info_msg_pptr);
+		break;
 	case RESPONSE_SLURM_RC:
 		rc = ((return_code_msg_t *) resp_msg.data)->return_code;
 		slurm_free_return_code_msg(resp_msg.data);
-		if (rc)
+		/* the cache is current, but the caller's data may not be */
+		if (delta && (rc == SLURM_NO_CHANGE_IN_DATA) &&
+		    (update_time < job_cache_time)) {
+			rc = _job_cache_load(job_info_msg_pptr);
+			break;
+		}
+		if (rc) {
+			slurm_mutex_unlock(&job_cache_lock);
 			slurm_seterrno_ret(rc);
+		}
 		break;
 	default:
+		slurm_mutex_unlock(&job_cache_lock);
 		slurm_seterrno_ret(SLURM_UNEXPECTED_MSG_ERROR);
 		break;
 	}
+	slurm_mutex_unlock(&job_cache_lock);
 
-	return SLURM_PROTOCOL_SUCCESS;
+	return rc;
 }
 
 /*
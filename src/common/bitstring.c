@@ -41,6 +41,7 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -75,6 +76,20 @@
 #define	_bitstr_words(nbits)	\
 	((((nbits) + BITSTR_MAXPOS) >> BITSTR_SHIFT) + BITSTR_OVERHEAD)
 
+/* bits in a word */
+#define _bitstr_word_bits	((bitoff_t) (sizeof(bitstr_t) * 8))
+
+/* unsigned view of a word, for shifts and bit counting */
+#ifdef USE_64BIT_BITSTR
+typedef uint64_t bitstr_uword_t;
+#else
+typedef uint32_t bitstr_uword_t;
+#endif
+
+/* mask of the valid bits in the last word of a bitstring of nbits > 0 */
+#define _bit_tail_mask(nbits)	\
+	_bit_low_mask((((nbits) - 1) & BITSTR_MAXPOS) + 1)
+
 /* check signature */
 #define _assert_bitstr_valid(name) do { \
 	assert((name) != NULL); \
@@ -113,6 +128,7 @@ strong_alias(bit_free,		slurm_bit_free);
 strong_alias(bit_realloc,	slurm_bit_realloc);
 strong_alias(bit_size,		slurm_bit_size);
 strong_alias(bit_and,		slurm_bit_and);
+strong_alias(bit_and_not,	slurm_bit_and_not);
 strong_alias(bit_not,		slurm_bit_not);
 strong_alias(bit_or,		slurm_bit_or);
 strong_alias(bit_set_count,	slurm_bit_set_count);
@@ -132,6 +148,7 @@ strong_alias(bit_fls,		slurm_bit_fls);
 strong_alias(bit_fill_gaps,	slurm_bit_fill_gaps);
 strong_alias(bit_super_set,	slurm_bit_super_set);
 strong_alias(bit_overlap,	slurm_bit_overlap);
+strong_alias(bit_overlap_any,	slurm_bit_overlap_any);
 strong_alias(bit_equal,		slurm_bit_equal);
 strong_alias(bit_copy,		slurm_bit_copy);
 strong_alias(bit_pick_cnt,	slurm_bit_pick_cnt);
@@ -139,9 +156,125 @@ strong_alias(bit_nffc,		slurm_bit_nffc);
 strong_alias(bit_noc,		slurm_bit_noc);
 strong_alias(bit_nffs,		slurm_bit_nffs);
 strong_alias(bit_copybits,	slurm_bit_copybits);
+strong_alias(bit_copybits_and,	slurm_bit_copybits_and);
+strong_alias(bit_scratch_alloc,	slurm_bit_scratch_alloc);
+strong_alias(bit_scratch_free,	slurm_bit_scratch_free);
 strong_alias(bit_get_bit_num,	slurm_bit_get_bit_num);
 strong_alias(bit_get_pos_num,	slurm_bit_get_pos_num);
 
+/*
+ * Return the mask of the first n bit positions of a word, 0 <= n <= word size
+ */
+static inline bitstr_uword_t
+_bit_low_mask(bitoff_t n)
+{
+	if (n <= 0)
+		return 0;
+	if (n >= _bitstr_word_bits)
+		return ~((bitstr_uword_t) 0);
+#ifdef SLURM_BIGENDIAN
+	return ~((~((bitstr_uword_t) 0)) >> n);
+#else
+	return (((bitstr_uword_t) 1) << n) - 1;
+#endif
+}
+
+/*
+ * Return the position within its word of the first bit set in w, w != 0
+ */
+static inline bitoff_t
+_word_ffs(bitstr_uword_t w)
+{
+#if defined(__GNUC__) && defined(USE_64BIT_BITSTR)
+#  ifdef SLURM_BIGENDIAN
+	return __builtin_clzll(w);
+#  else
+	return __builtin_ctzll(w);
+#  endif
+#elif defined(__GNUC__)
+#  ifdef SLURM_BIGENDIAN
+	return __builtin_clz(w);
+#  else
+	return __builtin_ctz(w);
+#  endif
+#else
+	bitoff_t pos = 0;
+
+	while (!(w & (bitstr_uword_t) _bit_mask(pos)))
+		pos++;
+	return pos;
+#endif
+}
+
+/*
+ * Return the position within its word of the last bit set in w, w != 0
+ */
+static inline bitoff_t
+_word_fls(bitstr_uword_t w)
+{
+#if defined(__GNUC__) && defined(USE_64BIT_BITSTR)
+#  ifdef SLURM_BIGENDIAN
+	return BITSTR_MAXPOS - __builtin_ctzll(w);
+#  else
+	return BITSTR_MAXPOS - __builtin_clzll(w);
+#  endif
+#elif defined(__GNUC__)
+#  ifdef SLURM_BIGENDIAN
+	return BITSTR_MAXPOS - __builtin_ctz(w);
+#  else
+	return BITSTR_MAXPOS - __builtin_clz(w);
+#  endif
+#else
+	bitoff_t pos = BITSTR_MAXPOS;
+
+	while (!(w & (bitstr_uword_t) _bit_mask(pos)))
+		pos--;
+	return pos;
+#endif
+}
+
+/*
+ * Find the first run of n bits all set (set != 0) or all clear among bits
+ * start ... end - 1, skipping whole words where possible
+ *   RETURN		position of the first bit of the run (-1 if none found)
+ */
+static bitoff_t
+_bit_run(bitstr_t *b, bitoff_t start, bitoff_t end, int32_t n, int set)
+{
+	bitstr_uword_t full = set ? ~((bitstr_uword_t) 0) : 0, w;
+	bitoff_t bit = start;
+	int32_t cnt = 0;
+
+	while (bit < end) {
+		if (((bit & BITSTR_MAXPOS) == 0) &&
+		    ((bit + _bitstr_word_bits) <= end)) {
+			w = b[_bit_word(bit)];
+			if (w == full) {
+				cnt += _bitstr_word_bits;
+				bit += _bitstr_word_bits;
+				if (cnt >= n)
+					return bit - cnt;
+				continue;
+			}
+			if (w == ~full) {
+				cnt = 0;
+				bit += _bitstr_word_bits;
+				continue;
+			}
+		}
+		if (bit_test(b, bit) == (set ? 1 : 0)) {
+			cnt++;
+			if (cnt >= n)
+				return bit - (cnt - 1);
+		} else {
+			cnt = 0;
+		}
+		bit++;
+	}
+
+	return -1;
+}
+
 /*
  * Allocate a bitstring.
  *   nbits (IN)		valid bits in new bitstring, initialized to all clear
@@ -200,6 +333,96 @@ bit_free(bitstr_t *b)
 	xfree(b);
 }
 
+/*
+ * Scratch bitmaps kept by each thread for reuse, so that functions called
+ * for every job tested need not allocate their temporary bitmaps each time
+ */
+#define BITSTR_SCRATCH_MAX	8
+
+typedef struct bit_scratch {
+	int cnt;
+	bitstr_t *bitmaps[BITSTR_SCRATCH_MAX];
+} bit_scratch_t;
+
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+
+static void
+_scratch_destroy(void *arg)
+{
+	bit_scratch_t *pool = (bit_scratch_t *) arg;
+	int i;
+
+	for (i = 0; i < pool->cnt; i++)
+		bit_free(pool->bitmaps[i]);
+	xfree(pool);
+}
+
+static void
+_scratch_key_create(void)
+{
+	if (pthread_key_create(&scratch_key, _scratch_destroy))
+		fatal("bit_scratch: pthread_key_create: %m");
+}
+
+/*
+ * Get a bitstring from the calling thread's scratch pool, allocating it if
+ * none of the size is kept.
+ *   nbits (IN)		valid bits in the bitstring, initialized to all clear
+ *   RETURN		bitstring to release with bit_scratch_free() from the
+ *			same thread
+ */
+bitstr_t *
+bit_scratch_alloc(bitoff_t nbits)
+{
+	bit_scratch_t *pool;
+	bitstr_t *b;
+	int i;
+
+	pthread_once(&scratch_once, _scratch_key_create);
+	pool = (bit_scratch_t *) pthread_getspecific(scratch_key);
+	if (pool) {
+		for (i = pool->cnt - 1; i >= 0; i--) {
+			b = pool->bitmaps[i];
+			if (_bitstr_bits(b) != nbits)
+				continue;
+			pool->bitmaps[i] = pool->bitmaps[--pool->cnt];
+			memset(&b[BITSTR_OVERHEAD], 0,
+			       (_bitstr_words(nbits) - BITSTR_OVERHEAD) *
+			       sizeof(bitstr_t));
+			return b;
+		}
+	}
+	return bit_alloc(nbits);
+}
+
+/*
+ * Return a bitstring to the calling thread's scratch pool, freeing it if
+ * the pool is full.
+ *   b (IN)		bitstring from bit_scratch_alloc() or bit_alloc()
+ */
+void
+bit_scratch_free(bitstr_t *b)
+{
+	bit_scratch_t *pool;
+
+	_assert_bitstr_valid(b);
+	pthread_once(&scratch_once, _scratch_key_create);
+	pool = (bit_scratch_t *) pthread_getspecific(scratch_key);
+	if (!pool) {
+		pool = xmalloc(sizeof(bit_scratch_t));
+		if (pthread_setspecific(scratch_key, pool)) {
+			xfree(pool);
+			bit_free(b);
+			return;
+		}
+	}
+	if (pool->cnt < BITSTR_SCRATCH_MAX)
+		pool->bitmaps[pool->cnt++] = b;
+	else
+		bit_free(b);
+}
+
 /*
  * Return the number of possible bits in a bitstring.
  *   b (IN)		bitstring to check
@@ -307,26 +530,21 @@ bit_nclear(bitstr_t *b, bitoff_t start, bitoff_t stop)
 bitoff_t
 bit_ffc(bitstr_t *b)
 {
-	bitoff_t bit = 0, value = -1;
+	bitoff_t word, words, bit;
+	bitstr_uword_t w;
 
 	_assert_bitstr_valid(b);
 
-	while (bit < _bitstr_bits(b) && value == -1) {
-		int32_t word = _bit_word(bit);
-
-		if (b[word] == BITSTR_MAXPOS) {
-			bit += sizeof(bitstr_t)*8;
+	words = _bitstr_words(_bitstr_bits(b));
+	for (word = BITSTR_OVERHEAD; word < words; word++) {
+		w = ~((bitstr_uword_t) b[word]);
+		if (w == 0)
 			continue;
-		}
-		while (bit < _bitstr_bits(b) && _bit_word(bit) == word) {
-			if (!bit_test(b, bit)) {
-				value = bit;
-				break;
-			}
-			bit++;
-		}
+		bit = (word - BITSTR_OVERHEAD) * _bitstr_word_bits +
+		      _word_ffs(w);
+		return (bit < _bitstr_bits(b)) ? bit : -1;
 	}
-	return value;
+	return -1;
 }
 
 /* Find the first n contiguous bits clear in b.
@@ -337,26 +555,10 @@ bit_ffc(bitstr_t *b)
 bitoff_t
 bit_nffc(bitstr_t *b, int32_t n)
 {
-	bitoff_t value = -1;
-	bitoff_t bit;
-	int32_t cnt = 0;
-
 	_assert_bitstr_valid(b);
 	assert(n > 0 && n < _bitstr_bits(b));
 
-	for (bit = 0; bit < _bitstr_bits(b); bit++) {
-		if (bit_test(b, bit)) {		/* fail */
-			cnt = 0;
-		} else {
-			cnt++;
-			if (cnt >= n) {
-				value = bit - (cnt - 1);
-				break;
-			}
-		}
-	}
-
-	return value;
+	return _bit_run(b, 0, _bitstr_bits(b), n, 0);
 }
 
 /* Find n contiguous bits clear in b starting at some offset.
@@ -368,9 +570,7 @@ bit_nffc(bitstr_t *b, int32_t n)
 bitoff_t
 bit_noc(bitstr_t *b, int32_t n, int32_t seed)
 {
-	bitoff_t value = -1;
-	bitoff_t bit;
-	int32_t cnt = 0;
+	bitoff_t value, end;
 
 	_assert_bitstr_valid(b);
 	assert(n > 0 && n <= _bitstr_bits(b));
@@ -378,34 +578,16 @@ bit_noc(bitstr_t *b, int32_t n, int32_t seed)
 	if ((seed + n) >= _bitstr_bits(b))
 		seed = _bitstr_bits(b);	/* skip offset test, too small */
 
-	for (bit = seed; bit < _bitstr_bits(b); bit++) {	/* start at offset */
-		if (bit_test(b, bit)) {		/* fail */
-			cnt = 0;
-		} else {
-			cnt++;
-			if (cnt >= n) {
-				value = bit - (cnt - 1);
-				return value;
-			}
-		}
-	}
+	value = _bit_run(b, seed, _bitstr_bits(b), n, 0); /* start at offset */
+	if (value != -1)
+		return value;
 
-	cnt = 0;	/* start at beginning */
-	for (bit = 0; bit < _bitstr_bits(b); bit++) {
-		if (bit_test(b, bit)) {		/* fail */
-			if (bit >= seed)
-				break;
-			cnt = 0;
-		} else {
-			cnt++;
-			if (cnt >= n) {
-				value = bit - (cnt - 1);
-				return value;
-			}
-		}
+	/* start at beginning, up to the first bit set at or after seed */
+	for (end = seed; end < _bitstr_bits(b); end++) {
+		if (bit_test(b, end))
+			break;
 	}
-
-	return -1;
+	return _bit_run(b, 0, end, n, 0);
 }
 
 /* Find the first n contiguous bits set in b.
@@ -416,26 +598,10 @@ bit_noc(bitstr_t *b, int32_t n, int32_t seed)
 bitoff_t
 bit_nffs(bitstr_t *b, int32_t n)
 {
-	bitoff_t value = -1;
-	bitoff_t bit;
-	int32_t cnt = 0;
-
 	_assert_bitstr_valid(b);
 	assert(n > 0 && n <= _bitstr_bits(b));
 
-	for (bit = 0; bit <= _bitstr_bits(b) - n; bit++) {
-		if (!bit_test(b, bit)) {	/* fail */
-			cnt = 0;
-		} else {
-			cnt++;
-			if (cnt >= n) {
-				value = bit - (cnt - 1);
-				break;
-			}
-		}
-	}
-
-	return value;
+	return _bit_run(b, 0, _bitstr_bits(b) - n + 1, n, 1);
 }
 
 /*
@@ -446,26 +612,19 @@ bit_nffs(bitstr_t *b, int32_t n)
 bitoff_t
 bit_ffs(bitstr_t *b)
 {
-	bitoff_t bit = 0, value = -1;
+	bitoff_t word, words, bit;
 
 	_assert_bitstr_valid(b);
 
-	while (bit < _bitstr_bits(b) && value == -1) {
-		int32_t word = _bit_word(bit);
-
-		if (b[word] == 0) {
-			bit += sizeof(bitstr_t)*8;
+	words = _bitstr_words(_bitstr_bits(b));
+	for (word = BITSTR_OVERHEAD; word < words; word++) {
+		if (b[word] == 0)
 			continue;
-		}
-		while (bit < _bitstr_bits(b) && _bit_word(bit) == word) {
-			if (bit_test(b, bit)) {
-				value = bit;
-				break;
-			}
-			bit++;
-		}
+		bit = (word - BITSTR_OVERHEAD) * _bitstr_word_bits +
+		      _word_ffs(b[word]);
+		return (bit < _bitstr_bits(b)) ? bit : -1;
 	}
-	return value;
+	return -1;
 }
 
 /*
@@ -476,39 +635,26 @@ bit_ffs(bitstr_t *b)
 bitoff_t
 bit_fls(bitstr_t *b)
 {
-	bitoff_t bit, value = -1;
-	int32_t word;
+	bitoff_t word;
+	bitstr_uword_t w;
 
 	_assert_bitstr_valid(b);
 
 	if (_bitstr_bits(b) == 0)	/* empty bitstring */
 		return -1;
 
-	bit = _bitstr_bits(b) - 1;	/* zero origin */
-
-	while (bit >= 0 && 		/* test partitial words */
-		(_bit_word(bit) == _bit_word(bit + 1))) {
-		if (bit_test(b, bit)) {
-			value = bit;
-			break;
-		}
-		bit--;
-	}
-	while (bit >= 0 && value == -1) {	/* test whole words */
-		word = _bit_word(bit);
-		if (b[word] == 0) {
-			bit -= sizeof(bitstr_t) * 8;
-			continue;
-		}
-		while (bit >= 0) {
-			if (bit_test(b, bit)) {
-				value = bit;
-				break;
-			}
-			bit--;
+	word = _bitstr_words(_bitstr_bits(b)) - 1;
+	w = b[word] & _bit_tail_mask(_bitstr_bits(b));
+	while (1) {
+		if (w) {
+			return (word - BITSTR_OVERHEAD) * _bitstr_word_bits +
+			       _word_fls(w);
 		}
+		if (--word < BITSTR_OVERHEAD)
+			break;
+		w = b[word];
 	}
-	return value;
+	return -1;
 }
 
 /*
@@ -538,17 +684,21 @@ bit_fill_gaps(bitstr_t *b)
 int
 bit_super_set(bitstr_t *b1, bitstr_t *b2)
 {
-	bitoff_t bit;
+	bitoff_t word, last;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8) {
-		if (b1[_bit_word(bit)] != (b1[_bit_word(bit)] &
-		                           b2[_bit_word(bit)]))
+	if (_bitstr_bits(b1) == 0)
+		return 1;
+	last = _bitstr_words(_bitstr_bits(b1)) - 1;
+	for (word = BITSTR_OVERHEAD; word < last; word++) {
+		if (b1[word] & ~b2[word])
 			return 0;
 	}
+	if ((b1[last] & ~b2[last]) & _bit_tail_mask(_bitstr_bits(b1)))
+		return 0;
 
 	return 1;
 }
@@ -559,7 +709,7 @@ bit_super_set(bitstr_t *b1, bitstr_t *b2)
 extern int
 bit_equal(bitstr_t *b1, bitstr_t *b2)
 {
-	bitoff_t bit;
+	bitoff_t word, last;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
@@ -567,10 +717,15 @@ bit_equal(bitstr_t *b1, bitstr_t *b2)
 	if (_bitstr_bits(b1) != _bitstr_bits(b2))
 		return 0;
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8) {
-		if (b1[_bit_word(bit)] != b2[_bit_word(bit)])
+	if (_bitstr_bits(b1) == 0)
+		return 1;
+	last = _bitstr_words(_bitstr_bits(b1)) - 1;
+	for (word = BITSTR_OVERHEAD; word < last; word++) {
+		if (b1[word] != b2[word])
 			return 0;
 	}
+	if ((b1[last] ^ b2[last]) & _bit_tail_mask(_bitstr_bits(b1)))
+		return 0;
 
 	return 1;
 }
@@ -585,14 +740,34 @@ bit_equal(bitstr_t *b1, bitstr_t *b2)
 void
 bit_and(bitstr_t *b1, bitstr_t *b2)
 {
-	bitoff_t bit;
+	bitoff_t word, words;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8)
-		b1[_bit_word(bit)] &= b2[_bit_word(bit)];
+	words = _bitstr_words(_bitstr_bits(b1));
+	for (word = BITSTR_OVERHEAD; word < words; word++)
+		b1[word] &= b2[word];
+}
+
+/*
+ * b1 &= ~b2, without modifying b2
+ *   b1 (IN/OUT)	first bitmap
+ *   b2 (IN)		second bitmap, bits to clear in b1
+ */
+void
+bit_and_not(bitstr_t *b1, bitstr_t *b2)
+{
+	bitoff_t word, words;
+
+	_assert_bitstr_valid(b1);
+	_assert_bitstr_valid(b2);
+	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
+
+	words = _bitstr_words(_bitstr_bits(b1));
+	for (word = BITSTR_OVERHEAD; word < words; word++)
+		b1[word] &= ~b2[word];
 }
 
 /*
@@ -602,12 +777,13 @@ bit_and(bitstr_t *b1, bitstr_t *b2)
 void
 bit_not(bitstr_t *b)
 {
-	bitoff_t bit;
+	bitoff_t word, words;
 
 	_assert_bitstr_valid(b);
 
-	for (bit = 0; bit < _bitstr_bits(b); bit += sizeof(bitstr_t)*8)
-		b[_bit_word(bit)] = ~b[_bit_word(bit)];
+	words = _bitstr_words(_bitstr_bits(b));
+	for (word = BITSTR_OVERHEAD; word < words; word++)
+		b[word] = ~b[word];
 }
 
 /*
@@ -618,14 +794,15 @@ bit_not(bitstr_t *b)
 void
 bit_or(bitstr_t *b1, bitstr_t *b2)
 {
-	bitoff_t bit;
+	bitoff_t word, words;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8)
-		b1[_bit_word(bit)] |= b2[_bit_word(bit)];
+	words = _bitstr_words(_bitstr_bits(b1));
+	for (word = BITSTR_OVERHEAD; word < words; word++)
+		b1[word] |= b2[word];
 }
 
 
@@ -664,6 +841,25 @@ bit_copybits(bitstr_t *dest, bitstr_t *src)
 	memcpy(&dest[BITSTR_OVERHEAD], &src[BITSTR_OVERHEAD], len);
 }
 
+/*
+ * dest = b1 & b2, all of the same size
+ */
+void
+bit_copybits_and(bitstr_t *dest, bitstr_t *b1, bitstr_t *b2)
+{
+	bitoff_t word, words;
+
+	_assert_bitstr_valid(dest);
+	_assert_bitstr_valid(b1);
+	_assert_bitstr_valid(b2);
+	assert(_bitstr_bits(dest) == _bitstr_bits(b1));
+	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
+
+	words = _bitstr_words(_bitstr_bits(b1));
+	for (word = BITSTR_OVERHEAD; word < words; word++)
+		dest[word] = b1[word] & b2[word];
+}
+
 #if !defined(USE_64BIT_BITSTR)
 /*
  * Returns the hamming weight (i.e. the number of bits set) in a word.
@@ -702,6 +898,77 @@ hweight(uint64_t w)
 }
 #endif /* !USE_64BIT_BITSTR */
 
+/*
+ * Count the bits set in words first ... last - 1 of b1, or of b1 & b2 if b2
+ * is not NULL. On x86 processors with the popcnt instruction, a version of
+ * the loop built to use it is selected at run time.
+ */
+typedef int32_t (*bit_weight_fn_t)(bitstr_t *b1, bitstr_t *b2,
+				   bitoff_t first, bitoff_t last);
+
+static int32_t
+_bit_weight_generic(bitstr_t *b1, bitstr_t *b2, bitoff_t first, bitoff_t last)
+{
+	int32_t count = 0;
+	bitoff_t word;
+
+	if (b2) {
+		for (word = first; word < last; word++)
+			count += hweight(b1[word] & b2[word]);
+	} else {
+		for (word = first; word < last; word++)
+			count += hweight(b1[word]);
+	}
+	return count;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 8)))
+#define BITSTR_HAVE_POPCNT	1
+
+#ifdef USE_64BIT_BITSTR
+#  define _popcnt_word(w)	__builtin_popcountll((bitstr_uword_t) (w))
+#else
+#  define _popcnt_word(w)	__builtin_popcount((bitstr_uword_t) (w))
+#endif
+
+__attribute__((target("popcnt"))) static int32_t
+_bit_weight_popcnt(bitstr_t *b1, bitstr_t *b2, bitoff_t first, bitoff_t last)
+{
+	int32_t count = 0;
+	bitoff_t word;
+
+	if (b2) {
+		for (word = first; word < last; word++)
+			count += _popcnt_word(b1[word] & b2[word]);
+	} else {
+		for (word = first; word < last; word++)
+			count += _popcnt_word(b1[word]);
+	}
+	return count;
+}
+#endif
+
+static inline int32_t
+_bit_weight(bitstr_t *b1, bitstr_t *b2, bitoff_t first, bitoff_t last)
+{
+#ifdef BITSTR_HAVE_POPCNT
+	/* Racing threads store the same value */
+	static bit_weight_fn_t weight_fn = NULL;
+
+	if (!weight_fn) {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("popcnt"))
+			weight_fn = _bit_weight_popcnt;
+		else
+			weight_fn = _bit_weight_generic;
+	}
+	return (*weight_fn)(b1, b2, first, last);
+#else
+	return _bit_weight_generic(b1, b2, first, last);
+#endif
+}
+
 /*
  * Count the number of bits set in bitstring.
  *   b (IN)		bitstring to check
@@ -710,20 +977,17 @@ hweight(uint64_t w)
 int32_t
 bit_set_count(bitstr_t *b)
 {
-	int32_t count = 0;
-	bitoff_t bit, bit_cnt;
-	int32_t word_size = sizeof(bitstr_t) * 8;
+	int32_t count;
+	bitoff_t last;
 
 	_assert_bitstr_valid(b);
 
-	bit_cnt = _bitstr_bits(b);
-	for (bit = 0; (bit + word_size) <= bit_cnt; bit += word_size) {
-		count += hweight(b[_bit_word(bit)]);
-	}
-	for ( ; bit < bit_cnt; bit++) {
-		if (bit_test(b, bit))
-			count++;
-	}
+	if (_bitstr_bits(b) == 0)
+		return 0;
+	last = _bitstr_words(_bitstr_bits(b)) - 1;
+	count = _bit_weight(b, NULL, BITSTR_OVERHEAD, last);
+	count += hweight(b[last] & _bit_tail_mask(_bitstr_bits(b)));
+
 	return count;
 }
 
@@ -737,26 +1001,27 @@ bit_set_count(bitstr_t *b)
 int32_t
 bit_set_count_range(bitstr_t *b, int32_t start, int32_t end)
 {
-	int32_t count = 0, eow;
-	bitoff_t bit;
-	const int32_t word_size = sizeof(bitstr_t) * 8;
+	int32_t count = 0;
+	bitoff_t first, last;
+	bitstr_uword_t first_mask, last_mask;
 
 	_assert_bitstr_valid(b);
 	_assert_bit_valid(b,start);
 
 	end = MIN(end, _bitstr_bits(b));
-	eow = ((start+word_size-1)/word_size) * word_size;  /* end of word */
-	for ( bit = start; bit < end && bit < eow; bit++) {
-		if (bit_test(b, bit))
-			count++;
-	}
-	for (; (bit + word_size) <= end ; bit += word_size) {
-		count += hweight(b[_bit_word(bit)]);
-	}
-	for ( ; bit < end; bit++) {
-		if (bit_test(b, bit))
-			count++;
-	}
+	if (start >= end)
+		return 0;
+
+	first = _bit_word(start);
+	last  = _bit_word(end - 1);
+	first_mask = ~_bit_low_mask(start & BITSTR_MAXPOS);
+	last_mask  = _bit_tail_mask(end);
+	if (first == last)
+		return hweight(b[first] & first_mask & last_mask);
+
+	count += hweight(b[first] & first_mask);
+	count += _bit_weight(b, NULL, first + 1, last);
+	count += hweight(b[last] & last_mask);
 
 	return count;
 }
@@ -767,28 +1032,49 @@ bit_set_count_range(bitstr_t *b, int32_t start, int32_t end)
 extern int32_t
 bit_overlap(bitstr_t *b1, bitstr_t *b2)
 {
-	int32_t count = 0;
-	bitoff_t bit, bit_cnt;
-	int32_t word_size = sizeof(bitstr_t) * 8;
+	int32_t count;
+	bitoff_t last;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	bit_cnt = _bitstr_bits(b1);
-	for (bit = 0; bit < bit_cnt; bit += word_size) {
-		if ((bit + word_size - 1) >= bit_cnt)
-			break;
-		count += hweight(b1[_bit_word(bit)] & b2[_bit_word(bit)]);
-	}
-	for ( ; bit < bit_cnt; bit++) {
-		if (bit_test(b1, bit) && bit_test(b2, bit))
-			count++;
-	}
+	if (_bitstr_bits(b1) == 0)
+		return 0;
+	last = _bitstr_words(_bitstr_bits(b1)) - 1;
+	count = _bit_weight(b1, b2, BITSTR_OVERHEAD, last);
+	count += hweight(b1[last] & b2[last] &
+			 _bit_tail_mask(_bitstr_bits(b1)));
 
 	return count;
 }
 
+/*
+ * return 1 if any bit set in b1 is also set in b2, 0 otherwise. Cheaper
+ * than bit_overlap() as it stops at the first common bit.
+ */
+extern int
+bit_overlap_any(bitstr_t *b1, bitstr_t *b2)
+{
+	bitoff_t word, last;
+
+	_assert_bitstr_valid(b1);
+	_assert_bitstr_valid(b2);
+	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
+
+	if (_bitstr_bits(b1) == 0)
+		return 0;
+	last = _bitstr_words(_bitstr_bits(b1)) - 1;
+	for (word = BITSTR_OVERHEAD; word < last; word++) {
+		if (b1[word] & b2[word])
+			return 1;
+	}
+	if ((b1[last] & b2[last]) & _bit_tail_mask(_bitstr_bits(b1)))
+		return 1;
+
+	return 0;
+}
+
 /*
  * Count the number of bits clear in bitstring.
  *   b (IN)		bitstring to check
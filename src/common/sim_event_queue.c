@@ -0,0 +1,371 @@
+/*****************************************************************************\
+ *  src/common/sim_event_queue.c - simulated batch job end events
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <pthread.h>
+#include <string.h>
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/xmalloc.h"
+#include "src/common/sim_event_queue.h"
+
+#define SIM_EVENT_POOL_CHUNK	1024	/* records allocated at once */
+#define SIM_EVENT_HASH_MIN	1024	/* initial hash table size */
+#define SIM_EVENT_HEAP_MIN	1024	/* initial heap size */
+
+typedef struct sim_event {
+	uint32_t job_id;
+	uint32_t duration;	/* simulated run time, seconds */
+	time_t when;		/* simulated end time, if queued */
+	uint32_t seq;		/* queue order of events with same end time */
+	int heap_inx;		/* position in event_heap, -1 if not queued */
+	uint16_t state;		/* SIM_EVENT_* */
+	struct sim_event *next;	/* hash chain, or free list when pooled */
+} sim_event_t;
+
+static pthread_mutex_t sim_event_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static sim_event_t **event_hash = NULL;	/* indexed by job id */
+static uint32_t event_hash_size = 0;
+static uint32_t event_rec_cnt = 0;	/* records in event_hash */
+
+static sim_event_t **event_heap = NULL;	/* min-heap on (when, seq) */
+static int event_heap_size = 0;
+static int event_heap_cnt = 0;
+static uint32_t event_seq = 0;
+
+static sim_event_t *event_free_list = NULL;
+static List event_chunk_list = NULL;	/* pool memory, freed at fini */
+
+#define EVENT_HASH_INX(_job_id) ((_job_id) % event_hash_size)
+
+/* Return true if event a must be popped before event b */
+static inline bool _event_before(sim_event_t *a, sim_event_t *b)
+{
+	if (a->when != b->when)
+		return (a->when < b->when);
+	return ((int32_t) (a->seq - b->seq) < 0);
+}
+
+static void _chunk_free(void *x)
+{
+	xfree(x);
+}
+
+static sim_event_t *_event_alloc(void)
+{
+	sim_event_t *event, *chunk;
+	int i;
+
+	if (!event_free_list) {
+		chunk = xmalloc(sizeof(sim_event_t) * SIM_EVENT_POOL_CHUNK);
+		if (!event_chunk_list)
+			event_chunk_list = list_create(_chunk_free);
+		list_append(event_chunk_list, chunk);
+		for (i = 0; i < SIM_EVENT_POOL_CHUNK; i++) {
+			chunk[i].next = event_free_list;
+			event_free_list = &chunk[i];
+		}
+	}
+	event = event_free_list;
+	event_free_list = event->next;
+	memset(event, 0, sizeof(sim_event_t));
+	event->heap_inx = -1;
+	return event;
+}
+
+static void _event_release(sim_event_t *event)
+{
+	event->next = event_free_list;
+	event_free_list = event;
+}
+
+/* Double the hash table size once it holds twice as many records as
+ * buckets, keeping chains short whatever the number of simulated jobs */
+static void _hash_grow(void)
+{
+	sim_event_t **old_hash = event_hash, *event, *next;
+	uint32_t old_size = event_hash_size, i, inx;
+
+	event_hash_size = MAX(SIM_EVENT_HASH_MIN, old_size * 2);
+	event_hash = xmalloc(sizeof(sim_event_t *) * event_hash_size);
+	for (i = 0; i < old_size; i++) {
+		for (event = old_hash[i]; event; event = next) {
+			next = event->next;
+			inx = EVENT_HASH_INX(event->job_id);
+			event->next = event_hash[inx];
+			event_hash[inx] = event;
+		}
+	}
+	xfree(old_hash);
+}
+
+static sim_event_t *_hash_find(uint32_t job_id)
+{
+	sim_event_t *event;
+
+	if (!event_hash)
+		return NULL;
+	for (event = event_hash[EVENT_HASH_INX(job_id)]; event;
+	     event = event->next) {
+		if (event->job_id == job_id)
+			return event;
+	}
+	return NULL;
+}
+
+static void _hash_add(sim_event_t *event)
+{
+	uint32_t inx;
+
+	if (event_rec_cnt >= (event_hash_size * 2))
+		_hash_grow();
+	inx = EVENT_HASH_INX(event->job_id);
+	event->next = event_hash[inx];
+	event_hash[inx] = event;
+	event_rec_cnt++;
+}
+
+static void _hash_remove(sim_event_t *event)
+{
+	sim_event_t **event_pptr;
+
+	event_pptr = &event_hash[EVENT_HASH_INX(event->job_id)];
+	while (*event_pptr) {
+		if (*event_pptr == event) {
+			*event_pptr = event->next;
+			event_rec_cnt--;
+			return;
+		}
+		event_pptr = &(*event_pptr)->next;
+	}
+}
+
+static inline void _heap_set(int inx, sim_event_t *event)
+{
+	event_heap[inx] = event;
+	event->heap_inx = inx;
+}
+
+static void _heap_sift_up(int inx)
+{
+	sim_event_t *event = event_heap[inx];
+	int parent;
+
+	while (inx > 0) {
+		parent = (inx - 1) / 2;
+		if (!_event_before(event, event_heap[parent]))
+			break;
+		_heap_set(inx, event_heap[parent]);
+		inx = parent;
+	}
+	_heap_set(inx, event);
+}
+
+static void _heap_sift_down(int inx)
+{
+	sim_event_t *event = event_heap[inx];
+	int child;
+
+	while ((child = (inx * 2) + 1) < event_heap_cnt) {
+		if (((child + 1) < event_heap_cnt) &&
+		    _event_before(event_heap[child + 1], event_heap[child]))
+			child++;
+		if (!_event_before(event_heap[child], event))
+			break;
+		_heap_set(inx, event_heap[child]);
+		inx = child;
+	}
+	_heap_set(inx, event);
+}
+
+static void _heap_push(sim_event_t *event)
+{
+	if (event_heap_cnt >= event_heap_size) {
+		event_heap_size = MAX(SIM_EVENT_HEAP_MIN, event_heap_size * 2);
+		xrealloc(event_heap, sizeof(sim_event_t *) * event_heap_size);
+	}
+	event->seq = event_seq++;
+	_heap_set(event_heap_cnt++, event);
+	_heap_sift_up(event->heap_inx);
+}
+
+static void _heap_remove(sim_event_t *event)
+{
+	int inx = event->heap_inx;
+
+	event->heap_inx = -1;
+	if (--event_heap_cnt == inx)
+		return;
+	_heap_set(inx, event_heap[event_heap_cnt]);
+	if ((inx > 0) && _event_before(event_heap[inx],
+				       event_heap[(inx - 1) / 2]))
+		_heap_sift_up(inx);
+	else
+		_heap_sift_down(inx);
+}
+
+extern int sim_event_set_duration(uint32_t job_id, uint32_t duration)
+{
+	sim_event_t *event;
+
+	slurm_mutex_lock(&sim_event_mutex);
+	if (!(event = _hash_find(job_id))) {
+		event = _event_alloc();
+		event->job_id = job_id;
+		event->state = SIM_EVENT_PENDING;
+		_hash_add(event);
+	} else if (event->state != SIM_EVENT_PENDING) {
+		debug("SIM: duration of job %u updated while running", job_id);
+	}
+	event->duration = duration;
+	slurm_mutex_unlock(&sim_event_mutex);
+
+	return SLURM_SUCCESS;
+}
+
+extern int sim_event_add(uint32_t job_id, time_t now, time_t *when)
+{
+	sim_event_t *event;
+
+	slurm_mutex_lock(&sim_event_mutex);
+	if (!(event = _hash_find(job_id))) {
+		slurm_mutex_unlock(&sim_event_mutex);
+		return SLURM_ERROR;
+	}
+	if (event->heap_inx >= 0)	/* launch request resent */
+		_heap_remove(event);
+	event->when = now + event->duration;
+	event->state = SIM_EVENT_QUEUED;
+	_heap_push(event);
+	if (when)
+		*when = event->when;
+	slurm_mutex_unlock(&sim_event_mutex);
+
+	return SLURM_SUCCESS;
+}
+
+extern time_t sim_event_next(void)
+{
+	time_t when = 0;
+
+	slurm_mutex_lock(&sim_event_mutex);
+	if (event_heap_cnt)
+		when = event_heap[0]->when;
+	slurm_mutex_unlock(&sim_event_mutex);
+
+	return when;
+}
+
+extern int sim_event_count(void)
+{
+	int cnt;
+
+	slurm_mutex_lock(&sim_event_mutex);
+	cnt = event_heap_cnt;
+	slurm_mutex_unlock(&sim_event_mutex);
+
+	return cnt;
+}
+
+extern uint32_t sim_event_pop_due(time_t now, uint32_t **job_ids,
+				  uint32_t *job_ids_size)
+{
+	sim_event_t *event;
+	uint32_t cnt = 0;
+
+	slurm_mutex_lock(&sim_event_mutex);
+	while (event_heap_cnt && (event_heap[0]->when <= now)) {
+		event = event_heap[0];
+		_heap_remove(event);
+		event->state = SIM_EVENT_ENDED;
+		if (cnt >= *job_ids_size) {
+			*job_ids_size = MAX(*job_ids_size * 2, 64);
+			xrealloc(*job_ids, sizeof(uint32_t) * *job_ids_size);
+		}
+		(*job_ids)[cnt++] = event->job_id;
+	}
+	slurm_mutex_unlock(&sim_event_mutex);
+
+	return cnt;
+}
+
+extern int sim_event_remove(uint32_t job_id, bool requeue)
+{
+	sim_event_t *event;
+	int state;
+
+	slurm_mutex_lock(&sim_event_mutex);
+	if (!(event = _hash_find(job_id))) {
+		slurm_mutex_unlock(&sim_event_mutex);
+		return SIM_EVENT_NONE;
+	}
+	state = event->state;
+	if (event->heap_inx >= 0)
+		_heap_remove(event);
+	if (requeue) {
+		event->state = SIM_EVENT_PENDING;
+	} else {
+		_hash_remove(event);
+		_event_release(event);
+	}
+	slurm_mutex_unlock(&sim_event_mutex);
+
+	return state;
+}
+
+extern void sim_event_fini(void)
+{
+	slurm_mutex_lock(&sim_event_mutex);
+	xfree(event_hash);
+	event_hash_size = 0;
+	event_rec_cnt = 0;
+	xfree(event_heap);
+	event_heap_size = 0;
+	event_heap_cnt = 0;
+	event_free_list = NULL;
+	if (event_chunk_list) {
+		list_destroy(event_chunk_list);
+		event_chunk_list = NULL;
+	}
+	slurm_mutex_unlock(&sim_event_mutex);
+}
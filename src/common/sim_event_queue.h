@@ -0,0 +1,95 @@
+/*****************************************************************************\
+ *  src/common/sim_event_queue.h - simulated batch job end events
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _SIM_EVENT_QUEUE_H
+#define _SIM_EVENT_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Job states as seen by sim_event_remove() */
+#define SIM_EVENT_NONE		0	/* job unknown */
+#define SIM_EVENT_PENDING	1	/* duration known, not launched */
+#define SIM_EVENT_QUEUED	2	/* launched, batch script running */
+#define SIM_EVENT_ENDED		3	/* batch script ended, not terminated */
+
+/*
+ * Every simulated job has one record, found by job id through a hash table,
+ * from the time its duration is received until slurmctld terminates it for
+ * good, or purges it if it never ran. A requeued job keeps its record.
+ * Launched jobs are kept in a binary min-heap ordered by end time, so adding
+ * an event or popping the next one is O(log n). Records come from a pool
+ * and are recycled rather than freed. All functions do their own locking.
+ */
+
+/* Record the simulated run time of a job, replacing any earlier value */
+extern int sim_event_set_duration(uint32_t job_id, uint32_t duration);
+
+/*
+ * Queue the end of the batch script of a job launched at time now
+ * OUT when - simulated end time of the batch script
+ * RET SLURM_SUCCESS or SLURM_ERROR if no duration is known for the job
+ */
+extern int sim_event_add(uint32_t job_id, time_t now, time_t *when);
+
+/* Return the earliest queued end time, zero if no event is queued */
+extern time_t sim_event_next(void);
+
+/* Return the count of queued events */
+extern int sim_event_count(void);
+
+/*
+ * Remove every event due at time now from the queue, in end time order
+ * IN/OUT job_ids - array of ended job ids, xrealloc'ed as needed
+ * IN/OUT job_ids_size - allocated size of job_ids
+ * RET count of ended jobs stored in job_ids
+ */
+extern uint32_t sim_event_pop_due(time_t now, uint32_t **job_ids,
+				  uint32_t *job_ids_size);
+
+/*
+ * Forget a job being terminated by slurmctld, removing its event from the
+ * queue if its batch script had not ended yet
+ * IN requeue - the job will be launched again, keep its record and duration
+ *	and put it back in the SIM_EVENT_PENDING state
+ * RET the job's state before the call, SIM_EVENT_*
+ */
+extern int sim_event_remove(uint32_t job_id, bool requeue);
+
+/* Release all memory */
+extern void sim_event_fini(void);
+
+#endif	/* _SIM_EVENT_QUEUE_H */
@@ -0,0 +1,638 @@
+/*****************************************************************************\
+ *  sim_sync.c - simulator time step synchronization between sim_mgr,
+ *	slurmctld, its backfill thread and slurmd
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#ifdef SLURM_SIMULATOR
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/sim_sync.h"
+#include "src/common/slurm_sim.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#define SIM_SYNC_SHM_NAME	"slurm_sim_sync.shm"
+#define SIM_SYNC_MAGIC		0x53594e43	/* "SYNC" */
+#define SIM_SYNC_ATTACH_TRIES	100	/* 10ms apart */
+
+typedef struct sim_sync_shm {
+	uint32_t magic;		/* SIM_SYNC_MAGIC once initialized */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pid_t mgr_pid;		/* zero until sim_mgr registers */
+	time_t next_time[SIM_SYNC_NEXT_CNT];	/* zero if nothing pending */
+	/* Wait time statistics by participant and phase waited for */
+	uint32_t wait_cnt[SIM_SYNC_WHO_CNT][SIM_SYNC_PHASE_CNT];
+	uint64_t wait_usec[SIM_SYNC_WHO_CNT][SIM_SYNC_PHASE_CNT];
+	uint64_t wait_max[SIM_SYNC_WHO_CNT][SIM_SYNC_PHASE_CNT];
+	uint32_t wait_hist[SIM_SYNC_WHO_CNT][SIM_SYNC_PHASE_CNT]
+			 [SIM_SYNC_HIST_BUCKETS];
+} sim_sync_shm_t;
+
+static pthread_mutex_t sim_sync_lock = PTHREAD_MUTEX_INITIALIZER;
+static sim_sync_shm_t *sync_shm = NULL;
+static sem_t *server_sem = SEM_FAILED;	/* SIM_SYNC_SERVER_SEM */
+
+static const char *who_names[SIM_SYNC_WHO_CNT] = {
+	"sim_mgr", "slurmctld", "backfill", "slurmd"
+};
+
+/* Participant reporting each next interesting time */
+static const sim_sync_who_t next_owner[SIM_SYNC_NEXT_CNT] = {
+	SIM_SYNC_SLURMD,	/* SIM_SYNC_NEXT_JOB_END */
+	SIM_SYNC_SLURMCTLD,	/* SIM_SYNC_NEXT_SCHEDULE */
+	SIM_SYNC_SLURMCTLD,	/* SIM_SYNC_NEXT_BACKFILL */
+	SIM_SYNC_SLURMCTLD,	/* SIM_SYNC_NEXT_TRIGGER */
+	SIM_SYNC_SLURMCTLD,	/* SIM_SYNC_NEXT_PRIO_DECAY */
+	SIM_SYNC_SLURMCTLD,	/* SIM_SYNC_NEXT_TIME_LIMIT */
+	SIM_SYNC_SLURMCTLD	/* SIM_SYNC_NEXT_TIMEOUT_CHECK */
+};
+
+/* Return the simulation identifier, NULL if none */
+static char *_sim_id(void)
+{
+	static bool checked = false;
+	static char *sim_id = NULL;
+	char *id;
+	int i;
+
+	if (checked)
+		return sim_id;
+
+	id = getenv(SIM_SYNC_ID_ENV);
+	if (id && id[0]) {
+		/* Must fit in IPC names, e.g. "/bf_done_sem.<id>" */
+		for (i = 0; id[i]; i++) {
+			if ((i >= SIM_SYNC_ID_MAX) ||
+			    (!isalnum((int) id[i]) && (id[i] != '-') &&
+			     (id[i] != '_')))
+				fatal("Invalid %s: %s", SIM_SYNC_ID_ENV, id);
+		}
+		sim_id = id;
+	}
+	checked = true;
+
+	return sim_id;
+}
+
+static uint64_t _now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+static int _init_shm(sim_sync_shm_t *shm)
+{
+	pthread_mutexattr_t mutex_attr;
+	pthread_condattr_t cond_attr;
+
+	pthread_mutexattr_init(&mutex_attr);
+	pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+	/* A participant killed mid-step must not hang the others */
+	pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+	if (pthread_mutex_init(&shm->mutex, &mutex_attr)) {
+		pthread_mutexattr_destroy(&mutex_attr);
+		return SLURM_ERROR;
+	}
+	pthread_mutexattr_destroy(&mutex_attr);
+
+	pthread_condattr_init(&cond_attr);
+	pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+	/* Not affected by the simulated wall clock */
+	pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+	if (pthread_cond_init(&shm->cond, &cond_attr)) {
+		pthread_condattr_destroy(&cond_attr);
+		return SLURM_ERROR;
+	}
+	pthread_condattr_destroy(&cond_attr);
+
+	/* Never signal a sim_mgr of an earlier run */
+	shm->mgr_pid = 0;
+	__sync_synchronize();
+	shm->magic = SIM_SYNC_MAGIC;
+	return SLURM_SUCCESS;
+}
+
+static void _lock_shm(void)
+{
+	if (pthread_mutex_lock(&sync_shm->mutex) == EOWNERDEAD) {
+		error("%s: previous holder died, recovering", __func__);
+		pthread_mutex_consistent(&sync_shm->mutex);
+	}
+}
+
+static void _unlock_shm(void)
+{
+	pthread_mutex_unlock(&sync_shm->mutex);
+}
+
+/* Cancellation cleanup of sim_sync_sleep_until(), shm mutex held */
+static void _sleep_cleanup(void *arg)
+{
+	sim_sync_next_t src = *(sim_sync_next_t *) arg;
+
+	sync_shm->next_time[src] = 0;
+	_unlock_shm();
+}
+
+/* Open the semaphore sim_mgr changes global_sync_flag under, waiting for
+ * sim_mgr to create it as the daemons always did */
+static void _open_server_sem(void)
+{
+	char *name = sim_sync_ipc_name(SIM_SYNC_SERVER_SEM);
+	int i;
+
+	for (i = 0; i < SIM_SYNC_SERVER_SEM_TRIES; i++) {
+		server_sem = sem_open(name, 0, 0644, 0);
+		if (server_sem != SEM_FAILED)
+			break;
+		sleep(1);
+	}
+	if (server_sem == SEM_FAILED)
+		error("%s: sem_open(%s): %m", __func__, name);
+	xfree(name);
+}
+
+/* Change global_sync_flag, shm mutex held */
+static void _set_flag(int phase)
+{
+	if (server_sem != SEM_FAILED)
+		sem_wait(server_sem);
+	*global_sync_flag = phase;
+	if (server_sem != SEM_FAILED)
+		sem_post(server_sem);
+	pthread_cond_broadcast(&sync_shm->cond);
+}
+
+static void _cond_timedwait_usec(long usec)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_sec += usec / 1000000;
+	ts.tv_nsec += (usec % 1000000) * 1000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+	if (pthread_cond_timedwait(&sync_shm->cond, &sync_shm->mutex, &ts) ==
+	    EOWNERDEAD) {
+		error("%s: previous holder died, recovering", __func__);
+		pthread_mutex_consistent(&sync_shm->mutex);
+	}
+}
+
+static void _cond_timedwait(void)
+{
+	_cond_timedwait_usec(SIM_SYNC_POLL_USEC);
+}
+
+/* Wait for the flag to enter [min_phase, max_phase], shm mutex held */
+static int _wait_phase(sim_sync_who_t who, int min_phase, int max_phase)
+{
+	uint64_t start, delta;
+	long poll_usec = SIM_SYNC_POLL_USEC;
+	int phase, bucket = 0;
+
+	if (who == SIM_SYNC_SLURMD)
+		poll_usec = SIM_SYNC_POLL_USEC_SLURMD;
+	start = _now_usec();
+	while (((phase = *global_sync_flag) < min_phase) ||
+	       (phase > max_phase))
+		_cond_timedwait_usec(poll_usec);
+
+	delta = _now_usec() - start;
+	while ((delta >> bucket) && (bucket < (SIM_SYNC_HIST_BUCKETS - 1)))
+		bucket++;
+	sync_shm->wait_cnt[who][phase]++;
+	sync_shm->wait_usec[who][phase] += delta;
+	if (delta > sync_shm->wait_max[who][phase])
+		sync_shm->wait_max[who][phase] = delta;
+	sync_shm->wait_hist[who][phase][bucket]++;
+
+	return phase;
+}
+
+extern int sim_sync_open(void)
+{
+	sim_sync_shm_t *shm;
+	bool created = false;
+	char *shm_name;
+	int fd, i;
+
+	slurm_mutex_lock(&sim_sync_lock);
+	if (sync_shm) {
+		slurm_mutex_unlock(&sim_sync_lock);
+		return SLURM_SUCCESS;
+	}
+
+	shm_name = sim_sync_ipc_name(SIM_SYNC_SHM_NAME);
+	fd = shm_open(shm_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd >= 0) {
+		created = true;
+		if (ftruncate(fd, sizeof(sim_sync_shm_t))) {
+			error("%s: ftruncate(%s): %m", __func__, shm_name);
+			close(fd);
+			shm_unlink(shm_name);
+			xfree(shm_name);
+			slurm_mutex_unlock(&sim_sync_lock);
+			return SLURM_ERROR;
+		}
+	} else if (errno == EEXIST) {
+		fd = shm_open(shm_name, O_RDWR, 0600);
+	}
+	if (fd < 0) {
+		error("%s: shm_open(%s): %m", __func__, shm_name);
+		xfree(shm_name);
+		slurm_mutex_unlock(&sim_sync_lock);
+		return SLURM_ERROR;
+	}
+
+	/* The creator may not have sized the segment yet */
+	for (i = 0; !created && (i < SIM_SYNC_ATTACH_TRIES); i++) {
+		struct stat st;
+		if (!fstat(fd, &st) && (st.st_size >= sizeof(sim_sync_shm_t)))
+			break;
+		usleep(10000);
+	}
+	shm = mmap(NULL, sizeof(sim_sync_shm_t), PROT_READ | PROT_WRITE,
+		   MAP_SHARED, fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED) {
+		error("%s: mmap(%s): %m", __func__, shm_name);
+		xfree(shm_name);
+		slurm_mutex_unlock(&sim_sync_lock);
+		return SLURM_ERROR;
+	}
+
+	if (created) {
+		if (_init_shm(shm) != SLURM_SUCCESS) {
+			error("%s: unable to initialize %s", __func__,
+			      shm_name);
+			munmap(shm, sizeof(sim_sync_shm_t));
+			shm_unlink(shm_name);
+			xfree(shm_name);
+			slurm_mutex_unlock(&sim_sync_lock);
+			return SLURM_ERROR;
+		}
+	} else {
+		for (i = 0; (shm->magic != SIM_SYNC_MAGIC) &&
+			    (i < SIM_SYNC_ATTACH_TRIES); i++)
+			usleep(10000);
+		if (shm->magic != SIM_SYNC_MAGIC) {
+			error("%s: %s never initialized", __func__, shm_name);
+			munmap(shm, sizeof(sim_sync_shm_t));
+			xfree(shm_name);
+			slurm_mutex_unlock(&sim_sync_lock);
+			return SLURM_ERROR;
+		}
+	}
+	xfree(shm_name);
+
+	if (!global_sync_flag) {
+		error("%s: simulator shared memory not attached", __func__);
+		munmap(shm, sizeof(sim_sync_shm_t));
+		slurm_mutex_unlock(&sim_sync_lock);
+		return SLURM_ERROR;
+	}
+
+	_open_server_sem();
+	sync_shm = shm;
+	slurm_mutex_unlock(&sim_sync_lock);
+	return SLURM_SUCCESS;
+}
+
+extern int sim_sync_attach(sim_sync_who_t who)
+{
+	int i;
+
+	if (sim_sync_open() != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	_lock_shm();
+	for (i = 0; i < SIM_SYNC_NEXT_CNT; i++) {
+		if (next_owner[i] == who)
+			sync_shm->next_time[i] = 0;
+	}
+	memset(sync_shm->wait_cnt[who], 0, sizeof(sync_shm->wait_cnt[who]));
+	memset(sync_shm->wait_usec[who], 0,
+	       sizeof(sync_shm->wait_usec[who]));
+	memset(sync_shm->wait_max[who], 0, sizeof(sync_shm->wait_max[who]));
+	memset(sync_shm->wait_hist[who], 0,
+	       sizeof(sync_shm->wait_hist[who]));
+	_unlock_shm();
+
+	return SLURM_SUCCESS;
+}
+
+extern void sim_sync_close(sim_sync_who_t who)
+{
+	slurm_mutex_lock(&sim_sync_lock);
+	if (sync_shm) {
+		sim_sync_log_stats(who);
+		munmap(sync_shm, sizeof(sim_sync_shm_t));
+		sync_shm = NULL;
+		if (server_sem != SEM_FAILED) {
+			sem_close(server_sem);
+			server_sem = SEM_FAILED;
+		}
+	}
+	slurm_mutex_unlock(&sim_sync_lock);
+}
+
+extern void sim_sync_unlink(void)
+{
+	char *name;
+
+	name = sim_sync_ipc_name(SIM_SYNC_SHM_NAME);
+	shm_unlink(name);
+	xfree(name);
+	name = sim_sync_ipc_name(SIM_SYNC_BF_SEM);
+	sem_unlink(name);
+	xfree(name);
+	name = sim_sync_ipc_name(SIM_SYNC_BF_DONE_SEM);
+	sem_unlink(name);
+	xfree(name);
+}
+
+extern char *sim_sync_ipc_name(const char *base)
+{
+	char *name = NULL, *sim_id = _sim_id();
+
+	if (sim_id)
+		xstrfmtcat(name, "/%s.%s", base, sim_id);
+	else
+		xstrfmtcat(name, "/%s", base);
+
+	return name;
+}
+
+extern sem_t *sim_sync_sem_open(const char *base)
+{
+	char *name = sim_sync_ipc_name(base);
+	sem_t *sem;
+
+	sem = sem_open(name, O_CREAT, 0644, 0);
+	if (sem == SEM_FAILED) {
+		error("%s: sem_open(%s): %m", __func__, name);
+		sem_unlink(name);
+	}
+	xfree(name);
+
+	return sem;
+}
+
+/* Test that pid is still a running sim_mgr and not a recycled pid */
+static bool _is_sim_mgr(pid_t pid)
+{
+	char path[32], comm[32];
+	bool rc = false;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "/proc/%d/comm", (int) pid);
+	if (!(fp = fopen(path, "r")))
+		return false;
+	if (fgets(comm, sizeof(comm), fp)) {
+		comm[strcspn(comm, "\n")] = '\0';
+		rc = !strcmp(comm, SIM_SYNC_MGR_NAME);
+	}
+	fclose(fp);
+	return rc;
+}
+
+/* How slurmd always found sim_mgr; used until sim_mgr registers */
+static pid_t _pidof_sim_mgr(void)
+{
+	char output[16];
+	pid_t pid = 0;
+	FILE *cmd;
+
+	if (!(cmd = popen("pidof -s " SIM_SYNC_MGR_NAME, "r")))
+		return 0;
+	if (fgets(output, sizeof(output), cmd))
+		pid = (pid_t) strtoul(output, NULL, 10);
+	pclose(cmd);
+	return pid;
+}
+
+extern void sim_sync_register_mgr(void)
+{
+	if (!sync_shm && (sim_sync_open() != SLURM_SUCCESS))
+		return;
+
+	_lock_shm();
+	sync_shm->mgr_pid = getpid();
+	pthread_cond_broadcast(&sync_shm->cond);
+	_unlock_shm();
+}
+
+extern int sim_sync_signal_mgr(int sig)
+{
+	pid_t pid;
+
+	if (!sync_shm && (sim_sync_open() != SLURM_SUCCESS))
+		return SLURM_ERROR;
+
+	_lock_shm();
+	pid = sync_shm->mgr_pid;
+	if (pid && !_is_sim_mgr(pid)) {
+		debug("%s: registered sim_mgr pid %d is gone",
+		      __func__, (int) pid);
+		sync_shm->mgr_pid = pid = 0;
+	}
+	_unlock_shm();
+
+	if (!pid && _sim_id()) {
+		/* pidof may find the sim_mgr of another simulation */
+		error("%s: sim_mgr of simulation %s not registered, it must "
+		      "call sim_sync_register_mgr() when %s is set",
+		      __func__, _sim_id(), SIM_SYNC_ID_ENV);
+		return SLURM_ERROR;
+	}
+	if (!pid && (pid = _pidof_sim_mgr()))
+		debug("%s: sim_mgr not registered, using pid %d",
+		      __func__, (int) pid);
+	if (!pid) {
+		error("%s: no sim_mgr found", __func__);
+		return SLURM_ERROR;
+	}
+	if (kill(pid, sig)) {
+		error("%s: kill(%d): %m", __func__, (int) pid);
+		return SLURM_ERROR;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+extern void sim_sync_step(sim_sync_who_t who)
+{
+	int phase;
+
+	if (!sync_shm && (sim_sync_open() != SLURM_SUCCESS))
+		return;
+
+	_lock_shm();
+	phase = _wait_phase(who, SIM_SYNC_FIRST_PHASE, SIM_SYNC_LAST_PHASE);
+	if (++phase > SIM_SYNC_LAST_PHASE)
+		phase = SIM_SYNC_MGR_PHASE;
+	_set_flag(phase);
+	_unlock_shm();
+}
+
+extern void sim_sync_wait_phase(sim_sync_who_t who, int phase)
+{
+	if (!sync_shm && (sim_sync_open() != SLURM_SUCCESS))
+		return;
+
+	_lock_shm();
+	_wait_phase(who, phase, phase);
+	_unlock_shm();
+}
+
+extern void sim_sync_set_phase(int phase)
+{
+	if (!sync_shm && (sim_sync_open() != SLURM_SUCCESS))
+		return;
+
+	_lock_shm();
+	_set_flag(phase);
+	_unlock_shm();
+}
+
+extern void sim_sync_set_next(sim_sync_next_t src, time_t when)
+{
+	if (!sync_shm && (sim_sync_open() != SLURM_SUCCESS))
+		return;
+
+	_lock_shm();
+	sync_shm->next_time[src] = when;
+	_unlock_shm();
+}
+
+extern time_t sim_sync_next_time(void)
+{
+	time_t when = 0;
+	int i;
+
+	if (!sync_shm && (sim_sync_open() != SLURM_SUCCESS))
+		return 0;
+
+	_lock_shm();
+	for (i = 0; i < SIM_SYNC_NEXT_CNT; i++) {
+		if (sync_shm->next_time[i] &&
+		    (!when || (sync_shm->next_time[i] < when)))
+			when = sync_shm->next_time[i];
+	}
+	_unlock_shm();
+
+	return when;
+}
+
+extern void sim_sync_sleep_until(sim_sync_next_t src, time_t when)
+{
+	if (!sync_shm && (sim_sync_open() != SLURM_SUCCESS)) {
+		/* Do not spin if the segment is unavailable */
+		while (time(NULL) < when)
+			sleep(1);
+		return;
+	}
+
+	_lock_shm();
+	pthread_cleanup_push(_sleep_cleanup, &src);
+	sync_shm->next_time[src] = when;
+	while (time(NULL) < when)
+		_cond_timedwait();
+	pthread_cleanup_pop(1);
+}
+
+extern void sim_sync_log_stats(sim_sync_who_t who)
+{
+	char hist[SIM_SYNC_HIST_BUCKETS * 12], *pos;
+	int i, phase, bucket, end;
+
+	if (!sync_shm)
+		return;
+
+	for (i = 0; i < SIM_SYNC_WHO_CNT; i++) {
+		if ((who != SIM_SYNC_WHO_CNT) && (who != i))
+			continue;
+		for (phase = 0; phase < SIM_SYNC_PHASE_CNT; phase++) {
+			if (!sync_shm->wait_cnt[i][phase])
+				continue;
+			pos = hist;
+			hist[0] = '\0';
+			for (bucket = 0; bucket < SIM_SYNC_HIST_BUCKETS;
+			     bucket++) {
+				if (!sync_shm->wait_hist[i][phase][bucket])
+					continue;
+				end = sizeof(hist) - (pos - hist);
+				pos += snprintf(pos, end, " <%uus:%u",
+						1U << bucket,
+						sync_shm->wait_hist[i][phase]
+								   [bucket]);
+			}
+			info("SIM: sync %s phase %d: waits=%u avg=%"PRIu64"us "
+			     "max=%"PRIu64"us hist:%s", who_names[i], phase,
+			     sync_shm->wait_cnt[i][phase],
+			     sync_shm->wait_usec[i][phase] /
+			     sync_shm->wait_cnt[i][phase],
+			     sync_shm->wait_max[i][phase], hist);
+		}
+	}
+}
+
+#endif	/* SLURM_SIMULATOR */
@@ -0,0 +1,199 @@
+/*****************************************************************************\
+ *  sim_sync.h - simulator time step synchronization between sim_mgr,
+ *	slurmctld, its backfill thread and slurmd
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _SIM_SYNC_H
+#define _SIM_SYNC_H
+
+#include <semaphore.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+/*
+ * Each simulated second goes through the phases of global_sync_flag: sim_mgr
+ * advances the clock in phase SIM_SYNC_MGR_PHASE, then every daemon
+ * participant waits for one of the phases SIM_SYNC_FIRST_PHASE to
+ * SIM_SYNC_LAST_PHASE and passes the flag on, the last one handing it back
+ * to sim_mgr.
+ *
+ * Waiters block on a process-shared condition variable kept with its mutex
+ * in a shared memory segment of its own, and are woken by whoever changes
+ * the flag through this module.
+ *
+ * The sim_mgr in use still writes global_sync_flag directly under the
+ * SIM_SYNC_SERVER_SEM semaphore, so every change of the flag made here is
+ * also done holding that semaphore, and the waits poll the flag as often
+ * as the daemons did before (SIM_SYNC_POLL_USEC, SIM_SYNC_POLL_USEC_SLURMD
+ * for slurmd) to notice sim_mgr handing the flag over. Once sim_mgr uses
+ * sim_sync_set_phase() and sim_sync_wait_phase() the polling only bounds
+ * the wait for a participant that died.
+ */
+#define SIM_SYNC_MGR_PHASE	1
+#define SIM_SYNC_FIRST_PHASE	2
+#define SIM_SYNC_LAST_PHASE	4
+#define SIM_SYNC_PHASE_CNT	(SIM_SYNC_LAST_PHASE + 1)
+
+#define SIM_SYNC_POLL_USEC		100000
+#define SIM_SYNC_POLL_USEC_SLURMD	1000
+#define SIM_SYNC_HIST_BUCKETS	24	/* log2 of wait time in usec */
+
+/*
+ * Several simulations may run on one host. Each one sets SIM_SYNC_ID_ENV to
+ * an identifier of its own in the environment of sim_mgr and the daemons,
+ * and every IPC object name gets it as a suffix. Without it the names are
+ * those of a lone simulation.
+ */
+#define SIM_SYNC_ID_ENV		"SLURM_SIM_ID"
+#define SIM_SYNC_ID_MAX		32
+
+#define SIM_SYNC_MGR_NAME	"sim_mgr"	/* sim_mgr's process name */
+
+/* Semaphore created by sim_mgr, held while changing global_sync_flag */
+#define SIM_SYNC_SERVER_SEM	"serversem"
+#define SIM_SYNC_SERVER_SEM_TRIES 10	/* 1s apart */
+
+/* Semaphores through which slurmctld runs the backfill scheduler */
+#define SIM_SYNC_BF_SEM		"bf_sem"
+#define SIM_SYNC_BF_DONE_SEM	"bf_done_sem"
+
+typedef enum {
+	SIM_SYNC_SIM_MGR,
+	SIM_SYNC_SLURMCTLD,
+	SIM_SYNC_BACKFILL,
+	SIM_SYNC_SLURMD,
+	SIM_SYNC_WHO_CNT
+} sim_sync_who_t;
+
+/*
+ * Next interesting times, the simulated times at which something may happen
+ * in a daemon. While nothing happens, sim_mgr may jump the clock straight to
+ * the earliest of them (or of its own next job submission) instead of
+ * advancing it one step at a time.
+ */
+typedef enum {
+	SIM_SYNC_NEXT_JOB_END,		/* slurmd: earliest batch script end */
+	SIM_SYNC_NEXT_SCHEDULE,		/* slurmctld: periodic schedule() */
+	SIM_SYNC_NEXT_BACKFILL,		/* slurmctld: periodic backfill */
+	SIM_SYNC_NEXT_TRIGGER,		/* slurmctld: trigger_process() */
+	SIM_SYNC_NEXT_PRIO_DECAY,	/* slurmctld: priority decay thread */
+	SIM_SYNC_NEXT_TIME_LIMIT,	/* slurmctld: earliest job time limit */
+	SIM_SYNC_NEXT_TIMEOUT_CHECK,	/* slurmctld: job_time_limit() run */
+	SIM_SYNC_NEXT_CNT
+} sim_sync_next_t;
+
+/*
+ * Attach to the synchronization segment, creating it if first. Calling it
+ * again from the same process is a no-op.
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int sim_sync_open(void);
+
+/*
+ * sim_sync_open(), then reset what a participant of an earlier run left in
+ * the segment, which outlives the runs: its wait statistics and the next
+ * interesting times it reports. Call once when the participant starts.
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int sim_sync_attach(sim_sync_who_t who);
+
+/* Detach from the synchronization segment, logging our wait statistics */
+extern void sim_sync_close(sim_sync_who_t who);
+
+/*
+ * Remove the synchronization segment and the backfill semaphores, sim_mgr
+ * does it at the end of a run
+ */
+extern void sim_sync_unlink(void);
+
+/*
+ * Return the name of an IPC object of this simulation, base with a leading
+ * '/' and the simulation identifier if any. Free with xfree().
+ */
+extern char *sim_sync_ipc_name(const char *base);
+
+/*
+ * Open, creating it if needed, a semaphore of this simulation
+ * RET the semaphore or SEM_FAILED
+ */
+extern sem_t *sim_sync_sem_open(const char *base);
+
+/* sim_mgr side: publish our pid, for sim_sync_signal_mgr() */
+extern void sim_sync_register_mgr(void);
+
+/*
+ * Send a signal to the sim_mgr of this simulation. Without SIM_SYNC_ID_ENV
+ * set, a sim_mgr that has not registered, or whose registered pid no longer
+ * runs SIM_SYNC_MGR_NAME, is looked up with pidof as before. With it set,
+ * pidof could find the sim_mgr of another simulation on the host, so
+ * sim_mgr must register.
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int sim_sync_signal_mgr(int sig);
+
+/*
+ * Daemon side of a time step: wait for a daemon phase of global_sync_flag,
+ * then pass the flag on to the next phase, waking the other participants.
+ */
+extern void sim_sync_step(sim_sync_who_t who);
+
+/* sim_mgr side: wait until global_sync_flag reaches the given phase */
+extern void sim_sync_wait_phase(sim_sync_who_t who, int phase);
+
+/* sim_mgr side: set global_sync_flag to the given phase, waking waiters */
+extern void sim_sync_set_phase(int phase);
+
+/*
+ * Report the next interesting time of one source, zero if it has nothing
+ * pending. Daemons report before sim_sync_step() so that sim_mgr sees the
+ * values of the step just completed.
+ */
+extern void sim_sync_set_next(sim_sync_next_t src, time_t when);
+
+/* sim_mgr side: return the earliest next interesting time, zero if none */
+extern time_t sim_sync_next_time(void);
+
+/*
+ * Block the calling thread until the simulated clock reaches the given time,
+ * reporting it as the next interesting time of src meanwhile. The thread is
+ * only woken when the flag changes phase, so it uses no CPU while blocked.
+ * Safe to cancel.
+ */
+extern void sim_sync_sleep_until(sim_sync_next_t src, time_t when);
+
+/* Log the wait time histograms of one participant, all if SIM_SYNC_WHO_CNT */
+extern void sim_sync_log_stats(sim_sync_who_t who);
+
+#endif	/* _SIM_SYNC_H */
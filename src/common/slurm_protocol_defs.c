@@ -735,6 +735,43 @@ void inline slurm_free_sim_helper_msg(sim_helper_msg_t *msg)
        xfree(msg);
 }
 
+extern void slurm_free_sim_helper_jobs_msg(sim_helper_jobs_msg_t *msg)
+{
+	if (msg) {
+		xfree(msg->job_ids);
+		xfree(msg);
+	}
+}
+
+extern void slurm_free_dry_run_msg(dry_run_msg_t *msg)
+{
+	xfree(msg);
+}
+
+extern void slurm_free_dry_run_response_msg(dry_run_response_msg_t *msg)
+{
+	if (msg) {
+		xfree(msg->job_ids);
+		xfree(msg->start_times);
+		xfree(msg);
+	}
+}
+
+extern void slurm_free_job_info_delta_msg(job_info_delta_msg_t *msg)
+{
+	uint32_t i;
+
+	if (msg) {
+		for (i = 0; msg->records && (i < msg->record_count); i++)
+			xfree(msg->records[i]);
+		xfree(msg->records);
+		xfree(msg->record_sizes);
+		xfree(msg->job_ids);
+		xfree(msg->gone_ids);
+		xfree(msg);
+	}
+}
+
 extern void slurm_free_signal_job_msg(signal_job_msg_t * msg)
 {
 	xfree(msg);
@@ -2760,6 +2797,19 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 		break;
 	case MESSAGE_SIM_HELPER_CYCLE:
 		slurm_free_sim_helper_msg(data);
+		break;
+	case MESSAGE_SIM_HELPER_CYCLE_JOBS:
+		slurm_free_sim_helper_jobs_msg(data);
+		break;
+	case REQUEST_DRY_RUN:
+		slurm_free_dry_run_msg(data);
+		break;
+	case RESPONSE_DRY_RUN:
+		slurm_free_dry_run_response_msg(data);
+		break;
+	case RESPONSE_JOB_INFO_DELTA:
+		slurm_free_job_info_delta_msg(data);
+		break;
 	case REQUEST_SUSPEND:
 	case SRUN_REQUEST_SUSPEND:
 		slurm_free_suspend_msg(data);
@@ -3116,6 +3166,12 @@ rpc_num2string(uint16_t opcode)
 			return "REQUEST_PRIORITY_FACTORS";
 		case RESPONSE_PRIORITY_FACTORS:
 			return "RESPONSE_PRIORITY_FACTORS";
+		case REQUEST_DRY_RUN:
+			return "REQUEST_DRY_RUN";
+		case RESPONSE_DRY_RUN:
+			return "RESPONSE_DRY_RUN";
+		case RESPONSE_JOB_INFO_DELTA:
+			return "RESPONSE_JOB_INFO_DELTA";
 		case REQUEST_TOPO_INFO:
 			return "REQUEST_TOPO_INFO";
 		case RESPONSE_TOPO_INFO:
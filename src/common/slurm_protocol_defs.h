@@ -241,6 +241,9 @@ typedef enum {
 	RESPONSE_STATS_RESET,
 	REQUEST_JOB_USER_INFO,
 	REQUEST_NODE_INFO_SINGLE,
+	REQUEST_DRY_RUN,
+	RESPONSE_DRY_RUN,
+	RESPONSE_JOB_INFO_DELTA,
 
 	REQUEST_UPDATE_JOB = 3001,
 	REQUEST_UPDATE_NODE,
@@ -313,6 +316,7 @@ typedef enum {
 	REQUEST_FORWARD_DATA,
 	REQUEST_COMPLETE_BATCH_JOB,
 	REQUEST_SUSPEND_INT,
+	MESSAGE_SIM_HELPER_CYCLE_JOBS,
 
 	REQUEST_LAUNCH_TASKS = 6001,
 	RESPONSE_LAUNCH_TASKS,
@@ -1079,6 +1083,43 @@ typedef struct sim_helper_msg {
         uint32_t total_jobs_ended;
 } sim_helper_msg_t;
 
+/* One simulator helper cycle: every batch script ended in the cycle plus the
+ * cycle marker, so slurmctld gets a single RPC per simulated tick */
+typedef struct sim_helper_jobs_msg {
+	uint32_t total_jobs_ended;
+	uint32_t *job_ids;	/* total_jobs_ended ended batch jobs */
+} sim_helper_jobs_msg_t;
+
+/* Projection of the pending jobs' start times on a snapshot of slurmctld,
+ * NO_VAL leaving a setting as configured */
+typedef struct dry_run_msg {
+	uint32_t bf_window;		/* minutes, as SchedulerParameters */
+	uint32_t horizon;		/* minutes of projected time */
+	uint32_t max_time;		/* seconds the projection may take */
+	uint32_t priority_weight_age;	/* as PriorityWeightAge */
+} dry_run_msg_t;
+
+typedef struct dry_run_response_msg {
+	time_t snapshot_time;		/* time the projection started from */
+	time_t end_time;		/* time the projection reached */
+	uint32_t job_cnt;
+	uint32_t *job_ids;		/* jobs pending at snapshot_time */
+	time_t *start_times;		/* zero if not started by end_time */
+} dry_run_response_msg_t;
+
+/* Job records changed since the last_update of a SHOW_DELTA request, each
+ * one packed as in RESPONSE_JOB_INFO */
+typedef struct job_info_delta_msg {
+	time_t last_update;		/* time of the dump */
+	uint16_t full;			/* records replace all earlier ones */
+	uint32_t record_count;
+	uint32_t *job_ids;		/* job ID of each record */
+	char **records;			/* packed job_info_t records */
+	uint32_t *record_sizes;		/* size of each packed record */
+	uint32_t gone_count;
+	uint32_t *gone_ids;		/* jobs purged or no longer shown */
+} job_info_delta_msg_t;
+
 /*****************************************************************************\
  *	SLURM MESSAGE INITIALIZATION
 \*****************************************************************************/
@@ -1253,6 +1294,12 @@ extern void slurm_free_job_notify_msg(job_notify_msg_t * msg);
 extern void slurm_free_accounting_update_msg(accounting_update_msg_t *msg);
 extern void slurm_free_spank_env_request_msg(spank_env_request_msg_t *msg);
 extern void slurm_free_spank_env_responce_msg(spank_env_responce_msg_t *msg);
+extern void slurm_free_sim_job_msg(sim_job_msg_t *msg);
+extern void slurm_free_sim_helper_msg(sim_helper_msg_t *msg);
+extern void slurm_free_sim_helper_jobs_msg(sim_helper_jobs_msg_t *msg);
+extern void slurm_free_dry_run_msg(dry_run_msg_t *msg);
+extern void slurm_free_dry_run_response_msg(dry_run_response_msg_t *msg);
+extern void slurm_free_job_info_delta_msg(job_info_delta_msg_t *msg);
 extern void slurm_free_requeue_msg(requeue_msg_t *);
 extern int slurm_free_msg_data(slurm_msg_type_t type, void *data);
 extern void slurm_free_license_info_request_msg(license_info_request_msg_t *msg);
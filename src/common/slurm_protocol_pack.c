@@ -71,6 +71,7 @@
 #include "src/common/job_options.h"
 
 #define _pack_job_info_msg(msg,buf)		_pack_buffer_msg(msg,buf)
+#define _pack_job_info_delta_msg(msg,buf)	_pack_buffer_msg(msg,buf)
 #define _pack_job_step_info_msg(msg,buf)	_pack_buffer_msg(msg,buf)
 #define _pack_block_info_resp_msg(msg,buf)	_pack_buffer_msg(msg,buf)
 #define _pack_front_end_info_msg(msg,buf)	_pack_buffer_msg(msg,buf)
@@ -681,6 +682,17 @@ static void _pack_sim_job_msg(sim_job_msg_t *msg, Buf buffer);
 static void _pack_sim_helper_msg(sim_helper_msg_t *msg, Buf buffer);
 static int  _unpack_sim_job_msg(sim_job_msg_t **msg_ptr, Buf buffer);
 static int  _unpack_sim_helper_msg(sim_helper_msg_t **msg_ptr, Buf buffer);
+static void _pack_sim_helper_jobs_msg(sim_helper_jobs_msg_t *msg, Buf buffer);
+static int  _unpack_sim_helper_jobs_msg(sim_helper_jobs_msg_t **msg_ptr,
+					Buf buffer);
+static void _pack_dry_run_msg(dry_run_msg_t *msg, Buf buffer);
+static int  _unpack_dry_run_msg(dry_run_msg_t **msg_ptr, Buf buffer);
+static void _pack_dry_run_response_msg(dry_run_response_msg_t *msg,
+				       Buf buffer);
+static int  _unpack_dry_run_response_msg(dry_run_response_msg_t **msg_ptr,
+					 Buf buffer);
+static int  _unpack_job_info_delta_msg(job_info_delta_msg_t **msg_ptr,
+				       Buf buffer);
 
 /* pack_header
  * packs a slurm protocol header that precedes every slurm message
@@ -1032,6 +1044,20 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 	case MESSAGE_SIM_HELPER_CYCLE:
 		_pack_sim_helper_msg((sim_helper_msg_t *)msg->data, buffer);
 		break;
+	case MESSAGE_SIM_HELPER_CYCLE_JOBS:
+		_pack_sim_helper_jobs_msg((sim_helper_jobs_msg_t *)msg->data,
+					  buffer);
+		break;
+	case REQUEST_DRY_RUN:
+		_pack_dry_run_msg((dry_run_msg_t *)msg->data, buffer);
+		break;
+	case RESPONSE_DRY_RUN:
+		_pack_dry_run_response_msg((dry_run_response_msg_t *)msg->data,
+					   buffer);
+		break;
+	case RESPONSE_JOB_INFO_DELTA:
+		_pack_job_info_delta_msg((slurm_msg_t *) msg, buffer);
+		break;
 	case REQUEST_ABORT_JOB:
 	case REQUEST_KILL_PREEMPTED:
 	case REQUEST_KILL_TIMELIMIT:
@@ -1638,6 +1664,21 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 	case MESSAGE_SIM_HELPER_CYCLE:
 		_unpack_sim_helper_msg((sim_helper_msg_t **)&msg->data, buffer);
 		break;
+	case MESSAGE_SIM_HELPER_CYCLE_JOBS:
+		rc = _unpack_sim_helper_jobs_msg(
+			(sim_helper_jobs_msg_t **)&msg->data, buffer);
+		break;
+	case REQUEST_DRY_RUN:
+		rc = _unpack_dry_run_msg((dry_run_msg_t **)&msg->data, buffer);
+		break;
+	case RESPONSE_DRY_RUN:
+		rc = _unpack_dry_run_response_msg(
+			(dry_run_response_msg_t **)&msg->data, buffer);
+		break;
+	case RESPONSE_JOB_INFO_DELTA:
+		rc = _unpack_job_info_delta_msg(
+			(job_info_delta_msg_t **)&msg->data, buffer);
+		break;
 	case REQUEST_ABORT_JOB:
 	case REQUEST_KILL_PREEMPTED:
 	case REQUEST_KILL_TIMELIMIT:
@@ -10605,6 +10646,37 @@ static void _pack_sim_helper_msg(sim_helper_msg_t *msg, Buf buffer)
        pack32((uint32_t)msg->total_jobs_ended, buffer ) ;
 }
 
+static void _pack_sim_helper_jobs_msg(sim_helper_jobs_msg_t *msg, Buf buffer)
+{
+	xassert(msg != NULL);
+
+	pack32_array(msg->job_ids, msg->total_jobs_ended, buffer);
+}
+
+static void _pack_dry_run_msg(dry_run_msg_t *msg, Buf buffer)
+{
+	xassert(msg != NULL);
+
+	pack32(msg->bf_window, buffer);
+	pack32(msg->horizon, buffer);
+	pack32(msg->max_time, buffer);
+	pack32(msg->priority_weight_age, buffer);
+}
+
+static void _pack_dry_run_response_msg(dry_run_response_msg_t *msg,
+				       Buf buffer)
+{
+	uint32_t i;
+
+	xassert(msg != NULL);
+
+	pack_time(msg->snapshot_time, buffer);
+	pack_time(msg->end_time, buffer);
+	pack32_array(msg->job_ids, msg->job_cnt, buffer);
+	for (i = 0; i < msg->job_cnt; i++)
+		pack_time(msg->start_times[i], buffer);
+}
+
 static int  _unpack_suspend_msg(suspend_msg_t **msg_ptr, Buf buffer,
 				uint16_t protocol_version)
 {
@@ -10770,6 +10842,106 @@ unpack_error:
        return SLURM_ERROR;
 }
 
+static int  _unpack_sim_helper_jobs_msg(sim_helper_jobs_msg_t **msg_ptr,
+					Buf buffer)
+{
+	sim_helper_jobs_msg_t *msg;
+	xassert(msg_ptr != NULL);
+
+	msg = xmalloc(sizeof(sim_helper_jobs_msg_t));
+	*msg_ptr = msg;
+
+	safe_unpack32_array(&msg->job_ids, &msg->total_jobs_ended, buffer);
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_sim_helper_jobs_msg(msg);
+	*msg_ptr = NULL;
+	return SLURM_ERROR;
+}
+
+static int  _unpack_dry_run_msg(dry_run_msg_t **msg_ptr, Buf buffer)
+{
+	dry_run_msg_t *msg;
+	xassert(msg_ptr != NULL);
+
+	msg = xmalloc(sizeof(dry_run_msg_t));
+	*msg_ptr = msg;
+
+	safe_unpack32(&msg->bf_window, buffer);
+	safe_unpack32(&msg->horizon, buffer);
+	safe_unpack32(&msg->max_time, buffer);
+	safe_unpack32(&msg->priority_weight_age, buffer);
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_dry_run_msg(msg);
+	*msg_ptr = NULL;
+	return SLURM_ERROR;
+}
+
+static int  _unpack_dry_run_response_msg(dry_run_response_msg_t **msg_ptr,
+					 Buf buffer)
+{
+	dry_run_response_msg_t *msg;
+	uint32_t i;
+	xassert(msg_ptr != NULL);
+
+	msg = xmalloc(sizeof(dry_run_response_msg_t));
+	*msg_ptr = msg;
+
+	safe_unpack_time(&msg->snapshot_time, buffer);
+	safe_unpack_time(&msg->end_time, buffer);
+	safe_unpack32_array(&msg->job_ids, &msg->job_cnt, buffer);
+	msg->start_times = xmalloc(sizeof(time_t) * (msg->job_cnt + 1));
+	for (i = 0; i < msg->job_cnt; i++)
+		safe_unpack_time(&msg->start_times[i], buffer);
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_dry_run_response_msg(msg);
+	*msg_ptr = NULL;
+	return SLURM_ERROR;
+}
+
+static int  _unpack_job_info_delta_msg(job_info_delta_msg_t **msg_ptr,
+				       Buf buffer)
+{
+	job_info_delta_msg_t *msg;
+	uint32_t i;
+	xassert(msg_ptr != NULL);
+
+	msg = xmalloc(sizeof(job_info_delta_msg_t));
+	*msg_ptr = msg;
+
+	safe_unpack32(&msg->record_count, buffer);
+	safe_unpack_time(&msg->last_update, buffer);
+	safe_unpack16(&msg->full, buffer);
+	if (msg->record_count > remaining_buf(buffer))
+		goto unpack_error;
+	msg->job_ids = xmalloc(sizeof(uint32_t) * (msg->record_count + 1));
+	msg->records = xmalloc(sizeof(char *) * (msg->record_count + 1));
+	msg->record_sizes = xmalloc(sizeof(uint32_t) *
+				    (msg->record_count + 1));
+	for (i = 0; i < msg->record_count; i++) {
+		safe_unpack32(&msg->job_ids[i], buffer);
+		safe_unpackmem_xmalloc(&msg->records[i],
+				       &msg->record_sizes[i], buffer);
+	}
+	safe_unpack32(&msg->gone_count, buffer);
+	if (msg->gone_count > remaining_buf(buffer))
+		goto unpack_error;
+	msg->gone_ids = xmalloc(sizeof(uint32_t) * (msg->gone_count + 1));
+	for (i = 0; i < msg->gone_count; i++)
+		safe_unpack32(&msg->gone_ids[i], buffer);
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_job_info_delta_msg(msg);
+	*msg_ptr = NULL;
+	return SLURM_ERROR;
+}
+
 static void
 _pack_checkpoint_msg(checkpoint_msg_t *msg, Buf buffer,
 		     uint16_t protocol_version)
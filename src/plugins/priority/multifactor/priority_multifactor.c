@@ -75,9 +75,14 @@
 #include "src/common/parse_time.h"
 
 #include "src/slurmctld/locks.h"
+#include "src/slurmctld/prio_queue.h"
 
 #include "src/unittests_lib/tools.h"
 
+#ifdef SLURM_SIMULATOR
+#include "src/common/sim_sync.h"
+#endif
+
 
 #define SECS_PER_DAY	(24 * 60 * 60)
 #define SECS_PER_WEEK	(7 * SECS_PER_DAY)
@@ -1333,7 +1338,9 @@ static void *_decay_thread(void *no_data)
 
 				job_ptr->priority = _get_priority_internal(
 					start_time, job_ptr);
-				last_job_update = time(NULL);
+				prio_queue_job_update(job_ptr);
+				last_job_update = job_ptr->last_update =
+					time(NULL);
 				debug2("priority for job %u is now %u",
 				       job_ptr->job_id, job_ptr->priority);
 			}
@@ -1420,7 +1427,9 @@ static void *_decay_thread(void *no_data)
 
 				job_ptr->priority = _get_priority_internal(
 					start_time, job_ptr);
-				last_job_update = time(NULL);
+				prio_queue_job_update(job_ptr);
+				last_job_update = job_ptr->last_update =
+					time(NULL);
 				debug2("priority for job %u is now %u",
 				       job_ptr->job_id, job_ptr->priority);
 			}
@@ -1454,16 +1463,11 @@ static void _my_sleep_prio(int secs)
 #ifndef SLURM_SIMULATOR
 	sleep(secs);
 #else
-	/* Since the backfill and time controling loops are synced, we cannot make
-	 * the sleep depend on "faked time", because it does not change while the
-	 * backfilling is running... and _my_sleep is called form in there.
-	 */
-	if (secs==0)
+	/* Block until the simulated clock passes the deadline rather than
+	 * polling time(), which does not advance while the daemons step */
+	if (secs <= 0)
 		return;
-	time_t target_time=time(NULL)+secs;
-	while (time(NULL)<target_time)
-		usleep(10);
-
+	sim_sync_sleep_until(SIM_SYNC_NEXT_PRIO_DECAY, time(NULL) + secs);
 #endif
 }
 
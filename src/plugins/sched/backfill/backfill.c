@@ -81,6 +81,9 @@
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/srun_comm.h"
 #include "backfill.h"
+#include "bf_plan.h"
+#include "bf_timeline.h"
+#include "bf_worker.h"
 #include "src/unittests_lib/tools.h"
 
 #ifdef SLURM_SIMULATOR
@@ -89,6 +92,8 @@
 #include <semaphore.h>
 #include <pthread.h>
 #include "src/common/slurm_sim.h"
+#include "src/common/sim_sync.h"
+#include "src/slurmctld/sim_trace.h"
 #endif
 
 #ifndef BACKFILL_INTERVAL
@@ -113,12 +118,16 @@
 
 #define SLURMCTLD_THREAD_LIMIT	5
 
-typedef struct node_space_map {
-	time_t begin_time;
-	time_t end_time;
-	bitstr_t *avail_bitmap;
-	int next;	/* next record, by time, zero termination */
-} node_space_map_t;
+/* Job tests between lock yields when yielding on work count. The simulator
+ * always does, its clock does not advance during a backfill cycle */
+#ifdef SLURM_SIMULATOR
+#  define BF_YIELD_JOBS		20
+#else
+#  define BF_YIELD_JOBS		0
+#endif
+
+/* Queue entries scanned per worker thread for jobs to test ahead */
+#define BF_WORKER_LOOKAHEAD	8
 
 /* Diag statistics */
 extern diag_stats_t slurmctld_diag_stats;
@@ -137,19 +146,15 @@ static int backfill_window = BACKFILL_WINDOW;
 static int max_backfill_job_cnt = 100;
 static int max_backfill_job_per_part = 0;
 static int max_backfill_job_per_user = 0;
+static int backfill_yield_jobs = BF_YIELD_JOBS;
+static int backfill_threads = 0;
 static int max_backfill_jobs_start = 0;
 static bool backfill_continue = false;
+static bool backfill_incremental = false;
 static int defer_rpc_cnt = 0;
+static bf_plan_t *bf_plan = NULL;	/* of the last complete cycle */
 
-#ifdef SLURM_SIMULATOR
-char SEM_NAME[] 	= "serversem";
-sem_t* mutexserver	= SEM_FAILED;
-#endif
 /*********************** local functions *********************/
-static void _add_reservation(uint32_t start_time, uint32_t end_reserve,
-			     bitstr_t *res_bitmap,
-			     node_space_map_t *node_space,
-			     int *node_space_recs);
 static int  _attempt_backfill(void);
 static bool _job_is_completing(void);
 static void _load_config(void);
@@ -158,11 +163,8 @@ static bool _more_work(time_t last_backfill_time);
 static void _my_sleep(int secs);
 static int  _num_feature_count(struct job_record *job_ptr);
 static void _reset_job_time_limit(struct job_record *job_ptr, time_t now,
-				  node_space_map_t *node_space);
+				  bf_timeline_t *node_space);
 static int  _start_job(struct job_record *job_ptr, bitstr_t *avail_bitmap);
-static bool _test_resv_overlap(node_space_map_t *node_space,
-			       bitstr_t *use_bitmap, uint32_t start_time,
-			       uint32_t end_reserve);
 static int  _try_sched(struct job_record *job_ptr, bitstr_t **avail_bitmap,
 		       uint32_t min_nodes, uint32_t max_nodes,
 		       uint32_t req_nodes, bitstr_t *exc_core_bitmap);
@@ -195,28 +197,6 @@ static void _dump_job_test(struct job_record *job_ptr, bitstr_t *avail_bitmap,
 	xfree(node_list);
 }
 
-/* Log resource allocate table */
-static void _dump_node_space_table(node_space_map_t *node_space_ptr)
-{
-	int i = 0;
-	char begin_buf[32], end_buf[32], *node_list;
-
-	info("=========================================");
-	while (1) {
-		slurm_make_time_str(&node_space_ptr[i].begin_time,
-				    begin_buf, sizeof(begin_buf));
-		slurm_make_time_str(&node_space_ptr[i].end_time,
-				    end_buf, sizeof(end_buf));
-		node_list = bitmap2node_name(node_space_ptr[i].avail_bitmap);
-		info("Begin:%s End:%s Nodes:%s",
-		     begin_buf, end_buf, node_list);
-		xfree(node_list);
-		if ((i = node_space_ptr[i].next) == 0)
-			break;
-	}
-	info("=========================================");
-}
-
 /*
  * _job_is_completing - Determine if jobs are in the process of completing.
  *	This is a variant of job_is_completing in slurmctld/job_scheduler.c.
@@ -514,6 +494,13 @@ static void _load_config(void)
 		backfill_continue = true;
 	}
 
+	/* bf_incremental makes backfill replay the plan of its previous
+	 * cycle for jobs whose state did not change, see bf_plan.h */
+	if (sched_params && (strstr(sched_params, "bf_incremental")))
+		backfill_incremental = true;
+	else
+		backfill_incremental = false;
+
 	if (sched_params && (tmp_ptr=strstr(sched_params, "max_rpc_cnt=")))
 		defer_rpc_cnt = atoi(tmp_ptr + 12);
 	if (defer_rpc_cnt < 0) {
@@ -522,6 +509,40 @@ static void _load_config(void)
 		defer_rpc_cnt = 0;
 	}
 
+	backfill_yield_jobs = BF_YIELD_JOBS;
+	if (sched_params && (tmp_ptr=strstr(sched_params, "bf_yield_jobs=")))
+		backfill_yield_jobs = atoi(tmp_ptr + 14);
+	if (backfill_yield_jobs < 0) {
+		error("Invalid SchedulerParameters bf_yield_jobs: %d",
+		      backfill_yield_jobs);
+		backfill_yield_jobs = BF_YIELD_JOBS;
+	}
+#ifdef SLURM_SIMULATOR
+	if (backfill_yield_jobs == 0) {
+		error("SchedulerParameters bf_yield_jobs=0 not supported by "
+		      "the simulator, using %d", BF_YIELD_JOBS);
+		backfill_yield_jobs = BF_YIELD_JOBS;
+	}
+#endif
+
+	backfill_threads = 0;
+	if (sched_params && (tmp_ptr=strstr(sched_params, "bf_threads=")))
+		backfill_threads = atoi(tmp_ptr + 11);
+	if (backfill_threads < 0) {
+		error("Invalid SchedulerParameters bf_threads: %d",
+		      backfill_threads);
+		backfill_threads = 0;
+	}
+	/* Other select plugins are not known to allow concurrent tests */
+	if (backfill_threads &&
+	    xstrcmp(slurmctld_conf.select_type, "select/cons_res") &&
+	    xstrcmp(slurmctld_conf.select_type, "select/linear")) {
+		error("SchedulerParameters bf_threads not supported by %s",
+		      slurmctld_conf.select_type);
+		backfill_threads = 0;
+	}
+	bf_worker_start(backfill_threads, _try_sched);
+
 	xfree(sched_params);
 }
 
@@ -559,59 +580,20 @@ static void _do_diag_stats(struct timeval *tv1, struct timeval *tv2,
 }
 
 #ifdef SLURM_SIMULATOR
-int
-open_global_sync_sem() {
-	int iter = 0;
-	while(mutexserver == SEM_FAILED && iter < 10) {
-		mutexserver = sem_open(SEM_NAME, 0, 0644, 0);
-		if(mutexserver == SEM_FAILED) sleep(1);
-		++iter;
-	}
-
-	if(mutexserver == SEM_FAILED)
-		return -1;
-	else
-		return 0;
-}
-
-void
-perform_global_sync() {
-	while(*global_sync_flag < 2 || *global_sync_flag > 4) {
-		usleep(100000);
-	}
-	sem_wait(mutexserver);
-	*global_sync_flag += 1;
-	if(*global_sync_flag > 4) {*global_sync_flag = 1;}
-	sem_post(mutexserver);
-}
 
-void
-close_global_sync_sem() {
-	if(mutexserver != SEM_FAILED) sem_close(mutexserver);
-}
-#endif
-
-
-
-#ifdef SLURM_SIMULATOR
-
-char BF_SEM_NAME[] = "bf_sem";
-char BF_DONE_SEM_NAME[] = "bf_done_sem";
 sem_t* mutex_bf_pg=NULL;
 sem_t* mutex_bf_done_pg=NULL;
 
 int open_BF_sync_semaphore_pg() {
-	mutex_bf_pg = sem_open(BF_SEM_NAME, O_CREAT, 0644, 0);
+	mutex_bf_pg = sim_sync_sem_open(SIM_SYNC_BF_SEM);
 	if(mutex_bf_pg == SEM_FAILED) {
 		error("unable to create backfill semaphore");
-		sem_unlink(BF_SEM_NAME);
 		return -1;
 	}
 
-	mutex_bf_done_pg = sem_open(BF_DONE_SEM_NAME, O_CREAT, 0644, 0);
+	mutex_bf_done_pg = sim_sync_sem_open(SIM_SYNC_BF_DONE_SEM);
 	if(mutex_bf_done_pg == SEM_FAILED) {
 		error("unable to create backfill done semaphore");
-		sem_unlink(BF_DONE_SEM_NAME);
 		return -1;
 	}
 
@@ -634,10 +616,11 @@ extern void *backfill_agent(void *args)
 	slurmctld_lock_t all_locks = {
 		READ_LOCK, WRITE_LOCK, WRITE_LOCK, READ_LOCK };
 
-	open_global_sync_sem();
 	_load_config();
 	last_backfill_time = time(NULL);
 #ifdef SLURM_SIMULATOR
+	sim_sync_attach(SIM_SYNC_BACKFILL);
+	sim_trace_set_sched(SIM_TRACE_SCHED_BACKFILL);
 	open_BF_sync_semaphore_pg();
 	backfill_interval=2;
 #endif
@@ -677,13 +660,29 @@ extern void *backfill_agent(void *args)
 #endif
 
 	}
+	bf_worker_fini();
 #ifdef SLURM_SIMULATOR
 	close_BF_sync_semaphore();
+	sim_sync_step(SIM_SYNC_BACKFILL);
+	sim_sync_close(SIM_SYNC_BACKFILL);
 #endif
-	perform_global_sync(); /* st on 20151020 */
 	return NULL;
 }
 
+/* Return true if the backfill scheduler should yield its locks. With
+ * bf_yield_jobs, after that many job tests whatever the time spent or the
+ * RPC load, so that the schedule is reproducible. Otherwise after
+ * sched_timeout seconds or once max_rpc_cnt RPCs are pending. */
+static bool _yield_due(time_t sched_start, int sched_timeout, int yield_work)
+{
+	if (backfill_yield_jobs)
+		return (yield_work >= backfill_yield_jobs);
+	if ((defer_rpc_cnt > 0) &&
+	    (slurmctld_config.server_thread_count >= defer_rpc_cnt))
+		return true;
+	return ((time(NULL) - sched_start) >= sched_timeout);
+}
+
 /* Return non-zero to break the backfill loop if change in job, node or
  * partition state or the backfill scheduler needs to be stopped. */
 static int _yield_locks(int secs)
@@ -710,6 +709,122 @@ static int _yield_locks(int secs)
 		return 1;
 }
 
+/* Determine a job's minimum, maximum and requested node counts in a
+ * partition, RET false if it can not run there */
+static bool _job_node_cnts(struct job_record *job_ptr,
+			   struct part_record *part_ptr, uint32_t *min_nodes,
+			   uint32_t *max_nodes, uint32_t *req_nodes)
+{
+	*min_nodes = MAX(job_ptr->details->min_nodes, part_ptr->min_nodes);
+	if (job_ptr->details->max_nodes == 0)
+		*max_nodes = part_ptr->max_nodes;
+	else
+		*max_nodes = MIN(job_ptr->details->max_nodes,
+				 part_ptr->max_nodes);
+	*max_nodes = MIN(*max_nodes, 500000);	/* prevent overflows */
+	if (job_ptr->details->max_nodes)
+		*req_nodes = *max_nodes;
+	else
+		*req_nodes = *min_nodes;
+
+	return (*min_nodes <= *max_nodes);
+}
+
+/* Determine a job's time limit in a partition, in minutes */
+static uint32_t _job_time_limit(struct job_record *job_ptr,
+				struct part_record *part_ptr)
+{
+	uint32_t part_time_limit;
+
+	if (part_ptr->max_time == INFINITE)
+		part_time_limit = 365 * 24 * 60; /* one year */
+	else
+		part_time_limit = part_ptr->max_time;
+	if (job_ptr->time_limit == NO_VAL)
+		return part_time_limit;
+	if (part_ptr->max_time == INFINITE)
+		return job_ptr->time_limit;
+	return MIN(job_ptr->time_limit, part_time_limit);
+}
+
+/*
+ * Queue for the worker threads the tests of the jobs following the one at
+ * position queue_pos, offered the nodes they would get at once as things
+ * stand. Jobs which would not be tested at once, or whose time limit the
+ * backfill scheduler changes, are left out.
+ */
+static void _worker_fill(List job_queue, uint32_t queue_pos,
+			 struct job_record *cur_job_ptr,
+			 bf_timeline_t *node_space, bitstr_t *non_cg_bitmap,
+			 time_t now, bool filter_root)
+{
+	ListIterator job_iterator;
+	job_queue_rec_t *job_queue_rec;
+	struct job_record *job_ptr;
+	struct part_record *part_ptr;
+	slurmdb_qos_rec_t *qos_ptr;
+	uint32_t min_nodes, max_nodes, req_nodes, time_limit;
+	bitstr_t *avail_bitmap = NULL, *exc_core_bitmap = NULL;
+	time_t start_res, later_start;
+	int scan_cnt = backfill_threads * BF_WORKER_LOOKAHEAD;
+	bool queued = true;
+
+	job_iterator = list_iterator_create(job_queue);
+	while (queued && (scan_cnt-- > 0) &&
+	       (job_queue_rec = (job_queue_rec_t *) list_next(job_iterator))) {
+		queue_pos++;
+		job_ptr  = job_queue_rec->job_ptr;
+		part_ptr = job_queue_rec->part_ptr;
+		if ((job_ptr->magic  != JOB_MAGIC) ||
+		    (job_ptr->job_id != job_queue_rec->job_id) ||
+		    (job_ptr == cur_job_ptr) || !IS_JOB_PENDING(job_ptr) ||
+		    job_ptr->preempt_in_progress || job_ptr->resv_name ||
+		    job_ptr->time_min || bf_worker_busy(job_ptr))
+			continue;
+		qos_ptr = job_ptr->qos_ptr;
+		if (qos_ptr && (qos_ptr->flags & QOS_FLAG_NO_RESERVE))
+			continue;
+		if (((part_ptr->state_up & PARTITION_SCHED) == 0) ||
+		    (part_ptr->node_bitmap == NULL) ||
+		    ((part_ptr->flags & PART_FLAG_ROOT_ONLY) && filter_root))
+			continue;
+		if (!_job_node_cnts(job_ptr, part_ptr, &min_nodes, &max_nodes,
+				    &req_nodes))
+			continue;
+		time_limit = _job_time_limit(job_ptr, part_ptr);
+
+		start_res = now;
+		if ((job_test_resv(job_ptr, &start_res, true, &avail_bitmap,
+				   &exc_core_bitmap) != SLURM_SUCCESS) ||
+		    (start_res > now))
+			goto next;
+		bit_and(avail_bitmap, part_ptr->node_bitmap);
+		bit_and(avail_bitmap, up_node_bitmap);
+		bit_and(avail_bitmap, non_cg_bitmap);
+		if (!bf_timeline_and(node_space, start_res,
+				     (time_limit * 60) + now, min_nodes,
+				     avail_bitmap, &later_start))
+			goto next;
+		if (job_ptr->details->exc_node_bitmap) {
+			bit_and_not(avail_bitmap,
+				    job_ptr->details->exc_node_bitmap);
+		}
+		if ((bit_set_count(avail_bitmap) < min_nodes) ||
+		    ((job_ptr->details->req_node_bitmap) &&
+		     (!bit_super_set(job_ptr->details->req_node_bitmap,
+				     avail_bitmap))) ||
+		    (job_req_node_filter(job_ptr, avail_bitmap)))
+			goto next;
+
+		queued = bf_worker_submit(queue_pos, job_ptr, part_ptr,
+					  avail_bitmap, exc_core_bitmap,
+					  min_nodes, max_nodes, req_nodes);
+ next:		FREE_NULL_BITMAP(avail_bitmap);
+		FREE_NULL_BITMAP(exc_core_bitmap);
+	}
+	list_iterator_destroy(job_iterator);
+}
+
 static int _attempt_backfill(void)
 {
 	DEF_TIMERS;
@@ -717,26 +832,28 @@ static int _attempt_backfill(void)
 	List job_queue;
 	job_queue_rec_t *job_queue_rec;
 	slurmdb_qos_rec_t *qos_ptr = NULL;
-	int i, j, node_space_recs;
+	int i, j;
+	bool avail_ok;
 	struct job_record *job_ptr;
 	struct part_record *part_ptr, **bf_part_ptr = NULL;
 	uint32_t end_time, end_reserve;
-	uint32_t time_limit, comp_time_limit, orig_time_limit, part_time_limit;
+	uint32_t time_limit, comp_time_limit, orig_time_limit;
 	uint32_t min_nodes, max_nodes, req_nodes;
 	bitstr_t *avail_bitmap = NULL, *resv_bitmap = NULL;
 	bitstr_t *exc_core_bitmap = NULL, *non_cg_bitmap = NULL;
+	bitstr_t *free_bitmap = NULL;
+	bf_plan_t *old_plan = NULL, *new_plan = NULL;
+	bool reserved, tested;
+	uint32_t queue_pos = 0;
 	time_t now, sched_start, later_start, start_res, resv_end, window_end;
-	node_space_map_t *node_space;
+	bf_timeline_t *node_space;
 	struct timeval bf_time1, bf_time2;
 	int sched_timeout = 2, yield_sleep = 1;
 	int rc = 0;
-	int job_test_count = 0;
+	int job_test_count = 0, yield_work = 0;
 	uint32_t *uid = NULL, nuser = 0, bf_parts = 0, *bf_part_jobs = NULL;
 	uint16_t *njobs = NULL;
 	bool already_counted;
-#ifdef SLURM_SIMULATOR
-       int local_loops;
-#endif
 	uint32_t reject_array_job_id = 0;
 	struct part_record *reject_array_part = NULL;
 	uint32_t job_start_cnt = 0, start_time;
@@ -781,6 +898,8 @@ static int _attempt_backfill(void)
 		else
 			debug("backfill: no jobs to backfill");
 		list_destroy(job_queue);
+		bf_plan_destroy(bf_plan);
+		bf_plan = NULL;
 		return 0;
 	}
 
@@ -789,6 +908,20 @@ static int _attempt_backfill(void)
 	non_cg_bitmap = bit_copy(cg_node_bitmap);
 	bit_not(non_cg_bitmap);
 
+	if (backfill_incremental) {
+		old_plan = bf_plan_check(bf_plan);
+		new_plan = bf_plan_create();
+		if (old_plan) {
+			free_bitmap = bit_copy(idle_node_bitmap);
+			bit_or(free_bitmap, share_node_bitmap);
+			bit_and(free_bitmap, up_node_bitmap);
+			bit_and(free_bitmap, non_cg_bitmap);
+		}
+	} else {
+		bf_plan_destroy(bf_plan);
+	}
+	bf_plan = NULL;
+
 	slurmctld_diag_stats.bf_queue_len = list_count(job_queue);
 	slurmctld_diag_stats.bf_queue_len_sum += slurmctld_diag_stats.
 						 bf_queue_len;
@@ -797,16 +930,11 @@ static int _attempt_backfill(void)
 	slurmctld_diag_stats.bf_when_last_cycle = now;
 	slurmctld_diag_stats.bf_active = 1;
 
-	node_space = xmalloc(sizeof(node_space_map_t) *
-			     (max_backfill_job_cnt * 2 + 1));
-	node_space[0].begin_time = sched_start;
 	window_end = sched_start + backfill_window;
-	node_space[0].end_time = window_end;
-	node_space[0].avail_bitmap = bit_copy(avail_node_bitmap);
-	node_space[0].next = 0;
-	node_space_recs = 1;
+	node_space = bf_timeline_create(sched_start, window_end,
+					avail_node_bitmap);
 	if (debug_flags & DEBUG_FLAG_BACKFILL_MAP)
-		_dump_node_space_table(node_space);
+		bf_timeline_log(node_space);
 
 	if (max_backfill_job_per_part) {
 		ListIterator part_iterator;
@@ -834,11 +962,10 @@ static int _attempt_backfill(void)
 				info("backfill: reached end of job queue");
 			break;
 		}
+		queue_pos++;
 		if (slurmctld_config.shutdown_time)
 			break;
-		if (((defer_rpc_cnt > 0) &&
-		     (slurmctld_config.server_thread_count >= defer_rpc_cnt)) ||
-		    ((time(NULL) - sched_start) >= sched_timeout)) {
+		if (_yield_due(sched_start, sched_timeout, yield_work)) {
 			if (debug_flags & DEBUG_FLAG_BACKFILL) {
 				END_TIMER;
 				info("backfill: completed yielding locks "
@@ -846,6 +973,7 @@ static int _attempt_backfill(void)
 				     slurmctld_diag_stats.bf_last_depth,
 				     job_test_count, TIME_STR);
 			}
+			bf_worker_discard();
 			if ((_yield_locks(yield_sleep) && !backfill_continue) ||
 			    (slurmctld_conf.last_update != config_update) ||
 			    (last_part_update != part_update)) {
@@ -863,12 +991,18 @@ static int _attempt_backfill(void)
 			/* cg_node_bitmap may be changed */
 			bit_copybits(non_cg_bitmap, cg_node_bitmap);
 			bit_not(non_cg_bitmap);
+			/* So may any job, stop replaying the old plan */
+			bf_plan_destroy(old_plan);
+			old_plan = NULL;
 			/* Reset backfill scheduling timers, resume testing */
 			sched_start = time(NULL);
 			job_test_count = 0;
+			yield_work = 0;
 			START_TIMER;
 		}
 		job_ptr  = job_queue_rec->job_ptr;
+		if (bf_worker_enabled())
+			bf_worker_reach(queue_pos, job_ptr);
 		/* With bf_continue configured, the original job could have
 		 * been cancelled and purged. Validate pointer here. */
 		if ((job_ptr->magic  != JOB_MAGIC) ||
@@ -989,19 +1123,8 @@ static int _attempt_backfill(void)
 		}
 
 		/* Determine minimum and maximum node counts */
-		min_nodes = MAX(job_ptr->details->min_nodes,
-				part_ptr->min_nodes);
-		if (job_ptr->details->max_nodes == 0)
-			max_nodes = part_ptr->max_nodes;
-		else
-			max_nodes = MIN(job_ptr->details->max_nodes,
-					part_ptr->max_nodes);
-		max_nodes = MIN(max_nodes, 500000);     /* prevent overflows */
-		if (job_ptr->details->max_nodes)
-			req_nodes = max_nodes;
-		else
-			req_nodes = min_nodes;
-		if (min_nodes > max_nodes) {
+		if (!_job_node_cnts(job_ptr, part_ptr, &min_nodes, &max_nodes,
+				    &req_nodes)) {
 			if (debug_flags & DEBUG_FLAG_BACKFILL)
 				info("backfill: job %u node count too high",
 				     job_ptr->job_id);
@@ -1009,19 +1132,7 @@ static int _attempt_backfill(void)
 		}
 
 		/* Determine job's expected completion time */
-		if (part_ptr->max_time == INFINITE)
-			part_time_limit = 365 * 24 * 60; /* one year */
-		else
-			part_time_limit = part_ptr->max_time;
-		if (job_ptr->time_limit == NO_VAL) {
-			time_limit = part_time_limit;
-		} else {
-			if (part_ptr->max_time == INFINITE)
-				time_limit = job_ptr->time_limit;
-			else
-				time_limit = MIN(job_ptr->time_limit,
-						 part_time_limit);
-		}
+		time_limit = _job_time_limit(job_ptr, part_ptr);
 		comp_time_limit = time_limit;
 		qos_ptr = job_ptr->qos_ptr;
 		if (qos_ptr && (qos_ptr->flags & QOS_FLAG_NO_RESERVE) &&
@@ -1030,18 +1141,32 @@ static int _attempt_backfill(void)
 		else if (job_ptr->time_min && (job_ptr->time_min < time_limit))
 			time_limit = job_ptr->time_limit = job_ptr->time_min;
 
+		if (old_plan &&
+		    bf_plan_replay(old_plan, job_ptr, part_ptr,
+				   orig_time_limit, time_limit, min_nodes,
+				   max_nodes, node_space, free_bitmap, now,
+				   new_plan, &reserved)) {
+			if (debug_flags & DEBUG_FLAG_BACKFILL)
+				info("backfill: job %u replayed from plan",
+				     job_ptr->job_id);
+			job_ptr->time_limit = orig_time_limit;
+			if (reserved) {
+				reject_array_job_id = 0;
+				reject_array_part   = NULL;
+			}
+			continue;
+		}
+		if (new_plan) {
+			bf_plan_add(new_plan, job_ptr, part_ptr,
+				    orig_time_limit, min_nodes, max_nodes);
+		}
+
 		/* Determine impact of any resource reservations */
 		later_start = now;
  TRY_LATER:
 		if (slurmctld_config.shutdown_time)
 			break;
-#ifndef SLURM_SIMULATOR
-		if (((defer_rpc_cnt > 0) &&
-		     (slurmctld_config.server_thread_count >= defer_rpc_cnt)) ||
-		    ((time(NULL) - sched_start) >= sched_timeout)) {
-#else
-			if (local_loops == 20) {
-#endif
+		if (_yield_due(sched_start, sched_timeout, yield_work)) {
 			uint32_t save_job_id = job_ptr->job_id;
 			uint32_t save_time_limit = job_ptr->time_limit;
 			job_ptr->time_limit = orig_time_limit;
@@ -1052,6 +1177,7 @@ static int _attempt_backfill(void)
 				     slurmctld_diag_stats.bf_last_depth,
 				     job_test_count, TIME_STR);
 			}
+			bf_worker_discard();
 			if ((_yield_locks(yield_sleep) && !backfill_continue) ||
 			    (slurmctld_conf.last_update != config_update) ||
 			    (last_part_update != part_update)) {
@@ -1065,12 +1191,12 @@ static int _attempt_backfill(void)
 				rc = 1;
 				break;
 			}
-#ifdef SLURM_SIMULATOR
-                       local_loops = 0;
-#endif
 			/* cg_node_bitmap may be changed */
 			bit_copybits(non_cg_bitmap, cg_node_bitmap);
 			bit_not(non_cg_bitmap);
+			/* So may any job, stop replaying the old plan */
+			bf_plan_destroy(old_plan);
+			old_plan = NULL;
 
 			/* With bf_continue configured, the original job could
 			 * have been scheduled or cancelled and purged.
@@ -1087,11 +1213,10 @@ static int _attempt_backfill(void)
 			/* Reset backfill scheduling timers, resume testing */
 			sched_start = time(NULL);
 			job_test_count = 1;
+			yield_work = 0;
 			START_TIMER;
 		}
-#ifdef SLURM_SIMULATOR
-               local_loops++;
-#endif
+		yield_work++;
 		FREE_NULL_BITMAP(avail_bitmap);
 		FREE_NULL_BITMAP(exc_core_bitmap);
 		start_res   = later_start;
@@ -1114,30 +1239,17 @@ static int _attempt_backfill(void)
 		bit_and(avail_bitmap, part_ptr->node_bitmap);
 		bit_and(avail_bitmap, up_node_bitmap);
 		bit_and(avail_bitmap, non_cg_bitmap);
-		for (j=0; ; ) {
-			if ((node_space[j].end_time > start_res) &&
-			     node_space[j].next && (later_start == 0))
-				later_start = node_space[j].end_time;
-			if (node_space[j].end_time <= start_res)
-				;
-			else if (node_space[j].begin_time <= end_time) {
-				bit_and(avail_bitmap,
-					node_space[j].avail_bitmap);
-			} else
-				break;
-			if ((j = node_space[j].next) == 0)
-				break;
-		}
+		avail_ok = bf_timeline_and(node_space, start_res, end_time,
+					   min_nodes, avail_bitmap,
+					   &later_start);
 		if (resv_end && (++resv_end < window_end) &&
 		    ((later_start == 0) || (resv_end < later_start))) {
 			later_start = resv_end;
 		}
 
-		if (job_ptr->details->exc_node_bitmap) {
-			bit_not(job_ptr->details->exc_node_bitmap);
-			bit_and(avail_bitmap,
-				job_ptr->details->exc_node_bitmap);
-			bit_not(job_ptr->details->exc_node_bitmap);
+		if (avail_ok && job_ptr->details->exc_node_bitmap) {
+			bit_and_not(avail_bitmap,
+				    job_ptr->details->exc_node_bitmap);
 		}
 
 		/* Test if insufficient nodes remain OR
@@ -1145,17 +1257,15 @@ static int _attempt_backfill(void)
 		 *	nodes lack features OR
 		 *	no change since previously tested nodes (only changes
 		 *	in other partition nodes) */
-		if ((bit_set_count(avail_bitmap) < min_nodes) ||
+		if (!avail_ok || (bit_set_count(avail_bitmap) < min_nodes) ||
 		    ((job_ptr->details->req_node_bitmap) &&
 		     (!bit_super_set(job_ptr->details->req_node_bitmap,
 				     avail_bitmap))) ||
 		    (job_req_node_filter(job_ptr, avail_bitmap))) {
-#ifndef SLURM_SIMULATOR
 			if (later_start) {
 				job_ptr->start_time = 0;
 				goto TRY_LATER;
 			}
-#endif
 
 			/* Job can not start until too far in the future */
 			job_ptr->time_limit = orig_time_limit;
@@ -1164,8 +1274,10 @@ static int _attempt_backfill(void)
 		}
 
 		/* Identify nodes which are definitely off limits */
-		FREE_NULL_BITMAP(resv_bitmap);
-		resv_bitmap = bit_copy(avail_bitmap);
+		if (resv_bitmap)
+			bit_scratch_free(resv_bitmap);
+		resv_bitmap = bit_scratch_alloc(bit_size(avail_bitmap));
+		bit_copybits(resv_bitmap, avail_bitmap);
 		bit_not(resv_bitmap);
 
 		/* this is the time consuming operation */
@@ -1179,8 +1291,19 @@ static int _attempt_backfill(void)
 
 		if (debug_flags & DEBUG_FLAG_BACKFILL_MAP)
 			_dump_job_test(job_ptr, avail_bitmap, start_res);
-		j = _try_sched(job_ptr, &avail_bitmap, min_nodes, max_nodes,
-			       req_nodes, exc_core_bitmap);
+		tested = false;
+		if (bf_worker_enabled()) {
+			tested = bf_worker_take(queue_pos, job_ptr, part_ptr,
+						&avail_bitmap, exc_core_bitmap,
+						min_nodes, max_nodes,
+						req_nodes, &j);
+			_worker_fill(job_queue, queue_pos, job_ptr, node_space,
+				     non_cg_bitmap, now, filter_root);
+		}
+		if (!tested) {
+			j = _try_sched(job_ptr, &avail_bitmap, min_nodes,
+				       max_nodes, req_nodes, exc_core_bitmap);
+		}
 
 		now = time(NULL);
 		if (j != SLURM_SUCCESS) {
@@ -1191,13 +1314,17 @@ static int _attempt_backfill(void)
 
 		if (start_res > job_ptr->start_time) {
 			job_ptr->start_time = start_res;
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
 		}
 		if (job_ptr->start_time <= now) {	/* Can start now */
 			uint32_t save_time_limit = job_ptr->time_limit;
 			uint32_t hard_limit;
 			bool reset_time = false;
-			int rc = _start_job(job_ptr, resv_bitmap);
+			int rc;
+
+			/* Starting the job changes what workers read */
+			bf_worker_discard();
+			rc = _start_job(job_ptr, resv_bitmap);
 			if (qos_ptr && (qos_ptr->flags & QOS_FLAG_NO_RESERVE)) {
 				if (orig_time_limit == NO_VAL) {
 					acct_policy_alter_job(
@@ -1252,6 +1379,8 @@ static int _attempt_backfill(void)
 				/* Started this job, move to next one */
 				reject_array_job_id = 0;
 				reject_array_part   = NULL;
+				if (new_plan)
+					bf_plan_started(new_plan);
 
 				/* Update the database if job time limit
 				 * changed and move to next job */
@@ -1280,14 +1409,12 @@ static int _attempt_backfill(void)
 			      backfill_resolution;
 		end_reserve = (end_reserve / backfill_resolution) *
 			      backfill_resolution;
-#ifndef SLURM_SIMULATOR
 		if (later_start && (start_time > later_start)) {
 			/* Try later when some nodes currently reserved for
 			 * pending jobs are free */
 			job_ptr->start_time = 0;
 			goto TRY_LATER;
 		}
-#endif
 
 		if (job_ptr->start_time > (sched_start + backfill_window)) {
 			/* Starts too far in the future to worry about */
@@ -1297,7 +1424,7 @@ static int _attempt_backfill(void)
 			continue;
 		}
 
-		if (node_space_recs >= max_backfill_job_cnt) {
+		if (node_space->split_cnt >= max_backfill_job_cnt) {
 			if (debug_flags & DEBUG_FLAG_BACKFILL) {
 				info("backfill: table size limit of %u reached",
 				     max_backfill_job_cnt);
@@ -1305,10 +1432,9 @@ static int _attempt_backfill(void)
 			break;
 		}
 
-#ifndef SLURM_SIMULATOR
 		if ((job_ptr->start_time > now) &&
-		    _test_resv_overlap(node_space, avail_bitmap,
-				       start_time, end_reserve)) {
+		    bf_timeline_overlap(node_space, start_time, end_reserve,
+					avail_bitmap)) {
 			/* This job overlaps with an existing reservation for
 			 * job to be backfill scheduled, which the sched
 			 * plugin does not know about. Try again later. */
@@ -1316,7 +1442,6 @@ static int _attempt_backfill(void)
 			job_ptr->start_time = 0;
 			goto TRY_LATER;
 		}
-#endif
 
 		/*
 		 * Add reservation to scheduling table if appropriate
@@ -1327,11 +1452,15 @@ static int _attempt_backfill(void)
 			continue;
 		reject_array_job_id = 0;
 		reject_array_part   = NULL;
+		if (new_plan) {
+			bf_plan_reserve(new_plan, job_ptr->start_time,
+					start_time, end_reserve, avail_bitmap);
+		}
 		bit_not(avail_bitmap);
-		_add_reservation(start_time, end_reserve,
-				 avail_bitmap, node_space, &node_space_recs);
+		bf_timeline_add(node_space, start_time, end_reserve,
+				avail_bitmap);
 		if (debug_flags & DEBUG_FLAG_BACKFILL_MAP)
-			_dump_node_space_table(node_space);
+			bf_timeline_log(node_space);
 	}
 	xfree(bf_part_jobs);
 	xfree(bf_part_ptr);
@@ -1339,15 +1468,23 @@ static int _attempt_backfill(void)
 	xfree(njobs);
 	FREE_NULL_BITMAP(avail_bitmap);
 	FREE_NULL_BITMAP(exc_core_bitmap);
-	FREE_NULL_BITMAP(resv_bitmap);
+	if (resv_bitmap)
+		bit_scratch_free(resv_bitmap);
 	FREE_NULL_BITMAP(non_cg_bitmap);
-
-	for (i=0; ; ) {
-		FREE_NULL_BITMAP(node_space[i].avail_bitmap);
-		if ((i = node_space[i].next) == 0)
-			break;
+	FREE_NULL_BITMAP(free_bitmap);
+	bf_worker_discard();
+	if (debug_flags & DEBUG_FLAG_BACKFILL)
+		bf_worker_log_stats();
+	bf_timeline_destroy(node_space);
+	if (new_plan && (rc == 0)) {
+		/* Kept for the next cycle, a full rebuild now and then */
+		if (old_plan)
+			new_plan->cycle_cnt = old_plan->cycle_cnt + 1;
+		bf_plan = new_plan;
+	} else {
+		bf_plan_destroy(new_plan);
 	}
-	xfree(node_space);
+	bf_plan_destroy(old_plan);
 	list_destroy(job_queue);
 	gettimeofday(&bf_time2, NULL);
 	_do_diag_stats(&bf_time1, &bf_time2, yield_sleep);
@@ -1381,7 +1518,7 @@ static int _start_job(struct job_record *job_ptr, bitstr_t *resv_bitmap)
 		FREE_NULL_BITMAP(orig_exc_nodes);
 	if (rc == SLURM_SUCCESS) {
 		/* job initiated */
-		last_job_update = time(NULL);
+		last_job_update = job_ptr->last_update = time(NULL);
 		info("backfill: Started JobId=%u on %s",
 		     job_ptr->job_id, job_ptr->nodes);
 		if (job_ptr->batch_flag == 0)
@@ -1420,25 +1557,28 @@ static int _start_job(struct job_record *job_ptr, bitstr_t *resv_bitmap)
  *	Avoid using resources reserved for pending jobs or in resource
  *	reservations */
 static void _reset_job_time_limit(struct job_record *job_ptr, time_t now,
-				  node_space_map_t *node_space)
+				  bf_timeline_t *node_space)
 {
 	int32_t j, resv_delay;
 	uint32_t orig_time_limit = job_ptr->time_limit;
 	uint32_t new_time_limit;
+	bf_slot_t *slot;
 
-	for (j=0; ; ) {
-		if ((node_space[j].begin_time != now) &&
-		    (node_space[j].begin_time < job_ptr->end_time) &&
+	/* Slots are by time, the first overlap found is the earliest */
+	for (j = 0; j < node_space->slot_cnt; j++) {
+		slot = node_space->slots + j;
+		if (slot->begin_time >= job_ptr->end_time)
+			break;
+		if ((slot->begin_time != now) &&
 		    (!bit_super_set(job_ptr->node_bitmap,
-				    node_space[j].avail_bitmap))) {
+				    slot->nodes->bitmap))) {
 			/* Job overlaps pending job's resource reservation */
-			resv_delay = difftime(node_space[j].begin_time, now);
+			resv_delay = difftime(slot->begin_time, now);
 			resv_delay /= 60;	/* seconds to minutes */
 			if (resv_delay < job_ptr->time_limit)
 				job_ptr->time_limit = resv_delay;
-		}
-		if ((j = node_space[j].next) == 0)
 			break;
+		}
 	}
 	new_time_limit = MAX(job_ptr->time_min, job_ptr->time_limit);
 	acct_policy_alter_job(job_ptr, new_time_limit);
@@ -1467,123 +1607,3 @@ static bool _more_work (time_t last_backfill_time)
 	pthread_mutex_unlock( &thread_flag_mutex );
 	return rc;
 }
-
-/* Create a reservation for a job in the future */
-static void _add_reservation(uint32_t start_time, uint32_t end_reserve,
-			     bitstr_t *res_bitmap,
-			     node_space_map_t *node_space,
-			     int *node_space_recs)
-{
-	bool placed = false;
-	int i, j;
-
-#if 0	
-	info("add job start:%u end:%u", start_time, end_reserve);
-	for (j = 0; ; ) {
-		info("node start:%u end:%u",
-		     (uint32_t) node_space[j].begin_time,
-		     (uint32_t) node_space[j].end_time);
-		if ((j = node_space[j].next) == 0)
-			break;
-	}
-#endif
-
-	start_time = MAX(start_time, node_space[0].begin_time);
-	for (j = 0; ; ) {
-		if (node_space[j].end_time > start_time) {
-			/* insert start entry record */
-			i = *node_space_recs;
-			node_space[i].begin_time = start_time;
-			node_space[i].end_time = node_space[j].end_time;
-			node_space[j].end_time = start_time;
-			node_space[i].avail_bitmap =
-				bit_copy(node_space[j].avail_bitmap);
-			node_space[i].next = node_space[j].next;
-			node_space[j].next = i;
-			(*node_space_recs)++;
-			placed = true;
-		}
-		if (node_space[j].end_time == start_time) {
-			/* no need to insert new start entry record */
-			placed = true;
-		}
-		if (placed == true) {
-			while ((j = node_space[j].next)) {
-				if (end_reserve < node_space[j].end_time) {
-					/* insert end entry record */
-					i = *node_space_recs;
-					node_space[i].begin_time = end_reserve;
-					node_space[i].end_time = node_space[j].
-								 end_time;
-					node_space[j].end_time = end_reserve;
-					node_space[i].avail_bitmap =
-						bit_copy(node_space[j].
-							 avail_bitmap);
-					node_space[i].next = node_space[j].next;
-					node_space[j].next = i;
-					(*node_space_recs)++;
-					break;
-				}
-				if (end_reserve == node_space[j].end_time) {
-					break;
-				}
-			}
-			break;
-		}
-		if ((j = node_space[j].next) == 0)
-			break;
-	}
-
-	for (j = 0; ; ) {
-		if ((node_space[j].begin_time >= start_time) &&
-		    (node_space[j].end_time <= end_reserve))
-			bit_and(node_space[j].avail_bitmap, res_bitmap);
-		if ((node_space[j].begin_time >= end_reserve) ||
-		    ((j = node_space[j].next) == 0))
-			break;
-	}
-
-	/* Drop records with identical bitmaps (up to one record).
-	 * This can significantly improve performance of the backfill tests. */
-	for (i = 0; ; ) {
-		if ((j = node_space[i].next) == 0)
-			break;
-		if (!bit_equal(node_space[i].avail_bitmap,
-			       node_space[j].avail_bitmap)) {
-			i = j;
-			continue;
-		}
-		node_space[i].end_time = node_space[j].end_time;
-		node_space[i].next = node_space[j].next;
-		FREE_NULL_BITMAP(node_space[j].avail_bitmap);
-		break;
-	}
-}
-
-/*
- * Determine if the resource specification for a new job overlaps with a
- *	reservation that the backfill scheduler has made for a job to be
- *	started in the future.
- * IN use_bitmap - nodes to be allocated
- * IN start_time - start time of job
- * IN end_reserve - end time of job
- */
-static bool _test_resv_overlap(node_space_map_t *node_space,
-			       bitstr_t *use_bitmap, uint32_t start_time,
-			       uint32_t end_reserve)
-{
-	bool overlap = false;
-	int j;
-
-	for (j=0; ; ) {
-		if ((node_space[j].end_time   > start_time) &&
-		    (node_space[j].begin_time < end_reserve) &&
-		    (!bit_super_set(use_bitmap, node_space[j].avail_bitmap))) {
-			overlap = true;
-			break;
-		}
-		if ((j = node_space[j].next) == 0)
-			break;
-	}
-	return overlap;
-}
@@ -0,0 +1,294 @@
+/*****************************************************************************\
+ *  bf_plan.c - backfill plan kept from one cycle to the next
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/read_config.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/reservation.h"
+#include "src/slurmctld/slurmctld.h"
+
+#include "bf_plan.h"
+
+static int _cmp_job_end(const void *x, const void *y)
+{
+	const bf_job_end_t *end1 = x, *end2 = y;
+
+	if (end1->job_id < end2->job_id)
+		return -1;
+	if (end1->job_id > end2->job_id)
+		return 1;
+	return 0;
+}
+
+static bf_plan_rec_t *_new_rec(bf_plan_t *plan)
+{
+	if (plan->rec_cnt == plan->rec_size) {
+		plan->rec_size = plan->rec_size ? (plan->rec_size * 2) : 64;
+		xrealloc(plan->recs, sizeof(bf_plan_rec_t) * plan->rec_size);
+	}
+	return plan->recs + plan->rec_cnt++;
+}
+
+/* Return true if a job started since the plan was made runs on nodes of a
+ * reservation before its start */
+static bool _new_job_conflict(bf_plan_t *plan, bf_plan_rec_t *rec)
+{
+	struct job_record *job_ptr;
+	int i;
+
+	for (i = 0; i < plan->new_cnt; i++) {
+		job_ptr = plan->new_jobs[i];
+		if ((job_ptr->end_time > rec->start_time) &&
+		    job_ptr->node_bitmap &&
+		    bit_overlap(job_ptr->node_bitmap, rec->use_bitmap))
+			return true;
+	}
+	return false;
+}
+
+/* Return true if enough nodes are free for the job to possibly start now,
+ * which only testing it can tell */
+static bool _may_start_now(struct part_record *part_ptr, uint32_t time_limit,
+			   uint32_t min_nodes, bf_timeline_t *timeline,
+			   bitstr_t *free_bitmap, time_t now)
+{
+	bitstr_t *tmp_bitmap;
+	time_t later_start;
+	bool rc = false;
+
+	tmp_bitmap = bit_scratch_alloc(bit_size(free_bitmap));
+	bit_copybits_and(tmp_bitmap, free_bitmap, part_ptr->node_bitmap);
+	if (bf_timeline_and(timeline, now, now + (time_limit * 60), min_nodes,
+			    tmp_bitmap, &later_start) &&
+	    (bit_set_count(tmp_bitmap) >= min_nodes))
+		rc = true;
+	bit_scratch_free(tmp_bitmap);
+
+	return rc;
+}
+
+extern bf_plan_t *bf_plan_create(void)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	bf_plan_t *plan = xmalloc(sizeof(bf_plan_t));
+
+	plan->plan_time = time(NULL);
+	plan->config_update = slurmctld_conf.last_update;
+	plan->part_update = last_part_update;
+	plan->resv_update = last_resv_update;
+	plan->avail_bitmap = bit_copy(avail_node_bitmap);
+	plan->up_bitmap = bit_copy(up_node_bitmap);
+
+	plan->run_ends = xmalloc(sizeof(bf_job_end_t) *
+				 (list_count(job_list) + 1));
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		if (!IS_JOB_RUNNING(job_ptr) && !IS_JOB_SUSPENDED(job_ptr))
+			continue;
+		plan->run_ends[plan->run_cnt].job_id = job_ptr->job_id;
+		plan->run_ends[plan->run_cnt].end_time = job_ptr->end_time;
+		plan->run_cnt++;
+	}
+	list_iterator_destroy(job_iterator);
+	qsort(plan->run_ends, plan->run_cnt, sizeof(bf_job_end_t),
+	      _cmp_job_end);
+
+	return plan;
+}
+
+extern void bf_plan_destroy(bf_plan_t *plan)
+{
+	int i;
+
+	if (!plan)
+		return;
+	for (i = 0; i < plan->rec_cnt; i++)
+		FREE_NULL_BITMAP(plan->recs[i].use_bitmap);
+	xfree(plan->recs);
+	FREE_NULL_BITMAP(plan->avail_bitmap);
+	FREE_NULL_BITMAP(plan->up_bitmap);
+	xfree(plan->run_ends);
+	xfree(plan->new_jobs);
+	xfree(plan);
+}
+
+extern bf_plan_t *bf_plan_check(bf_plan_t *plan)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	bf_job_end_t key, *run_end;
+
+	if (!plan)
+		return NULL;
+	if ((plan->cycle_cnt >= BF_PLAN_MAX_CYCLES) ||
+	    (plan->config_update != slurmctld_conf.last_update) ||
+	    (plan->part_update != last_part_update) ||
+	    (plan->resv_update != last_resv_update) ||
+	    !bit_equal(plan->avail_bitmap, avail_node_bitmap) ||
+	    !bit_equal(plan->up_bitmap, up_node_bitmap)) {
+		bf_plan_destroy(plan);
+		return NULL;
+	}
+
+	xfree(plan->new_jobs);
+	plan->new_cnt = 0;
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		if (!IS_JOB_RUNNING(job_ptr) && !IS_JOB_SUSPENDED(job_ptr))
+			continue;
+		key.job_id = job_ptr->job_id;
+		run_end = NULL;
+		if (job_ptr->start_time < plan->plan_time) {
+			run_end = bsearch(&key, plan->run_ends, plan->run_cnt,
+					  sizeof(bf_job_end_t), _cmp_job_end);
+		}
+		if (!run_end) {
+			xrealloc(plan->new_jobs, sizeof(struct job_record *) *
+						 (plan->new_cnt + 1));
+			plan->new_jobs[plan->new_cnt++] = job_ptr;
+		} else if (job_ptr->end_time > run_end->end_time) {
+			/* Its nodes may be reserved from its old end time */
+			list_iterator_destroy(job_iterator);
+			bf_plan_destroy(plan);
+			return NULL;
+		}
+	}
+	list_iterator_destroy(job_iterator);
+	plan->rec_pos = 0;
+
+	return plan;
+}
+
+extern bool bf_plan_replay(bf_plan_t *plan, struct job_record *job_ptr,
+			   struct part_record *part_ptr,
+			   uint32_t orig_time_limit, uint32_t time_limit,
+			   uint32_t min_nodes, uint32_t max_nodes,
+			   bf_timeline_t *timeline, bitstr_t *free_bitmap,
+			   time_t now, bf_plan_t *new_plan, bool *reserved)
+{
+	bf_plan_rec_t *rec, *new_rec;
+
+	*reserved = false;
+	if (plan->rec_pos < 0)
+		return false;
+	while ((plan->rec_pos < plan->rec_cnt) &&
+	       (plan->recs[plan->rec_pos].state == BF_PLAN_STARTED))
+		plan->rec_pos++;	/* no longer in the queue */
+	if (plan->rec_pos >= plan->rec_cnt)
+		goto invalid;
+
+	rec = plan->recs + plan->rec_pos;
+	if ((rec->job_id     != job_ptr->job_id)   ||
+	    (rec->part_ptr   != part_ptr)          ||
+	    (rec->priority   != job_ptr->priority) ||
+	    (rec->time_limit != orig_time_limit)   ||
+	    (rec->min_nodes  != min_nodes)         ||
+	    (rec->max_nodes  != max_nodes))
+		goto invalid;
+	if ((rec->state == BF_PLAN_RESERVED) &&
+	    ((rec->job_start <= now) ||
+	     _new_job_conflict(plan, rec) ||
+	     bf_timeline_overlap(timeline, rec->start_time, rec->end_reserve,
+				 rec->use_bitmap)))
+		goto invalid;
+	if (_may_start_now(part_ptr, time_limit, min_nodes, timeline,
+			   free_bitmap, now))
+		goto invalid;
+
+	if (rec->state == BF_PLAN_RESERVED) {
+		bit_not(rec->use_bitmap);
+		bf_timeline_add(timeline, rec->start_time, rec->end_reserve,
+				rec->use_bitmap);
+		bit_not(rec->use_bitmap);
+		job_ptr->start_time = rec->job_start;
+		*reserved = true;
+	}
+	new_rec = _new_rec(new_plan);
+	*new_rec = *rec;
+	rec->use_bitmap = NULL;		/* now owned by new_plan */
+	plan->rec_pos++;
+	return true;
+
+invalid:
+	plan->rec_pos = -1;
+	return false;
+}
+
+extern void bf_plan_add(bf_plan_t *plan, struct job_record *job_ptr,
+			struct part_record *part_ptr, uint32_t orig_time_limit,
+			uint32_t min_nodes, uint32_t max_nodes)
+{
+	bf_plan_rec_t *rec = _new_rec(plan);
+
+	memset(rec, 0, sizeof(bf_plan_rec_t));
+	rec->job_id = job_ptr->job_id;
+	rec->part_ptr = part_ptr;
+	rec->priority = job_ptr->priority;
+	rec->time_limit = orig_time_limit;
+	rec->min_nodes = min_nodes;
+	rec->max_nodes = max_nodes;
+	rec->state = BF_PLAN_NONE;
+}
+
+extern void bf_plan_reserve(bf_plan_t *plan, time_t job_start,
+			    time_t start_time, time_t end_reserve,
+			    bitstr_t *use_bitmap)
+{
+	bf_plan_rec_t *rec = plan->recs + plan->rec_cnt - 1;
+
+	xassert(plan->rec_cnt);
+	rec->state = BF_PLAN_RESERVED;
+	rec->job_start = job_start;
+	rec->start_time = start_time;
+	rec->end_reserve = end_reserve;
+	FREE_NULL_BITMAP(rec->use_bitmap);
+	rec->use_bitmap = bit_copy(use_bitmap);
+}
+
+extern void bf_plan_started(bf_plan_t *plan)
+{
+	xassert(plan->rec_cnt);
+	plan->recs[plan->rec_cnt - 1].state = BF_PLAN_STARTED;
+}
@@ -0,0 +1,149 @@
+/*****************************************************************************\
+ *  bf_plan.h - backfill plan kept from one cycle to the next
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifndef _SLURM_BF_PLAN_H
+#define _SLURM_BF_PLAN_H
+
+#include <time.h>
+
+#include "src/common/bitstring.h"
+#include "src/slurmctld/slurmctld.h"
+
+#include "bf_timeline.h"
+
+/*
+ * With SchedulerParameters=bf_incremental, the backfill scheduler keeps the
+ * outcome of the test of every pending job. The next cycle replays them in
+ * queue order rather than testing the jobs again, re-adding their
+ * reservations to the timeline. Jobs are tested again from the first one
+ * whose record no longer holds: the queue changed at that position, the job
+ * was modified, a job started since then uses its reserved nodes, or enough
+ * nodes are now free for it to start at once.
+ *
+ * The whole plan is dropped when the configuration, partitions, advanced
+ * reservations or available nodes change, when a running job's end time
+ * moves later, and every BF_PLAN_MAX_CYCLES cycles to bound its age.
+ */
+#define BF_PLAN_MAX_CYCLES	10
+
+typedef enum {
+	BF_PLAN_NONE,		/* no reservation made */
+	BF_PLAN_RESERVED,	/* reservation made for a later start */
+	BF_PLAN_STARTED		/* started by the backfill scheduler */
+} bf_plan_state_t;
+
+typedef struct bf_plan_rec {
+	uint32_t job_id;
+	struct part_record *part_ptr;
+	uint32_t priority;
+	uint32_t time_limit;	/* of the job record, not the one tested */
+	uint32_t min_nodes;
+	uint32_t max_nodes;
+	bf_plan_state_t state;
+	time_t job_start;	/* expected start time of the job */
+	time_t start_time;	/* BF_PLAN_RESERVED: the reservation */
+	time_t end_reserve;
+	bitstr_t *use_bitmap;
+} bf_plan_rec_t;
+
+typedef struct bf_job_end {
+	uint32_t job_id;
+	time_t end_time;
+} bf_job_end_t;
+
+typedef struct bf_plan {
+	bf_plan_rec_t *recs;	/* in queue order */
+	int rec_cnt;
+	int rec_size;
+	int rec_pos;		/* next record to replay, -1 once invalid */
+	int cycle_cnt;		/* cycles since the plan was last rebuilt */
+	time_t plan_time;	/* start of the cycle which made it */
+	time_t config_update;
+	time_t part_update;
+	time_t resv_update;
+	bitstr_t *avail_bitmap;	/* avail_node_bitmap at plan_time */
+	bitstr_t *up_bitmap;	/* up_node_bitmap at plan_time */
+	bf_job_end_t *run_ends;	/* running jobs at plan_time, by job_id */
+	int run_cnt;
+	struct job_record **new_jobs;	/* started since plan_time, only
+					 * valid until the locks are released */
+	int new_cnt;
+} bf_plan_t;
+
+/*
+ * Create an empty plan at the start of a cycle, saving what bf_plan_check()
+ * compares against in the next one
+ * NOTE: Call with the job and node read locks at least.
+ */
+extern bf_plan_t *bf_plan_create(void);
+
+extern void bf_plan_destroy(bf_plan_t *plan);
+
+/*
+ * Check at the start of a cycle whether a plan can still be replayed
+ * RET the plan, or NULL after destroying it
+ * NOTE: Call with the job and node read locks at least.
+ */
+extern bf_plan_t *bf_plan_check(bf_plan_t *plan);
+
+/*
+ * Replay the next record of a plan for a job about to be tested, adding its
+ * reservation to the timeline and copying it to new_plan
+ * IN free_bitmap - nodes on which some job could start now
+ * OUT reserved - set if a reservation was added
+ * RET true if replayed, false if the job must be tested
+ */
+extern bool bf_plan_replay(bf_plan_t *plan, struct job_record *job_ptr,
+			   struct part_record *part_ptr,
+			   uint32_t orig_time_limit, uint32_t time_limit,
+			   uint32_t min_nodes, uint32_t max_nodes,
+			   bf_timeline_t *timeline, bitstr_t *free_bitmap,
+			   time_t now, bf_plan_t *new_plan, bool *reserved);
+
+/* Add a record for a job about to be tested */
+extern void bf_plan_add(bf_plan_t *plan, struct job_record *job_ptr,
+			struct part_record *part_ptr, uint32_t orig_time_limit,
+			uint32_t min_nodes, uint32_t max_nodes);
+
+/* Note the reservation made for the job of the last record */
+extern void bf_plan_reserve(bf_plan_t *plan, time_t job_start,
+			    time_t start_time, time_t end_reserve,
+			    bitstr_t *use_bitmap);
+
+/* Note that the job of the last record was started */
+extern void bf_plan_started(bf_plan_t *plan);
+
+#endif	/* _SLURM_BF_PLAN_H */
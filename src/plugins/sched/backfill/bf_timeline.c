@@ -0,0 +1,294 @@
+/*****************************************************************************\
+ *  bf_timeline.c - resource timeline of the backfill scheduler
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/parse_time.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/slurmctld.h"
+
+#include "bf_timeline.h"
+
+static bf_nodes_t *_nodes_create(bitstr_t *bitmap)
+{
+	bf_nodes_t *nodes = xmalloc(sizeof(bf_nodes_t));
+
+	nodes->bitmap = bitmap;
+	nodes->node_cnt = bit_set_count(bitmap);
+	nodes->ref_cnt = 1;
+
+	return nodes;
+}
+
+static void _nodes_release(bf_nodes_t *nodes)
+{
+	if (--nodes->ref_cnt == 0) {
+		FREE_NULL_BITMAP(nodes->bitmap);
+		xfree(nodes);
+	}
+}
+
+static bool _nodes_equal(bf_nodes_t *nodes1, bf_nodes_t *nodes2)
+{
+	if (nodes1 == nodes2)
+		return true;
+	if (nodes1->node_cnt != nodes2->node_cnt)
+		return false;
+	return bit_equal(nodes1->bitmap, nodes2->bitmap);
+}
+
+/* Return the index of the first slot ending after when, slot_cnt if none */
+static int _find_slot(bf_timeline_t *timeline, time_t when)
+{
+	int lo = 0, hi = timeline->slot_cnt, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (timeline->slots[mid].end_time > when)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return lo;
+}
+
+/* Split the slot containing when, if any, so that a slot begins at when.
+ * The two parts share their nodes. RET index of the slot beginning at when,
+ * slot_cnt if when is past the end */
+static int _split_slot(bf_timeline_t *timeline, time_t when)
+{
+	bf_slot_t *slot;
+	int i = _find_slot(timeline, when);
+
+	if ((i == timeline->slot_cnt) ||
+	    (timeline->slots[i].begin_time >= when))
+		return i;
+
+	if (timeline->slot_cnt == timeline->slot_size) {
+		timeline->slot_size *= 2;
+		xrealloc(timeline->slots,
+			 sizeof(bf_slot_t) * timeline->slot_size);
+	}
+	slot = timeline->slots + i;
+	memmove(slot + 1, slot, sizeof(bf_slot_t) * (timeline->slot_cnt - i));
+	timeline->slot_cnt++;
+	timeline->split_cnt++;
+	slot[0].end_time = when;
+	slot[1].begin_time = when;
+	slot[1].nodes->ref_cnt++;
+
+	return i + 1;
+}
+
+/* Merge equal adjacent slots from index first to last */
+static void _merge_slots(bf_timeline_t *timeline, int first, int last)
+{
+	bf_slot_t *slot;
+	int i;
+
+	first = MAX(first, 0);
+	last = MIN(last, timeline->slot_cnt - 1);
+	for (i = first; i < last; ) {
+		slot = timeline->slots + i;
+		if (!_nodes_equal(slot[0].nodes, slot[1].nodes)) {
+			i++;
+			continue;
+		}
+		slot[0].end_time = slot[1].end_time;
+		_nodes_release(slot[1].nodes);
+		memmove(slot + 1, slot + 2,
+			sizeof(bf_slot_t) * (timeline->slot_cnt - i - 2));
+		timeline->slot_cnt--;
+		last--;
+	}
+}
+
+extern bf_timeline_t *bf_timeline_create(time_t begin, time_t end,
+					 bitstr_t *avail_bitmap)
+{
+	bf_timeline_t *timeline = xmalloc(sizeof(bf_timeline_t));
+
+	timeline->slot_size = 64;
+	timeline->slots = xmalloc(sizeof(bf_slot_t) * timeline->slot_size);
+	timeline->slots[0].begin_time = begin;
+	timeline->slots[0].end_time = end;
+	timeline->slots[0].nodes = _nodes_create(bit_copy(avail_bitmap));
+	timeline->slot_cnt = 1;
+
+	return timeline;
+}
+
+extern void bf_timeline_destroy(bf_timeline_t *timeline)
+{
+	int i;
+
+	if (!timeline)
+		return;
+	for (i = 0; i < timeline->slot_cnt; i++)
+		_nodes_release(timeline->slots[i].nodes);
+	xfree(timeline->slots);
+	xfree(timeline);
+}
+
+extern void bf_timeline_add(bf_timeline_t *timeline, time_t start_time,
+			    time_t end_reserve, bitstr_t *res_bitmap)
+{
+	bf_nodes_t *old_nodes = NULL, *new_nodes = NULL, *nodes;
+	bf_slot_t *slot;
+	int first, i;
+
+	start_time = MAX(start_time, timeline->slots[0].begin_time);
+	first = _split_slot(timeline, start_time);
+	(void) _split_slot(timeline, end_reserve);
+
+	for (i = first; i < timeline->slot_cnt; i++) {
+		slot = timeline->slots + i;
+		if (slot->end_time > end_reserve)
+			break;
+		nodes = slot->nodes;
+		if (nodes == old_nodes) {
+			/* Still shared with the previous slot */
+			new_nodes->ref_cnt++;
+			slot->nodes = new_nodes;
+			_nodes_release(nodes);
+			continue;
+		}
+		old_nodes = nodes;
+		if (bit_super_set(nodes->bitmap, res_bitmap)) {
+			new_nodes = nodes;	/* none of them reserved */
+		} else if (nodes->ref_cnt == 1) {
+			bit_and(nodes->bitmap, res_bitmap);
+			nodes->node_cnt = bit_set_count(nodes->bitmap);
+			new_nodes = nodes;
+		} else {
+			new_nodes = _nodes_create(bit_copy(nodes->bitmap));
+			bit_and(new_nodes->bitmap, res_bitmap);
+			new_nodes->node_cnt = bit_set_count(new_nodes->bitmap);
+			slot->nodes = new_nodes;
+			_nodes_release(nodes);
+		}
+	}
+
+	_merge_slots(timeline, first - 1, i);
+}
+
+extern bool bf_timeline_and(bf_timeline_t *timeline, time_t start_time,
+			    time_t end_time, int min_nodes,
+			    bitstr_t *avail_bitmap, time_t *later_start)
+{
+	bf_nodes_t *last_nodes = NULL;
+	bf_slot_t *slot;
+	int first, i;
+
+	*later_start = 0;
+	first = _find_slot(timeline, start_time);
+	if (first == timeline->slot_cnt)
+		return true;
+	if ((first + 1) < timeline->slot_cnt)
+		*later_start = timeline->slots[first].end_time;
+
+	for (i = first; i < timeline->slot_cnt; i++) {
+		slot = timeline->slots + i;
+		if (slot->begin_time > end_time)
+			break;
+		if (slot->nodes->node_cnt < min_nodes)
+			return false;
+	}
+	for (i = first; i < timeline->slot_cnt; i++) {
+		slot = timeline->slots + i;
+		if (slot->begin_time > end_time)
+			break;
+		if (slot->nodes == last_nodes)
+			continue;
+		last_nodes = slot->nodes;
+		bit_and(avail_bitmap, last_nodes->bitmap);
+	}
+
+	return true;
+}
+
+extern bool bf_timeline_overlap(bf_timeline_t *timeline, time_t start_time,
+				time_t end_reserve, bitstr_t *use_bitmap)
+{
+	bf_nodes_t *last_nodes = NULL;
+	bf_slot_t *slot;
+	int i, use_cnt = -1;
+
+	for (i = _find_slot(timeline, start_time); i < timeline->slot_cnt;
+	     i++) {
+		slot = timeline->slots + i;
+		if (slot->begin_time >= end_reserve)
+			break;
+		if (slot->nodes == last_nodes)
+			continue;
+		last_nodes = slot->nodes;
+		if (use_cnt < 0)
+			use_cnt = bit_set_count(use_bitmap);
+		if ((last_nodes->node_cnt < use_cnt) ||
+		    !bit_super_set(use_bitmap, last_nodes->bitmap))
+			return true;
+	}
+
+	return false;
+}
+
+extern void bf_timeline_log(bf_timeline_t *timeline)
+{
+	char begin_buf[32], end_buf[32], *node_list;
+	bf_slot_t *slot;
+	int i;
+
+	info("=========================================");
+	for (i = 0; i < timeline->slot_cnt; i++) {
+		slot = timeline->slots + i;
+		slurm_make_time_str(&slot->begin_time,
+				    begin_buf, sizeof(begin_buf));
+		slurm_make_time_str(&slot->end_time,
+				    end_buf, sizeof(end_buf));
+		node_list = bitmap2node_name(slot->nodes->bitmap);
+		info("Begin:%s End:%s Nodes:%s (%d)",
+		     begin_buf, end_buf, node_list, slot->nodes->node_cnt);
+		xfree(node_list);
+	}
+	info("=========================================");
+}
@@ -0,0 +1,107 @@
+/*****************************************************************************\
+ *  bf_timeline.h - resource timeline of the backfill scheduler
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifndef _SLURM_BF_TIMELINE_H
+#define _SLURM_BF_TIMELINE_H
+
+#include <time.h>
+
+#include "src/common/bitstring.h"
+
+/*
+ * Nodes available over time for jobs yet to be started, as a sequence of
+ * contiguous slots sorted by time and located by bisection. Slots split
+ * from one another share their bitmap until one of them is changed, and
+ * each bitmap caches its count of available nodes so that most tests can
+ * fail on counts alone, without any bitmap operation.
+ */
+typedef struct bf_nodes {
+	bitstr_t *bitmap;	/* available nodes */
+	int node_cnt;		/* bit_set_count(bitmap) */
+	int ref_cnt;		/* slots sharing it */
+} bf_nodes_t;
+
+typedef struct bf_slot {
+	time_t begin_time;
+	time_t end_time;
+	bf_nodes_t *nodes;
+} bf_slot_t;
+
+typedef struct bf_timeline {
+	bf_slot_t *slots;	/* by begin_time, end_time of one is
+				 * begin_time of the next */
+	int slot_cnt;
+	int slot_size;		/* allocated slots */
+	int split_cnt;		/* slots ever split, to bound the work */
+} bf_timeline_t;
+
+/* Create a timeline with avail_bitmap available from begin to end */
+extern bf_timeline_t *bf_timeline_create(time_t begin, time_t end,
+					 bitstr_t *avail_bitmap);
+
+extern void bf_timeline_destroy(bf_timeline_t *timeline);
+
+/*
+ * Reserve nodes from start_time to end_reserve for a job to be started later
+ * IN res_bitmap - nodes remaining available, those of the job cleared
+ */
+extern void bf_timeline_add(bf_timeline_t *timeline, time_t start_time,
+			    time_t end_reserve, bitstr_t *res_bitmap);
+
+/*
+ * Clear from avail_bitmap the nodes unavailable at some time of the slots
+ * ending after start_time and beginning no later than end_time
+ * IN min_nodes - count of nodes needed
+ * OUT later_start - end of the first of these slots if another one follows,
+ *	zero otherwise, the next start time worth testing
+ * RET false if one of these slots has fewer than min_nodes available, in
+ *	which case avail_bitmap is left unfiltered
+ */
+extern bool bf_timeline_and(bf_timeline_t *timeline, time_t start_time,
+			    time_t end_time, int min_nodes,
+			    bitstr_t *avail_bitmap, time_t *later_start);
+
+/*
+ * Return true if some of the nodes in use_bitmap are reserved at some time
+ * after start_time and before end_reserve
+ */
+extern bool bf_timeline_overlap(bf_timeline_t *timeline, time_t start_time,
+				time_t end_reserve, bitstr_t *use_bitmap);
+
+/* Log the slots of a timeline */
+extern void bf_timeline_log(bf_timeline_t *timeline);
+
+#endif	/* _SLURM_BF_TIMELINE_H */
@@ -0,0 +1,390 @@
+/*****************************************************************************\
+ *  bf_worker.c - threads testing ahead when pending jobs could start
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <pthread.h>
+
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/xmalloc.h"
+
+#include "bf_worker.h"
+
+#define BF_WORKER_DEPTH	2	/* tests queued per worker thread */
+
+typedef enum {
+	BF_TEST_FREE,
+	BF_TEST_QUEUED,
+	BF_TEST_RUNNING,
+	BF_TEST_DONE,
+	BF_TEST_DROPPED		/* running, free it once done */
+} bf_test_state_t;
+
+typedef struct bf_test {
+	bf_test_state_t state;
+	uint32_t queue_pos;
+	struct job_record *job_ptr;
+	struct part_record *part_ptr;
+	uint32_t min_nodes;
+	uint32_t max_nodes;
+	uint32_t req_nodes;
+	bitstr_t *avail_bitmap;		/* nodes offered */
+	bitstr_t *exc_core_bitmap;
+	bitstr_t *select_bitmap;	/* nodes selected */
+	time_t start_time;
+	int rc;
+} bf_test_t;
+
+static pthread_mutex_t worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  worker_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  done_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t *worker_threads = NULL;
+static int worker_cnt = 0;
+static bool worker_stop = false;
+static bf_worker_test_f worker_test = NULL;
+static bf_test_t *tests = NULL;
+static int test_cnt = 0;
+static uint32_t used_cnt = 0, wasted_cnt = 0;
+
+/* Release a test's resources. Call with worker_mutex locked. */
+static void _free_test(bf_test_t *test)
+{
+	if (test->state == BF_TEST_DONE)
+		wasted_cnt++;
+	FREE_NULL_BITMAP(test->avail_bitmap);
+	FREE_NULL_BITMAP(test->exc_core_bitmap);
+	FREE_NULL_BITMAP(test->select_bitmap);
+	test->state = BF_TEST_FREE;
+}
+
+/* Drop a test, or have its worker do it when done if running.
+ * Call with worker_mutex locked. */
+static void _drop_test(bf_test_t *test)
+{
+	if (test->state == BF_TEST_RUNNING)
+		test->state = BF_TEST_DROPPED;
+	else if (test->state != BF_TEST_DROPPED)
+		_free_test(test);
+}
+
+/* Return the queued test of the job first in the queue.
+ * Call with worker_mutex locked. */
+static bf_test_t *_next_test(void)
+{
+	bf_test_t *next = NULL;
+	int i;
+
+	for (i = 0; i < test_cnt; i++) {
+		if ((tests[i].state == BF_TEST_QUEUED) &&
+		    (!next || (tests[i].queue_pos < next->queue_pos)))
+			next = &tests[i];
+	}
+	return next;
+}
+
+static void _run_test(bf_test_t *test)
+{
+	struct job_record *job_ptr = test->job_ptr;
+	struct part_record *save_part_ptr = job_ptr->part_ptr;
+	time_t save_start_time = job_ptr->start_time;
+
+	/* The backfill scheduler leaves the job alone until it is done */
+	job_ptr->part_ptr = test->part_ptr;
+	test->select_bitmap = bit_copy(test->avail_bitmap);
+	test->rc = (*worker_test)(job_ptr, &test->select_bitmap,
+				  test->min_nodes, test->max_nodes,
+				  test->req_nodes, test->exc_core_bitmap);
+	test->start_time = job_ptr->start_time;
+	job_ptr->part_ptr = save_part_ptr;
+	job_ptr->start_time = save_start_time;
+}
+
+static void *_worker_agent(void *args)
+{
+	bf_test_t *test;
+
+	slurm_mutex_lock(&worker_mutex);
+	while (!worker_stop) {
+		if (!(test = _next_test())) {
+			pthread_cond_wait(&worker_cond, &worker_mutex);
+			continue;
+		}
+		test->state = BF_TEST_RUNNING;
+		slurm_mutex_unlock(&worker_mutex);
+
+		_run_test(test);
+
+		slurm_mutex_lock(&worker_mutex);
+		if (test->state == BF_TEST_DROPPED) {
+			wasted_cnt++;
+			_free_test(test);
+		} else
+			test->state = BF_TEST_DONE;
+		pthread_cond_broadcast(&done_cond);
+	}
+	slurm_mutex_unlock(&worker_mutex);
+
+	return NULL;
+}
+
+extern void bf_worker_start(int thread_cnt, bf_worker_test_f test_func)
+{
+	pthread_attr_t thread_attr;
+	int i;
+
+	if (thread_cnt == worker_cnt)
+		return;
+	bf_worker_fini();
+	if (thread_cnt <= 0)
+		return;
+
+	slurm_mutex_lock(&worker_mutex);
+	worker_stop = false;
+	worker_test = test_func;
+	test_cnt = thread_cnt * BF_WORKER_DEPTH;
+	tests = xmalloc(sizeof(bf_test_t) * test_cnt);
+	worker_threads = xmalloc(sizeof(pthread_t) * thread_cnt);
+	slurm_attr_init(&thread_attr);
+	for (i = 0; i < thread_cnt; i++) {
+		if (pthread_create(&worker_threads[i], &thread_attr,
+				   _worker_agent, NULL)) {
+			error("backfill: unable to start worker thread: %m");
+			break;
+		}
+	}
+	slurm_attr_destroy(&thread_attr);
+	worker_cnt = i;
+	slurm_mutex_unlock(&worker_mutex);
+
+	if (worker_cnt)
+		verbose("backfill: started %d worker threads", worker_cnt);
+	else
+		bf_worker_fini();
+}
+
+extern void bf_worker_fini(void)
+{
+	int i;
+
+	if (!worker_threads)
+		return;
+
+	bf_worker_discard();
+	slurm_mutex_lock(&worker_mutex);
+	worker_stop = true;
+	pthread_cond_broadcast(&worker_cond);
+	slurm_mutex_unlock(&worker_mutex);
+	for (i = 0; i < worker_cnt; i++)
+		pthread_join(worker_threads[i], NULL);
+
+	xfree(worker_threads);
+	xfree(tests);
+	worker_cnt = 0;
+	test_cnt = 0;
+}
+
+extern bool bf_worker_enabled(void)
+{
+	return (worker_cnt > 0);
+}
+
+extern bool bf_worker_busy(struct job_record *job_ptr)
+{
+	bool busy = false;
+	int i;
+
+	slurm_mutex_lock(&worker_mutex);
+	for (i = 0; i < test_cnt; i++) {
+		if ((tests[i].state != BF_TEST_FREE) &&
+		    (tests[i].job_ptr == job_ptr)) {
+			busy = true;
+			break;
+		}
+	}
+	slurm_mutex_unlock(&worker_mutex);
+
+	return busy;
+}
+
+extern bool bf_worker_submit(uint32_t queue_pos, struct job_record *job_ptr,
+			     struct part_record *part_ptr,
+			     bitstr_t *avail_bitmap,
+			     bitstr_t *exc_core_bitmap, uint32_t min_nodes,
+			     uint32_t max_nodes, uint32_t req_nodes)
+{
+	bf_test_t *test = NULL;
+	int i;
+
+	slurm_mutex_lock(&worker_mutex);
+	for (i = 0; i < test_cnt; i++) {
+		if (tests[i].state == BF_TEST_FREE) {
+			test = &tests[i];
+			break;
+		}
+	}
+	if (!test) {
+		slurm_mutex_unlock(&worker_mutex);
+		return false;
+	}
+
+	test->state = BF_TEST_QUEUED;
+	test->queue_pos = queue_pos;
+	test->job_ptr = job_ptr;
+	test->part_ptr = part_ptr;
+	test->min_nodes = min_nodes;
+	test->max_nodes = max_nodes;
+	test->req_nodes = req_nodes;
+	test->avail_bitmap = bit_copy(avail_bitmap);
+	if (exc_core_bitmap)
+		test->exc_core_bitmap = bit_copy(exc_core_bitmap);
+	pthread_cond_signal(&worker_cond);
+	slurm_mutex_unlock(&worker_mutex);
+
+	return true;
+}
+
+extern void bf_worker_reach(uint32_t queue_pos, struct job_record *job_ptr)
+{
+	int i;
+
+	slurm_mutex_lock(&worker_mutex);
+	for (i = 0; i < test_cnt; i++) {
+		if (tests[i].state == BF_TEST_FREE)
+			continue;
+		if (tests[i].queue_pos < queue_pos)
+			_drop_test(&tests[i]);
+		else if ((tests[i].queue_pos == queue_pos) &&
+			 (tests[i].state == BF_TEST_QUEUED))
+			_free_test(&tests[i]);	/* quicker to test now */
+		else if ((tests[i].queue_pos > queue_pos) &&
+			 (tests[i].job_ptr == job_ptr))
+			_drop_test(&tests[i]);	/* same job, other partition */
+	}
+	/* A worker may be changing the job's part_ptr and start_time */
+	for (i = 0; i < test_cnt; i++) {
+		while ((tests[i].job_ptr == job_ptr) &&
+		       ((tests[i].state == BF_TEST_RUNNING) ||
+			(tests[i].state == BF_TEST_DROPPED)))
+			pthread_cond_wait(&done_cond, &worker_mutex);
+	}
+	slurm_mutex_unlock(&worker_mutex);
+}
+
+static bool _bitmap_equal(bitstr_t *b1, bitstr_t *b2)
+{
+	if (!b1 || !b2)
+		return (b1 == b2);
+	return bit_equal(b1, b2);
+}
+
+extern bool bf_worker_take(uint32_t queue_pos, struct job_record *job_ptr,
+			   struct part_record *part_ptr,
+			   bitstr_t **avail_bitmap, bitstr_t *exc_core_bitmap,
+			   uint32_t min_nodes, uint32_t max_nodes,
+			   uint32_t req_nodes, int *rc)
+{
+	bf_test_t *test = NULL;
+	bool used = false;
+	int i;
+
+	slurm_mutex_lock(&worker_mutex);
+	for (i = 0; i < test_cnt; i++) {
+		if ((tests[i].state == BF_TEST_DONE) &&
+		    (tests[i].queue_pos == queue_pos)) {
+			test = &tests[i];
+			break;
+		}
+	}
+	if (!test) {
+		slurm_mutex_unlock(&worker_mutex);
+		return false;
+	}
+
+	if ((test->job_ptr   == job_ptr)   &&
+	    (test->part_ptr  == part_ptr)  &&
+	    (test->min_nodes == min_nodes) &&
+	    (test->max_nodes == max_nodes) &&
+	    (test->req_nodes == req_nodes) &&
+	    _bitmap_equal(test->avail_bitmap, *avail_bitmap) &&
+	    _bitmap_equal(test->exc_core_bitmap, exc_core_bitmap)) {
+		FREE_NULL_BITMAP(*avail_bitmap);
+		*avail_bitmap = test->select_bitmap;
+		test->select_bitmap = NULL;
+		job_ptr->start_time = test->start_time;
+		*rc = test->rc;
+		test->state = BF_TEST_FREE;
+		used_cnt++;
+		used = true;
+	}
+	_free_test(test);
+	slurm_mutex_unlock(&worker_mutex);
+
+	return used;
+}
+
+extern void bf_worker_discard(void)
+{
+	bool running;
+	int i;
+
+	slurm_mutex_lock(&worker_mutex);
+	do {
+		running = false;
+		for (i = 0; i < test_cnt; i++) {
+			_drop_test(&tests[i]);
+			if (tests[i].state == BF_TEST_DROPPED)
+				running = true;
+		}
+		if (running)
+			pthread_cond_wait(&done_cond, &worker_mutex);
+	} while (running);
+	slurm_mutex_unlock(&worker_mutex);
+}
+
+extern void bf_worker_log_stats(void)
+{
+	slurm_mutex_lock(&worker_mutex);
+	if (used_cnt || wasted_cnt) {
+		info("backfill: used %u of %u tests by worker threads",
+		     used_cnt, (used_cnt + wasted_cnt));
+	}
+	used_cnt = 0;
+	wasted_cnt = 0;
+	slurm_mutex_unlock(&worker_mutex);
+}
@@ -0,0 +1,120 @@
+/*****************************************************************************\
+ *  bf_worker.h - threads testing ahead when pending jobs could start
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifndef _SLURM_BF_WORKER_H
+#define _SLURM_BF_WORKER_H
+
+#include <stdint.h>
+
+#include "src/common/bitstring.h"
+#include "src/slurmctld/slurmctld.h"
+
+/*
+ * With SchedulerParameters=bf_threads=#, worker threads run the will-run
+ * tests of the jobs following the one the backfill scheduler is testing,
+ * against the nodes they would be offered at the time. The backfill
+ * scheduler still goes through the queue in order: on reaching a job it
+ * uses the speculative result if the job is offered exactly the nodes it
+ * was tested against, and tests it again otherwise, typically when a
+ * reservation made meanwhile for an earlier job changed them.
+ *
+ * Workers only read the job, node and partition records, the backfill
+ * scheduler holding the slurmctld locks meanwhile. Before changing any
+ * state they may read, such as starting a job or releasing its locks, the
+ * backfill scheduler must call bf_worker_discard(). Jobs are identified by
+ * their position in the job queue, starting from one.
+ */
+
+/* Same as _try_sched() in backfill.c */
+typedef int (*bf_worker_test_f)(struct job_record *job_ptr,
+				bitstr_t **avail_bitmap, uint32_t min_nodes,
+				uint32_t max_nodes, uint32_t req_nodes,
+				bitstr_t *exc_core_bitmap);
+
+/*
+ * Start thread_cnt worker threads testing jobs with test_func, or stop them
+ * if zero. Threads already running are restarted if their count differs.
+ */
+extern void bf_worker_start(int thread_cnt, bf_worker_test_f test_func);
+
+/* Stop the worker threads */
+extern void bf_worker_fini(void);
+
+/* Return true if worker threads are running */
+extern bool bf_worker_enabled(void);
+
+/* Return true if a test of this job is queued, running or done */
+extern bool bf_worker_busy(struct job_record *job_ptr);
+
+/*
+ * Queue the test of the job at position queue_pos in partition part_ptr,
+ * avail_bitmap and exc_core_bitmap being copied
+ * RET false if as many tests are pending as the workers may hold
+ */
+extern bool bf_worker_submit(uint32_t queue_pos, struct job_record *job_ptr,
+			     struct part_record *part_ptr,
+			     bitstr_t *avail_bitmap,
+			     bitstr_t *exc_core_bitmap, uint32_t min_nodes,
+			     uint32_t max_nodes, uint32_t req_nodes);
+
+/*
+ * The backfill scheduler reached job_ptr at position queue_pos: drop the
+ * tests of the jobs before it and the tests of job_ptr at later positions
+ * (the job queued in other partitions), then wait for every test of job_ptr
+ * still running, so that the job record can be changed
+ */
+extern void bf_worker_reach(uint32_t queue_pos, struct job_record *job_ptr);
+
+/*
+ * Use the test of the job at position queue_pos if done with the same
+ * arguments, replacing *avail_bitmap with the nodes selected and setting
+ * the job's start_time as _try_sched() would
+ * OUT rc - return code of the test
+ * RET true if used, false if the job must be tested now
+ */
+extern bool bf_worker_take(uint32_t queue_pos, struct job_record *job_ptr,
+			   struct part_record *part_ptr,
+			   bitstr_t **avail_bitmap, bitstr_t *exc_core_bitmap,
+			   uint32_t min_nodes, uint32_t max_nodes,
+			   uint32_t req_nodes, int *rc);
+
+/* Drop every test, waiting for those running to end */
+extern void bf_worker_discard(void);
+
+/* Log and reset the counts of tests used and wasted */
+extern void bf_worker_log_stats(void);
+
+#endif	/* _SLURM_BF_WORKER_H */
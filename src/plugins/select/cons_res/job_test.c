@@ -2075,13 +2075,14 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 	int error_code = SLURM_SUCCESS, ll; /* ll = layout array index */
 	uint16_t *layout_ptr = NULL;
 	bitstr_t *orig_map, *avail_cores, *free_cores, *part_core_map = NULL;
-	bitstr_t *tmpcore = NULL, *reqmap = NULL;
+	bitstr_t *reqmap = NULL;
 	bool test_only;
 	uint32_t c, i, k, n, csize, total_cpus, save_mem = 0;
 	int32_t build_cnt;
 	job_resources_t *job_res;
 	struct job_details *details_ptr;
 	struct part_res_record *p_ptr, *jp_ptr;
+	struct part_row_data **rows = NULL;
 	uint16_t *cpu_count;
 
 	if (gang_mode == -1) {
@@ -2133,7 +2134,8 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 		     job_ptr->job_id, bit_set_count(node_bitmap));
 	}
 
-	orig_map = bit_copy(node_bitmap);
+	orig_map = bit_scratch_alloc(bit_size(node_bitmap));
+	bit_copybits(orig_map, node_bitmap);
 	avail_cores = _make_core_bitmap(node_bitmap,
 					job_ptr->details->core_spec);
 
@@ -2149,7 +2151,7 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 				  part_core_map);
 	if (cpu_count == NULL) {
 		/* job cannot fit */
-		FREE_NULL_BITMAP(orig_map);
+		bit_scratch_free(orig_map);
 		FREE_NULL_BITMAP(free_cores);
 		FREE_NULL_BITMAP(avail_cores);
 		if (select_debug_flags & DEBUG_FLAG_CPU_BIND) {
@@ -2158,7 +2160,7 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 		}
 		return SLURM_ERROR;
 	} else if (test_only) {
-		FREE_NULL_BITMAP(orig_map);
+		bit_scratch_free(orig_map);
 		FREE_NULL_BITMAP(free_cores);
 		FREE_NULL_BITMAP(avail_cores);
 		xfree(cpu_count);
@@ -2166,7 +2168,7 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 			info("cons_res: cr_job_test: test 0 pass: test_only");
 		return SLURM_SUCCESS;
 	} else if (!job_ptr->best_switch) {
-		FREE_NULL_BITMAP(orig_map);
+		bit_scratch_free(orig_map);
 		FREE_NULL_BITMAP(free_cores);
 		FREE_NULL_BITMAP(avail_cores);
 		xfree(cpu_count);
@@ -2246,22 +2248,17 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 		bit_fmt(str, (sizeof(str) - 1), exc_core_bitmap);
 		debug2("excluding cores reserved: %s", str);
 #endif
-		bit_not(exc_core_bitmap);
-		bit_and(free_cores, exc_core_bitmap);
-		bit_not(exc_core_bitmap);
+		bit_and_not(free_cores, exc_core_bitmap);
 	}
 
 	/* remove all existing allocations from free_cores */
-	tmpcore = bit_copy(free_cores);
 	for (p_ptr = cr_part_ptr; p_ptr; p_ptr = p_ptr->next) {
 		if (!p_ptr->row)
 			continue;
 		for (i = 0; i < p_ptr->num_rows; i++) {
 			if (!p_ptr->row[i].row_bitmap)
 				continue;
-			bit_copybits(tmpcore, p_ptr->row[i].row_bitmap);
-			bit_not(tmpcore); /* set bits now "free" resources */
-			bit_and(free_cores, tmpcore);
+			bit_and_not(free_cores, p_ptr->row[i].row_bitmap);
 			if (p_ptr->part_ptr != job_ptr->part_ptr)
 				continue;
 			if (part_core_map) {
@@ -2311,9 +2308,7 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 	bit_copybits(free_cores, avail_cores);
 
 	if (exc_core_bitmap) {
-		bit_not(exc_core_bitmap);
-		bit_and(free_cores, exc_core_bitmap);
-		bit_not(exc_core_bitmap);
+		bit_and_not(free_cores, exc_core_bitmap);
 	}
 
 	for (jp_ptr = cr_part_ptr; jp_ptr; jp_ptr = jp_ptr->next) {
@@ -2346,9 +2341,7 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 		for (i = 0; i < p_ptr->num_rows; i++) {
 			if (!p_ptr->row[i].row_bitmap)
 				continue;
-			bit_copybits(tmpcore, p_ptr->row[i].row_bitmap);
-			bit_not(tmpcore); /* set bits now "free" resources */
-			bit_and(free_cores, tmpcore);
+			bit_and_not(free_cores, p_ptr->row[i].row_bitmap);
 		}
 	}
 	if (job_ptr->details->whole_node)
@@ -2388,9 +2381,7 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 		for (i = 0; i < p_ptr->num_rows; i++) {
 			if (!p_ptr->row[i].row_bitmap)
 				continue;
-			bit_copybits(tmpcore, p_ptr->row[i].row_bitmap);
-			bit_not(tmpcore); /* set bits now "free" resources */
-			bit_and(free_cores, tmpcore);
+			bit_and_not(free_cores, p_ptr->row[i].row_bitmap);
 		}
 	}
 	cpu_count = _select_nodes(job_ptr, min_nodes, max_nodes, req_nodes,
@@ -2418,7 +2409,6 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 	/*** Step 4 ***/
 	/* try to fit the job into an existing row
 	 *
-	 * tmpcore = worker core_bitmap
 	 * free_cores = core_bitmap to be built
 	 * avail_cores = static core_bitmap of all available cores
 	 */
@@ -2443,18 +2433,24 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 		goto alloc_job;
 	}
 
-	cr_sort_part_rows(jp_ptr);
+	/* Will-run tests may be run concurrently by the backfill scheduler,
+	 * so they leave the order of the partition rows untouched */
+	if (mode != SELECT_MODE_WILL_RUN)
+		cr_sort_part_rows(jp_ptr);
+	rows = xmalloc(sizeof(struct part_row_data *) * jp_ptr->num_rows);
+	for (i = 0; i < jp_ptr->num_rows; i++)
+		rows[i] = &(jp_ptr->row[i]);
+	if (mode == SELECT_MODE_WILL_RUN)
+		cr_sort_part_row_ptrs(rows, jp_ptr->num_rows);
 	c = jp_ptr->num_rows;
 	if (job_node_req != NODE_CR_AVAILABLE)
 		c = 1;
 	for (i = 0; i < c; i++) {
-		if (!jp_ptr->row[i].row_bitmap)
+		if (!rows[i]->row_bitmap)
 			break;
 		bit_copybits(node_bitmap, orig_map);
 		bit_copybits(free_cores, avail_cores);
-		bit_copybits(tmpcore, jp_ptr->row[i].row_bitmap);
-		bit_not(tmpcore);
-		bit_and(free_cores, tmpcore);
+		bit_and_not(free_cores, rows[i]->row_bitmap);
 		cpu_count = _select_nodes(job_ptr, min_nodes, max_nodes,
 					  req_nodes, node_bitmap, cr_node_cnt,
 					  free_cores, node_usage, cr_type,
@@ -2470,7 +2466,7 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 			info("cons_res: cr_job_test: test 4 fail - row %i", i);
 	}
 
-	if ((i < c) && !jp_ptr->row[i].row_bitmap) {
+	if ((i < c) && !rows[i]->row_bitmap) {
 		/* we've found an empty row, so use it */
 		bit_copybits(node_bitmap, orig_map);
 		bit_copybits(free_cores, avail_cores);
@@ -2512,10 +2508,10 @@ alloc_job:
 	 * create the job_resources struct,
 	 * distribute the job on the bits, and exit
 	 */
-	FREE_NULL_BITMAP(orig_map);
+	bit_scratch_free(orig_map);
 	FREE_NULL_BITMAP(avail_cores);
-	FREE_NULL_BITMAP(tmpcore);
 	FREE_NULL_BITMAP(part_core_map);
+	xfree(rows);
 	if ((!cpu_count) || (!job_ptr->best_switch)) {
 		/* we were sent here to cleanup and exit */
 		FREE_NULL_BITMAP(free_cores);
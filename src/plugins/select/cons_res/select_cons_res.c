@@ -101,6 +101,8 @@
 #  endif
 #endif
 
+#include <pthread.h>
+
 #include "src/common/slurm_xlator.h"
 #include "src/common/slurm_selecttype_info.h"
 #include "select_cons_res.h"
@@ -188,6 +190,30 @@ static bool select_state_initializing = true;
 static int select_node_cnt = 0;
 static int preempt_reorder_cnt = 1;
 static bool preempt_strict_order = false;
+static bool will_run_bisect = false;
+
+/*
+ * Will-run tests simulate the end of the running jobs one at a time, by end
+ * time. Without preemption the resulting future states are the same for
+ * every pending job until the running jobs change, so they are kept here,
+ * each built from the previous one when a test first needs it. Up to
+ * WILL_RUN_CACHE_MAX states are kept, later ones are built by each test in
+ * private as before.
+ */
+#define WILL_RUN_CACHE_MAX	64
+
+typedef struct will_run_state {
+	struct job_record *job_ptr;	/* job whose end leads to this state */
+	uint32_t job_id;
+	time_t end_time;
+	struct part_res_record *future_part;	/* NULL until built */
+	struct node_use_record *future_usage;
+} will_run_state_t;
+
+static pthread_mutex_t will_run_mutex = PTHREAD_MUTEX_INITIALIZER;
+static will_run_state_t *will_run_states = NULL;	/* by end_time */
+static int will_run_cnt = -1;	/* states, -1 if not built */
+static int will_run_built = 0;	/* states with future data */
 
 struct select_nodeinfo {
 	uint16_t magic;		/* magic number */
@@ -217,6 +243,7 @@ static int _sort_usable_nodes_dec(void *, void *);
 static int _test_only(struct job_record *job_ptr, bitstr_t *bitmap,
 		      uint32_t min_nodes, uint32_t max_nodes,
  		      uint32_t req_nodes, uint16_t job_node_req);
+static void _will_run_invalidate(void);
 static int _will_run_test(struct job_record *job_ptr, bitstr_t *bitmap,
 			  uint32_t min_nodes, uint32_t max_nodes,
 			  uint32_t req_nodes, uint16_t job_node_req,
@@ -412,6 +439,7 @@ static void _create_part_data(void)
 	struct part_res_record *this_ptr;
 	int num_parts;
 
+	_will_run_invalidate();
 	_destroy_part_data(select_part_record);
 	select_part_record = NULL;
 
@@ -555,6 +583,32 @@ extern void cr_sort_part_rows(struct part_res_record *p_ptr)
 	return;
 }
 
+/* Order pointers to the rows of a partition as cr_sort_part_rows() would
+ * order the rows themselves, leaving the partition untouched */
+extern void cr_sort_part_row_ptrs(struct part_row_data **rows,
+				  uint32_t num_rows)
+{
+	struct part_row_data *tmp_row;
+	uint32_t i, j, a, b;
+
+	for (i = 0; i < num_rows; i++) {
+		if (rows[i]->row_bitmap)
+			a = bit_set_count(rows[i]->row_bitmap);
+		else
+			a = 0;
+		for (j = i+1; j < num_rows; j++) {
+			if (!rows[j]->row_bitmap)
+				continue;
+			b = bit_set_count(rows[j]->row_bitmap);
+			if (b > a) {
+				tmp_row = rows[i];
+				rows[i] = rows[j];
+				rows[j] = tmp_row;
+			}
+		}
+	}
+}
+
 
 /*
  * _build_row_bitmaps: A job has been removed from the given partition,
@@ -796,6 +850,7 @@ static int _add_job_to_res(struct job_record *job_ptr, int action)
 
 	debug3("cons_res: _add_job_to_res: job %u act %d ", job_ptr->job_id,
 	       action);
+	_will_run_invalidate();
 
 	if (select_debug_flags & DEBUG_FLAG_CPU_BIND)
 		_dump_job_res(job);
@@ -1132,6 +1187,8 @@ static int _rm_job_from_res(struct part_res_record *part_record_ptr,
 	int i, n;
 	List gres_list;
 
+	if (part_record_ptr == select_part_record)
+		_will_run_invalidate();
 	if (select_state_initializing) {
 		/* Ignore job removal until select/cons_res data structures
 		 * values are set by select_p_reconfigure() */
@@ -1289,6 +1346,7 @@ static int _rm_job_from_one_node(struct job_record *job_ptr,
 
 	debug3("cons_res: _rm_job_from_one_node: job %u node %s",
 	       job_ptr->job_id, node_ptr->name);
+	_will_run_invalidate();
 	if (select_debug_flags & DEBUG_FLAG_CPU_BIND)
 		_dump_job_res(job);
 
@@ -1657,6 +1715,381 @@ top:	orig_map = bit_copy(save_bitmap);
 	return rc;
 }
 
+/* Discard the future states. Call with will_run_mutex locked. */
+static void _will_run_clear(void)
+{
+	int i;
+
+	for (i = 0; i < will_run_built; i++) {
+		_destroy_part_data(will_run_states[i].future_part);
+		_destroy_node_data(will_run_states[i].future_usage, NULL);
+	}
+	xfree(will_run_states);
+	will_run_cnt = -1;
+	will_run_built = 0;
+}
+
+/* Discard the future states, running jobs or their resources changed */
+static void _will_run_invalidate(void)
+{
+	slurm_mutex_lock(&will_run_mutex);
+	_will_run_clear();
+	slurm_mutex_unlock(&will_run_mutex);
+}
+
+static int _will_run_state_sort(const void *x, const void *y)
+{
+	const will_run_state_t *state1 = x;
+	const will_run_state_t *state2 = y;
+
+	return (int) SLURM_DIFFTIME(state1->end_time, state2->end_time);
+}
+
+/* List the running and suspended jobs by end time, with no future state
+ * built yet. Call with will_run_mutex locked. */
+static void _will_run_build(void)
+{
+	ListIterator job_iterator;
+	struct job_record *tmp_job_ptr;
+	will_run_state_t *state;
+
+	will_run_states = xmalloc(sizeof(will_run_state_t) *
+				  (list_count(job_list) + 1));
+	will_run_cnt = 0;
+	job_iterator = list_iterator_create(job_list);
+	while ((tmp_job_ptr = (struct job_record *) list_next(job_iterator))) {
+		if (!IS_JOB_RUNNING(tmp_job_ptr) &&
+		    !IS_JOB_SUSPENDED(tmp_job_ptr))
+			continue;
+		if (tmp_job_ptr->end_time == 0) {
+			error("Job %u has zero end_time", tmp_job_ptr->job_id);
+			continue;
+		}
+		state = &will_run_states[will_run_cnt++];
+		state->job_ptr  = tmp_job_ptr;
+		state->job_id   = tmp_job_ptr->job_id;
+		state->end_time = tmp_job_ptr->end_time;
+	}
+	list_iterator_destroy(job_iterator);
+	qsort(will_run_states, will_run_cnt, sizeof(will_run_state_t),
+	      _will_run_state_sort);
+}
+
+/* Return true if the listed jobs still run until the same end time.
+ * Call with will_run_mutex locked. */
+static bool _will_run_valid(void)
+{
+	struct job_record *tmp_job_ptr;
+	int i;
+
+	for (i = 0; i < will_run_cnt; i++) {
+		tmp_job_ptr = will_run_states[i].job_ptr;
+		if ((tmp_job_ptr->job_id != will_run_states[i].job_id) ||
+		    (tmp_job_ptr->end_time != will_run_states[i].end_time) ||
+		    (!IS_JOB_RUNNING(tmp_job_ptr) &&
+		     !IS_JOB_SUSPENDED(tmp_job_ptr)))
+			return false;
+	}
+	return true;
+}
+
+/* Build the future states up to index inx, each from the previous one.
+ * Call with will_run_mutex locked.
+ * RET true if built, false if beyond WILL_RUN_CACHE_MAX or out of data */
+static bool _will_run_extend(int inx)
+{
+	struct part_res_record *prev_part;
+	struct node_use_record *prev_usage;
+	will_run_state_t *state;
+
+	if (inx >= WILL_RUN_CACHE_MAX)
+		return false;
+	while (will_run_built <= inx) {
+		if (will_run_built == 0) {
+			prev_part  = select_part_record;
+			prev_usage = select_node_usage;
+		} else {
+			state = &will_run_states[will_run_built - 1];
+			prev_part  = state->future_part;
+			prev_usage = state->future_usage;
+		}
+		state = &will_run_states[will_run_built];
+		state->future_part  = _dup_part_data(prev_part);
+		state->future_usage = _dup_node_usage(prev_usage);
+		if (!state->future_part || !state->future_usage) {
+			_destroy_part_data(state->future_part);
+			_destroy_node_data(state->future_usage, NULL);
+			state->future_part  = NULL;
+			state->future_usage = NULL;
+			return false;
+		}
+		_rm_job_from_res(state->future_part, state->future_usage,
+				 state->job_ptr, 0);
+		will_run_built++;
+	}
+	return true;
+}
+
+/* Future state built by one test beyond the cached ones */
+typedef struct will_run_priv {
+	struct part_res_record *future_part;
+	struct node_use_record *future_usage;
+	int inx;		/* last job ended in it, -1 for none */
+} will_run_priv_t;
+
+/*
+ * Get the future state after the end of job inx, from the cache or else
+ * from priv, which is rebuilt from the last cached state if already past inx
+ * RET SLURM_SUCCESS or SLURM_ERROR if there is no select data
+ */
+static int _will_run_get(int inx, will_run_priv_t *priv,
+			 struct part_res_record **future_part,
+			 struct node_use_record **future_usage)
+{
+	struct part_res_record *base_part;
+	struct node_use_record *base_usage;
+	bool cached;
+
+	slurm_mutex_lock(&will_run_mutex);
+	cached = _will_run_extend(inx);
+	if (cached) {
+		*future_part  = will_run_states[inx].future_part;
+		*future_usage = will_run_states[inx].future_usage;
+	} else if (!priv->future_part || !priv->future_usage ||
+		   (priv->inx > inx)) {
+		_destroy_part_data(priv->future_part);
+		_destroy_node_data(priv->future_usage, NULL);
+		priv->inx = will_run_built - 1;
+		if (priv->inx < 0) {
+			base_part  = select_part_record;
+			base_usage = select_node_usage;
+		} else {
+			base_part  = will_run_states[priv->inx].future_part;
+			base_usage = will_run_states[priv->inx].future_usage;
+		}
+		priv->future_part  = _dup_part_data(base_part);
+		priv->future_usage = _dup_node_usage(base_usage);
+	}
+	slurm_mutex_unlock(&will_run_mutex);
+	if (cached)
+		return SLURM_SUCCESS;
+
+	if (!priv->future_part || !priv->future_usage)
+		return SLURM_ERROR;
+	while (priv->inx < inx) {
+		priv->inx++;
+		_rm_job_from_res(priv->future_part, priv->future_usage,
+				 will_run_states[priv->inx].job_ptr, 0);
+	}
+	*future_part  = priv->future_part;
+	*future_usage = priv->future_usage;
+	return SLURM_SUCCESS;
+}
+
+/* Test the job in the future state after the end of job inx, setting its
+ * start time on success */
+static int _will_run_at(int inx, will_run_priv_t *priv,
+			struct job_record *job_ptr, bitstr_t *bitmap,
+			bitstr_t *orig_map, uint32_t min_nodes,
+			uint32_t max_nodes, uint32_t req_nodes,
+			uint16_t tmp_cr_type, uint16_t job_node_req,
+			bitstr_t *exc_core_bitmap, time_t now)
+{
+	struct part_res_record *future_part;
+	struct node_use_record *future_usage;
+	time_t end_time = will_run_states[inx].end_time;
+	int rc;
+
+	if (_will_run_get(inx, priv, &future_part, &future_usage))
+		return SLURM_ERROR;
+	bit_or(bitmap, orig_map);
+	rc = cr_job_test(job_ptr, bitmap, min_nodes, max_nodes, req_nodes,
+			 SELECT_MODE_WILL_RUN, tmp_cr_type, job_node_req,
+			 select_node_cnt, future_part, future_usage,
+			 exc_core_bitmap);
+	if (rc == SLURM_SUCCESS) {
+		if (end_time <= now)
+			job_ptr->start_time = now + 1;
+		else
+			job_ptr->start_time = end_time;
+	}
+	return rc;
+}
+
+/*
+ * Return the first of the cand_cnt candidate jobs after whose end the nodes
+ * of orig_map may have enough free CPUs and nodes with a free CPU for the
+ * job, cand_cnt if none. Only running jobs are counted and memory, gres and
+ * cores are ignored, so the counts never miss a start. Return 0 where they
+ * do not hold: partitions with several rows or overcommit.
+ */
+static int _will_run_first_fit(struct job_record *job_ptr,
+			       bitstr_t *orig_map, int *cand, int cand_cnt,
+			       uint32_t min_nodes)
+{
+	struct part_res_record *p_ptr;
+	struct job_record *tmp_job_ptr;
+	job_resources_t *job_res;
+	uint32_t *alloc_cpus, *freed_cpus, *free_nodes;
+	uint32_t avail_cpus = 0, avail_nodes = 0;
+	int *first_free;
+	int i, j, k, n, pos = 0;
+
+	if (job_ptr->details->overcommit)
+		return 0;
+	for (p_ptr = select_part_record; p_ptr; p_ptr = p_ptr->next) {
+		if (p_ptr->num_rows > 1)
+			return 0;
+	}
+
+	alloc_cpus = xmalloc(sizeof(uint32_t) * select_node_cnt);
+	first_free = xmalloc(sizeof(int) * select_node_cnt);
+	for (n = 0; n < select_node_cnt; n++)
+		first_free[n] = cand_cnt;
+	freed_cpus = xmalloc(sizeof(uint32_t) * cand_cnt);
+	free_nodes = xmalloc(sizeof(uint32_t) * (cand_cnt + 1));
+
+	/* CPUs in use now and by the candidate jobs, on nodes of orig_map */
+	for (i = 0, j = 0; i < will_run_cnt; i++) {
+		while ((j < cand_cnt) && (cand[j] < i))
+			j++;
+		tmp_job_ptr = will_run_states[i].job_ptr;
+		job_res = tmp_job_ptr->job_resrcs;
+		if (!IS_JOB_RUNNING(tmp_job_ptr) || !job_res ||
+		    !job_res->node_bitmap || !job_res->cpus)
+			continue;
+		for (n = 0, k = -1; n < select_node_cnt; n++) {
+			if (!bit_test(job_res->node_bitmap, n))
+				continue;
+			if (++k >= job_res->nhosts)
+				break;
+			if (!bit_test(orig_map, n))
+				continue;
+			alloc_cpus[n] += job_res->cpus[k];
+			if ((j < cand_cnt) && (cand[j] == i)) {
+				freed_cpus[j] += job_res->cpus[k];
+				if (first_free[n] > j)
+					first_free[n] = j;
+			}
+		}
+	}
+
+	for (n = 0; n < select_node_cnt; n++) {
+		if (!bit_test(orig_map, n))
+			continue;
+		if (alloc_cpus[n] > select_node_record[n].cpus) {
+			pos = 0;	/* Oversubscribed, counts unusable */
+			goto fini;
+		}
+		avail_cpus += select_node_record[n].cpus - alloc_cpus[n];
+		if (alloc_cpus[n] < select_node_record[n].cpus)
+			avail_nodes++;
+		else
+			free_nodes[first_free[n]]++;
+	}
+	for (pos = 0; pos < cand_cnt; pos++) {
+		avail_cpus  += freed_cpus[pos];
+		avail_nodes += free_nodes[pos];
+		if ((avail_cpus >= job_ptr->details->min_cpus) &&
+		    (avail_nodes >= min_nodes))
+			break;
+	}
+
+fini:	xfree(alloc_cpus);
+	xfree(first_free);
+	xfree(freed_cpus);
+	xfree(free_nodes);
+	return pos;
+}
+
+/*
+ * Body of _will_run_test() for a job with no preemption candidates, run
+ * against the cached future states. Where these stop, the remaining jobs are
+ * removed from a private copy of the last one.
+ *
+ * Only the ends of jobs on nodes of orig_map are tested. By default they are
+ * tested one at a time in end time order. With will_run_bisect, a start
+ * being taken as never lost once possible, the first of them after which
+ * the job can start is found by bisection, from the first one passing the
+ * count checks of _will_run_first_fit().
+ */
+static int _will_run_cached(struct job_record *job_ptr, bitstr_t *bitmap,
+			    bitstr_t *orig_map, uint32_t min_nodes,
+			    uint32_t max_nodes, uint32_t req_nodes,
+			    uint16_t tmp_cr_type, uint16_t job_node_req,
+			    bitstr_t *exc_core_bitmap, time_t now)
+{
+	will_run_priv_t priv = { NULL, NULL, -1 };
+	struct job_record *tmp_job_ptr;
+	bitstr_t *best_map = NULL;
+	time_t best_start = 0;
+	int *cand, cand_cnt = 0;
+	int i, lo, hi, mid, tests = 0, rc = SLURM_ERROR;
+
+	slurm_mutex_lock(&will_run_mutex);
+	if ((will_run_cnt >= 0) && !_will_run_valid())
+		_will_run_clear();
+	if (will_run_cnt < 0)
+		_will_run_build();
+	slurm_mutex_unlock(&will_run_mutex);
+
+	cand = xmalloc(sizeof(int) * (will_run_cnt + 1));
+	for (i = 0; i < will_run_cnt; i++) {
+		tmp_job_ptr = will_run_states[i].job_ptr;
+		if (bit_overlap(orig_map, tmp_job_ptr->node_bitmap) == 0)
+			continue;	/* job has no usable nodes, skip it */
+		cand[cand_cnt++] = i;
+	}
+
+	if (!will_run_bisect) {
+		for (i = 0; i < cand_cnt; i++) {
+			debug2("cons_res: _will_run_test, job %u: overlap=%d",
+			       will_run_states[cand[i]].job_id,
+			       bit_overlap(orig_map, will_run_states[cand[i]].
+					   job_ptr->node_bitmap));
+			rc = _will_run_at(cand[i], &priv, job_ptr, bitmap,
+					  orig_map, min_nodes, max_nodes,
+					  req_nodes, tmp_cr_type, job_node_req,
+					  exc_core_bitmap, now);
+			if (rc == SLURM_SUCCESS)
+				break;
+		}
+		goto fini;
+	}
+
+	lo = _will_run_first_fit(job_ptr, orig_map, cand, cand_cnt,
+				 min_nodes);
+	hi = cand_cnt - 1;
+	while (lo <= hi) {
+		mid = lo + (hi - lo) / 2;
+		tests++;
+		if (_will_run_at(cand[mid], &priv, job_ptr, bitmap, orig_map,
+				 min_nodes, max_nodes, req_nodes, tmp_cr_type,
+				 job_node_req, exc_core_bitmap, now) ==
+		    SLURM_SUCCESS) {
+			best_start = job_ptr->start_time;
+			FREE_NULL_BITMAP(best_map);
+			best_map = bit_copy(bitmap);
+			hi = mid - 1;
+		} else {
+			lo = mid + 1;
+		}
+	}
+	debug2("cons_res: _will_run_test, job %u: %d tests for %d job ends",
+	       job_ptr->job_id, tests, cand_cnt);
+	if (best_map) {
+		bit_copybits(bitmap, best_map);
+		job_ptr->start_time = best_start;
+		FREE_NULL_BITMAP(best_map);
+		rc = SLURM_SUCCESS;
+	}
+
+fini:	xfree(cand);
+	_destroy_part_data(priv.future_part);
+	_destroy_node_data(priv.future_usage, NULL);
+	return rc;
+}
+
 /* _will_run_test - determine when and where a pending job can start, removes
  *	jobs from node table at termination time and run _test_job() after
  *	each one. Used by SLURM's sched/backfill plugin and Moab. */
@@ -1703,6 +2136,13 @@ static int _will_run_test(struct job_record *job_ptr, bitstr_t *bitmap,
 
 	/* Job is still pending. Simulate termination of jobs one at a time
 	 * to determine when and where the job can start. */
+	if (!preemptee_candidates) {
+		rc = _will_run_cached(job_ptr, bitmap, orig_map, min_nodes,
+				      max_nodes, req_nodes, tmp_cr_type,
+				      job_node_req, exc_core_bitmap, now);
+		FREE_NULL_BITMAP(orig_map);
+		return rc;
+	}
 	future_part = _dup_part_data(select_part_record);
 	if (future_part == NULL) {
 		FREE_NULL_BITMAP(orig_map);
@@ -1850,6 +2290,7 @@ extern int init(void)
 
 extern int fini(void)
 {
+	_will_run_invalidate();
 	_destroy_node_data(select_node_usage, select_node_record);
 	select_node_record = NULL;
 	select_node_usage = NULL;
@@ -1934,6 +2375,10 @@ extern int select_p_node_init(struct node_record *node_ptr, int node_cnt)
 	sched_params = slurm_get_sched_params();
 	if (sched_params && strstr(sched_params, "preempt_strict_order"))
 		preempt_strict_order = true;
+	if (sched_params && strstr(sched_params, "will_run_bisect"))
+		will_run_bisect = true;
+	else
+		will_run_bisect = false;
 	if (sched_params &&
 	    (tmp_ptr = strstr(sched_params, "preempt_reorder_count=")))
 		preempt_reorder_cnt = atoi(tmp_ptr + 22);
@@ -1948,6 +2393,7 @@ extern int select_p_node_init(struct node_record *node_ptr, int node_cnt)
 	select_fast_schedule = slurm_get_fast_schedule();
 	cr_init_global_core_data(node_ptr, node_cnt, select_fast_schedule);
 
+	_will_run_invalidate();
 	_destroy_node_data(select_node_usage, select_node_record);
 	select_node_cnt  = node_cnt;
 	select_node_record = xmalloc(node_cnt *
@@ -2966,11 +3412,8 @@ extern bitstr_t * select_p_resv_test(bitstr_t *avail_bitmap, uint32_t node_cnt,
 		switches_core_bitmap[i] =
 			_make_core_bitmap_filtered(switches_bitmap[i], 1);
 
-		if (*core_bitmap) {
-			bit_not(*core_bitmap);
-			bit_and(switches_core_bitmap[i], *core_bitmap);
-			bit_not(*core_bitmap);
-		}
+		if (*core_bitmap)
+			bit_and_not(switches_core_bitmap[i], *core_bitmap);
 		bit_fmt(str, sizeof(str), switches_core_bitmap[i]);
 		debug2("Switch %d can use cores: %s", i, str);
 
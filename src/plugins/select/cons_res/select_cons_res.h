@@ -111,6 +111,8 @@ extern struct node_res_record *select_node_record;
 extern struct node_use_record *select_node_usage;
 
 extern void cr_sort_part_rows(struct part_res_record *p_ptr);
+extern void cr_sort_part_row_ptrs(struct part_row_data **rows,
+				  uint32_t num_rows);
 extern uint32_t cr_get_coremap_offset(uint32_t node_index);
 
 #endif /* !_CONS_RES_H */
@@ -308,123 +308,152 @@ static int _fini_status_pthread(void)
 }
 #endif
 
-/* Add job id to record of jobs running on this node */
-static void _add_run_job(struct cr_record *cr_ptr, uint32_t job_id)
+/* Find job_id in a job ID set by binary search, set *inx to its position
+ * or to where it would be inserted.
+ * RET true if job_id is in the set */
+static bool _job_set_find(struct job_id_set *set, uint32_t job_id,
+			  uint32_t *inx)
+{
+	uint32_t lo = 0, hi, mid;
+
+	if (set) {
+		hi = set->cnt;
+		while (lo < hi) {
+			mid = (lo + hi) / 2;
+			if (set->ids[mid] < job_id)
+				lo = mid + 1;
+			else if (set->ids[mid] > job_id)
+				hi = mid;
+			else {
+				*inx = mid;
+				return true;
+			}
+		}
+	}
+	*inx = lo;
+	return false;
+}
+
+/* Return a job ID set which the caller may modify, copying *set_pptr if it
+ * is shared with another cr_record and creating it if NULL */
+static struct job_id_set *_job_set_write(struct job_id_set **set_pptr)
 {
-	int i;
+	struct job_id_set *set = *set_pptr, *new_set;
 
-	if (cr_ptr->run_job_ids == NULL) {	/* create new array */
-		cr_ptr->run_job_len = RUN_JOB_INCR;
-		cr_ptr->run_job_ids = xmalloc(sizeof(uint32_t) *
-					      cr_ptr->run_job_len);
-		cr_ptr->run_job_ids[0] = job_id;
-		return;
-	}
+	if (set && (set->ref_cnt == 1))
+		return set;
 
-	for (i=0; i<cr_ptr->run_job_len; i++) {
-		if (cr_ptr->run_job_ids[i])
-			continue;
-		/* fill in hole */
-		cr_ptr->run_job_ids[i] = job_id;
-		return;
+	new_set = xmalloc(sizeof(struct job_id_set));
+	new_set->ref_cnt = 1;
+	if (set && set->cnt) {
+		new_set->cnt  = set->cnt;
+		new_set->size = set->cnt + RUN_JOB_INCR;
+		new_set->ids  = xmalloc(sizeof(uint32_t) * new_set->size);
+		memcpy(new_set->ids, set->ids, sizeof(uint32_t) * set->cnt);
 	}
-
-	/* expand array and add to end */
-	cr_ptr->run_job_len += RUN_JOB_INCR;
-	xrealloc(cr_ptr->run_job_ids, sizeof(uint32_t) * cr_ptr->run_job_len);
-	cr_ptr->run_job_ids[i] = job_id;
+	if (set)
+		set->ref_cnt--;
+	*set_pptr = new_set;
+	return new_set;
 }
 
-/* Add job id to record of jobs running or suspended on this node */
-static void _add_tot_job(struct cr_record *cr_ptr, uint32_t job_id)
+/* Add job_id to a job ID set, if not already there */
+static void _job_set_add(struct job_id_set **set_pptr, uint32_t job_id)
 {
-	int i;
+	struct job_id_set *set;
+	uint32_t inx;
 
-	if (cr_ptr->tot_job_ids == NULL) {	/* create new array */
-		cr_ptr->tot_job_len = RUN_JOB_INCR;
-		cr_ptr->tot_job_ids = xmalloc(sizeof(uint32_t) *
-					      cr_ptr->tot_job_len);
-		cr_ptr->tot_job_ids[0] = job_id;
+	if (_job_set_find(*set_pptr, job_id, &inx))
 		return;
-	}
 
-	for (i=0; i<cr_ptr->tot_job_len; i++) {
-		if (cr_ptr->tot_job_ids[i])
-			continue;
-		/* fill in hole */
-		cr_ptr->tot_job_ids[i] = job_id;
-		return;
+	set = _job_set_write(set_pptr);
+	if (set->cnt == set->size) {	/* expand array */
+		set->size = MAX(set->size * 2, RUN_JOB_INCR);
+		xrealloc(set->ids, sizeof(uint32_t) * set->size);
 	}
-
-	/* expand array and add to end */
-	cr_ptr->tot_job_len += RUN_JOB_INCR;
-	xrealloc(cr_ptr->tot_job_ids, sizeof(uint32_t) * cr_ptr->tot_job_len);
-	cr_ptr->tot_job_ids[i] = job_id;
+	/* Job IDs mostly increase, so this rarely moves anything */
+	memmove(set->ids + inx + 1, set->ids + inx,
+		sizeof(uint32_t) * (set->cnt - inx));
+	set->ids[inx] = job_id;
+	set->cnt++;
 }
 
-static bool _ck_run_job(struct cr_record *cr_ptr, uint32_t job_id,
-			bool clear_it)
+/* Remove job_id from a job ID set,
+ * RET true if successful, false if job_id was not in the set */
+static bool _job_set_rem(struct job_id_set **set_pptr, uint32_t job_id)
 {
-	int i;
-	bool rc = false;
+	struct job_id_set *set;
+	uint32_t inx;
 
-	if ((cr_ptr->run_job_ids == NULL) || (cr_ptr->run_job_len == 0))
-		return rc;
+	if (!_job_set_find(*set_pptr, job_id, &inx))
+		return false;
 
-	for (i=0; i<cr_ptr->run_job_len; i++) {
-		if (cr_ptr->run_job_ids[i] != job_id)
-			continue;
-		if (clear_it)
-			cr_ptr->run_job_ids[i] = 0;
-		rc = true;
+	set = _job_set_write(set_pptr);
+	set->cnt--;
+	memmove(set->ids + inx, set->ids + inx + 1,
+		sizeof(uint32_t) * (set->cnt - inx));
+	return true;
+}
+
+/* Return another reference to a job ID set, for a duplicated cr_record */
+static struct job_id_set *_job_set_ref(struct job_id_set *set)
+{
+	if (set)
+		set->ref_cnt++;
+	return set;
+}
+
+/* Release a reference to a job ID set, freeing it with the last one */
+static void _job_set_free(struct job_id_set *set)
+{
+	if (set && (--set->ref_cnt == 0)) {
+		xfree(set->ids);
+		xfree(set);
 	}
-	return rc;
+}
+
+/* Add job id to record of jobs running on this node */
+static void _add_run_job(struct cr_record *cr_ptr, uint32_t job_id)
+{
+	_job_set_add(&cr_ptr->run_jobs, job_id);
+}
+
+/* Add job id to record of jobs running or suspended on this node */
+static void _add_tot_job(struct cr_record *cr_ptr, uint32_t job_id)
+{
+	_job_set_add(&cr_ptr->tot_jobs, job_id);
 }
 
 /* Remove job id from record of jobs running,
  * RET true if successful, false if the job was not running */
 static bool _rem_run_job(struct cr_record *cr_ptr, uint32_t job_id)
 {
-	return _ck_run_job(cr_ptr, job_id, true);
+	return _job_set_rem(&cr_ptr->run_jobs, job_id);
 }
 
 /* Test for job id in record of jobs running,
  * RET true if successful, false if the job was not running */
 static bool _test_run_job(struct cr_record *cr_ptr, uint32_t job_id)
 {
-	return _ck_run_job(cr_ptr, job_id, false);
-}
+	uint32_t inx;
 
-static bool _ck_tot_job(struct cr_record *cr_ptr, uint32_t job_id,
-			bool clear_it)
-{
-	int i;
-	bool rc = false;
-
-	if ((cr_ptr->tot_job_ids == NULL) || (cr_ptr->tot_job_len == 0))
-		return rc;
-
-	for (i=0; i<cr_ptr->tot_job_len; i++) {
-		if (cr_ptr->tot_job_ids[i] != job_id)
-			continue;
-		if (clear_it)
-			cr_ptr->tot_job_ids[i] = 0;
-		rc = true;
-	}
-	return rc;
+	return _job_set_find(cr_ptr->run_jobs, job_id, &inx);
 }
+
 /* Remove job id from record of jobs running or suspended,
  * RET true if successful, false if the job was not found */
 static bool _rem_tot_job(struct cr_record *cr_ptr, uint32_t job_id)
 {
-	return _ck_tot_job(cr_ptr, job_id, true);
+	return _job_set_rem(&cr_ptr->tot_jobs, job_id);
 }
 
 /* Test for job id in record of jobs running or suspended,
  * RET true if successful, false if the job was not found */
 static bool _test_tot_job(struct cr_record *cr_ptr, uint32_t job_id)
 {
-	return _ck_tot_job(cr_ptr, job_id, false);
+	uint32_t inx;
+
+	return _job_set_find(cr_ptr->tot_jobs, job_id, &inx);
 }
 
 static bool _enough_nodes(int avail_nodes, int rem_nodes,
@@ -2081,8 +2110,8 @@ static void _free_cr(struct cr_record *cr_ptr)
 			list_destroy(cr_ptr->nodes[i].gres_list);
 	}
 	xfree(cr_ptr->nodes);
-	xfree(cr_ptr->run_job_ids);
-	xfree(cr_ptr->tot_job_ids);
+	_job_set_free(cr_ptr->run_jobs);
+	_job_set_free(cr_ptr->tot_jobs);
 	xfree(cr_ptr);
 }
 
@@ -2097,14 +2126,10 @@ static void _dump_node_cr(struct cr_record *cr_ptr)
 	if ((cr_ptr == NULL) || (cr_ptr->nodes == NULL))
 		return;
 
-	for (i = 0; i < cr_ptr->run_job_len; i++) {
-		if (cr_ptr->run_job_ids[i])
-			info("Running job:%u", cr_ptr->run_job_ids[i]);
-	}
-	for (i = 0; i < cr_ptr->tot_job_len; i++) {
-		if (cr_ptr->tot_job_ids[i])
-			info("Alloc job:%u", cr_ptr->tot_job_ids[i]);
-	}
+	for (i = 0; cr_ptr->run_jobs && (i < cr_ptr->run_jobs->cnt); i++)
+		info("Running job:%u", cr_ptr->run_jobs->ids[i]);
+	for (i = 0; cr_ptr->tot_jobs && (i < cr_ptr->tot_jobs->cnt); i++)
+		info("Alloc job:%u", cr_ptr->tot_jobs->ids[i]);
 
 	for (i = 0; i < select_node_cnt; i++) {
 		node_ptr = node_record_table_ptr + i;
@@ -2143,14 +2168,9 @@ static struct cr_record *_dup_cr(struct cr_record *cr_ptr)
 		return NULL;
 
 	new_cr_ptr = xmalloc(sizeof(struct cr_record));
-	new_cr_ptr->run_job_len = cr_ptr->run_job_len;
-	i = sizeof(uint32_t) * cr_ptr->run_job_len;
-	new_cr_ptr->run_job_ids = xmalloc(i);
-	memcpy(new_cr_ptr->run_job_ids, cr_ptr->run_job_ids, i);
-	new_cr_ptr->tot_job_len = cr_ptr->tot_job_len;
-	i = sizeof(uint32_t) * cr_ptr->tot_job_len;
-	new_cr_ptr->tot_job_ids = xmalloc(i);
-	memcpy(new_cr_ptr->tot_job_ids, cr_ptr->tot_job_ids, i);
+	/* Copied only when either record is modified */
+	new_cr_ptr->run_jobs = _job_set_ref(cr_ptr->run_jobs);
+	new_cr_ptr->tot_jobs = _job_set_ref(cr_ptr->tot_jobs);
 
 	new_cr_ptr->nodes = xmalloc(select_node_cnt *
 				    sizeof(struct node_cr_record));
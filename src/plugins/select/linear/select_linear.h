@@ -74,13 +74,23 @@ struct node_cr_record {
 					 * plugins */
 };
 
+/*
+ * job_id_set is a sorted array of job IDs. A cr_record and its duplicates
+ * share their sets until one of them modifies a set, which is then copied
+ * (copy on write). All access is protected by cr_mutex.
+ */
+struct job_id_set {
+	uint32_t *ids;			/* sorted job IDs */
+	uint32_t cnt;			/* count of job IDs in ids */
+	uint32_t size;			/* length of ids array */
+	uint32_t ref_cnt;		/* count of cr_records using the set */
+};
+
 struct cr_record {
 	struct node_cr_record *nodes;	/* ptr to array of node records */
-	uint32_t *run_job_ids;		/* job IDs for running jobs */
-	uint16_t run_job_len;		/* length of run_job_ids array */
-	uint32_t *tot_job_ids;		/* job IDs for allocated jobs 
+	struct job_id_set *run_jobs;	/* job IDs for running jobs */
+	struct job_id_set *tot_jobs;	/* job IDs for allocated jobs
 					 * (RUNNING & SUSPENDED)*/
-	uint16_t tot_job_len;		/* length of tot_job_ids array */
 };
 
 #endif /* !_SELECT_LINEAR_H */
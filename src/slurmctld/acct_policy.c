@@ -2108,7 +2108,7 @@ extern int acct_policy_update_pending_job(struct job_record *job_ptr)
 	}
 
 	if (update_accounting) {
-		last_job_update = time(NULL);
+		last_job_update = job_ptr->last_update = time(NULL);
 		debug("limits changed for job %u: updating accounting",
 		      job_ptr->job_id);
 		if (details_ptr->begin_time) {
@@ -2169,7 +2169,7 @@ extern bool acct_policy_job_time_out(struct job_record *job_ptr)
 
 		if ((qos->grp_cpu_mins != (uint64_t)INFINITE)
 		    && (usage_mins >= qos->grp_cpu_mins)) {
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
 			info("Job %u timed out, "
 			     "the job is at or exceeds QOS %s's "
 			     "group max cpu minutes of %"PRIu64" "
@@ -2184,7 +2184,7 @@ extern bool acct_policy_job_time_out(struct job_record *job_ptr)
 
 		if ((qos->grp_wall != INFINITE)
 		    && (wall_mins >= qos->grp_wall)) {
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
 			info("Job %u timed out, "
 			     "the job is at or exceeds QOS %s's "
 			     "group wall limit of %u with %u",
@@ -2197,7 +2197,7 @@ extern bool acct_policy_job_time_out(struct job_record *job_ptr)
 
 		if ((qos->max_cpu_mins_pj != (uint64_t)INFINITE)
 		    && (job_cpu_usage_mins >= qos->max_cpu_mins_pj)) {
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
 			info("Job %u timed out, "
 			     "the job is at or exceeds QOS %s's "
 			     "max cpu minutes of %"PRIu64" "
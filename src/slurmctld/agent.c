@@ -96,6 +96,9 @@
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/state_save.h"
 #include "src/slurmctld/srun_comm.h"
+#ifdef SLURM_SIMULATOR
+#include "src/slurmctld/sim_nodes.h"
+#endif
 
 #define MAX_RETRIES		100
 
@@ -1303,6 +1306,14 @@ void agent_queue_request(agent_arg_t *agent_arg_ptr)
 {
 	queued_request_t *queued_req_ptr = NULL;
 
+#ifdef SLURM_SIMULATOR
+	if (sim_nodes_enabled()) {
+		sim_nodes_agent_request(agent_arg_ptr);
+		_purge_agent_args(agent_arg_ptr);
+		return;
+	}
+#endif
+
 	if (agent_arg_ptr->msg_type == REQUEST_SHUTDOWN) {
 		/* execute now */
 		pthread_attr_t attr_agent;
@@ -116,6 +116,9 @@
 #include <semaphore.h>
 #include <pthread.h>
 #include "src/common/slurm_sim.h"
+#include "src/common/sim_sync.h"
+#include "src/slurmctld/sim_nodes.h"
+#include "src/slurmctld/sim_trace.h"
 #endif
 
 
@@ -205,11 +208,6 @@ static pthread_t assoc_cache_thread = (pthread_t) 0;
 static pthread_mutex_t sched_cnt_mutex = PTHREAD_MUTEX_INITIALIZER;
 static int      job_sched_cnt = 0;
 
-#ifdef SLURM_SIMULATOR
-char SEM_NAME[]		= "serversem";
-sem_t* mutexserver	= SEM_FAILED;
-#endif
-
 /*
  * Static list of signals to block in this process
  * *Must be zero-terminated*
@@ -518,6 +516,10 @@ int main(int argc, char *argv[])
 
 		_accounting_cluster_ready();
 
+#ifdef SLURM_SIMULATOR
+		/* Before the priority decay thread reports its next time */
+		sim_sync_attach(SIM_SYNC_SLURMCTLD);
+#endif
 		if (slurm_priority_init() != SLURM_SUCCESS)
 			fatal("failed to initialize priority plugin");
 #ifndef SLURM_SIMULATOR
@@ -526,6 +528,10 @@ int main(int argc, char *argv[])
 #endif
 		if (slurmctld_plugstack_init())
 			fatal("failed to initialize slurmctld_plugstack");
+#ifdef SLURM_SIMULATOR
+		if (sim_trace_init())
+			fatal("failed to open the simulation event trace");
+#endif
 
 		/*
 		 * create attached thread to process RPCs
@@ -573,10 +579,22 @@ int main(int argc, char *argv[])
   		 */
 		start_power_mgr(&slurmctld_config.thread_id_power);
 
+#ifdef SLURM_SIMULATOR
+		/*
+		 * simulate the compute nodes in-process if so configured
+		 */
+		if (sim_nodes_enabled() && sim_nodes_start())
+			fatal("failed to start in-process simulated nodes");
+#endif
+
 		/*
 		 * process slurm background activities, could run as pthread
 		 */
 		_slurmctld_background(NULL);
+#ifdef SLURM_SIMULATOR
+		sim_nodes_fini();
+		sim_trace_fini();
+#endif
 
 		/* termination of controller */
 		dir_name = slurm_get_state_save_location();
@@ -713,6 +731,9 @@ int main(int argc, char *argv[])
 		info("Slurmctld shutdown completing with %d active agent "
 		     "thread", cnt);
 	}
+#ifdef SLURM_SIMULATOR
+	sim_sync_close(SIM_SYNC_SLURMCTLD);
+#endif
 	log_fini();
 	sched_log_fini();
 
@@ -1030,41 +1051,6 @@ void *_slurmctld_rpc_mgr(void *no_data)
 	return NULL;
 }
 
-/* st on 20151020 */
-#ifdef SLURM_SIMULATOR
-int
-open_global_sync_sem() {
-	int iter = 0;
-	while (mutexserver == SEM_FAILED && iter < 10) {
-		mutexserver = sem_open(SEM_NAME, 0, 0644, 0);
-		if(mutexserver == SEM_FAILED) sleep(1);
-		++iter;
-	}
-
-	if(mutexserver == SEM_FAILED)
-		return -1;
-	else
-		return 0;
-}
-
-void
-perform_global_sync() {
-	while(*global_sync_flag < 2 || *global_sync_flag > 4) {
-		usleep(100000); /* one-tenth second */
-	}
-
-	sem_wait(mutexserver);
-	*global_sync_flag += 1;
-	if ( *global_sync_flag > 4) *global_sync_flag = 1;
-	sem_post(mutexserver);
-}
-void
-close_global_sync_sem() {
-	if(mutexserver != SEM_FAILED) sem_close(mutexserver);
-}
-#endif
-/* st on 20151020 */
-
 /*
  * _service_connection - service the RPC
  * IN/OUT arg - really just the connection's file descriptor, freed
@@ -1076,9 +1062,11 @@ void *_service_connection(void *arg)
 	connection_arg_t *conn = (connection_arg_t *) arg;
 	void *return_code = NULL;
 	slurm_msg_t *msg = xmalloc(sizeof(slurm_msg_t));
+#ifdef SLURM_SIMULATOR
+	bool sim_step;
+#endif
 
 	slurm_msg_t_init(msg);
-	open_global_sync_sem();
 	/*
 	 * slurm_receive_msg sets msg connection fd to accepted fd. This allows
 	 * possibility for slurmctld_req() to close accepted connection.
@@ -1104,11 +1092,18 @@ void *_service_connection(void *arg)
 		error ("close(%d): %m",  conn->newsockfd);
 
 cleanup:
+#ifdef SLURM_SIMULATOR
+	/* REQUEST_SIM_JOB used to go to slurmd, which takes no step for it */
+	sim_step = (msg->msg_type != REQUEST_SIM_JOB);
+#endif
 	slurm_free_msg(msg);
 	xfree(arg);
 	_free_server_thread();
 
-	perform_global_sync(); /* st on 20151020 */
+#ifdef SLURM_SIMULATOR
+	if (sim_step)
+		sim_sync_step(SIM_SYNC_SLURMCTLD);
+#endif
 	pthread_exit(NULL);
 	return return_code;
 }
@@ -1444,6 +1439,10 @@ static void *_slurmctld_background(void *no_data)
 	last_no_resp_msg_time = last_resv_time = last_ctld_bu_ping = now;
 	last_uid_update = last_reboot_msg_time = now;
 	last_acct_gather_node_time = last_ext_sensors_time = now;
+#ifdef SLURM_SIMULATOR
+	sim_sync_set_next(SIM_SYNC_NEXT_TIMEOUT_CHECK,
+			  last_timelimit_time + PERIODIC_TIMEOUT);
+#endif
 
 	if ((slurmctld_conf.min_job_age > 0) &&
 	    (slurmctld_conf.min_job_age < PURGE_JOB_INTERVAL)) {
@@ -1530,6 +1529,11 @@ static void *_slurmctld_background(void *no_data)
 			job_time_limit();
 			step_checkpoint();
 			unlock_slurmctld(job_write_lock);
+#ifdef SLURM_SIMULATOR
+			sim_sync_set_next(SIM_SYNC_NEXT_TIMEOUT_CHECK,
+					  last_timelimit_time +
+					  PERIODIC_TIMEOUT);
+#endif
 		}
 
 		if (slurmctld_conf.health_check_interval &&
@@ -1673,6 +1677,10 @@ static void *_slurmctld_background(void *no_data)
 			lock_slurmctld(job_node_read_lock);
 			trigger_process();
 			unlock_slurmctld(job_node_read_lock);
+#ifdef SLURM_SIMULATOR
+			sim_sync_set_next(SIM_SYNC_NEXT_TRIGGER,
+					  last_trigger + TRIGGER_INTERVAL + 1);
+#endif
 		}
 
 #ifndef SLURM_SIMULATOR
@@ -0,0 +1,694 @@
+/*****************************************************************************\
+ *  dry_run.c - project pending job start times on a slurmctld snapshot
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/bitstring.h"
+#include "src/common/job_resources.h"
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/node_select.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/dry_run.h"
+#include "src/slurmctld/job_scheduler.h"
+#include "src/slurmctld/licenses.h"
+#include "src/slurmctld/locks.h"
+#include "src/slurmctld/slurmctld.h"
+
+#define DRY_RUN_BF_WINDOW	(24 * 60 * 60)	/* as the backfill scheduler */
+#define DRY_RUN_BF_JOB_TEST	100
+#define DRY_RUN_KILL_DELAY	5	/* seconds past max_time */
+#define MAX_FAILED_RESV		10
+
+/* Nodes reserved by the backfill scheduler for a job to start later */
+typedef struct dry_run_resv {
+	time_t start_time;
+	time_t end_time;
+	bitstr_t *avail_bitmap;		/* nodes NOT reserved */
+} dry_run_resv_t;
+
+typedef struct dry_run_conf {
+	bool backfill;			/* sched/backfill configured */
+	time_t bf_window;		/* seconds */
+	int bf_max_job_test;
+	time_t end_time;		/* of the projection */
+	time_t deadline;		/* monotonic clock */
+} dry_run_conf_t;
+
+static pthread_mutex_t dry_run_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static time_t _monotonic(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+static void _resv_del(void *x)
+{
+	dry_run_resv_t *resv = (dry_run_resv_t *) x;
+
+	if (resv) {
+		FREE_NULL_BITMAP(resv->avail_bitmap);
+		xfree(resv);
+	}
+}
+
+static void _queue_rec_del(void *x)
+{
+	xfree(x);
+}
+
+/* Determine a job's time limit in a partition, in minutes, as the backfill
+ * scheduler does */
+static uint32_t _job_time_limit(struct job_record *job_ptr,
+				struct part_record *part_ptr)
+{
+	uint32_t part_time_limit;
+
+	if (part_ptr->max_time == INFINITE)
+		part_time_limit = 365 * 24 * 60; /* one year */
+	else
+		part_time_limit = part_ptr->max_time;
+	if (job_ptr->time_limit == NO_VAL)
+		return part_time_limit;
+	if (part_ptr->max_time == INFINITE)
+		return job_ptr->time_limit;
+	return MIN(job_ptr->time_limit, part_time_limit);
+}
+
+static void _queue_append(List job_queue, struct job_record *job_ptr,
+			  struct part_record *part_ptr, uint32_t priority)
+{
+	job_queue_rec_t *job_queue_rec;
+
+	job_queue_rec = xmalloc(sizeof(job_queue_rec_t));
+	job_queue_rec->job_id   = job_ptr->job_id;
+	job_queue_rec->job_ptr  = job_ptr;
+	job_queue_rec->part_ptr = part_ptr;
+	job_queue_rec->priority = priority;
+	list_append(job_queue, job_queue_rec);
+}
+
+/* Queue every pending job in each of its partitions, in priority order.
+ * Priorities do not change during a projection, so it is built once. */
+static List _build_queue(void)
+{
+	List job_queue;
+	ListIterator job_iterator, part_iterator;
+	struct job_record *job_ptr;
+	struct part_record *part_ptr;
+	int inx;
+
+	job_queue = list_create(_queue_rec_del);
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		if (!IS_JOB_PENDING(job_ptr) || (job_ptr->priority == 0) ||
+		    !job_ptr->details)
+			continue;
+		if (job_ptr->part_ptr_list) {
+			inx = 0;
+			part_iterator = list_iterator_create(
+				job_ptr->part_ptr_list);
+			while ((part_ptr = (struct part_record *)
+				list_next(part_iterator))) {
+				_queue_append(job_queue, job_ptr, part_ptr,
+					      job_ptr->priority_array ?
+					      job_ptr->priority_array[inx] :
+					      job_ptr->priority);
+				inx++;
+			}
+			list_iterator_destroy(part_iterator);
+		} else if (job_ptr->part_ptr) {
+			_queue_append(job_queue, job_ptr, job_ptr->part_ptr,
+				      job_ptr->priority);
+		}
+	}
+	list_iterator_destroy(job_iterator);
+	sort_job_queue(job_queue);
+
+	return job_queue;
+}
+
+/* Add delta to a priority, keeping it above zero which holds the job */
+static uint32_t _prio_add(uint32_t priority, double delta)
+{
+	double new_prio = (double) priority + delta;
+
+	if (new_prio < 1.0)
+		return 1;
+	if (new_prio > (double) 0xfffffffe)
+		return 0xfffffffe;
+	return (uint32_t) new_prio;
+}
+
+/* Scale the age factor of the pending jobs' priorities to another weight.
+ * priority/multifactor keeps the weighted factors in prio_factors. */
+static void _set_weight_age(uint32_t weight_age)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	double age, delta;
+	int i, part_cnt;
+
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		if (!IS_JOB_PENDING(job_ptr) || (job_ptr->priority == 0) ||
+		    job_ptr->direct_set_prio || !job_ptr->prio_factors)
+			continue;
+		age = job_ptr->prio_factors->priority_age;
+		delta = age * weight_age /
+			slurmctld_conf.priority_weight_age - age;
+		job_ptr->priority = _prio_add(job_ptr->priority, delta);
+		if (job_ptr->priority_array && job_ptr->part_ptr_list) {
+			part_cnt = list_count(job_ptr->part_ptr_list);
+			for (i = 0; i < part_cnt; i++) {
+				job_ptr->priority_array[i] = _prio_add(
+					job_ptr->priority_array[i], delta);
+			}
+		}
+	}
+	list_iterator_destroy(job_iterator);
+}
+
+/* Return true if a job may be tested for a start at time when */
+static bool _job_eligible(struct job_record *job_ptr, time_t when)
+{
+	if (!IS_JOB_PENDING(job_ptr) || (job_ptr->priority == 0))
+		return false;
+	if (job_ptr->details->begin_time > when)
+		return false;
+	if (test_job_dependency(job_ptr) != 0)
+		return false;
+	return (license_job_test(job_ptr, when) == SLURM_SUCCESS);
+}
+
+/* Start a job at time when on some of the nodes of avail, as select_nodes()
+ * would as far as the select plugin is concerned */
+static int _job_start(struct job_record *job_ptr,
+		      struct part_record *part_ptr, bitstr_t *avail,
+		      time_t when)
+{
+	bitstr_t *sel_bitmap = NULL;
+	time_t start_time;
+	int rc;
+
+	rc = job_test_start(job_ptr, part_ptr, avail, SELECT_MODE_RUN_NOW,
+			    when, &start_time, &sel_bitmap);
+	if (rc != SLURM_SUCCESS)
+		return rc;
+
+	FREE_NULL_BITMAP(job_ptr->node_bitmap);
+	job_ptr->node_bitmap = sel_bitmap;
+	job_ptr->start_time = when;
+	job_ptr->end_time = when + _job_time_limit(job_ptr, part_ptr) * 60;
+	if (select_g_job_begin(job_ptr) != SLURM_SUCCESS) {
+		job_ptr->start_time = 0;
+		job_ptr->end_time = 0;
+		FREE_NULL_BITMAP(job_ptr->node_bitmap);
+		free_job_resources(&job_ptr->job_resrcs);
+		return ESLURM_NODES_BUSY;
+	}
+	job_ptr->job_state = JOB_RUNNING;
+	(void) select_g_select_nodeinfo_set(job_ptr);
+	(void) license_job_get(job_ptr);
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * End the running jobs due by time when
+ * RET the earliest end time of the jobs still running, zero if none
+ */
+static time_t _jobs_end(time_t when)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	time_t next_end = 0;
+
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		if (!IS_JOB_RUNNING(job_ptr))
+			continue;
+		if (job_ptr->end_time <= when) {
+			(void) select_g_job_fini(job_ptr);
+			(void) license_job_return(job_ptr);
+			job_ptr->job_state = JOB_COMPLETE;
+			job_ptr->exit_code = 0;
+			job_ptr->end_time = when;
+		} else if (!next_end || (job_ptr->end_time < next_end)) {
+			next_end = job_ptr->end_time;
+		}
+	}
+	list_iterator_destroy(job_iterator);
+
+	return next_end;
+}
+
+/* Return the earliest begin time after when of the pending jobs */
+static time_t _next_begin(List job_queue, time_t when)
+{
+	ListIterator job_iterator;
+	job_queue_rec_t *job_queue_rec;
+	struct job_record *job_ptr;
+	time_t next_begin = 0;
+
+	job_iterator = list_iterator_create(job_queue);
+	while ((job_queue_rec = (job_queue_rec_t *) list_next(job_iterator))) {
+		job_ptr = job_queue_rec->job_ptr;
+		if (!IS_JOB_PENDING(job_ptr) ||
+		    (job_ptr->details->begin_time <= when))
+			continue;
+		if (!next_begin || (job_ptr->details->begin_time < next_begin))
+			next_begin = job_ptr->details->begin_time;
+	}
+	list_iterator_destroy(job_iterator);
+
+	return next_begin;
+}
+
+/* A job not able to start now: hold it if it never could, as schedule()
+ * does with FAIL_BAD_CONSTRAINTS */
+static bool _job_never_runs(struct job_record *job_ptr,
+			    struct part_record *part_ptr, time_t when)
+{
+	bitstr_t *sel_bitmap = NULL;
+	time_t start_time;
+
+	if (job_test_start(job_ptr, part_ptr, avail_node_bitmap,
+			   SELECT_MODE_WILL_RUN, when, &start_time,
+			   &sel_bitmap) == SLURM_SUCCESS) {
+		FREE_NULL_BITMAP(sel_bitmap);
+		return false;
+	}
+	if (!job_ptr->part_ptr_list)
+		job_ptr->priority = 0;
+	return true;
+}
+
+/* A pass of schedule() at time when: the jobs are started in priority order
+ * until one can not in its partition or reservation */
+static void _sched_pass(List job_queue, time_t when, dry_run_conf_t *conf)
+{
+	ListIterator job_iterator;
+	job_queue_rec_t *job_queue_rec;
+	struct job_record *job_ptr;
+	struct part_record *part_ptr, **failed_parts;
+	struct slurmctld_resv *failed_resv[MAX_FAILED_RESV];
+	bitstr_t *sched_avail;
+	int failed_part_cnt = 0, failed_resv_cnt = 0, i, rc;
+	bool skip;
+
+	failed_parts = xmalloc(sizeof(struct part_record *) *
+			       (list_count(part_list) + 1));
+	sched_avail = bit_copy(avail_node_bitmap);
+	job_iterator = list_iterator_create(job_queue);
+	while ((job_queue_rec = (job_queue_rec_t *) list_next(job_iterator))) {
+		job_ptr = job_queue_rec->job_ptr;
+		part_ptr = job_queue_rec->part_ptr;
+		if (_monotonic() >= conf->deadline)
+			break;
+		if (!_job_eligible(job_ptr, when))
+			continue;
+
+		skip = false;
+		if (job_ptr->resv_name) {
+			for (i = 0; i < failed_resv_cnt; i++) {
+				if (failed_resv[i] == job_ptr->resv_ptr)
+					skip = true;
+			}
+		} else {
+			for (i = 0; i < failed_part_cnt; i++) {
+				if (failed_parts[i] == part_ptr)
+					skip = true;
+			}
+		}
+		if (skip)
+			continue;
+
+		rc = _job_start(job_ptr, part_ptr, sched_avail, when);
+		if ((rc == SLURM_SUCCESS) ||
+		    (rc == ESLURM_REQUESTED_PART_CONFIG_UNAVAILABLE) ||
+		    (rc == ESLURM_NODE_NOT_AVAIL) ||
+		    (rc == ESLURM_RESERVATION_NOT_USABLE) ||
+		    _job_never_runs(job_ptr, part_ptr, when))
+			continue;
+
+		if (job_ptr->details->req_node_bitmap &&
+		    (bit_set_count(job_ptr->details->req_node_bitmap) >=
+		     job_ptr->details->min_nodes)) {
+			bit_and_not(sched_avail,
+				    job_ptr->details->req_node_bitmap);
+		} else if (job_ptr->resv_name) {
+			if (failed_resv_cnt < MAX_FAILED_RESV)
+				failed_resv[failed_resv_cnt++] =
+					job_ptr->resv_ptr;
+		} else {
+			failed_parts[failed_part_cnt++] = part_ptr;
+			bit_and_not(sched_avail, part_ptr->node_bitmap);
+		}
+	}
+	list_iterator_destroy(job_iterator);
+	FREE_NULL_BITMAP(sched_avail);
+	xfree(failed_parts);
+}
+
+/* A pass of the backfill scheduler at time when: every job is started if
+ * it does not use nodes reserved for the jobs ahead of it, and otherwise
+ * gets such a reservation if it may start within bf_window */
+static void _backfill_pass(List job_queue, time_t when, dry_run_conf_t *conf)
+{
+	List resv_list;
+	ListIterator job_iterator, resv_iterator;
+	job_queue_rec_t *job_queue_rec;
+	struct job_record *job_ptr;
+	struct part_record *part_ptr;
+	dry_run_resv_t *resv;
+	bitstr_t *avail, *sel_bitmap = NULL;
+	time_t end_time, start_time;
+	int job_test_cnt = 0;
+
+	resv_list = list_create(_resv_del);
+	job_iterator = list_iterator_create(job_queue);
+	while ((job_queue_rec = (job_queue_rec_t *) list_next(job_iterator))) {
+		job_ptr = job_queue_rec->job_ptr;
+		part_ptr = job_queue_rec->part_ptr;
+		if (_monotonic() >= conf->deadline)
+			break;
+		if (!_job_eligible(job_ptr, when))
+			continue;
+		if (++job_test_cnt > conf->bf_max_job_test)
+			break;
+
+		end_time = when + _job_time_limit(job_ptr, part_ptr) * 60;
+		avail = bit_copy(avail_node_bitmap);
+		resv_iterator = list_iterator_create(resv_list);
+		while ((resv = (dry_run_resv_t *) list_next(resv_iterator))) {
+			if ((resv->start_time < end_time) &&
+			    (resv->end_time > when))
+				bit_and(avail, resv->avail_bitmap);
+		}
+		list_iterator_destroy(resv_iterator);
+		if (_job_start(job_ptr, part_ptr, avail, when) ==
+		    SLURM_SUCCESS) {
+			FREE_NULL_BITMAP(avail);
+			continue;
+		}
+		FREE_NULL_BITMAP(avail);
+
+		if (job_test_start(job_ptr, part_ptr, avail_node_bitmap,
+				   SELECT_MODE_WILL_RUN, when, &start_time,
+				   &sel_bitmap) != SLURM_SUCCESS)
+			continue;
+		if (start_time > (when + conf->bf_window)) {
+			FREE_NULL_BITMAP(sel_bitmap);
+			continue;
+		}
+		resv = xmalloc(sizeof(dry_run_resv_t));
+		resv->start_time = start_time;
+		resv->end_time = start_time +
+				 _job_time_limit(job_ptr, part_ptr) * 60;
+		bit_not(sel_bitmap);
+		resv->avail_bitmap = sel_bitmap;
+		sel_bitmap = NULL;
+		list_append(resv_list, resv);
+	}
+	list_iterator_destroy(job_iterator);
+	list_destroy(resv_list);
+}
+
+/* Write all of buf, RET false on error */
+static bool _write_all(int fd, void *buf, size_t size)
+{
+	char *ptr = (char *) buf;
+	ssize_t len;
+
+	while (size) {
+		len = write(fd, ptr, size);
+		if (len < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN))
+				continue;
+			return false;
+		}
+		ptr += len;
+		size -= len;
+	}
+	return true;
+}
+
+/* Read all of buf by the monotonic deadline, RET false on error */
+static bool _read_all(int fd, void *buf, size_t size, time_t deadline)
+{
+	char *ptr = (char *) buf;
+	struct pollfd pfd;
+	ssize_t len;
+	int timeout;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	while (size) {
+		timeout = (deadline - _monotonic()) * 1000;
+		if (timeout <= 0)
+			return false;
+		if (poll(&pfd, 1, timeout) <= 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		len = read(fd, ptr, size);
+		if (len < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN))
+				continue;
+			return false;
+		}
+		if (len == 0)
+			return false;
+		ptr += len;
+		size -= len;
+	}
+	return true;
+}
+
+/*
+ * The child process: project the schedule forward from time now and write
+ * to fd the time reached, the count of jobs pending at now, then their ids
+ * and start times. Never returns.
+ */
+static void _dry_run_child(dry_run_msg_t *req, dry_run_conf_t *conf,
+			   time_t now, int fd)
+{
+	List job_queue;
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	uint32_t i, job_cnt = 0, *job_ids;
+	time_t *start_times, when = now, next_end, next_begin;
+
+	if (req->priority_weight_age != NO_VAL)
+		_set_weight_age(req->priority_weight_age);
+	job_queue = _build_queue();
+
+	job_ids = xmalloc(sizeof(uint32_t) * (list_count(job_list) + 1));
+	start_times = xmalloc(sizeof(time_t) * (list_count(job_list) + 1));
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		if (IS_JOB_PENDING(job_ptr))
+			job_ids[job_cnt++] = job_ptr->job_id;
+	}
+	list_iterator_destroy(job_iterator);
+
+	while (1) {
+		(void) _jobs_end(when);
+		_sched_pass(job_queue, when, conf);
+		if (conf->backfill)
+			_backfill_pass(job_queue, when, conf);
+		if (_monotonic() >= conf->deadline)
+			break;
+
+		next_end = _jobs_end(when);
+		next_begin = _next_begin(job_queue, when);
+		if (!next_end || (next_begin && (next_begin < next_end)))
+			next_end = next_begin;
+		if (!next_end || (next_end > conf->end_time)) {
+			when = conf->end_time;
+			break;
+		}
+		when = next_end;
+	}
+
+	for (i = 0; i < job_cnt; i++) {
+		job_ptr = find_job_record(job_ids[i]);
+		if (job_ptr && !IS_JOB_PENDING(job_ptr))
+			start_times[i] = job_ptr->start_time;
+	}
+	if (!_write_all(fd, &when, sizeof(time_t)) ||
+	    !_write_all(fd, &job_cnt, sizeof(uint32_t)) ||
+	    !_write_all(fd, job_ids, sizeof(uint32_t) * job_cnt) ||
+	    !_write_all(fd, start_times, sizeof(time_t) * job_cnt))
+		_exit(1);
+	_exit(0);
+}
+
+/* Settings of a projection, from the configuration and the request */
+static void _dry_run_conf(dry_run_msg_t *req, time_t now,
+			  dry_run_conf_t *conf)
+{
+	char *tmp_ptr, *sched_params = slurmctld_conf.sched_params;
+
+	memset(conf, 0, sizeof(dry_run_conf_t));
+	conf->backfill = (slurmctld_conf.schedtype &&
+			  !strcmp(slurmctld_conf.schedtype, "sched/backfill"));
+	conf->bf_window = DRY_RUN_BF_WINDOW;
+	if (sched_params && (tmp_ptr = strstr(sched_params, "bf_window=")))
+		conf->bf_window = atoi(tmp_ptr + 10) * 60;
+	if (req->bf_window != NO_VAL)
+		conf->bf_window = req->bf_window * 60;
+	if (conf->bf_window < 1)
+		conf->bf_window = DRY_RUN_BF_WINDOW;
+	conf->bf_max_job_test = DRY_RUN_BF_JOB_TEST;
+	if (sched_params &&
+	    (tmp_ptr = strstr(sched_params, "bf_max_job_test=")))
+		conf->bf_max_job_test = atoi(tmp_ptr + 16);
+	if (conf->bf_max_job_test < 1)
+		conf->bf_max_job_test = DRY_RUN_BF_JOB_TEST;
+
+	if (req->horizon == NO_VAL)
+		conf->end_time = now + DRY_RUN_HORIZON * 60;
+	else
+		conf->end_time = now + req->horizon * 60;
+	if (req->max_time == NO_VAL)
+		conf->deadline = _monotonic() + DRY_RUN_MAX_TIME;
+	else
+		conf->deadline = _monotonic() + req->max_time;
+}
+
+extern int dry_run_project(dry_run_msg_t *req, dry_run_response_msg_t **resp)
+{
+	/* Locks: Read config, write job, write node, write partition */
+	slurmctld_lock_t job_write_lock = {
+		READ_LOCK, WRITE_LOCK, WRITE_LOCK, WRITE_LOCK };
+	dry_run_response_msg_t *resp_msg;
+	dry_run_conf_t conf;
+	time_t now, end_time;
+	uint32_t job_cnt;
+	int fd[2], rc = SLURM_SUCCESS, status;
+	pid_t cpid;
+
+	if (pthread_mutex_trylock(&dry_run_mutex))
+		return EAGAIN;
+	if (pipe(fd) < 0) {
+		error("dry_run: pipe: %m");
+		slurm_mutex_unlock(&dry_run_mutex);
+		return SLURM_ERROR;
+	}
+
+	/* With write locks, no other thread is in the select plugin or holds
+	 * one of its mutexes, which the child could never get */
+	lock_slurmctld(job_write_lock);
+	if ((req->priority_weight_age != NO_VAL) &&
+	    ((slurmctld_conf.priority_weight_age == 0) ||
+	     strcmp(slurmctld_conf.priority_type, "priority/multifactor"))) {
+		unlock_slurmctld(job_write_lock);
+		close(fd[0]);
+		close(fd[1]);
+		slurm_mutex_unlock(&dry_run_mutex);
+		return ESLURM_NOT_SUPPORTED;
+	}
+	now = time(NULL);
+	_dry_run_conf(req, now, &conf);
+	cpid = fork();
+	if (cpid == 0) {
+		close(fd[0]);
+		_dry_run_child(req, &conf, now, fd[1]);
+	}
+	unlock_slurmctld(job_write_lock);
+
+	close(fd[1]);
+	if (cpid < 0) {
+		error("dry_run: fork: %m");
+		close(fd[0]);
+		slurm_mutex_unlock(&dry_run_mutex);
+		return SLURM_ERROR;
+	}
+
+	resp_msg = xmalloc(sizeof(dry_run_response_msg_t));
+	resp_msg->snapshot_time = now;
+	conf.deadline += DRY_RUN_KILL_DELAY;
+	if (!_read_all(fd[0], &end_time, sizeof(time_t), conf.deadline) ||
+	    !_read_all(fd[0], &job_cnt, sizeof(uint32_t), conf.deadline)) {
+		rc = SLURM_ERROR;
+	} else {
+		resp_msg->end_time = end_time;
+		resp_msg->job_cnt = job_cnt;
+		resp_msg->job_ids = xmalloc(sizeof(uint32_t) * (job_cnt + 1));
+		resp_msg->start_times = xmalloc(sizeof(time_t) *
+						(job_cnt + 1));
+		if (!_read_all(fd[0], resp_msg->job_ids,
+			       sizeof(uint32_t) * job_cnt, conf.deadline) ||
+		    !_read_all(fd[0], resp_msg->start_times,
+			       sizeof(time_t) * job_cnt, conf.deadline))
+			rc = SLURM_ERROR;
+	}
+	close(fd[0]);
+	if (rc != SLURM_SUCCESS) {
+		error("dry_run: projection %d failed or timed out", cpid);
+		kill(cpid, SIGKILL);
+	}
+	while ((waitpid(cpid, &status, 0) < 0) && (errno == EINTR))
+		;
+	slurm_mutex_unlock(&dry_run_mutex);
+
+	if (rc == SLURM_SUCCESS)
+		*resp = resp_msg;
+	else
+		slurm_free_dry_run_response_msg(resp_msg);
+	return rc;
+}
@@ -0,0 +1,64 @@
+/*****************************************************************************\
+ *  dry_run.h - project pending job start times on a slurmctld snapshot
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifndef _HAVE_DRY_RUN_H
+#define _HAVE_DRY_RUN_H
+
+#include "src/common/slurm_protocol_defs.h"
+
+/*
+ * A dry run answers what the queue would look like with other scheduling
+ * settings without running a simulation again. slurmctld forks, and the
+ * child works on its copy-on-write image of the job, node, partition and
+ * select plugin state: it starts and ends jobs by their time limits in
+ * projected time, the way schedule() and the backfill scheduler would, and
+ * reports the start times through a pipe. The live state is never changed
+ * and no RPC is sent.
+ */
+#define DRY_RUN_HORIZON		(7 * 24 * 60)	/* default, minutes */
+#define DRY_RUN_MAX_TIME	5		/* default, seconds */
+
+/*
+ * Project the start times of the pending jobs
+ * IN req - settings to change in the projection
+ * OUT resp - start times, free with slurm_free_dry_run_response_msg()
+ * RET SLURM_SUCCESS or an error code
+ * NOTE: Sets its own locks, call without holding any. Only one dry run is
+ *	done at a time.
+ */
+extern int dry_run_project(dry_run_msg_t *req, dry_run_response_msg_t **resp);
+
+#endif /* !_HAVE_DRY_RUN_H */
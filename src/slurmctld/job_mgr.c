@@ -88,6 +88,7 @@
 #include "src/slurmctld/locks.h"
 #include "src/slurmctld/node_scheduler.h"
 #include "src/slurmctld/preempt.h"
+#include "src/slurmctld/prio_queue.h"
 #include "src/slurmctld/proc_req.h"
 #include "src/slurmctld/reservation.h"
 #include "src/slurmctld/sched_plugin.h"
@@ -102,11 +103,20 @@
 #include "src/slurmctld/wf_program.h"
 #endif
 
+#ifdef SLURM_SIMULATOR
+#include "src/common/sim_sync.h"
+#include "src/slurmctld/sim_nodes.h"
+#include "src/slurmctld/sim_trace.h"
+#endif
+
 #define DETAILS_FLAG 0xdddd
 #define SLURM_CREATE_JOB_FLAG_NO_ALLOCATE_0 0
 #define STEP_FLAG 0xbbbb
 #define TOP_PRIORITY 0xffff0000	/* large, but leave headroom for higher */
 
+#define JOB_PURGE_LOG_AGE 600	/* seconds purged job IDs are kept for
+				 * incremental job info requests */
+
 #define JOB_HASH_INX(_job_id)	(_job_id % hash_table_size)
 #define JOB_ARRAY_HASH_INX(_job_id, _task_id) \
 	((_job_id + _task_id) % hash_table_size)
@@ -140,6 +150,37 @@ static bool     wiki_sched = false;
 static bool     wiki2_sched = false;
 static bool     wiki_sched_test = false;
 
+/* IDs of purged job records, for incremental job info requests. Every job
+ * purged since job_purge_start is in job_purge_log, oldest first. */
+typedef struct job_purge_rec {
+	uint32_t job_id;
+	time_t purge_time;
+} job_purge_rec_t;
+static job_purge_rec_t *job_purge_log = NULL;
+static uint32_t job_purge_cnt = 0, job_purge_size = 0;
+static time_t   job_purge_start = (time_t) 0;
+
+/* A job's pack_job() output, reused by later job information requests with
+ * the same show_flags and protocol version until the job record, partitions
+ * or configuration change. Job info requests run under a job read lock, so
+ * job_pack_cache_mutex serializes access to the job_record's pack_cache. */
+struct job_pack_cache {
+	char *data;
+	uint32_t size;
+	time_t pack_time;	/* when data was packed */
+	uint16_t show_flags;
+	uint16_t protocol_version;
+	/* fields the schedulers change without setting job last_update */
+	uint16_t job_state;
+	uint16_t state_reason;
+	char *state_desc;
+	uint32_t priority;
+	uint32_t time_limit;
+	time_t start_time;
+	time_t end_time;
+};
+static pthread_mutex_t job_pack_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 /* Local functions */
 static void _add_job_hash(struct job_record *job_ptr);
 static void _add_job_array_hash(struct job_record *job_ptr);
@@ -173,6 +214,10 @@ static int  _job_create(job_desc_msg_t * job_specs, int allocate, int will_run,
 			struct job_record **job_rec_ptr, uid_t submit_uid,
 			char **err_msg);
 static void _list_delete_job(void *job_entry);
+static void _log_job_purge(uint32_t job_id);
+static void _pack_job_cached(struct job_record *job_ptr, uint16_t show_flags,
+			     Buf buffer, uint16_t protocol_version, uid_t uid,
+			     time_t now);
 static int  _list_find_job_id(void *job_entry, void *key);
 static int  _list_find_job_old(void *job_entry, void *key);
 static int  _load_job_details(struct job_record *job_ptr, Buf buffer,
@@ -190,6 +235,8 @@ static void _pack_pending_job_details(struct job_details *detail_ptr,
 				      Buf buffer,
 				      uint16_t protocol_version);
 static int  _purge_job_record(uint32_t job_id);
+static bool _hide_job_info(struct job_record *job_ptr, uint16_t show_flags,
+			   uid_t uid);
 static void _purge_missing_jobs(int node_inx, time_t now);
 static int  _read_data_array_from_file(char *file_name, char ***data,
 				       uint32_t * size,
@@ -262,6 +309,7 @@ struct job_record *create_job_record(int *error_code)
 
 	xassert (detail_ptr->magic = DETAILS_MAGIC); /* set value */
 	detail_ptr->submit_time = time(NULL);
+	job_ptr->last_update = detail_ptr->submit_time;
 	job_ptr->requid = -1; /* force to -1 for sacct to know this
 			       * hasn't been set yet  */
 	(void) list_append(job_list, job_ptr);
@@ -2309,7 +2357,7 @@ static void _rebuild_part_name_list(struct job_record  *job_ptr)
 		xstrcat(job_ptr->partition, part_ptr->name);
 	}
 	list_iterator_destroy(part_iterator);
-	last_job_update = time(NULL);
+	last_job_update = job_ptr->last_update = time(NULL);
 }
 
 /*
@@ -2376,6 +2424,7 @@ extern int kill_job_by_part_name(char *part_name)
 		}
 		if (IS_JOB_RUNNING(job_ptr) || suspended) {
 			job_count++;
+			job_ptr->last_update = now;
 			info("Killing job_id %u on defunct partition %s",
 			     job_ptr->job_id, part_name);
 			job_ptr->job_state = JOB_NODE_FAIL | JOB_COMPLETING;
@@ -2395,6 +2444,7 @@ extern int kill_job_by_part_name(char *part_name)
 						 false);
 		} else if (pending) {
 			job_count++;
+			job_ptr->last_update = now;
 			info("Killing job_id %u on defunct partition %s",
 			     job_ptr->job_id, part_name);
 			job_ptr->job_state	= JOB_CANCELLED;
@@ -2455,6 +2505,7 @@ extern int kill_job_by_front_end_name(char *node_name)
 		}
 		if (IS_JOB_COMPLETING(job_ptr)) {
 			job_count++;
+			job_ptr->last_update = now;
 			while ((i = bit_ffs(job_ptr->node_bitmap_cg)) >= 0) {
 				bit_clear(job_ptr->node_bitmap_cg, i);
 				job_update_cpu_cnt(job_ptr, i);
@@ -2480,6 +2531,7 @@ extern int kill_job_by_front_end_name(char *node_name)
 			}
 		} else if (IS_JOB_RUNNING(job_ptr) || suspended) {
 			job_count++;
+			job_ptr->last_update = now;
 			if (job_ptr->batch_flag && job_ptr->details &&
 			    slurmctld_conf.job_requeue &&
 			    (job_ptr->details->requeue > 0)) {
@@ -2524,6 +2576,7 @@ extern int kill_job_by_front_end_name(char *node_name)
 				job_ptr->job_state = JOB_PENDING;
 				if (job_ptr->node_cnt)
 					job_ptr->job_state |= JOB_COMPLETING;
+				prio_queue_job_update(job_ptr);
 
 				/* restart from periodic checkpoint */
 				if (job_ptr->ckpt_interval &&
@@ -2686,6 +2739,7 @@ extern int kill_running_job_by_node_name(char *node_name)
 			if (!bit_test(job_ptr->node_bitmap_cg, bit_position))
 				continue;
 			job_count++;
+			job_ptr->last_update = now;
 			bit_clear(job_ptr->node_bitmap_cg, bit_position);
 			job_update_cpu_cnt(job_ptr, bit_position);
 			if (job_ptr->node_cnt)
@@ -2708,6 +2762,7 @@ extern int kill_running_job_by_node_name(char *node_name)
 			}
 		} else if (IS_JOB_RUNNING(job_ptr) || suspended) {
 			job_count++;
+			job_ptr->last_update = now;
 			if ((job_ptr->details) &&
 			    (job_ptr->kill_on_node_fail == 0) &&
 			    (job_ptr->node_cnt > 1)) {
@@ -2761,6 +2816,7 @@ extern int kill_running_job_by_node_name(char *node_name)
 				job_ptr->job_state = JOB_PENDING;
 				if (job_ptr->node_cnt)
 					job_ptr->job_state |= JOB_COMPLETING;
+				prio_queue_job_update(job_ptr);
 
 				/* restart from periodic checkpoint */
 				if (job_ptr->ckpt_interval &&
@@ -3058,6 +3114,7 @@ int init_job_conf(void)
 	}
 
 	last_job_update = time(NULL);
+	job_purge_start = last_job_update;
 	return SLURM_SUCCESS;
 }
 
@@ -3128,6 +3185,9 @@ static struct job_record *_job_rec_copy(struct job_record *job_ptr,
 	job_ptr_new->details  = save_details;
 	job_ptr_new->prio_factors = save_prio_factors;
 	job_ptr_new->step_list = save_step_list;
+	job_ptr_new->prio_queue_rec = NULL;
+	job_ptr_new->pack_cache = NULL;
+	job_ptr_new->last_update = time(NULL);
 
 	job_ptr_new->array_job_id  = job_ptr->job_id;
 	job_ptr_new->array_task_id = array_task_id;
@@ -3256,6 +3316,7 @@ static struct job_record *_job_rec_copy(struct job_record *job_ptr,
 	job_ptr_new->workflow_program =
 				copy_wf_program(job_ptr->workflow_program);
 #endif
+	prio_queue_job_update(job_ptr_new);
 
 	return job_ptr_new;
 }
@@ -3405,6 +3466,10 @@ extern int job_allocate(job_desc_msg_t * job_specs, int immediate,
 		return error_code;
 	}
 	xassert(job_ptr);
+#ifdef SLURM_SIMULATOR
+	if (!will_run)
+		sim_trace_job(SIM_TRACE_SUBMIT, job_ptr);
+#endif
 	if (job_specs->array_bitmap)
 		independent = false;
 	else
@@ -3415,6 +3480,8 @@ extern int job_allocate(job_desc_msg_t * job_specs, int immediate,
 	 */
 	if (job_ptr->priority == NO_VAL)
 		set_job_prio(job_ptr);
+	else
+		prio_queue_job_update(job_ptr);
 
 	if (independent &&
 	    (license_job_test(job_ptr, time(NULL)) != SLURM_SUCCESS))
@@ -3484,6 +3551,7 @@ extern int job_allocate(job_desc_msg_t * job_specs, int immediate,
 	error_code = _select_nodes_parts(job_ptr, no_alloc, NULL);
 	if (!test_only) {
 		last_job_update = now;
+		job_ptr->last_update = now;
 		slurm_sched_g_schedule();	/* work for external scheduler */
 	}
 
@@ -3584,6 +3652,7 @@ extern int job_fail(uint32_t job_id, uint16_t job_state)
 		} else
 			job_ptr->end_time       = now;
 		last_job_update                 = now;
+		job_ptr->last_update            = now;
 		job_ptr->job_state = job_state | JOB_COMPLETING;
 		job_ptr->exit_code = 1;
 		job_ptr->state_reason = FAIL_LAUNCH;
@@ -3695,6 +3764,7 @@ extern int job_signal(uint32_t job_id, uint16_t signal, uint16_t flags,
 
 	if (IS_JOB_PENDING(job_ptr) && (signal == SIGKILL)) {
 		last_job_update		= now;
+		job_ptr->last_update	= now;
 		job_ptr->job_state	= JOB_CANCELLED;
 		job_ptr->start_time	= now;
 		job_ptr->end_time	= now;
@@ -3710,6 +3780,7 @@ extern int job_signal(uint32_t job_id, uint16_t signal, uint16_t flags,
 		job_term_state = JOB_CANCELLED;
 	if (IS_JOB_SUSPENDED(job_ptr) &&  (signal == SIGKILL)) {
 		last_job_update         = now;
+		job_ptr->last_update    = now;
 		job_ptr->end_time       = job_ptr->suspend_time;
 		job_ptr->tot_sus_time  += difftime(now, job_ptr->suspend_time);
 		job_ptr->job_state      = job_term_state | JOB_COMPLETING;
@@ -3728,6 +3799,7 @@ extern int job_signal(uint32_t job_id, uint16_t signal, uint16_t flags,
 			job_ptr->time_last_active	= now;
 			job_ptr->end_time		= now;
 			last_job_update			= now;
+			job_ptr->last_update		= now;
 			job_ptr->job_state = job_term_state | JOB_COMPLETING;
 			build_cg_bitmap(job_ptr);
 			job_completion_logger(job_ptr, false);
@@ -3926,6 +3998,7 @@ extern int job_complete(uint32_t job_id, uid_t uid, bool requeue,
 		job_ptr->batch_flag++;	/* only one retry */
 		job_ptr->restart_cnt++;
 		job_ptr->job_state = JOB_PENDING | job_comp_flag;
+		prio_queue_job_update(job_ptr);
 		/* Since the job completion logger removes the job submit
 		 * information, we need to add it again. */
 		acct_policy_add_job_submit(job_ptr);
@@ -3984,6 +4057,7 @@ extern int job_complete(uint32_t job_id, uid_t uid, bool requeue,
 	}
 
 	last_job_update = now;
+	job_ptr->last_update = now;
 	job_ptr->time_last_active = now;   /* Timer for resending kill RPC */
 	if (job_comp_flag) {	/* job was running */
 		build_cg_bitmap(job_ptr);
@@ -6008,6 +6082,9 @@ void job_time_limit(void)
 			    slurmctld_conf.msg_timeout + 1);
 	time_t over_run;
 	int resv_status = 0;
+#ifdef SLURM_SIMULATOR
+	time_t next_limit = 0;	/* earliest time a job will be timed out */
+#endif
 
 	if (slurmctld_conf.over_time_limit == (uint16_t) INFINITE)
 		over_run = now - (365 * 24 * 60 * 60);	/* one year */
@@ -6051,6 +6128,7 @@ void job_time_limit(void)
 			}
 			if (job_ptr->end_time <= now) {
 				last_job_update = now;
+				job_ptr->last_update = now;
 				info("Preemption GraceTime reached JobId=%u",
 				     job_ptr->job_id);
 				_job_timed_out(job_ptr);
@@ -6058,6 +6136,11 @@ void job_time_limit(void)
 						     JOB_COMPLETING;
 				xfree(job_ptr->state_desc);
 			}
+#ifdef SLURM_SIMULATOR
+			if ((job_ptr->end_time > now) &&
+			    (!next_limit || (job_ptr->end_time < next_limit)))
+				next_limit = job_ptr->end_time;
+#endif
 			continue;
 		}
 
@@ -6093,6 +6176,7 @@ void job_time_limit(void)
 			}
 			if (job_ptr->end_time <= over_run) {
 				last_job_update = now;
+				job_ptr->last_update = now;
 				info("Time limit exhausted for JobId=%u",
 				     job_ptr->job_id);
 				_job_timed_out(job_ptr);
@@ -6100,10 +6184,20 @@ void job_time_limit(void)
 				xfree(job_ptr->state_desc);
 				continue;
 			}
+#ifdef SLURM_SIMULATOR
+			if (slurmctld_conf.over_time_limit !=
+			    (uint16_t) INFINITE) {
+				time_t kill_time = job_ptr->end_time +
+					(slurmctld_conf.over_time_limit * 60);
+				if (!next_limit || (kill_time < next_limit))
+					next_limit = kill_time;
+			}
+#endif
 		}
 
 		if (resv_status != SLURM_SUCCESS) {
 			last_job_update = now;
+			job_ptr->last_update = now;
 			info("Reservation ended for JobId=%u",
 			     job_ptr->job_id);
 			_job_timed_out(job_ptr);
@@ -6122,6 +6216,7 @@ void job_time_limit(void)
 
 		if (job_ptr->state_reason == FAIL_TIMEOUT) {
 			last_job_update = now;
+			job_ptr->last_update = now;
 			_job_timed_out(job_ptr);
 			xfree(job_ptr->state_desc);
 			continue;
@@ -6133,6 +6228,11 @@ void job_time_limit(void)
 	}
 	list_iterator_destroy(job_iterator);
 	fini_job_resv_check();
+#ifdef SLURM_SIMULATOR
+	/* A job started after this run is covered by the next run, which
+	 * slurmctld reports as SIM_SYNC_NEXT_TIMEOUT_CHECK */
+	sim_sync_set_next(SIM_SYNC_NEXT_TIME_LIMIT, next_limit);
+#endif
 }
 
 extern int job_update_cpu_cnt(struct job_record *job_ptr, int node_inx)
@@ -6341,6 +6441,8 @@ static void _list_delete_job(void *job_entry)
 	xassert(job_entry);
 	xassert (job_ptr->magic == JOB_MAGIC);
 	job_ptr->magic = 0;	/* make sure we don't delete record twice */
+	prio_queue_job_remove(job_ptr);
+	_log_job_purge(job_ptr->job_id);
 
 	/* Remove the record from job hash table */
 	job_pptr = &job_hash[JOB_HASH_INX(job_ptr->job_id)];
@@ -6409,6 +6511,11 @@ static void _list_delete_job(void *job_entry)
 	FREE_NULL_BITMAP(job_ptr->node_bitmap_cg);
 	xfree(job_ptr->nodes);
 	xfree(job_ptr->nodes_completing);
+	if (job_ptr->pack_cache) {
+		xfree(job_ptr->pack_cache->data);
+		xfree(job_ptr->pack_cache->state_desc);
+		xfree(job_ptr->pack_cache);
+	}
 	xfree(job_ptr->partition);
 	FREE_NULL_LIST(job_ptr->part_ptr_list);
 	xfree(job_ptr->priority_array);
@@ -6437,6 +6544,36 @@ static void _list_delete_job(void *job_entry)
 	xfree(job_ptr);
 }
 
+/* Note the purge of a job record for incremental job info requests,
+ * dropping the records older than JOB_PURGE_LOG_AGE when the log is full */
+static void _log_job_purge(uint32_t job_id)
+{
+	time_t now = time(NULL);
+	uint32_t i;
+
+	if (job_purge_cnt == job_purge_size) {
+		for (i = 0; i < job_purge_cnt; i++) {
+			if ((job_purge_log[i].purge_time + JOB_PURGE_LOG_AGE) >
+			    now)
+				break;
+		}
+		if (i) {
+			job_purge_start = job_purge_log[i - 1].purge_time + 1;
+			job_purge_cnt -= i;
+			memmove(job_purge_log, job_purge_log + i,
+				sizeof(job_purge_rec_t) * job_purge_cnt);
+		}
+	}
+	if (job_purge_cnt == job_purge_size) {
+		job_purge_size = MAX(job_purge_size * 2, 1024);
+		xrealloc(job_purge_log,
+			 sizeof(job_purge_rec_t) * job_purge_size);
+	}
+	job_purge_log[job_purge_cnt].job_id = job_id;
+	job_purge_log[job_purge_cnt].purge_time = now;
+	job_purge_cnt++;
+}
+
 
 /*
  * _list_find_job_id - find specific job_id entry in the job list,
@@ -6506,6 +6643,9 @@ static int _list_find_job_old(void *job_entry, void *key)
 	if (with_slurmdbd && !job_ptr->db_index)
 		jobacct_storage_g_job_start(acct_db_conn, job_ptr);
 
+#ifdef SLURM_SIMULATOR
+	sim_nodes_job_purged(job_ptr);
+#endif
 	return 1;		/* Purge the job */
 }
 
@@ -6546,6 +6686,17 @@ static bool _hide_job(struct job_record *job_ptr, uid_t uid)
 	return false;
 }
 
+/* Determine if a given job is left out of the job information sent to a
+ * specific user, for its partitions or for PrivateData */
+static bool _hide_job_info(struct job_record *job_ptr, uint16_t show_flags,
+			   uid_t uid)
+{
+	if (((show_flags & SHOW_ALL) == 0) && (uid != 0) &&
+	    _all_parts_hidden(job_ptr))
+		return true;
+	return _hide_job(job_ptr, uid);
+}
+
 /*
  * pack_all_jobs - dump all job information for all jobs in
  *	machine independent form (for network transmission)
@@ -6588,11 +6739,7 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
 		xassert (job_ptr->magic == JOB_MAGIC);
 
-		if (((show_flags & SHOW_ALL) == 0) && (uid != 0) &&
-		    _all_parts_hidden(job_ptr))
-			continue;
-
-		if (_hide_job(job_ptr, uid))
+		if (_hide_job_info(job_ptr, show_flags, uid))
 			continue;
 
 		if ((min_age > 0) && (job_ptr->end_time < min_age) &&
@@ -6602,7 +6749,8 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 		if ((filter_uid != NO_VAL) && (filter_uid != job_ptr->user_id))
 			continue;
 
-		pack_job(job_ptr, show_flags, buffer, protocol_version, uid);
+		_pack_job_cached(job_ptr, show_flags, buffer,
+				 protocol_version, uid, now);
 		jobs_packed++;
 	}
 	part_filter_clear();
@@ -6618,6 +6766,133 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 	buffer_ptr[0] = xfer_buf_data(buffer);
 }
 
+/*
+ * pack_job_delta - dump information for the jobs changed since last_update
+ *	in machine independent form (for network transmission), for a
+ *	client keeping the records of earlier dumps (SHOW_DELTA)
+ * OUT buffer_ptr - the pointer is set to the allocated buffer.
+ * OUT buffer_size - set to size of the buffer in bytes
+ * IN show_flags - job filtering options
+ * IN uid - uid of user making request (for partition filtering)
+ * IN last_update - time of the client's latest dump
+ * IN protocol_version - slurm protocol version of client
+ * global: job_list - global list of job records
+ * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ * NOTE: change _unpack_job_info_delta_msg() in common/slurm_protocol_pack.c
+ *	whenever the data format changes
+ */
+extern void pack_job_delta(char **buffer_ptr, int *buffer_size,
+			   uint16_t show_flags, uid_t uid, time_t last_update,
+			   uint16_t protocol_version)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	uint32_t jobs_packed = 0, gone_cnt = 0, gone_size = 0;
+	uint32_t *gone_ids = NULL;
+	uint32_t i, rec_offset, tmp_offset;
+	uint16_t full;
+	Buf buffer;
+	time_t begin_time, min_age = 0, now = time(NULL);
+	bool changed, shown;
+
+	buffer_ptr[0] = NULL;
+	*buffer_size = 0;
+	show_flags &= (~SHOW_DELTA);
+
+	/* Send every record if jobs may have been purged without a trace in
+	 * job_purge_log, or partition or configuration changes could have
+	 * changed what the user sees of jobs not updated themselves */
+	full = ((last_update < job_purge_start) ||
+		(last_update <= last_part_update) ||
+		(last_update <= slurmctld_conf.last_update));
+
+	buffer = init_buf(BUF_SIZE);
+
+	/* write message body header : size, time and full flag */
+	/* put in a place holder job record count of 0 for now */
+	pack32(jobs_packed, buffer);
+	pack_time(now, buffer);
+	pack16(full, buffer);
+
+	if (slurmctld_conf.min_job_age > 0)
+		min_age = now  - slurmctld_conf.min_job_age;
+
+	/* write job ID and size of each changed job record, then the record */
+	part_filter_set(uid);
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		xassert (job_ptr->magic == JOB_MAGIC);
+
+		changed = full || (job_ptr->last_update >= last_update);
+		/* pack_job() reports start_time once begin_time passed */
+		begin_time = job_ptr->details ?
+			     job_ptr->details->begin_time : 0;
+		if ((begin_time >= last_update) && (begin_time <= now))
+			changed = true;
+
+		shown = !_hide_job_info(job_ptr, show_flags, uid);
+		if (shown && (min_age > 0) && (job_ptr->end_time < min_age) &&
+		    (! IS_JOB_COMPLETING(job_ptr)) && IS_JOB_FINISHED(job_ptr)) {
+			shown = false;	/* job ready for purging */
+			if ((job_ptr->end_time + slurmctld_conf.min_job_age) >=
+			    last_update)
+				changed = true;	/* since last_update */
+		}
+		if (!changed)
+			continue;
+
+		if (!shown) {
+			/* The client may still have an older record */
+			if (full)
+				continue;
+			if (gone_cnt == gone_size) {
+				gone_size = MAX(gone_size * 2, 64);
+				xrealloc(gone_ids,
+					 sizeof(uint32_t) * gone_size);
+			}
+			gone_ids[gone_cnt++] = job_ptr->job_id;
+			continue;
+		}
+
+		pack32(job_ptr->job_id, buffer);
+		rec_offset = get_buf_offset(buffer);
+		pack32(0, buffer);	/* record size, set below */
+		_pack_job_cached(job_ptr, show_flags, buffer,
+				 protocol_version, uid, now);
+		tmp_offset = get_buf_offset(buffer);
+		set_buf_offset(buffer, rec_offset);
+		pack32(tmp_offset - rec_offset - sizeof(uint32_t), buffer);
+		set_buf_offset(buffer, tmp_offset);
+		jobs_packed++;
+	}
+	part_filter_clear();
+	list_iterator_destroy(job_iterator);
+
+	/* write IDs of jobs purged or no longer shown since last_update */
+	for (i = 0; !full && (i < job_purge_cnt); i++) {
+		if (job_purge_log[i].purge_time < last_update)
+			continue;
+		if (gone_cnt == gone_size) {
+			gone_size = MAX(gone_size * 2, 64);
+			xrealloc(gone_ids, sizeof(uint32_t) * gone_size);
+		}
+		gone_ids[gone_cnt++] = job_purge_log[i].job_id;
+	}
+	pack32(gone_cnt, buffer);
+	for (i = 0; i < gone_cnt; i++)
+		pack32(gone_ids[i], buffer);
+	xfree(gone_ids);
+
+	/* put the real record count in the message body header */
+	tmp_offset = get_buf_offset(buffer);
+	set_buf_offset(buffer, 0);
+	pack32(jobs_packed, buffer);
+	set_buf_offset(buffer, tmp_offset);
+
+	*buffer_size = get_buf_offset(buffer);
+	buffer_ptr[0] = xfer_buf_data(buffer);
+}
+
 /*
  * pack_one_job - dump information for one jobs in
  *	machine independent form (for network transmission)
@@ -6693,6 +6968,94 @@ extern int pack_one_job(char **buffer_ptr, int *buffer_size,
 	return SLURM_SUCCESS;
 }
 
+/* Return true if a job's cached pack_job() output is still current */
+static bool _pack_cache_valid(struct job_record *job_ptr,
+			      struct job_pack_cache *cache_ptr,
+			      uint16_t show_flags, uint16_t protocol_version)
+{
+	time_t begin_time;
+
+	if ((cache_ptr->show_flags != show_flags) ||
+	    (cache_ptr->protocol_version != protocol_version))
+		return false;
+	/* Times have a one second resolution, so a change made in the
+	 * second the record was packed may not be in it */
+	if ((job_ptr->last_update >= cache_ptr->pack_time) ||
+	    (last_part_update >= cache_ptr->pack_time) ||
+	    (slurmctld_conf.last_update >= cache_ptr->pack_time))
+		return false;
+	/* pack_job() reports begin_time as the start time until it passes */
+	begin_time = job_ptr->details ? job_ptr->details->begin_time : 0;
+	if (begin_time >= cache_ptr->pack_time)
+		return false;
+	if ((cache_ptr->job_state != job_ptr->job_state) ||
+	    (cache_ptr->state_reason != job_ptr->state_reason) ||
+	    xstrcmp(cache_ptr->state_desc, job_ptr->state_desc) ||
+	    (cache_ptr->priority != job_ptr->priority) ||
+	    (cache_ptr->time_limit != job_ptr->time_limit) ||
+	    (cache_ptr->start_time != job_ptr->start_time) ||
+	    (cache_ptr->end_time != job_ptr->end_time))
+		return false;
+	return true;
+}
+
+/*
+ * _pack_job_cached - pack_job() through the job's pack_cache, copying the
+ *	cached record if still current and saving a new one otherwise
+ * IN now - time the job read lock was taken at or after
+ */
+static void _pack_job_cached(struct job_record *job_ptr, uint16_t show_flags,
+			     Buf buffer, uint16_t protocol_version, uid_t uid,
+			     time_t now)
+{
+	struct job_pack_cache *cache_ptr;
+	uint32_t offset, size;
+
+	/* The batch script is only sent to some users */
+	if (show_flags & SHOW_DETAIL2) {
+		pack_job(job_ptr, show_flags, buffer, protocol_version, uid);
+		return;
+	}
+
+	slurm_mutex_lock(&job_pack_cache_mutex);
+	cache_ptr = job_ptr->pack_cache;
+	if (cache_ptr && _pack_cache_valid(job_ptr, cache_ptr, show_flags,
+					   protocol_version)) {
+		packmem_array(cache_ptr->data, cache_ptr->size, buffer);
+		slurm_mutex_unlock(&job_pack_cache_mutex);
+		return;
+	}
+	slurm_mutex_unlock(&job_pack_cache_mutex);
+
+	offset = get_buf_offset(buffer);
+	pack_job(job_ptr, show_flags, buffer, protocol_version, uid);
+	size = get_buf_offset(buffer) - offset;
+
+	slurm_mutex_lock(&job_pack_cache_mutex);
+	cache_ptr = job_ptr->pack_cache;
+	if (!cache_ptr)
+		cache_ptr = job_ptr->pack_cache =
+			xmalloc(sizeof(struct job_pack_cache));
+	if (cache_ptr->size != size) {
+		xfree(cache_ptr->data);
+		cache_ptr->data = xmalloc(size);
+		cache_ptr->size = size;
+	}
+	memcpy(cache_ptr->data, get_buf_data(buffer) + offset, size);
+	cache_ptr->pack_time = now;
+	cache_ptr->show_flags = show_flags;
+	cache_ptr->protocol_version = protocol_version;
+	cache_ptr->job_state = job_ptr->job_state;
+	cache_ptr->state_reason = job_ptr->state_reason;
+	xfree(cache_ptr->state_desc);
+	cache_ptr->state_desc = xstrdup(job_ptr->state_desc);
+	cache_ptr->priority = job_ptr->priority;
+	cache_ptr->time_limit = job_ptr->time_limit;
+	cache_ptr->start_time = job_ptr->start_time;
+	cache_ptr->end_time = job_ptr->end_time;
+	slurm_mutex_unlock(&job_pack_cache_mutex);
+}
+
 /*
  * pack_job - dump all configuration information about a specific job in
  *	machine independent form (for network transmission)
@@ -7430,6 +7793,7 @@ void purge_old_job(void)
 			job_ptr->end_time	= now;
 			job_completion_logger(job_ptr, false);
 			last_job_update		= now;
+			job_ptr->last_update	= now;
 			srun_allocate_abort(job_ptr);
 		}
 	}
@@ -7734,6 +8098,7 @@ extern void set_job_prio(struct job_record *job_ptr)
 		return;
 	job_ptr->priority = slurm_sched_g_initial_priority(lowest_prio,
 							   job_ptr);
+	prio_queue_job_update(job_ptr);
 	if ((job_ptr->priority == 0) || (job_ptr->direct_set_prio))
 		return;
 
@@ -7983,6 +8348,7 @@ int update_job(job_desc_msg_t * job_specs, uid_t uid)
 	if (detail_ptr)
 		mc_ptr = detail_ptr->mc_ptr;
 	last_job_update = now;
+	job_ptr->last_update = now;
 
 	if (job_specs->account
 	    && !xstrcmp(job_specs->account, job_ptr->account)) {
@@ -9607,6 +9973,8 @@ fini:
 	if ((error_code == SLURM_SUCCESS) && (job_ptr->priority != 0) &&
 	    strcmp(slurmctld_conf.priority_type, "priority/basic"))
 		set_job_prio(job_ptr);
+	else
+		prio_queue_job_update(job_ptr);
 
 	return error_code;
 }
@@ -10476,6 +10844,8 @@ void job_fini (void)
 	xfree(job_hash);
 	xfree(job_array_hash_j);
 	xfree(job_array_hash_t);
+	xfree(job_purge_log);
+	job_purge_cnt = job_purge_size = 0;
 }
 
 /* log the completion of the specified job */
@@ -10493,6 +10863,11 @@ extern void job_completion_logger(struct job_record  *job_ptr, bool requeue)
 		free_job_resources(&job_ptr->job_resrcs);
 #endif
 	acct_policy_remove_job_submit(job_ptr);
+#ifdef SLURM_SIMULATOR
+	if (!IS_JOB_RESIZING(job_ptr))
+		sim_trace_job(requeue ? SIM_TRACE_REQUEUE : SIM_TRACE_END,
+			      job_ptr);
+#endif
 
 	if (!IS_JOB_RESIZING(job_ptr)) {
 		/* Remove configuring state just to make sure it isn't there
@@ -10612,6 +10987,15 @@ extern bool job_independent(struct job_record *job_ptr, int will_run)
 		job_ptr->state_reason = WAIT_NO_REASON;
 		xfree(job_ptr->state_desc);
 	}
+#ifdef SLURM_SIMULATOR
+	/* Once per begin time, which may have been set in the future at
+	 * submission, by a job update or by a requeue */
+	if (!will_run && detail_ptr && detail_ptr->begin_time &&
+	    (job_ptr->sim_eligible_time != detail_ptr->begin_time)) {
+		job_ptr->sim_eligible_time = detail_ptr->begin_time;
+		sim_trace_job(SIM_TRACE_ELIGIBLE, job_ptr);
+	}
+#endif
 	return true;
 }
 
@@ -10880,7 +11264,7 @@ static int _suspend_job_nodes(struct job_record *job_ptr, bool indf_susp)
 			node_ptr->last_idle  = now;
 		}
 	}
-	last_job_update = last_node_update = now;
+	last_job_update = last_node_update = job_ptr->last_update = now;
 	return rc;
 }
 
@@ -10928,7 +11312,7 @@ static int _resume_job_nodes(struct job_record *job_ptr, bool indf_susp)
 		node_flags = node_ptr->node_state & NODE_STATE_FLAGS;
 		node_ptr->node_state = NODE_STATE_ALLOCATED | node_flags;
 	}
-	last_job_update = last_node_update = time(NULL);
+	last_job_update = last_node_update = job_ptr->last_update = time(NULL);
 	return rc;
 }
 
@@ -11154,6 +11538,7 @@ extern int job_requeue(uid_t uid,
 
 	slurm_sched_g_requeue(job_ptr, "Job requeued by user/admin");
 	last_job_update = now;
+	job_ptr->last_update = now;
 
 	if (IS_JOB_SUSPENDED(job_ptr)) {
 		enum job_states suspend_job_state = job_ptr->job_state;
@@ -11203,6 +11588,7 @@ extern int job_requeue(uid_t uid,
 	job_ptr->job_state = JOB_PENDING;
 	if (job_ptr->node_cnt)
 		job_ptr->job_state |= JOB_COMPLETING;
+	prio_queue_job_update(job_ptr);
 
 	job_ptr->pre_sus_time = (time_t) 0;
 	job_ptr->suspend_time = (time_t) 0;
@@ -11452,7 +11838,7 @@ extern int update_job_account(char *module, struct job_record *job_ptr,
 	}
 	job_ptr->assoc_id = assoc_rec.id;
 
-	last_job_update = time(NULL);
+	last_job_update = job_ptr->last_update = time(NULL);
 
 	return SLURM_SUCCESS;
 }
@@ -11516,7 +11902,7 @@ extern int update_job_wckey(char *module, struct job_record *job_ptr,
 		     module, job_ptr->job_id);
 	}
 
-	last_job_update = time(NULL);
+	last_job_update = job_ptr->last_update = time(NULL);
 
 	return SLURM_SUCCESS;
 }
@@ -11644,7 +12030,7 @@ extern int job_checkpoint(checkpoint_msg_t *ckpt_ptr, uid_t uid,
 				   &resp_data.error_msg);
 		info("checkpoint_op %u of %u.%u complete, rc=%d",
 		     ckpt_ptr->op, ckpt_ptr->job_id, ckpt_ptr->step_id, rc);
-		last_job_update = time(NULL);
+		last_job_update = job_ptr->last_update = time(NULL);
 	} else {		/* operate on all of a job's steps */
 		int update_rc = -2;
 		ListIterator step_iterator;
@@ -11678,7 +12064,7 @@ extern int job_checkpoint(checkpoint_msg_t *ckpt_ptr, uid_t uid,
 			xfree(image_dir);
 		}
 		if (update_rc != -2)	/* some work done */
-			last_job_update = time(NULL);
+			last_job_update = job_ptr->last_update = time(NULL);
 		list_iterator_destroy (step_iterator);
 	}
 
@@ -12121,7 +12507,7 @@ extern int job_restart(checkpoint_msg_t *ckpt_ptr, uid_t uid, slurm_fd_t conn_fd
 		job_ptr->details->restart_dir = image_dir;
 		image_dir = NULL;	/* Nothing left to xfree */
 
-		last_job_update = time(NULL);
+		last_job_update = job_ptr->last_update = time(NULL);
 	}
 
  unpack_error:
@@ -12256,6 +12642,8 @@ extern void job_hold_requeue(struct job_record *job_ptr)
 	job_ptr->job_state &= ~JOB_REQUEUE_HOLD;
 	job_ptr->job_state &= ~JOB_REQUEUE;
 
+	prio_queue_job_update(job_ptr);
+
 	debug("%s: job %u state 0x%x reason %u priority %d", __func__,
 	      job_ptr->job_id, job_ptr->job_state,
 	      job_ptr->state_reason, job_ptr->priority);
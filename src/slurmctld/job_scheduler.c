@@ -51,6 +51,7 @@
 #endif
 #include <ctype.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -77,6 +78,7 @@
 #include "src/slurmctld/locks.h"
 #include "src/slurmctld/node_scheduler.h"
 #include "src/slurmctld/preempt.h"
+#include "src/slurmctld/prio_queue.h"
 #include "src/slurmctld/proc_req.h"
 #include "src/slurmctld/reservation.h"
 #include "src/slurmctld/slurmctld.h"
@@ -85,10 +87,55 @@
 #ifdef WF_API
 #include "src/slurmctld/wf_program.h"
 #endif
+#ifdef SLURM_SIMULATOR
+#include "src/slurmctld/sim_nodes.h"
+#endif
 
 #define _DEBUG 0
 #define MAX_FAILED_RESV 10
 #define MAX_RETRIES 10
+#define SCHED_PLAN_YIELD_JOBS 32
+
+/* Outcome of a job/partition pair tested by _sched_plan() */
+typedef struct sched_plan {
+	uint32_t job_id;
+	struct part_record *part_ptr;
+	int rc;			/* SLURM_SUCCESS if it may start now,
+				 * ESLURM_NODES_BUSY if not, else
+				 * select_nodes() must tell */
+} sched_plan_t;
+
+/* Jobs of partitions planned apart from the others by _sched_plan() */
+typedef struct sched_group {
+	List job_queue;			/* job_queue_rec_t, priority order */
+	struct part_record **failed_parts;
+	int failed_part_cnt;
+	struct slurmctld_resv **failed_resv;
+	int failed_resv_cnt;
+	bitstr_t *plan_avail;		/* nodes left for the group's jobs */
+	sched_plan_t *plan;
+	int plan_cnt;
+	bool may_start;
+	bool done;			/* queue tested or timed out */
+} sched_group_t;
+
+/* Threads advancing the groups of _sched_plan() by rounds, the locks being
+ * yielded between rounds */
+typedef struct sched_group_work {
+	sched_group_t *groups;
+	int group_cnt;
+	int next_group;			/* next one to advance */
+	int round;			/* count of rounds started */
+	int active;			/* threads advancing groups */
+	bool stop;
+	pthread_mutex_t mutex;
+	pthread_cond_t start_cond;	/* round started or stop set */
+	pthread_cond_t done_cond;	/* active dropped to zero */
+	pthread_t *threads;
+	int thread_cnt;
+	time_t now;
+	int sched_timeout;
+} sched_group_work_t;
 
 typedef struct epilog_arg {
 	char *epilog_slurmctld;
@@ -106,6 +153,8 @@ static bool	_job_runnable_test1(struct job_record *job_ptr,
 				    bool clear_start);
 static bool	_job_runnable_test2(struct job_record *job_ptr,
 				    bool check_min_time);
+static bool	_job_runnable_test3(struct job_record *job_ptr,
+				    struct part_record *part_ptr);
 static void *	_run_epilog(void *arg);
 static void *	_run_prolog(void *arg);
 static bool	_scan_depend(List dependency_list, uint32_t job_id);
@@ -114,6 +163,10 @@ static int	_valid_node_feature(char *feature);
 
 static int	save_last_part_update = 0;
 
+/* Serializes the job_test_resv() calls of the _sched_plan() threads, should
+ * one advance the times of a reservation despite resv_advance_due() */
+static pthread_mutex_t resv_test_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 extern diag_stats_t slurmctld_diag_stats;
 
 /*
@@ -193,7 +246,7 @@ static bool _job_runnable_test1(struct job_record *job_ptr, bool clear_start)
 	if (job_ptr->state_reason == WAIT_FRONT_END) {
 		job_ptr->state_reason = WAIT_NO_REASON;
 		xfree(job_ptr->state_desc);
-		last_job_update = time(NULL);
+		last_job_update = job_ptr->last_update = time(NULL);
 	}
 #endif
 
@@ -206,7 +259,7 @@ static bool _job_runnable_test1(struct job_record *job_ptr, bool clear_start)
 		    && (job_ptr->state_reason != WAIT_HELD_USER)) {
 			job_ptr->state_reason = WAIT_HELD;
 			xfree(job_ptr->state_desc);
-			last_job_update = time(NULL);
+			last_job_update = job_ptr->last_update = time(NULL);
 		}
 		debug3("sched: JobId=%u. State=%s. Reason=%s. Priority=%u.",
 		       job_ptr->job_id,
@@ -251,6 +304,35 @@ static bool _job_runnable_test2(struct job_record *job_ptr, bool check_min_time)
 	return true;
 }
 
+/*
+ * Tests of build_job_queue() for one job/partition pair of the priority
+ * queues, with no partition pointer reset and no minimum time limit
+ */
+static bool _job_runnable_test3(struct job_record *job_ptr,
+				struct part_record *part_ptr)
+{
+	int reason;
+
+	if (!_job_runnable_test1(job_ptr, false))
+		return false;
+	if (!job_ptr->part_ptr_list) {
+		job_ptr->part_ptr = part_ptr;
+		return _job_runnable_test2(job_ptr, false);
+	}
+
+	job_ptr->part_ptr = part_ptr;
+	reason = job_limits_check(&job_ptr, false);
+	if ((reason != WAIT_NO_REASON) &&
+	    (reason != job_ptr->state_reason) &&
+	    (!part_policy_job_runnable_state(job_ptr))) {
+		job_ptr->state_reason = reason;
+		xfree(job_ptr->state_desc);
+	}
+	if (reason != WAIT_NO_REASON)
+		return false;
+	return true;
+}
+
 /*
  * build_job_queue - build (non-priority ordered) list of pending jobs
  * IN clear_start - if set then clear the start_time for pending jobs
@@ -559,7 +641,7 @@ next_part:		part_ptr = (struct part_record *)
 				job_ptr->state_reason = WAIT_NO_REASON;
 				xfree(job_ptr->state_desc);
 				job_ptr->assoc_id = assoc_rec.id;
-				last_job_update = now;
+				last_job_update = job_ptr->last_update = now;
 			} else {
 				continue;
 			}
@@ -575,12 +657,12 @@ next_part:		part_ptr = (struct part_record *)
 					job_ptr->job_id);
 				xfree(job_ptr->state_desc);
 				job_ptr->state_reason = FAIL_QOS;
-				last_job_update = now;
+				last_job_update = job_ptr->last_update = now;
 				continue;
 			} else if (job_ptr->state_reason == FAIL_QOS) {
 				xfree(job_ptr->state_desc);
 				job_ptr->state_reason = WAIT_NO_REASON;
-				last_job_update = now;
+				last_job_update = job_ptr->last_update = now;
 			}
 		}
 
@@ -589,7 +671,7 @@ next_part:		part_ptr = (struct part_record *)
 		    (job_ptr->state_reason == WAIT_QOS_TIME_LIMIT)) {
 			job_ptr->state_reason = WAIT_NO_REASON;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
 		}
 
 		if ((job_ptr->state_reason == WAIT_NODE_NOT_AVAIL) &&
@@ -608,7 +690,7 @@ next_part:		part_ptr = (struct part_record *)
 		if (license_job_test(job_ptr, now) != SLURM_SUCCESS) {
 			job_ptr->state_reason = WAIT_LICENSES;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
 			continue;
 		}
 
@@ -621,7 +703,7 @@ next_part:		part_ptr = (struct part_record *)
 			 * very rare. */
 			info("sched: JobId=%u has invalid account",
 			     job_ptr->job_id);
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
 			job_ptr->state_reason = FAIL_ACCOUNT;
 			xfree(job_ptr->state_desc);
 			continue;
@@ -652,7 +734,7 @@ next_part:		part_ptr = (struct part_record *)
 		bit_free(job_ptr->details->exc_node_bitmap);
 		job_ptr->details->exc_node_bitmap = orig_exc_bitmap;
 		if (error_code == SLURM_SUCCESS) {
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
 			info("sched: Allocate JobId=%u NodeList=%s #CPUs=%u",
 			     job_ptr->job_id, job_ptr->nodes,
 			     job_ptr->total_cpus);
@@ -710,6 +792,769 @@ static bool _all_partition_priorities_same(void)
 	return result;
 }
 
+/* Candidate test of _sched_plan(), build_job_queue() without the tests that
+ * set job fields
+ * OUT depend - set if left out only for its dependencies, which only
+ *	test_job_dependency() can tell are satisfied */
+static bool _plan_job_candidate(struct job_record *job_ptr, time_t now,
+				bool *depend)
+{
+	if (!IS_JOB_PENDING(job_ptr) || IS_JOB_COMPLETING(job_ptr) ||
+	    (job_ptr->priority == 0) || !job_ptr->details)
+		return false;
+	if (job_ptr->details->begin_time > now)
+		return false;
+	if (job_ptr->details->depend_list &&
+	    list_count(job_ptr->details->depend_list)) {
+		*depend = true;
+		return false;
+	}
+	return true;
+}
+
+/* Like build_job_queue(), but only sets no job fields, for _sched_plan()
+ * OUT depend - set if a job was left out for its dependencies */
+static List _build_plan_queue(time_t now, bool *depend)
+{
+	List job_queue;
+	ListIterator job_iterator, part_iterator;
+	struct job_record *job_ptr;
+	struct part_record *part_ptr;
+	int inx;
+
+	job_queue = list_create(_job_queue_rec_del);
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		if (!_plan_job_candidate(job_ptr, now, depend))
+			continue;
+		if (job_ptr->part_ptr_list) {
+			inx = 0;
+			part_iterator = list_iterator_create(
+				job_ptr->part_ptr_list);
+			while ((part_ptr = (struct part_record *)
+				list_next(part_iterator))) {
+				if (job_ptr->priority_array) {
+					_job_queue_append(job_queue, job_ptr,
+							  part_ptr,
+							  job_ptr->
+							  priority_array[inx]);
+				} else {
+					_job_queue_append(job_queue, job_ptr,
+							  part_ptr,
+							  job_ptr->priority);
+				}
+				inx++;
+			}
+			list_iterator_destroy(part_iterator);
+		} else if (job_ptr->part_ptr) {
+			_job_queue_append(job_queue, job_ptr,
+					  job_ptr->part_ptr, job_ptr->priority);
+		}
+	}
+	list_iterator_destroy(job_iterator);
+
+	return job_queue;
+}
+
+/*
+ * Find the nodes of a partition on which a job may run, as job_start_data()
+ * does, without setting any job field
+ * IN plan_avail - nodes usable at all
+ * IN later_resv - if set, a reservation of the job starting after now is not
+ *	an error
+ * OUT start_res - when the job's reservation, if any, may be used
+ * OUT avail_bitmap, exc_core_bitmap, min_nodes, max_nodes, req_nodes -
+ *	arguments of select_g_job_test(), to free on success
+ * RET SLURM_SUCCESS, ESLURM_NODES_BUSY or another error code
+ */
+static int _job_test_nodes(struct job_record *job_ptr,
+			   struct part_record *part_ptr, bitstr_t *plan_avail,
+			   time_t now, bool later_resv, time_t *start_res,
+			   bitstr_t **avail_bitmap, bitstr_t **exc_core_bitmap,
+			   uint32_t *min_nodes, uint32_t *max_nodes,
+			   uint32_t *req_nodes)
+{
+	int rc;
+
+	*start_res = now;
+	*avail_bitmap = NULL;
+	*exc_core_bitmap = NULL;
+	if (!part_ptr->node_bitmap)
+		return ESLURM_REQUESTED_PART_CONFIG_UNAVAILABLE;
+	slurm_mutex_lock(&resv_test_mutex);
+	rc = job_test_resv(job_ptr, start_res, false, avail_bitmap,
+			   exc_core_bitmap);
+	slurm_mutex_unlock(&resv_test_mutex);
+	if (rc != SLURM_SUCCESS)
+		return rc;
+	if (!later_resv && (*start_res > now)) {
+		rc = ESLURM_RESERVATION_NOT_USABLE;
+		goto fini;
+	}
+
+	bit_and(*avail_bitmap, part_ptr->node_bitmap);
+	bit_and(*avail_bitmap, plan_avail);
+	if (job_ptr->details->exc_node_bitmap) {
+		bit_and_not(*avail_bitmap,
+			    job_ptr->details->exc_node_bitmap);
+	}
+	if (job_ptr->details->req_node_bitmap &&
+	    !bit_super_set(job_ptr->details->req_node_bitmap,
+			   *avail_bitmap)) {
+		rc = ESLURM_NODE_NOT_AVAIL;
+		goto fini;
+	}
+
+	*min_nodes = MAX(job_ptr->details->min_nodes, part_ptr->min_nodes);
+	if (job_ptr->details->max_nodes == 0)
+		*max_nodes = part_ptr->max_nodes;
+	else
+		*max_nodes = MIN(job_ptr->details->max_nodes,
+				 part_ptr->max_nodes);
+	*max_nodes = MIN(*max_nodes, 500000);	/* prevent overflows */
+	if (!job_ptr->limit_set_max_nodes && job_ptr->details->max_nodes)
+		*req_nodes = *max_nodes;
+	else
+		*req_nodes = *min_nodes;
+	if (*min_nodes > *max_nodes) {
+		rc = ESLURM_REQUESTED_PART_CONFIG_UNAVAILABLE;
+		goto fini;
+	}
+	if (bit_set_count(*avail_bitmap) < *min_nodes)
+		rc = ESLURM_NODES_BUSY;
+
+fini:	if (rc != SLURM_SUCCESS) {
+		FREE_NULL_BITMAP(*avail_bitmap);
+		FREE_NULL_BITMAP(*exc_core_bitmap);
+	}
+	return rc;
+}
+
+/*
+ * Test if a job may start now in a partition on the nodes of plan_avail, as
+ * job_start_data() does, with read locks only. job_test_resv() and the
+ * select plugin set fields of the job and of its details they test (e.g.
+ * cons_res sets details->mc_ptr and whole_node), so they are given copies
+ * of both records, and a job whose test would advance the times of a
+ * reservation is left to select_nodes().
+ * OUT sel_bitmap - nodes the job would use, on success
+ * RET SLURM_SUCCESS, ESLURM_NODES_BUSY or another error code
+ */
+static int _plan_job_test(struct job_record *job_ptr,
+			  struct part_record *part_ptr, bitstr_t *plan_avail,
+			  bitstr_t **sel_bitmap, time_t now)
+{
+	struct job_record job_copy;
+	struct job_details details_copy;
+	time_t start_res;
+	bitstr_t *avail_bitmap, *exc_core_bitmap;
+	uint32_t min_nodes, max_nodes, req_nodes;
+	int rc;
+
+	/* job_test_resv() takes the time right after this */
+	if (resv_advance_due(time(NULL) + 1))
+		return ESLURM_RESERVATION_NOT_USABLE;
+
+	memcpy(&job_copy, job_ptr, sizeof(struct job_record));
+	memcpy(&details_copy, job_ptr->details, sizeof(struct job_details));
+	job_copy.details = &details_copy;
+	rc = _job_test_nodes(&job_copy, part_ptr, plan_avail, now, false,
+			     &start_res, &avail_bitmap, &exc_core_bitmap,
+			     &min_nodes, &max_nodes, &req_nodes);
+	if (rc != SLURM_SUCCESS)
+		return rc;
+
+	job_copy.part_ptr = part_ptr;
+	rc = select_g_job_test(&job_copy, avail_bitmap, min_nodes, max_nodes,
+			       req_nodes, SELECT_MODE_WILL_RUN, NULL, NULL,
+			       exc_core_bitmap);
+	if ((rc == SLURM_SUCCESS) && (job_copy.start_time > now))
+		rc = ESLURM_NODES_BUSY;
+	if (details_copy.mc_ptr != job_ptr->details->mc_ptr)
+		xfree(details_copy.mc_ptr);	/* default set by cons_res */
+
+	if (rc == SLURM_SUCCESS)
+		*sel_bitmap = avail_bitmap;
+	else
+		FREE_NULL_BITMAP(avail_bitmap);
+	FREE_NULL_BITMAP(exc_core_bitmap);
+	return rc;
+}
+
+/*
+ * job_test_start - test when a job may start in a partition on the nodes
+ *	of avail, from now on
+ * IN mode - SELECT_MODE_WILL_RUN: the job's partition, start time and CPU
+ *	count are restored, so only read locks are needed.
+ *	SELECT_MODE_RUN_NOW: on success the job is left in the partition with
+ *	its resources selected, for select_g_job_begin().
+ * OUT start_time - when the job may start, no sooner than now
+ * OUT sel_bitmap - nodes the job would use, on success
+ * RET SLURM_SUCCESS or an error code
+ */
+extern int job_test_start(struct job_record *job_ptr,
+			  struct part_record *part_ptr, bitstr_t *avail,
+			  uint16_t mode, time_t now, time_t *start_time,
+			  bitstr_t **sel_bitmap)
+{
+	struct part_record *save_part_ptr = job_ptr->part_ptr;
+	time_t save_start_time = job_ptr->start_time, start_res;
+	uint32_t save_total_cpus = job_ptr->total_cpus;
+	bitstr_t *avail_bitmap, *exc_core_bitmap;
+	uint32_t min_nodes, max_nodes, req_nodes;
+	int rc;
+
+	rc = _job_test_nodes(job_ptr, part_ptr, avail, now,
+			     (mode == SELECT_MODE_WILL_RUN), &start_res,
+			     &avail_bitmap, &exc_core_bitmap,
+			     &min_nodes, &max_nodes, &req_nodes);
+	if (rc != SLURM_SUCCESS)
+		return rc;
+
+	job_ptr->part_ptr = part_ptr;
+	rc = select_g_job_test(job_ptr, avail_bitmap, min_nodes, max_nodes,
+			       req_nodes, mode, NULL, NULL, exc_core_bitmap);
+	if (mode == SELECT_MODE_WILL_RUN) {
+		*start_time = MAX(job_ptr->start_time, start_res);
+		*start_time = MAX(*start_time, now);
+		job_ptr->part_ptr   = save_part_ptr;
+		job_ptr->start_time = save_start_time;
+		job_ptr->total_cpus = save_total_cpus;
+	} else if (rc == SLURM_SUCCESS) {
+		*start_time = now;
+	} else {
+		job_ptr->part_ptr = save_part_ptr;
+	}
+
+	if (rc == SLURM_SUCCESS)
+		*sel_bitmap = avail_bitmap;
+	else
+		FREE_NULL_BITMAP(avail_bitmap);
+	FREE_NULL_BITMAP(exc_core_bitmap);
+	return rc;
+}
+
+static int _sched_plan_cmp(const void *x, const void *y)
+{
+	const sched_plan_t *plan1 = x;
+	const sched_plan_t *plan2 = y;
+
+	if (plan1->job_id != plan2->job_id)
+		return (plan1->job_id < plan2->job_id) ? -1 : 1;
+	if (plan1->part_ptr != plan2->part_ptr)
+		return (plan1->part_ptr < plan2->part_ptr) ? -1 : 1;
+	return 0;
+}
+
+/* Set up a group to plan the jobs of job_queue, which it takes */
+static void _sched_group_init(sched_group_t *group, List job_queue)
+{
+	group->job_queue = job_queue;
+	group->failed_parts = xmalloc(sizeof(struct part_record *) *
+				      (list_count(part_list) + 1));
+	group->failed_resv = xmalloc(sizeof(struct slurmctld_resv *) *
+				     MAX_FAILED_RESV);
+	group->plan_avail = bit_copy(avail_node_bitmap);
+	group->plan = xmalloc(sizeof(sched_plan_t) *
+			      (list_count(job_queue) + 1));
+}
+
+static void _sched_groups_free(sched_group_t *groups, int group_cnt)
+{
+	int i;
+
+	for (i = 0; i < group_cnt; i++) {
+		FREE_NULL_LIST(groups[i].job_queue);
+		xfree(groups[i].failed_parts);
+		xfree(groups[i].failed_resv);
+		FREE_NULL_BITMAP(groups[i].plan_avail);
+		xfree(groups[i].plan);
+	}
+	xfree(groups);
+}
+
+static int _part_ptr_cmp(const void *x, const void *y)
+{
+	struct part_record *part_ptr1 = *(struct part_record **) x;
+	struct part_record *part_ptr2 = *(struct part_record **) y;
+
+	if (part_ptr1 == part_ptr2)
+		return 0;
+	return (part_ptr1 < part_ptr2) ? -1 : 1;
+}
+
+/* Union-find over partition indexes */
+static int _group_find(int *group_parent, int inx)
+{
+	while (group_parent[inx] != inx) {
+		group_parent[inx] = group_parent[group_parent[inx]];
+		inx = group_parent[inx];
+	}
+	return inx;
+}
+
+static void _group_union(int *group_parent, int inx1, int inx2)
+{
+	inx1 = _group_find(group_parent, inx1);
+	inx2 = _group_find(group_parent, inx2);
+	if (inx1 < inx2)
+		group_parent[inx2] = inx1;
+	else if (inx2 < inx1)
+		group_parent[inx1] = inx2;
+}
+
+static int _group_part_inx(struct part_record **parts, int part_cnt,
+			   struct part_record *part_ptr)
+{
+	struct part_record **found;
+
+	found = bsearch(&part_ptr, parts, part_cnt,
+			sizeof(struct part_record *), _part_ptr_cmp);
+	return found ? (found - parts) : -1;
+}
+
+/*
+ * Split a job queue among groups of partitions which may be planned apart:
+ * partitions sharing nodes are in the same group, and so are partitions
+ * of a job submitted to several and partitions whose jobs use the same
+ * advanced reservation, so that each job and reservation is in one group.
+ * IN job_queue - in priority order, destroyed
+ * OUT group_cnt - count of groups returned
+ * RET the groups, their queues in priority order. Free with
+ *	_sched_groups_free().
+ */
+static sched_group_t *_sched_groups(List job_queue, int *group_cnt)
+{
+	ListIterator job_iterator, part_iterator;
+	job_queue_rec_t *job_queue_rec;
+	struct job_record *job_ptr;
+	struct part_record *part_ptr, **parts;
+	struct slurmctld_resv **resv_ptrs;
+	sched_group_t *groups;
+	List *group_queues;
+	int *group_parent, *resv_inx, *group_inx;
+	int part_cnt = 0, resv_cnt = 0, i, j, inx;
+
+	parts = xmalloc(sizeof(struct part_record *) *
+			(list_count(part_list) + 1));
+	part_iterator = list_iterator_create(part_list);
+	while ((part_ptr = (struct part_record *) list_next(part_iterator)))
+		parts[part_cnt++] = part_ptr;
+	list_iterator_destroy(part_iterator);
+	qsort(parts, part_cnt, sizeof(struct part_record *), _part_ptr_cmp);
+
+	group_parent = xmalloc(sizeof(int) * (part_cnt + 1));
+	for (i = 0; i < part_cnt; i++) {
+		group_parent[i] = i;
+		for (j = 0; j < i; j++) {
+			if (parts[i]->node_bitmap && parts[j]->node_bitmap &&
+			    bit_overlap(parts[i]->node_bitmap,
+					parts[j]->node_bitmap))
+				_group_union(group_parent, i, j);
+		}
+	}
+
+	resv_ptrs = xmalloc(sizeof(struct slurmctld_resv *) *
+			    (list_count(job_queue) + 1));
+	resv_inx = xmalloc(sizeof(int) * (list_count(job_queue) + 1));
+	job_iterator = list_iterator_create(job_queue);
+	while ((job_queue_rec = (job_queue_rec_t *) list_next(job_iterator))) {
+		job_ptr = job_queue_rec->job_ptr;
+		inx = _group_part_inx(parts, part_cnt,
+				      job_queue_rec->part_ptr);
+		if (inx < 0)
+			continue;
+		if (job_ptr->part_ptr_list) {
+			part_iterator = list_iterator_create(
+				job_ptr->part_ptr_list);
+			while ((part_ptr = (struct part_record *)
+				list_next(part_iterator))) {
+				i = _group_part_inx(parts, part_cnt,
+						    part_ptr);
+				if (i >= 0)
+					_group_union(group_parent, inx, i);
+			}
+			list_iterator_destroy(part_iterator);
+		}
+		if (job_ptr->resv_ptr) {
+			for (i = 0; i < resv_cnt; i++) {
+				if (resv_ptrs[i] == job_ptr->resv_ptr)
+					break;
+			}
+			if (i < resv_cnt) {
+				_group_union(group_parent, inx, resv_inx[i]);
+			} else {
+				resv_ptrs[resv_cnt] = job_ptr->resv_ptr;
+				resv_inx[resv_cnt++] = inx;
+			}
+		}
+	}
+	list_iterator_destroy(job_iterator);
+
+	/* Jobs in a partition not found are left to the first group */
+	group_inx = xmalloc(sizeof(int) * (part_cnt + 1));
+	group_queues = xmalloc(sizeof(List) * (part_cnt + 1));
+	*group_cnt = 0;
+	while ((job_queue_rec = (job_queue_rec_t *) list_pop(job_queue))) {
+		inx = _group_part_inx(parts, part_cnt,
+				      job_queue_rec->part_ptr);
+		inx = (inx < 0) ? 0 : _group_find(group_parent, inx);
+		if (!group_queues[inx]) {
+			group_queues[inx] = list_create(_job_queue_rec_del);
+			group_inx[(*group_cnt)++] = inx;
+		}
+		list_append(group_queues[inx], job_queue_rec);
+	}
+	list_destroy(job_queue);
+
+	groups = xmalloc(sizeof(sched_group_t) * (*group_cnt + 1));
+	for (i = 0; i < *group_cnt; i++)
+		_sched_group_init(&groups[i], group_queues[group_inx[i]]);
+
+	xfree(parts);
+	xfree(group_parent);
+	xfree(resv_ptrs);
+	xfree(resv_inx);
+	xfree(group_inx);
+	xfree(group_queues);
+	return groups;
+}
+
+/*
+ * Test the next jobs of a group in priority order for an immediate start,
+ * blocking the nodes of the jobs that may start and of partitions and
+ * reservations whose jobs can not as schedule() does, until
+ * SCHED_PLAN_YIELD_JOBS more are tested or the group is done
+ */
+static void _sched_group_plan(sched_group_t *group, time_t now,
+			      int sched_timeout)
+{
+	job_queue_rec_t *job_queue_rec;
+	struct job_record *job_ptr;
+	struct part_record *part_ptr;
+	bitstr_t *sel_bitmap = NULL;
+	int test_cnt = 0, i, rc;
+	bool skip;
+
+	while (test_cnt < SCHED_PLAN_YIELD_JOBS) {
+		job_queue_rec = (job_queue_rec_t *) list_pop(group->job_queue);
+		if (!job_queue_rec) {
+			group->done = true;
+			break;
+		}
+		part_ptr = job_queue_rec->part_ptr;
+		job_ptr = find_job_record(job_queue_rec->job_id);
+		xfree(job_queue_rec);
+		if (!job_ptr || !IS_JOB_PENDING(job_ptr))
+			continue;
+		if ((time(NULL) - now) >= sched_timeout) {
+			group->done = true;
+			break;
+		}
+
+		skip = false;
+		for (i = 0; i < group->plan_cnt; i++) {
+			if ((group->plan[i].job_id == job_ptr->job_id) &&
+			    (group->plan[i].rc == SLURM_SUCCESS))
+				skip = true;	/* in another partition */
+		}
+		if (job_ptr->resv_name) {
+			for (i = 0; i < group->failed_resv_cnt; i++) {
+				if (group->failed_resv[i] == job_ptr->resv_ptr)
+					skip = true;
+			}
+		} else if (_failed_partition(part_ptr, group->failed_parts,
+					     group->failed_part_cnt)) {
+			skip = true;
+		}
+		if (skip || (license_job_test(job_ptr, now) != SLURM_SUCCESS))
+			continue;
+
+		rc = _plan_job_test(job_ptr, part_ptr, group->plan_avail,
+				    &sel_bitmap, now);
+		group->plan[group->plan_cnt].job_id   = job_ptr->job_id;
+		group->plan[group->plan_cnt].part_ptr = part_ptr;
+		group->plan[group->plan_cnt].rc       = rc;
+		group->plan_cnt++;
+		test_cnt++;
+		if (rc == SLURM_SUCCESS) {
+			bit_and_not(group->plan_avail, sel_bitmap);
+			FREE_NULL_BITMAP(sel_bitmap);
+			group->may_start = true;
+		} else if (rc == ESLURM_NODES_BUSY) {
+			if (job_ptr->details->req_node_bitmap &&
+			    (bit_set_count(job_ptr->details->req_node_bitmap) >=
+			     job_ptr->details->min_nodes)) {
+				bit_and_not(group->plan_avail,
+					    job_ptr->details->req_node_bitmap);
+			} else if (job_ptr->resv_name) {
+				if (group->failed_resv_cnt < MAX_FAILED_RESV) {
+					group->failed_resv[group->
+							   failed_resv_cnt++] =
+						job_ptr->resv_ptr;
+				}
+			} else {
+				group->failed_parts[group->failed_part_cnt++] =
+					part_ptr;
+				bit_and_not(group->plan_avail,
+					    part_ptr->node_bitmap);
+			}
+		} else {
+			group->may_start = true; /* select_nodes() will tell */
+		}
+	}
+}
+
+/* Take the next group to advance in the current round, NULL if none is
+ * left. Call with work->mutex locked. */
+static sched_group_t *_sched_group_next(sched_group_work_t *work)
+{
+	while ((work->next_group < work->group_cnt) &&
+	       work->groups[work->next_group].done)
+		work->next_group++;
+	if (work->next_group >= work->group_cnt)
+		return NULL;
+	return &work->groups[work->next_group++];
+}
+
+/* Advance groups until none is left in the round. Call with work->mutex
+ * locked. */
+static void _sched_group_round(sched_group_work_t *work)
+{
+	sched_group_t *group;
+
+	work->active++;
+	while ((group = _sched_group_next(work))) {
+		slurm_mutex_unlock(&work->mutex);
+		_sched_group_plan(group, work->now, work->sched_timeout);
+		slurm_mutex_lock(&work->mutex);
+	}
+	if (--work->active == 0)
+		pthread_cond_broadcast(&work->done_cond);
+}
+
+/* Worker thread of _sched_plan(), joining every round until stopped */
+static void *_sched_group_agent(void *args)
+{
+	sched_group_work_t *work = (sched_group_work_t *) args;
+	int round = 0;
+
+	slurm_mutex_lock(&work->mutex);
+	while (1) {
+		while (!work->stop && (work->round == round))
+			pthread_cond_wait(&work->start_cond, &work->mutex);
+		if (work->stop)
+			break;
+		round = work->round;
+		_sched_group_round(work);
+	}
+	slurm_mutex_unlock(&work->mutex);
+	return NULL;
+}
+
+/* Start up to thread_cnt - 1 worker threads advancing the groups along
+ * with the calling one, kept for every round of the plan */
+static void _sched_work_start(sched_group_work_t *work,
+			      sched_group_t *groups, int group_cnt,
+			      int thread_cnt, time_t now, int sched_timeout)
+{
+	pthread_attr_t thread_attr;
+	int i;
+
+	memset(work, 0, sizeof(sched_group_work_t));
+	work->groups = groups;
+	work->group_cnt = group_cnt;
+	work->now = now;
+	work->sched_timeout = sched_timeout;
+	slurm_mutex_init(&work->mutex);
+	pthread_cond_init(&work->start_cond, NULL);
+	pthread_cond_init(&work->done_cond, NULL);
+
+	thread_cnt = MIN(thread_cnt, group_cnt) - 1;
+	if (thread_cnt <= 0)
+		return;
+	work->threads = xmalloc(sizeof(pthread_t) * thread_cnt);
+	slurm_attr_init(&thread_attr);
+	for (i = 0; i < thread_cnt; i++) {
+		if (pthread_create(&work->threads[work->thread_cnt],
+				   &thread_attr, _sched_group_agent, work)) {
+			error("sched: pthread_create: %m");
+			break;
+		}
+		work->thread_cnt++;
+	}
+	slurm_attr_destroy(&thread_attr);
+}
+
+/* Advance every group not done yet by SCHED_PLAN_YIELD_JOBS tests, in the
+ * worker threads and this one. The slurmctld locks must be held. */
+static void _sched_work_round(sched_group_work_t *work)
+{
+	slurm_mutex_lock(&work->mutex);
+	work->next_group = 0;
+	work->round++;
+	pthread_cond_broadcast(&work->start_cond);
+	_sched_group_round(work);
+	while (work->active)
+		pthread_cond_wait(&work->done_cond, &work->mutex);
+	slurm_mutex_unlock(&work->mutex);
+}
+
+static void _sched_work_fini(sched_group_work_t *work)
+{
+	int i;
+
+	slurm_mutex_lock(&work->mutex);
+	work->stop = true;
+	pthread_cond_broadcast(&work->start_cond);
+	slurm_mutex_unlock(&work->mutex);
+	for (i = 0; i < work->thread_cnt; i++)
+		pthread_join(work->threads[i], NULL);
+	xfree(work->threads);
+	pthread_cond_destroy(&work->start_cond);
+	pthread_cond_destroy(&work->done_cond);
+	slurm_mutex_destroy(&work->mutex);
+}
+
+/*
+ * Phase one of a two-phase scheduling pass: with read locks only, test the
+ * pending jobs in priority order for an immediate start, blocking the nodes
+ * of the jobs that may start and of partitions and reservations whose jobs
+ * can not as schedule() does, on a copy of avail_node_bitmap. The locks are
+ * yielded every SCHED_PLAN_YIELD_JOBS jobs tested, so that RPCs needing write
+ * locks get in.
+ * With thread_cnt > 1, partitions sharing no node are split in groups
+ * planned in parallel, each from its own copy of avail_node_bitmap, and the
+ * locks are yielded once every group tested SCHED_PLAN_YIELD_JOBS more jobs.
+ * The threads are started once for the whole plan, and wait while the
+ * locks are yielded.
+ * OUT plan_cnt - count of jobs tested
+ * OUT depend - set if jobs were left out for their dependencies
+ * RET the outcomes, sorted by job id and partition, NULL if no job tested
+ *	may start now. Free with xfree().
+ */
+static sched_plan_t *_sched_plan(uint32_t job_limit, int sched_timeout,
+				 int thread_cnt, int *plan_cnt, bool *depend)
+{
+	/* Locks: Read config, read job, read node, read partition */
+	slurmctld_lock_t job_read_lock =
+	    { READ_LOCK, READ_LOCK, READ_LOCK, READ_LOCK };
+	List job_queue;
+	ListIterator job_iterator;
+	sched_group_t *groups;
+	sched_group_work_t work;
+	sched_plan_t *plan;
+	time_t now = time(NULL), part_update;
+	uint32_t job_depth = 0;
+	int group_cnt = 1, i;
+	bool done, may_start = false;
+
+	lock_slurmctld(job_read_lock);
+	part_update = last_part_update;
+	job_queue = _build_plan_queue(now, depend);
+	sort_job_queue(job_queue);
+	job_iterator = list_iterator_create(job_queue);
+	while (list_next(job_iterator)) {
+		if (job_depth++ > job_limit)
+			list_delete_item(job_iterator);
+	}
+	list_iterator_destroy(job_iterator);
+	if (thread_cnt > 1) {
+		groups = _sched_groups(job_queue, &group_cnt);
+	} else {
+		groups = xmalloc(sizeof(sched_group_t));
+		_sched_group_init(groups, job_queue);
+	}
+
+	_sched_work_start(&work, groups, group_cnt, thread_cnt, now,
+			  sched_timeout);
+	while (1) {
+		_sched_work_round(&work);
+		done = true;
+		for (i = 0; i < group_cnt; i++) {
+			if (!groups[i].done)
+				done = false;
+		}
+		if (done)
+			break;
+
+		unlock_slurmctld(job_read_lock);
+		lock_slurmctld(job_read_lock);
+		if (last_part_update != part_update) {
+			debug("sched: partitions changed, plan cut short");
+			break;
+		}
+	}
+	unlock_slurmctld(job_read_lock);
+	_sched_work_fini(&work);
+
+	*plan_cnt = 0;
+	for (i = 0; i < group_cnt; i++) {
+		*plan_cnt += groups[i].plan_cnt;
+		if (groups[i].may_start)
+			may_start = true;
+	}
+	if (!may_start) {
+		_sched_groups_free(groups, group_cnt);
+		return NULL;
+	}
+	plan = xmalloc(sizeof(sched_plan_t) * (*plan_cnt + 1));
+	*plan_cnt = 0;
+	for (i = 0; i < group_cnt; i++) {
+		memcpy(plan + *plan_cnt, groups[i].plan,
+		       sizeof(sched_plan_t) * groups[i].plan_cnt);
+		*plan_cnt += groups[i].plan_cnt;
+	}
+	_sched_groups_free(groups, group_cnt);
+	qsort(plan, *plan_cnt, sizeof(sched_plan_t), _sched_plan_cmp);
+	return plan;
+}
+
+/* Return true if select_nodes() is worth calling for a job in its current
+ * partition: may start as planned, failed for another reason than busy
+ * nodes, or was not tested by _sched_plan() (submitted or freed of its
+ * dependencies since, skipped for licenses, or the plan was cut short) */
+static bool _sched_plan_test(sched_plan_t *plan, int plan_cnt,
+			     struct job_record *job_ptr)
+{
+	sched_plan_t key, *found;
+
+	key.job_id   = job_ptr->job_id;
+	key.part_ptr = job_ptr->part_ptr;
+	found = bsearch(&key, plan, plan_cnt, sizeof(sched_plan_t),
+			_sched_plan_cmp);
+	return (!found || (found->rc != ESLURM_NODES_BUSY));
+}
+
+/* Run the dependency tests of the pending jobs left out of an empty plan,
+ * as build_job_queue() would
+ * RET true if one of them may be scheduled now */
+static bool _sched_depend_test(void)
+{
+	/* Locks: Read config, write job, write node, read partition */
+	slurmctld_lock_t job_write_lock =
+	    { READ_LOCK, WRITE_LOCK, WRITE_LOCK, READ_LOCK };
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	bool ready = false;
+
+	lock_slurmctld(job_write_lock);
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		if (!IS_JOB_PENDING(job_ptr) || IS_JOB_COMPLETING(job_ptr) ||
+		    (job_ptr->priority == 0) || !job_ptr->details ||
+		    !job_ptr->details->depend_list ||
+		    !list_count(job_ptr->details->depend_list))
+			continue;
+		if (job_independent(job_ptr, 0))
+			ready = true;
+	}
+	list_iterator_destroy(job_iterator);
+	unlock_slurmctld(job_write_lock);
+
+	return ready;
+}
+
 /*
  * schedule - attempt to schedule all pending jobs
  *	pending jobs for each partition will be scheduled in priority
@@ -749,6 +1594,9 @@ extern int schedule(uint32_t job_limit)
 	static time_t sched_update = 0;
 	static bool wiki_sched = false;
 	static bool fifo_sched = false;
+	static bool prio_queue = false;
+	static bool two_phase = false;
+	static int plan_threads = 1;
 #ifdef WF_API
 	static bool wf_backfill_sched = false;
 #endif
@@ -760,6 +1608,9 @@ extern int schedule(uint32_t job_limit)
 	uint32_t reject_array_job_id = 0;
 	struct part_record *reject_array_part = NULL;
 	uint16_t reject_state_reason = WAIT_NO_REASON;
+	sched_plan_t *plan = NULL;
+	int plan_cnt = 0;
+	bool plan_depend = false;
 	DEF_TIMERS;
 
 	if (slurmctld_config.shutdown_time)
@@ -861,6 +1712,30 @@ extern int schedule(uint32_t job_limit)
 			sched_interval = 60;
 		}
 
+		if (sched_params && strstr(sched_params, "prio_queue"))
+			prio_queue = true;
+		else
+			prio_queue = false;
+		if (sched_params && strstr(sched_params, "sched_two_phase"))
+			two_phase = true;
+		else
+			two_phase = false;
+		plan_threads = 1;
+		if (sched_params &&
+		    (tmp_ptr=strstr(sched_params, "sched_plan_threads=")))
+			plan_threads = atoi(tmp_ptr + 19);
+		if (plan_threads < 1) {
+			error("Invalid sched_plan_threads: %d", plan_threads);
+			plan_threads = 1;
+		}
+		if ((plan_threads > 1) &&
+		    xstrcmp(slurmctld_conf.select_type, "select/cons_res") &&
+		    xstrcmp(slurmctld_conf.select_type, "select/linear")) {
+			error("sched_plan_threads is incompatible with %s",
+			      slurmctld_conf.select_type);
+			plan_threads = 1;
+		}
+
 		xfree(sched_params);
 		sched_update = slurmctld_conf.last_update;
 		info("SchedulerParameters=default_queue_depth=%d,"
@@ -883,6 +1758,21 @@ extern int schedule(uint32_t job_limit)
 	if (job_limit == 0)
 		job_limit = def_job_limit;
 
+	/* Phase one of a two-phase pass, the write locks are then only
+	 * needed to start the jobs found able to */
+	if (two_phase && !fifo_sched && !wiki_sched &&
+#ifdef WF_API
+	    !wf_backfill_sched &&
+#endif
+	    !slurm_preemption_enabled()) {
+		plan = _sched_plan(job_limit, sched_timeout, plan_threads,
+				   &plan_cnt, &plan_depend);
+		if (!plan && (!plan_depend || !_sched_depend_test())) {
+			debug("sched: schedule() returning, no job can start");
+			return 0;
+		}
+	}
+
 	lock_slurmctld(job_write_lock);
 	now = time(NULL);
 	sched_start = now;
@@ -902,6 +1792,7 @@ extern int schedule(uint32_t job_limit)
 		list_iterator_destroy(job_iterator);
 
 		unlock_slurmctld(job_write_lock);
+		xfree(plan);
 		debug("sched: schedule() returning, no front end nodes are "
 		      "available");
 		return 0;
@@ -909,6 +1800,7 @@ extern int schedule(uint32_t job_limit)
 	/* Avoid resource fragmentation if important */
 	if ((!wiki_sched) && job_is_completing()) {
 		unlock_slurmctld(job_write_lock);
+		xfree(plan);
 		debug("sched: schedule() returning, some job is still "
 		      "completing");
 		return 0;
@@ -923,6 +1815,7 @@ extern int schedule(uint32_t job_limit)
 	 */
 	if (select_g_reconfigure()) {
 		unlock_slurmctld(job_write_lock);
+		xfree(plan);
 		debug4("sched: not scheduling due to ALPS");
 		return SLURM_SUCCESS;
 	}
@@ -966,9 +1859,17 @@ extern int schedule(uint32_t job_limit)
 			decompress_workflows();
 		}
 #endif
-		job_queue = build_job_queue(false, false);
-		slurmctld_diag_stats.schedule_queue_len = list_count(job_queue);
-		sort_job_queue(job_queue);
+		if (prio_queue) {
+			prio_queue_iter_start();
+			slurmctld_diag_stats.schedule_queue_len =
+				prio_queue_count();
+		} else {
+			prio_queue_clear();
+			job_queue = build_job_queue(false, false);
+			slurmctld_diag_stats.schedule_queue_len =
+				list_count(job_queue);
+			sort_job_queue(job_queue);
+		}
 	}
 	while (1) {
 		if (fifo_sched) {
@@ -981,7 +1882,7 @@ extern int schedule(uint32_t job_limit)
 			if (!avail_front_end(job_ptr)) {
 				job_ptr->state_reason = WAIT_FRONT_END;
 				xfree(job_ptr->state_desc);
-				last_job_update = now;
+				last_job_update = job_ptr->last_update = now;
 				continue;
 			}
 			if (!_job_runnable_test1(job_ptr, false))
@@ -1007,16 +1908,23 @@ next_part:			part_ptr = (struct part_record *)
 			}
 		} else {
 			// Gonzalo: get the job to be scheduled.
-			job_queue_rec = list_pop(job_queue);
-			if (!job_queue_rec)
-				break;
-			job_ptr  = job_queue_rec->job_ptr;
-			part_ptr = job_queue_rec->part_ptr;
-			xfree(job_queue_rec);
+			if (prio_queue) {
+				if (!prio_queue_iter_next(&job_ptr, &part_ptr))
+					break;
+				if (!_job_runnable_test3(job_ptr, part_ptr))
+					continue;
+			} else {
+				job_queue_rec = list_pop(job_queue);
+				if (!job_queue_rec)
+					break;
+				job_ptr  = job_queue_rec->job_ptr;
+				part_ptr = job_queue_rec->part_ptr;
+				xfree(job_queue_rec);
+			}
 			if (!avail_front_end(job_ptr)) {
 				job_ptr->state_reason = WAIT_FRONT_END;
 				xfree(job_ptr->state_desc);
-				last_job_update = now;
+				last_job_update = job_ptr->last_update = now;
 				continue;
 			}
 			if (!IS_JOB_PENDING(job_ptr))
@@ -1111,7 +2019,7 @@ next_part:			part_ptr = (struct part_record *)
 			    (job_ptr->state_reason == WAIT_NO_REASON)) {
 				job_ptr->state_reason = WAIT_PRIORITY;
 				xfree(job_ptr->state_desc);
-				last_job_update = now;
+				last_job_update = job_ptr->last_update = now;
 			}
 			debug("sched: JobId=%u. State=PENDING. "
 			       "Reason=%s(Priority), Priority=%u, "
@@ -1138,7 +2046,7 @@ next_part:			part_ptr = (struct part_record *)
 				job_ptr->state_reason = WAIT_NO_REASON;
 				xfree(job_ptr->state_desc);
 				job_ptr->assoc_id = assoc_rec.id;
-				last_job_update = now;
+				last_job_update = job_ptr->last_update = now;
 			} else {
 				debug("sched: JobId=%u has invalid association",
 				      job_ptr->job_id);
@@ -1159,12 +2067,12 @@ next_part:			part_ptr = (struct part_record *)
 				      job_ptr->job_id);
 				xfree(job_ptr->state_desc);
 				job_ptr->state_reason = FAIL_QOS;
-				last_job_update = now;
+				last_job_update = job_ptr->last_update = now;
 				continue;
 			} else if (job_ptr->state_reason == FAIL_QOS) {
 				xfree(job_ptr->state_desc);
 				job_ptr->state_reason = WAIT_NO_REASON;
-				last_job_update = now;
+				last_job_update = job_ptr->last_update = now;
 			}
 		}
 
@@ -1192,7 +2100,7 @@ next_part:			part_ptr = (struct part_record *)
 			 * reserved for jobs in higher priority partition */
 			job_ptr->state_reason = WAIT_RESOURCES;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
 			debug3("sched: JobId=%u. State=%s. Reason=%s. "
 			       "Priority=%u. Partition=%s.",
 			       job_ptr->job_id,
@@ -1206,7 +2114,7 @@ next_part:			part_ptr = (struct part_record *)
 		if (license_job_test(job_ptr, time(NULL)) != SLURM_SUCCESS) {
 			job_ptr->state_reason = WAIT_LICENSES;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
 			debug3("sched: JobId=%u. State=%s. Reason=%s. "
 			       "Priority=%u.",
 			       job_ptr->job_id,
@@ -1225,13 +2133,20 @@ next_part:			part_ptr = (struct part_record *)
 			 * very rare. */
 			info("sched: JobId=%u has invalid account",
 			     job_ptr->job_id);
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
 			job_ptr->state_reason = FAIL_ACCOUNT;
 			xfree(job_ptr->state_desc);
 			continue;
 		}
 		// Gonzalo: Test if job can run (if free resources)
-		error_code = select_nodes(job_ptr, false, NULL);
+		if (plan && !_sched_plan_test(plan, plan_cnt, job_ptr)) {
+			/* Found unable to start by _sched_plan() */
+			job_ptr->state_reason = WAIT_RESOURCES;
+			xfree(job_ptr->state_desc);
+			error_code = ESLURM_NODES_BUSY;
+		} else {
+			error_code = select_nodes(job_ptr, false, NULL);
+		}
 		if (error_code == ESLURM_NODES_BUSY) {
 			debug3("sched: JobId=%u. State=%s. Reason=%s. "
 			       "Priority=%u. Partition=%s.",
@@ -1259,10 +2174,8 @@ next_part:			part_ptr = (struct part_record *)
 				/* Do not schedule more jobs on nodes required
 				 * by this job, but don't block the entire
 				 * queue/partition. */
-				bit_not(job_ptr->details->req_node_bitmap);
-				bit_and(avail_node_bitmap,
-					job_ptr->details->req_node_bitmap);
-				bit_not(job_ptr->details->req_node_bitmap);
+				bit_and_not(avail_node_bitmap,
+					    job_ptr->details->req_node_bitmap);
 			}
 #endif
 
@@ -1282,10 +2195,8 @@ next_part:			part_ptr = (struct part_record *)
 				 * or on nodes in this partition */
 				failed_parts[failed_part_cnt++] =
 						job_ptr->part_ptr;
-				bit_not(job_ptr->part_ptr->node_bitmap);
-				bit_and(avail_node_bitmap,
-					job_ptr->part_ptr->node_bitmap);
-				bit_not(job_ptr->part_ptr->node_bitmap);
+				bit_and_not(avail_node_bitmap,
+					    job_ptr->part_ptr->node_bitmap);
 			}
 		} else if (error_code == ESLURM_RESERVATION_NOT_USABLE) {
 			if (job_ptr->resv_ptr &&
@@ -1297,10 +2208,8 @@ next_part:			part_ptr = (struct part_record *)
 				       job_reason_string(job_ptr->
 							 state_reason),
 				       job_ptr->priority);
-				bit_not(job_ptr->resv_ptr->node_bitmap);
-				bit_and(avail_node_bitmap,
-					job_ptr->resv_ptr->node_bitmap);
-				bit_not(job_ptr->resv_ptr->node_bitmap);
+				bit_and_not(avail_node_bitmap,
+					    job_ptr->resv_ptr->node_bitmap);
 			} else {
 				/* The job has no reservation but requires
 				 * nodes that are currently in some reservation
@@ -1315,7 +2224,7 @@ next_part:			part_ptr = (struct part_record *)
 		} else if (error_code == SLURM_SUCCESS) {
 			/* job initiated */
 			debug3("sched: JobId=%u initiated", job_ptr->job_id);
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
 #ifdef HAVE_BG
 			select_g_select_jobinfo_get(job_ptr->select_jobinfo,
 						    SELECT_JOBDATA_IONODES,
@@ -1363,7 +2272,7 @@ next_part:			part_ptr = (struct part_record *)
 			info("sched: schedule: JobId=%u non-runnable: %s",
 			     job_ptr->job_id, slurm_strerror(error_code));
 			if (!wiki_sched) {
-				last_job_update = now;
+				last_job_update = job_ptr->last_update = now;
 				job_ptr->job_state = JOB_PENDING;
 				job_ptr->state_reason = FAIL_BAD_CONSTRAINTS;
 				xfree(job_ptr->state_desc);
@@ -1390,8 +2299,11 @@ next_part:			part_ptr = (struct part_record *)
 			list_iterator_destroy(job_iterator);
 		if (part_iterator)
 			list_iterator_destroy(part_iterator);
-	} else if (job_queue) {
-		FREE_NULL_LIST(job_queue);
+	} else {
+		if (prio_queue)
+			prio_queue_iter_end();
+		else
+			FREE_NULL_LIST(job_queue);
 #ifdef WF_API
 		if (wf_backfill_sched) {
 			compress_workflows();
@@ -1400,6 +2312,7 @@ next_part:			part_ptr = (struct part_record *)
 	}
 	xfree(sched_part_ptr);
 	xfree(sched_part_jobs);
+	xfree(plan);
 	unlock_slurmctld(job_write_lock);
 	END_TIMER2("schedule");
 
@@ -1611,6 +2524,14 @@ extern void launch_job(struct job_record *job_ptr)
 		protocol_version = node_ptr->protocol_version;
 #endif
 
+#ifdef SLURM_SIMULATOR
+	if (sim_nodes_enabled()) {
+		/* No batch script, environment or credential is needed */
+		sim_nodes_launch_job(job_ptr->job_id);
+		return;
+	}
+#endif
+
 	launch_msg_ptr = build_launch_job_msg(job_ptr, protocol_version);
 	if (launch_msg_ptr == NULL)
 		return;
@@ -1974,10 +2895,15 @@ extern int test_job_dependency(struct job_record *job_ptr)
 		}
 	}
 	list_iterator_destroy(depend_iter);
-	if (rebuild_str)
+	if (rebuild_str) {
 		_depend_list2str(job_ptr);
-	if (list_count(job_ptr->details->depend_list) == 0)
+		job_ptr->last_update = now;
+	}
+	if ((list_count(job_ptr->details->depend_list) == 0) &&
+	    job_ptr->details->dependency) {
 		xfree(job_ptr->details->dependency);
+		job_ptr->last_update = now;
+	}
 
 	if (failure)
 		results = 2;
@@ -2398,11 +3324,8 @@ extern int job_start_data(job_desc_msg_t *job_desc_msg,
 	if (job_req_node_filter(job_ptr, avail_bitmap))
 		rc = ESLURM_REQUESTED_PART_CONFIG_UNAVAILABLE;
 	if (job_ptr->details->exc_node_bitmap) {
-		bitstr_t *exc_node_mask = NULL;
-		exc_node_mask = bit_copy(job_ptr->details->exc_node_bitmap);
-		bit_not(exc_node_mask);
-		bit_and(avail_bitmap, exc_node_mask);
-		FREE_NULL_BITMAP(exc_node_mask);
+		bit_and_not(avail_bitmap,
+			    job_ptr->details->exc_node_bitmap);
 	}
 	if (job_ptr->details->req_node_bitmap) {
 		if (!bit_super_set(job_ptr->details->req_node_bitmap,
@@ -97,6 +97,22 @@ extern bool job_is_completing(void);
 extern int job_start_data(job_desc_msg_t *job_desc_msg,
 			  will_run_response_msg_t **resp);
 
+/*
+ * job_test_start - test when a job may start in a partition on the nodes
+ *	of avail, from now on
+ * IN mode - SELECT_MODE_WILL_RUN: the job's partition, start time and CPU
+ *	count are restored, so only read locks are needed.
+ *	SELECT_MODE_RUN_NOW: on success the job is left in the partition with
+ *	its resources selected, for select_g_job_begin().
+ * OUT start_time - when the job may start, no sooner than now
+ * OUT sel_bitmap - nodes the job would use, on success
+ * RET SLURM_SUCCESS or an error code
+ */
+extern int job_test_start(struct job_record *job_ptr,
+			  struct part_record *part_ptr, bitstr_t *avail,
+			  uint16_t mode, time_t now, time_t *start_time,
+			  bitstr_t **sel_bitmap);
+
 /*
  * launch_job - send an RPC to a slurmd to initiate a batch job
  * IN job_ptr - pointer to job that will be initiated
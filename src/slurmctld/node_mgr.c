@@ -3063,7 +3063,7 @@ void make_node_idle(struct node_record *node_ptr,
 	xassert(node_ptr);
 	if (node_bitmap && (bit_test(node_bitmap, inx))) {
 		/* Not a replay */
-		last_job_update = now;
+		last_job_update = job_ptr->last_update = now;
 		bit_clear(node_bitmap, inx);
 
 		job_update_cpu_cnt(job_ptr, inx);
@@ -87,6 +87,10 @@
 #include "src/slurmctld/sched_plugin.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/slurmctld_plugstack.h"
+#ifdef SLURM_SIMULATOR
+#include "src/slurmctld/sim_nodes.h"
+#include "src/slurmctld/sim_trace.h"
+#endif
 
 #define MAX_FEATURES  32	/* max exclusive features "[fs1|fs2]"=2 */
 #define MAX_RETRIES   10
@@ -1226,10 +1230,8 @@ _pick_best_nodes(struct node_set *node_set_ptr, int node_set_size,
 					bit_and(node_set_ptr[i].my_bitmap,
 						share_node_bitmap);
 #ifndef HAVE_BG
-					bit_not(cg_node_bitmap);
-					bit_and(node_set_ptr[i].my_bitmap,
-						cg_node_bitmap);
-					bit_not(cg_node_bitmap);
+					bit_and_not(node_set_ptr[i].my_bitmap,
+						    cg_node_bitmap);
 #endif
 				} else {
 					bit_and(node_set_ptr[i].my_bitmap,
@@ -1238,10 +1240,8 @@ _pick_best_nodes(struct node_set *node_set_ptr, int node_set_size,
 				}
 			} else {
 #ifndef HAVE_BG
-				bit_not(cg_node_bitmap);
-				bit_and(node_set_ptr[i].my_bitmap,
-					cg_node_bitmap);
-				bit_not(cg_node_bitmap);
+				bit_and_not(node_set_ptr[i].my_bitmap,
+					    cg_node_bitmap);
 #endif
 			}
 			if (!nodes_busy) {
@@ -1575,7 +1575,7 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 		     job_ptr->part_ptr, qos_ptr)) != SLURM_SUCCESS) {
 		xfree(job_ptr->state_desc);
 		job_ptr->state_reason = WAIT_QOS;
-		last_job_update = now;
+		last_job_update = job_ptr->last_update = now;
 		return ESLURM_REQUESTED_PART_CONFIG_UNAVAILABLE;
 	}
 
@@ -1587,7 +1587,7 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 	    != SLURM_SUCCESS) {
 		xfree(job_ptr->state_desc);
 		job_ptr->state_reason = WAIT_ACCOUNT;
-		last_job_update = now;
+		last_job_update = job_ptr->last_update = now;
 		return ESLURM_REQUESTED_PART_CONFIG_UNAVAILABLE;
 	}
 
@@ -1731,7 +1731,7 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 			       job_ptr->job_id);
 			job_ptr->state_reason = WAIT_PART_NODE_LIMIT;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
 
 		/* Non-fatal errors for job below */
 		} else if (error_code == ESLURM_NODE_NOT_AVAIL) {
@@ -1740,7 +1740,7 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 			       job_ptr->job_id);
 			job_ptr->state_reason = WAIT_NODE_NOT_AVAIL;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
 		} else if (error_code == ESLURM_RESERVATION_NOT_USABLE) {
 			job_ptr->state_reason = WAIT_RESERVATION;
 			xfree(job_ptr->state_desc);
@@ -1833,6 +1833,9 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 
 	slurmctld_diag_stats.jobs_started++;
 	acct_policy_job_begin(job_ptr);
+#ifdef SLURM_SIMULATOR
+	sim_trace_job(SIM_TRACE_START, job_ptr);
+#endif
 
 	/* Update the job_record's gres and gres_alloc fields with
 	 * strings representing the amount of each GRES type requested
@@ -2065,7 +2068,7 @@ static bool _valid_feature_counts(struct job_details *detail_ptr,
 	struct feature_record *job_feat_ptr;
 	struct features_record *feat_ptr;
 	int have_count = false, last_op = FEATURE_OP_AND;
-	bitstr_t *feature_bitmap, *tmp_bitmap;
+	bitstr_t *feature_bitmap;
 	bool rc = true;
 
 	xassert(detail_ptr);
@@ -2117,11 +2120,9 @@ static bool _valid_feature_counts(struct job_details *detail_ptr,
 				rc = false;
 				break;
 			}
-			tmp_bitmap = bit_copy(feature_bitmap);
-			bit_and(tmp_bitmap, feat_ptr->node_bitmap);
-			if (bit_set_count(tmp_bitmap) < job_feat_ptr->count)
+			if (bit_overlap(feature_bitmap, feat_ptr->node_bitmap) <
+			    job_feat_ptr->count)
 				rc = false;
-			FREE_NULL_BITMAP(tmp_bitmap);
 			if (!rc)
 				break;
 		}
@@ -2308,9 +2309,8 @@ static int _build_node_list(struct job_record *job_ptr,
 	node_set_ptr[node_set_inx+1].my_bitmap = NULL;
 	if (detail_ptr->exc_node_bitmap) {
 		if (usable_node_mask) {
-			bit_not(detail_ptr->exc_node_bitmap);
-			bit_and(usable_node_mask, detail_ptr->exc_node_bitmap);
-			bit_not(detail_ptr->exc_node_bitmap);
+			bit_and_not(usable_node_mask,
+				    detail_ptr->exc_node_bitmap);
 		} else {
 			usable_node_mask =
 				bit_copy(detail_ptr->exc_node_bitmap);
@@ -2848,6 +2848,10 @@ extern void re_kill_job(struct job_record *job_ptr)
 #ifndef SLURM_SIMULATOR
 	agent_queue_request(agent_args);
 #else
+	if (sim_nodes_enabled()) {
+		agent_queue_request(agent_args);
+		return;
+	}
 
         {
                 slurm_msg_t msg, resp;
@@ -0,0 +1,515 @@
+/*****************************************************************************\
+ *  prio_queue.c - persistent priority queues of pending jobs
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <time.h>
+
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/timers.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/job_scheduler.h"
+#include "src/slurmctld/preempt.h"
+#include "src/slurmctld/prio_queue.h"
+#include "src/slurmctld/slurmctld.h"
+
+typedef struct prio_queue_part prio_queue_part_t;
+
+/* A pending job in one of its partitions */
+typedef struct prio_queue_rec {
+	job_queue_rec_t rec;		/* as built by build_job_queue(),
+					 * job_ptr NULL once job removed */
+	bool has_resv;			/* job had a reservation */
+	prio_queue_part_t *queue;	/* queue of rec.part_ptr */
+	int heap_inx;			/* position in queue->heap */
+	uint32_t pass;			/* last pass returning it */
+	struct prio_queue_rec *job_next; /* next entry of the same job */
+} prio_queue_rec_t;
+
+/* Heap of the pending jobs of one partition */
+struct prio_queue_part {
+	struct part_record *part_ptr;
+	prio_queue_rec_t **heap;
+	int cnt;
+	int size;
+	prio_queue_part_t *next;
+};
+
+static prio_queue_part_t *queues = NULL;
+static bool queues_built = false;
+static time_t queues_build_time = 0;
+static time_t queues_part_update = 0;
+static time_t queues_conf_update = 0;
+static bool preemption_enabled = false;
+static int rec_cnt = 0;
+
+/* State of the pass in progress. The heaps do not change during a pass,
+ * so that the frontier of their next entries remains valid. */
+static bool iterating = false;
+static uint32_t iter_pass = 0;
+static prio_queue_rec_t **frontier = NULL;	/* heap of next entries */
+static int frontier_cnt = 0, frontier_size = 0;
+static uint32_t *deferred = NULL;	/* jobs to update after the pass */
+static int deferred_cnt = 0, deferred_size = 0;
+static bool dead_recs = false;		/* entries of removed jobs left */
+
+/* Same order as sort_job_queue2(), from the values at queueing time */
+static int _rec_cmp(prio_queue_rec_t *rec1, prio_queue_rec_t *rec2)
+{
+	job_queue_rec_t *job_rec1 = &rec1->rec;
+	job_queue_rec_t *job_rec2 = &rec2->rec;
+	uint32_t p1, p2;
+
+	if (preemption_enabled && job_rec1->job_ptr && job_rec2->job_ptr) {
+		if (slurm_job_preempt_check(job_rec1, job_rec2))
+			return -1;
+		if (slurm_job_preempt_check(job_rec2, job_rec1))
+			return 1;
+	}
+
+	if (rec1->has_resv && !rec2->has_resv)
+		return -1;
+	if (!rec1->has_resv && rec2->has_resv)
+		return 1;
+
+	p1 = job_rec1->part_ptr->priority;
+	p2 = job_rec2->part_ptr->priority;
+	if (p1 < p2)
+		return 1;
+	if (p1 > p2)
+		return -1;
+
+	if (job_rec1->priority < job_rec2->priority)
+		return 1;
+	if (job_rec1->priority > job_rec2->priority)
+		return -1;
+
+	if (job_rec1->job_id > job_rec2->job_id)
+		return 1;
+	if (job_rec1->job_id < job_rec2->job_id)
+		return -1;
+	return 0;
+}
+
+/* Heap operations, track set to maintain the entries' heap_inx */
+static void _sift_up(prio_queue_rec_t **heap, int inx, bool track)
+{
+	prio_queue_rec_t *rec = heap[inx];
+	int parent;
+
+	while (inx > 0) {
+		parent = (inx - 1) / 2;
+		if (_rec_cmp(rec, heap[parent]) >= 0)
+			break;
+		heap[inx] = heap[parent];
+		if (track)
+			heap[inx]->heap_inx = inx;
+		inx = parent;
+	}
+	heap[inx] = rec;
+	if (track)
+		rec->heap_inx = inx;
+}
+
+static void _sift_down(prio_queue_rec_t **heap, int cnt, int inx, bool track)
+{
+	prio_queue_rec_t *rec = heap[inx];
+	int child;
+
+	while ((child = (2 * inx) + 1) < cnt) {
+		if (((child + 1) < cnt) &&
+		    (_rec_cmp(heap[child + 1], heap[child]) < 0))
+			child++;
+		if (_rec_cmp(heap[child], rec) >= 0)
+			break;
+		heap[inx] = heap[child];
+		if (track)
+			heap[inx]->heap_inx = inx;
+		inx = child;
+	}
+	heap[inx] = rec;
+	if (track)
+		rec->heap_inx = inx;
+}
+
+static prio_queue_part_t *_find_queue(struct part_record *part_ptr)
+{
+	prio_queue_part_t *queue;
+
+	for (queue = queues; queue; queue = queue->next) {
+		if (queue->part_ptr == part_ptr)
+			return queue;
+	}
+	queue = xmalloc(sizeof(prio_queue_part_t));
+	queue->part_ptr = part_ptr;
+	queue->next = queues;
+	queues = queue;
+	return queue;
+}
+
+static void _rec_add(struct job_record *job_ptr, struct part_record *part_ptr,
+		     uint32_t priority)
+{
+	prio_queue_part_t *queue = _find_queue(part_ptr);
+	prio_queue_rec_t *rec;
+
+	rec = xmalloc(sizeof(prio_queue_rec_t));
+	rec->rec.job_id   = job_ptr->job_id;
+	rec->rec.job_ptr  = job_ptr;
+	rec->rec.part_ptr = part_ptr;
+	rec->rec.priority = priority;
+	rec->has_resv = (job_ptr->resv_id != 0);
+	rec->queue = queue;
+	rec->job_next = job_ptr->prio_queue_rec;
+	job_ptr->prio_queue_rec = rec;
+
+	if (queue->cnt >= queue->size) {
+		queue->size = MAX(queue->size * 2, 64);
+		xrealloc(queue->heap, sizeof(prio_queue_rec_t *) * queue->size);
+	}
+	queue->heap[queue->cnt++] = rec;
+	_sift_up(queue->heap, queue->cnt - 1, true);
+	rec_cnt++;
+}
+
+static void _rec_del(prio_queue_rec_t *rec)
+{
+	prio_queue_part_t *queue = rec->queue;
+	prio_queue_rec_t *moved;
+	int inx = rec->heap_inx;
+
+	queue->cnt--;
+	if (inx != queue->cnt) {
+		moved = queue->heap[queue->cnt];
+		queue->heap[inx] = moved;
+		moved->heap_inx = inx;
+		_sift_down(queue->heap, queue->cnt, inx, true);
+		_sift_up(queue->heap, moved->heap_inx, true);
+	}
+	xfree(rec);
+	rec_cnt--;
+}
+
+/* Return the priority of a job in one of its partitions */
+static uint32_t _job_part_prio(struct job_record *job_ptr,
+			       struct part_record *part_ptr)
+{
+	ListIterator part_iterator;
+	struct part_record *tmp_part_ptr;
+	uint32_t priority = job_ptr->priority;
+	int inx = 0;
+
+	if (!job_ptr->part_ptr_list || !job_ptr->priority_array)
+		return priority;
+	part_iterator = list_iterator_create(job_ptr->part_ptr_list);
+	while ((tmp_part_ptr = (struct part_record *)
+				list_next(part_iterator))) {
+		if (tmp_part_ptr == part_ptr) {
+			priority = job_ptr->priority_array[inx];
+			break;
+		}
+		inx++;
+	}
+	list_iterator_destroy(part_iterator);
+	return priority;
+}
+
+static void _job_add(struct job_record *job_ptr)
+{
+	ListIterator part_iterator;
+	struct part_record *part_ptr;
+	int inx = 0;
+
+	if (!IS_JOB_PENDING(job_ptr) || (job_ptr->priority == 0))
+		return;
+	if (job_ptr->part_ptr_list) {
+		part_iterator = list_iterator_create(job_ptr->part_ptr_list);
+		while ((part_ptr = (struct part_record *)
+				   list_next(part_iterator))) {
+			if (job_ptr->priority_array) {
+				_rec_add(job_ptr, part_ptr,
+					 job_ptr->priority_array[inx]);
+			} else {
+				_rec_add(job_ptr, part_ptr, job_ptr->priority);
+			}
+			inx++;
+		}
+		list_iterator_destroy(part_iterator);
+	} else if (job_ptr->part_ptr) {
+		_rec_add(job_ptr, job_ptr->part_ptr, job_ptr->priority);
+	}
+}
+
+static void _job_del(struct job_record *job_ptr)
+{
+	prio_queue_rec_t *rec, *next;
+
+	for (rec = job_ptr->prio_queue_rec; rec; rec = next) {
+		next = rec->job_next;
+		_rec_del(rec);
+	}
+	job_ptr->prio_queue_rec = NULL;
+}
+
+static void _defer(uint32_t job_id)
+{
+	if (deferred_cnt >= deferred_size) {
+		deferred_size = MAX(deferred_size * 2, 64);
+		xrealloc(deferred, sizeof(uint32_t) * deferred_size);
+	}
+	deferred[deferred_cnt++] = job_id;
+}
+
+static void _frontier_push(prio_queue_rec_t *rec)
+{
+	if (frontier_cnt >= frontier_size) {
+		frontier_size = MAX(frontier_size * 2, 64);
+		xrealloc(frontier, sizeof(prio_queue_rec_t *) * frontier_size);
+	}
+	frontier[frontier_cnt++] = rec;
+	_sift_up(frontier, frontier_cnt - 1, false);
+}
+
+/* Free the entries of the jobs removed during a pass */
+static void _sweep_dead(void)
+{
+	prio_queue_part_t *queue;
+	prio_queue_rec_t *rec;
+	int i, j;
+
+	for (queue = queues; queue; queue = queue->next) {
+		for (i = 0, j = 0; i < queue->cnt; i++) {
+			rec = queue->heap[i];
+			if (!rec->rec.job_ptr) {
+				xfree(rec);
+				rec_cnt--;
+				continue;
+			}
+			rec->heap_inx = j;
+			queue->heap[j++] = rec;
+		}
+		if (j == queue->cnt)
+			continue;
+		queue->cnt = j;
+		for (i = (queue->cnt / 2) - 1; i >= 0; i--)
+			_sift_down(queue->heap, queue->cnt, i, true);
+	}
+	dead_recs = false;
+}
+
+/* Return true if the queues are kept, dropping them if their partition
+ * records may be gone */
+static bool _queues_current(void)
+{
+	if (!queues_built)
+		return false;
+	if (queues_part_update != last_part_update) {
+		prio_queue_clear();
+		return false;
+	}
+	return true;
+}
+
+static void _queues_build(void)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	DEF_TIMERS;
+
+	START_TIMER;
+	prio_queue_clear();
+	preemption_enabled = slurm_preemption_enabled();
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator)))
+		_job_add(job_ptr);
+	list_iterator_destroy(job_iterator);
+
+	queues_built = true;
+	queues_build_time  = time(NULL);
+	queues_part_update = last_part_update;
+	queues_conf_update = slurmctld_conf.last_update;
+	END_TIMER2("prio_queue_build");
+	debug("sched: priority queues built with %d jobs/partitions %s",
+	      rec_cnt, TIME_STR);
+}
+
+extern void prio_queue_clear(void)
+{
+	prio_queue_part_t *queue, *next;
+	prio_queue_rec_t *rec;
+	int i;
+
+	for (queue = queues; queue; queue = next) {
+		next = queue->next;
+		for (i = 0; i < queue->cnt; i++) {
+			rec = queue->heap[i];
+			if (rec->rec.job_ptr)
+				rec->rec.job_ptr->prio_queue_rec = NULL;
+			xfree(rec);
+		}
+		xfree(queue->heap);
+		xfree(queue);
+	}
+	queues = NULL;
+	queues_built = false;
+	rec_cnt = 0;
+	frontier_cnt = 0;
+	deferred_cnt = 0;
+	dead_recs = false;
+}
+
+extern int prio_queue_count(void)
+{
+	return rec_cnt;
+}
+
+extern void prio_queue_iter_start(void)
+{
+	prio_queue_part_t *queue;
+
+	if (!queues_built ||
+	    (queues_part_update != last_part_update) ||
+	    (queues_conf_update != slurmctld_conf.last_update) ||
+	    (difftime(time(NULL), queues_build_time) >=
+	     PRIO_QUEUE_REBUILD_TIME))
+		_queues_build();
+
+	iterating = true;
+	iter_pass++;
+	frontier_cnt = 0;
+	for (queue = queues; queue; queue = queue->next) {
+		if (queue->cnt)
+			_frontier_push(queue->heap[0]);
+	}
+}
+
+extern bool prio_queue_iter_next(struct job_record **job_pptr,
+				 struct part_record **part_pptr)
+{
+	prio_queue_rec_t *rec, *job_rec;
+	struct job_record *job_ptr;
+	bool first;
+	int i;
+
+	while (frontier_cnt > 0) {
+		rec = frontier[0];
+		frontier[0] = frontier[--frontier_cnt];
+		if (frontier_cnt)
+			_sift_down(frontier, frontier_cnt, 0, false);
+		for (i = (2 * rec->heap_inx) + 1;
+		     (i <= (2 * rec->heap_inx) + 2) && (i < rec->queue->cnt);
+		     i++)
+			_frontier_push(rec->queue->heap[i]);
+
+		job_ptr = rec->rec.job_ptr;
+		if (!job_ptr)
+			continue;	/* removed during the pass */
+		if (!IS_JOB_PENDING(job_ptr) || (job_ptr->priority == 0)) {
+			_defer(job_ptr->job_id);	/* drop it */
+			continue;
+		}
+		if ((rec->has_resv != (job_ptr->resv_id != 0)) ||
+		    (rec->rec.priority !=
+		     _job_part_prio(job_ptr, rec->rec.part_ptr))) {
+			/* Changed behind our back, queue it right for the
+			 * next pass */
+			_defer(job_ptr->job_id);
+		}
+
+		first = true;
+		for (job_rec = job_ptr->prio_queue_rec; job_rec;
+		     job_rec = job_rec->job_next) {
+			if (job_rec->pass == iter_pass)
+				first = false;
+		}
+		if (first)
+			job_ptr->preempt_in_progress = false;
+		rec->pass = iter_pass;
+
+		*job_pptr  = job_ptr;
+		*part_pptr = rec->rec.part_ptr;
+		return true;
+	}
+	return false;
+}
+
+extern void prio_queue_iter_end(void)
+{
+	struct job_record *job_ptr;
+	int i;
+
+	iterating = false;
+	frontier_cnt = 0;
+	if (dead_recs)
+		_sweep_dead();
+	for (i = 0; i < deferred_cnt; i++) {
+		if ((job_ptr = find_job_record(deferred[i])))
+			prio_queue_job_update(job_ptr);
+	}
+	deferred_cnt = 0;
+}
+
+extern void prio_queue_job_update(struct job_record *job_ptr)
+{
+	if (!_queues_current())
+		return;
+	if (iterating) {
+		_defer(job_ptr->job_id);
+		return;
+	}
+	_job_del(job_ptr);
+	_job_add(job_ptr);
+}
+
+extern void prio_queue_job_remove(struct job_record *job_ptr)
+{
+	prio_queue_rec_t *rec;
+
+	if (!_queues_current())
+		return;
+	if (iterating) {
+		for (rec = job_ptr->prio_queue_rec; rec; rec = rec->job_next) {
+			rec->rec.job_ptr = NULL;
+			dead_recs = true;
+		}
+		job_ptr->prio_queue_rec = NULL;
+		return;
+	}
+	_job_del(job_ptr);
+}
@@ -0,0 +1,94 @@
+/*****************************************************************************\
+ *  prio_queue.h - persistent priority queues of pending jobs
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifndef _HAVE_PRIO_QUEUE_H
+#define _HAVE_PRIO_QUEUE_H
+
+#include "src/slurmctld/slurmctld.h"
+
+/*
+ * With SchedulerParameters=prio_queue, schedule() no longer builds and sorts
+ * a queue of every pending job on each pass. Each partition instead keeps an
+ * indexed binary heap of its pending jobs, in sort_job_queue2() order, which
+ * is updated as jobs are submitted, requeued, released or have their
+ * priority, partition or reservation changed. A pass merges the heaps lazily
+ * and so only pays for the jobs it actually reaches. The runnable tests of
+ * build_job_queue() still apply to each job as it is reached.
+ *
+ * The queues are only kept while enabled, from the first pass on, and are
+ * rebuilt from job_list after a partition or configuration change and every
+ * PRIO_QUEUE_REBUILD_TIME seconds, which also catches jobs changed outside
+ * of the update hooks.
+ *
+ * All functions must be called with the job write lock set.
+ */
+#define PRIO_QUEUE_REBUILD_TIME	600
+
+/* Drop the queues, until the next prio_queue_iter_start() */
+extern void prio_queue_clear(void);
+
+/* Return the count of job/partition pairs queued */
+extern int prio_queue_count(void);
+
+/*
+ * Start a pass over the queued job/partition pairs in priority order,
+ * building the queues first if needed. Also call with the partition read
+ * lock set.
+ */
+extern void prio_queue_iter_start(void);
+
+/*
+ * Get the next job/partition pair of the pass, skipping jobs no longer
+ * pending or held. Clears the job's preempt_in_progress flag the first time
+ * the job is returned in the pass.
+ * RET false once all have been returned
+ */
+extern bool prio_queue_iter_next(struct job_record **job_pptr,
+				 struct part_record **part_pptr);
+
+/* End the pass, applying the updates deferred during it */
+extern void prio_queue_iter_end(void);
+
+/*
+ * Queue a job again after a change of state, priority, partition or
+ * reservation, in each of its partitions if pending and not held
+ */
+extern void prio_queue_job_update(struct job_record *job_ptr);
+
+/* Remove a job from the queues before its record is freed */
+extern void prio_queue_job_remove(struct job_record *job_ptr);
+
+#endif /* !_HAVE_PRIO_QUEUE_H */
@@ -77,6 +77,7 @@
 #include "src/common/slurm_protocol_interface.h"
 
 #include "src/slurmctld/agent.h"
+#include "src/slurmctld/dry_run.h"
 #include "src/slurmctld/front_end.h"
 #include "src/slurmctld/gang.h"
 #include "src/slurmctld/job_scheduler.h"
@@ -96,13 +97,34 @@
 
 #ifdef SLURM_SIMULATOR
 #include <semaphore.h>
+#include "src/common/sim_event_queue.h"
+#include "src/common/sim_sync.h"
+#include "src/slurmctld/sim_nodes.h"
 #endif
 
 static pthread_mutex_t throttle_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t throttle_cond = PTHREAD_COND_INITIALIZER;
 
+#ifdef SLURM_SIMULATOR
+/* Jobs completed in the current simulator helper cycle and the count of
+ * MESSAGE_EPILOG_COMPLETE RPCs still expected for each (one per node, or one
+ * per front end). The cycle may not advance simulated time until the list
+ * is empty. Epilogs of other jobs (time limits, cancellations) are not
+ * waited for and do not count. */
+typedef struct sim_epilog_rec {
+	uint32_t job_id;
+	uint32_t pending;
+} sim_epilog_rec_t;
+static pthread_mutex_t sim_epilog_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_epilog_cond = PTHREAD_COND_INITIALIZER;
+static List sim_epilog_list = NULL;
+#endif
+
 static void         _fill_ctld_conf(slurm_ctl_conf_t * build_ptr);
 static void         _kill_job_on_msg_fail(uint32_t job_id);
+static void         _log_batch_step(struct job_record *job_ptr,
+				    jobacctinfo_t *jobacct, uint32_t job_rc,
+				    char *nodes);
 static int          _is_prolog_finished(uint32_t job_id);
 static int 	    _launch_batch_step(job_desc_msg_t *job_desc_msg,
 				       uid_t uid, uint32_t *step_id,
@@ -112,6 +134,12 @@ static int          _make_step_cred(struct step_record *step_rec,
 				    uint16_t protocol_version);
 static void         _throttle_fini(int *active_rpc_cnt);
 static void         _throttle_start(int *active_rpc_cnt);
+#ifdef SLURM_SIMULATOR
+static void         _sim_epilog_done(uint32_t job_id);
+static void         _sim_epilog_expect(uint32_t job_id);
+static void         _sim_epilog_rec_del(void *x);
+static void         _sim_epilog_wait(void);
+#endif
 
 inline static void  _slurm_rpc_accounting_first_reg(slurm_msg_t *msg);
 inline static void  _slurm_rpc_accounting_register_ctld(slurm_msg_t *msg);
@@ -124,6 +152,7 @@ inline static void  _slurm_rpc_delete_partition(slurm_msg_t * msg);
 inline static void  _slurm_rpc_complete_job_allocation(slurm_msg_t * msg);
 inline static void  _slurm_rpc_complete_batch_script(slurm_msg_t * msg);
 inline static void  _slurm_rpc_complete_prolog(slurm_msg_t * msg);
+inline static void  _slurm_rpc_dry_run(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_conf(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_front_end(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_jobs(slurm_msg_t * msg);
@@ -164,6 +193,8 @@ inline static void  _slurm_rpc_shutdown_controller(slurm_msg_t * msg);
 inline static void  _slurm_rpc_shutdown_controller_immediate(slurm_msg_t *
 							     msg);
 inline static void  _slurm_rpc_sim_helper_cycle(slurm_msg_t * msg);
+inline static void  _slurm_rpc_sim_helper_cycle_jobs(slurm_msg_t * msg);
+inline static void  _slurm_rpc_sim_job(slurm_msg_t * msg);
 inline static void  _slurm_rpc_step_complete(slurm_msg_t * msg);
 inline static void  _slurm_rpc_step_layout(slurm_msg_t * msg);
 inline static void  _slurm_rpc_step_update(slurm_msg_t * msg);
@@ -246,6 +277,10 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 		_slurm_rpc_get_priority_factors(msg);
 		slurm_free_priority_factors_request_msg(msg->data);
 		break;
+	case REQUEST_DRY_RUN:
+		_slurm_rpc_dry_run(msg);
+		slurm_free_dry_run_msg(msg->data);
+		break;
 	case REQUEST_JOB_END_TIME:
 		_slurm_rpc_end_time(msg);
 		slurm_free_job_alloc_info_msg(msg->data);
@@ -307,6 +342,14 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
                _slurm_rpc_sim_helper_cycle(msg);
                slurm_free_sim_helper_msg(msg->data);
                break;
+	case MESSAGE_SIM_HELPER_CYCLE_JOBS:
+		_slurm_rpc_sim_helper_cycle_jobs(msg);
+		slurm_free_sim_helper_jobs_msg(msg->data);
+		break;
+	case REQUEST_SIM_JOB:
+		_slurm_rpc_sim_job(msg);
+		slurm_free_sim_job_msg(msg->data);
+		break;
 	case REQUEST_JOB_ALLOCATION_INFO:
 		_slurm_rpc_job_alloc_info(msg);
 		slurm_free_job_alloc_info_msg(msg->data);
@@ -529,6 +572,103 @@ static void _throttle_fini(int *active_rpc_cnt)
 	slurm_mutex_unlock(&throttle_mutex);
 }
 
+#ifdef SLURM_SIMULATOR
+static void _sim_epilog_rec_del(void *x)
+{
+	sim_epilog_rec_t *epilog_ptr = (sim_epilog_rec_t *) x;
+
+	xfree(epilog_ptr);
+}
+
+static int _find_sim_epilog(void *x, void *key)
+{
+	sim_epilog_rec_t *epilog_ptr = (sim_epilog_rec_t *) x;
+	uint32_t *job_id = (uint32_t *) key;
+
+	if (epilog_ptr->job_id == *job_id)
+		return 1;
+	return 0;
+}
+
+/* Note the MESSAGE_EPILOG_COMPLETE RPCs that will follow for a job completed
+ * during the current simulator helper cycle, one for each node it is still
+ * completing on. Call with the job write lock held, right after
+ * job_complete() queued the job's termination. */
+static void _sim_epilog_expect(uint32_t job_id)
+{
+	struct job_record *job_ptr = find_job_record(job_id);
+	sim_epilog_rec_t *epilog_ptr;
+	uint32_t pending;
+
+	if (!job_ptr || !IS_JOB_COMPLETING(job_ptr))
+		return;		/* No epilog to wait for */
+#ifdef HAVE_FRONT_END
+	pending = 1;
+#else
+	pending = job_ptr->node_cnt;
+#endif
+	if (pending == 0)
+		return;
+
+	slurm_mutex_lock(&sim_epilog_mutex);
+	if (!sim_epilog_list)
+		sim_epilog_list = list_create(_sim_epilog_rec_del);
+	epilog_ptr = list_find_first(sim_epilog_list, _find_sim_epilog,
+				     &job_id);
+	if (!epilog_ptr) {
+		epilog_ptr = xmalloc(sizeof(sim_epilog_rec_t));
+		epilog_ptr->job_id = job_id;
+		list_append(sim_epilog_list, epilog_ptr);
+	}
+	epilog_ptr->pending += pending;
+	slurm_mutex_unlock(&sim_epilog_mutex);
+}
+
+/* Note that a MESSAGE_EPILOG_COMPLETE RPC has been processed for a job,
+ * waking up the simulator helper cycle once the last one it waits for is in.
+ * Epilogs of jobs the cycle did not complete are ignored. */
+static void _sim_epilog_done(uint32_t job_id)
+{
+	sim_epilog_rec_t *epilog_ptr;
+
+	slurm_mutex_lock(&sim_epilog_mutex);
+	if (sim_epilog_list &&
+	    (epilog_ptr = list_find_first(sim_epilog_list, _find_sim_epilog,
+					  &job_id))) {
+		if (--epilog_ptr->pending == 0) {
+			list_delete_all(sim_epilog_list, _find_sim_epilog,
+					&job_id);
+		}
+		if (list_count(sim_epilog_list) == 0)
+			pthread_cond_broadcast(&sim_epilog_cond);
+	}
+	slurm_mutex_unlock(&sim_epilog_mutex);
+}
+
+/* Block until every expected MESSAGE_EPILOG_COMPLETE RPC has been processed.
+ * The MessageTimeout bound only protects against an epilog message lost on
+ * the way, it plays no part in normal synchronization. */
+static void _sim_epilog_wait(void)
+{
+	int msg_timeout = slurm_get_msg_timeout();
+	struct timespec ts;
+
+	slurm_mutex_lock(&sim_epilog_mutex);
+	while (sim_epilog_list && list_count(sim_epilog_list)) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += msg_timeout;
+		if (pthread_cond_timedwait(&sim_epilog_cond, &sim_epilog_mutex,
+					   &ts) == ETIMEDOUT) {
+			error("SIM: epilog complete RPCs of %d jobs still "
+			      "missing after %d seconds, advancing anyway",
+			      list_count(sim_epilog_list), msg_timeout);
+			list_flush(sim_epilog_list);
+		}
+	}
+	slurm_mutex_unlock(&sim_epilog_mutex);
+}
+#endif
+
 /*
  * _fill_ctld_conf - make a copy of current slurm configuration
  *	this is done with locks set so the data can change at other times
@@ -1034,6 +1174,46 @@ static void _slurm_rpc_allocate_resources(slurm_msg_t * msg)
 	xfree(err_msg);
 }
 
+/* _slurm_rpc_dry_run - process RPC to project the start times of the
+ *	pending jobs on a snapshot of the controller, see dry_run.h */
+static void _slurm_rpc_dry_run(slurm_msg_t * msg)
+{
+	DEF_TIMERS;
+	dry_run_msg_t *req_msg = (dry_run_msg_t *) msg->data;
+	dry_run_response_msg_t *resp_msg = NULL;
+	slurm_msg_t response_msg;
+	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
+	int rc;
+
+	START_TIMER;
+	debug2("Processing RPC: REQUEST_DRY_RUN from uid=%u", uid);
+	if (!validate_slurm_user(uid)) {
+		error("Security violation, REQUEST_DRY_RUN RPC from uid=%u",
+		      uid);
+		slurm_send_rc_msg(msg, ESLURM_USER_ID_MISSING);
+		return;
+	}
+
+	rc = dry_run_project(req_msg, &resp_msg);
+	END_TIMER2("_slurm_rpc_dry_run");
+	if (rc != SLURM_SUCCESS) {
+		info("_slurm_rpc_dry_run: %s", slurm_strerror(rc));
+		slurm_send_rc_msg(msg, rc);
+		return;
+	}
+
+	debug2("_slurm_rpc_dry_run: %u jobs projected %s",
+	       resp_msg->job_cnt, TIME_STR);
+	slurm_msg_t_init(&response_msg);
+	response_msg.flags = msg->flags;
+	response_msg.protocol_version = msg->protocol_version;
+	response_msg.address  = msg->address;
+	response_msg.msg_type = RESPONSE_DRY_RUN;
+	response_msg.data     = resp_msg;
+	slurm_send_node_msg(msg->conn_fd, &response_msg);
+	slurm_free_dry_run_response_msg(resp_msg);
+}
+
 /* _slurm_rpc_dump_conf - process RPC for Slurm configuration information */
 static void _slurm_rpc_dump_conf(slurm_msg_t * msg)
 {
@@ -1088,6 +1268,7 @@ static void _slurm_rpc_dump_jobs(slurm_msg_t * msg)
 	slurmctld_lock_t job_read_lock = {
 		READ_LOCK, READ_LOCK, NO_LOCK, WRITE_LOCK };
 	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
+	bool delta = (job_info_request_msg->show_flags & SHOW_DELTA);
 
 	START_TIMER;
 	debug3("Processing RPC: REQUEST_JOB_INFO from uid=%d", uid);
@@ -1098,10 +1279,20 @@ static void _slurm_rpc_dump_jobs(slurm_msg_t * msg)
 		debug3("_slurm_rpc_dump_jobs, no change");
 		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
 	} else {
-		pack_all_jobs(&dump, &dump_size,
-			      job_info_request_msg->show_flags,
-			      g_slurm_auth_get_uid(msg->auth_cred, NULL),
-			      NO_VAL, msg->protocol_version);
+		if (delta) {
+			pack_job_delta(&dump, &dump_size,
+				       job_info_request_msg->show_flags,
+				       g_slurm_auth_get_uid(msg->auth_cred,
+							    NULL),
+				       job_info_request_msg->last_update,
+				       msg->protocol_version);
+		} else {
+			pack_all_jobs(&dump, &dump_size,
+				      job_info_request_msg->show_flags,
+				      g_slurm_auth_get_uid(msg->auth_cred,
+							   NULL),
+				      NO_VAL, msg->protocol_version);
+		}
 		unlock_slurmctld(job_read_lock);
 		END_TIMER2("_slurm_rpc_dump_jobs");
 #if 0
@@ -1113,7 +1304,10 @@ static void _slurm_rpc_dump_jobs(slurm_msg_t * msg)
 		response_msg.flags = msg->flags;
 		response_msg.protocol_version = msg->protocol_version;
 		response_msg.address = msg->address;
-		response_msg.msg_type = RESPONSE_JOB_INFO;
+		if (delta)
+			response_msg.msg_type = RESPONSE_JOB_INFO_DELTA;
+		else
+			response_msg.msg_type = RESPONSE_JOB_INFO;
 		response_msg.data = dump;
 		response_msg.data_size = dump_size;
 
@@ -1547,6 +1741,9 @@ static void  _slurm_rpc_epilog_complete(slurm_msg_t * msg)
 				epilog_msg->return_code))
 		run_scheduler = true;
 	unlock_slurmctld(job_write_lock);
+#ifdef SLURM_SIMULATOR
+	_sim_epilog_done(epilog_msg->job_id);
+#endif
 	END_TIMER2("_slurm_rpc_epilog_complete");
 
 	if (epilog_msg->return_code)
@@ -1756,11 +1953,34 @@ static void _slurm_rpc_complete_prolog(slurm_msg_t * msg)
 	}
 }
 
+/* _log_batch_step - record the batch step of a completing job in
+ *	accounting, the step having no record of its own in slurmctld */
+static void _log_batch_step(struct job_record *job_ptr,
+			    jobacctinfo_t *jobacct, uint32_t job_rc,
+			    char *nodes)
+{
+	struct step_record batch_step;
+
+	memset(&batch_step, 0, sizeof(struct step_record));
+	batch_step.job_ptr = job_ptr;
+	batch_step.step_id = SLURM_BATCH_SCRIPT;
+	batch_step.jobacct = jobacct;
+	batch_step.exit_code = job_rc;
+	batch_step.gres = nodes;
+	node_name2bitmap(batch_step.gres, false,
+			 &batch_step.step_node_bitmap);
+	batch_step.requid = -1;
+	batch_step.start_time = job_ptr->start_time;
+	batch_step.name = "batch";
+	batch_step.select_jobinfo = job_ptr->select_jobinfo;
+
+	jobacct_storage_g_step_start(acct_db_conn, &batch_step);
+	jobacct_storage_g_step_complete(acct_db_conn, &batch_step);
+	FREE_NULL_BITMAP(batch_step.step_node_bitmap);
+}
+
 /* _slurm_rpc_complete_batch - process RPC from slurmstepd to note the
  *	completion of a batch script */
-
-int finished_jobs_waiting_for_epilog=0;
-
 static void _slurm_rpc_complete_batch_script(slurm_msg_t * msg)
 {
 	static int active_rpc_cnt = 0;
@@ -1828,26 +2048,11 @@ static void _slurm_rpc_complete_batch_script(slurm_msg_t * msg)
 	 */
 	if (association_based_accounting && job_ptr
 	    && (job_ptr->job_state != JOB_PENDING)) {
-		struct step_record batch_step;
-		memset(&batch_step, 0, sizeof(struct step_record));
-		batch_step.job_ptr = job_ptr;
-		batch_step.step_id = SLURM_BATCH_SCRIPT;
-		batch_step.jobacct = comp_msg->jobacct;
-		batch_step.exit_code = comp_msg->job_rc;
 #ifdef HAVE_FRONT_END
 		nodes = job_ptr->nodes;
 #endif
-		batch_step.gres = nodes;
-		node_name2bitmap(batch_step.gres, false,
-				 &batch_step.step_node_bitmap);
-		batch_step.requid = -1;
-		batch_step.start_time = job_ptr->start_time;
-		batch_step.name = "batch";
-		batch_step.select_jobinfo = job_ptr->select_jobinfo;
-
-		jobacct_storage_g_step_start(acct_db_conn, &batch_step);
-		jobacct_storage_g_step_complete(acct_db_conn, &batch_step);
-		FREE_NULL_BITMAP(batch_step.step_node_bitmap);
+		_log_batch_step(job_ptr, comp_msg->jobacct, comp_msg->job_rc,
+				nodes);
 	}
 
 #ifdef HAVE_FRONT_END
@@ -1931,9 +2136,15 @@ static void _slurm_rpc_complete_batch_script(slurm_msg_t * msg)
 	/* Mark job allocation complete */
 	if (msg->msg_type == REQUEST_COMPLETE_BATCH_JOB)
 		job_epilog_complete(comp_msg->job_id, comp_msg->node_name, 0);
-	finished_jobs_waiting_for_epilog+=1;
 	i = job_complete(comp_msg->job_id, uid, job_requeue, false,
 			 comp_msg->job_rc);
+#ifdef SLURM_SIMULATOR
+	/* The terminate request queued by job_complete() comes back as an
+	 * epilog complete RPC, which needs the job write lock still held
+	 * here, so it can not be counted down before this increment. */
+	if (i == SLURM_SUCCESS)
+		_sim_epilog_expect(comp_msg->job_id);
+#endif
 	error_code = MAX(error_code, i);
 	unlock_slurmctld(job_write_lock);
 	_throttle_fini(&active_rpc_cnt);
@@ -4834,23 +5045,19 @@ _slurm_rpc_dump_licenses(slurm_msg_t * msg)
 
 
 
-char BF_SEM_NAME[] = "bf_sem";
-char BF_DONE_SEM_NAME[] = "bf_done_sem";
 sem_t* mutex_bf=NULL;
 sem_t* mutex_bf_done=NULL;
 
 int open_BF_sync_semaphore() {
-	mutex_bf = sem_open(BF_SEM_NAME, O_CREAT, 0644, 0);
+	mutex_bf = sim_sync_sem_open(SIM_SYNC_BF_SEM);
 	if(mutex_bf == SEM_FAILED) {
 		error("unable to create backfill semaphore");
-		sem_unlink(BF_SEM_NAME);
 		return -1;
 	}
 
-	mutex_bf_done = sem_open(BF_DONE_SEM_NAME, O_CREAT, 0644, 0);
+	mutex_bf_done = sim_sync_sem_open(SIM_SYNC_BF_DONE_SEM);
 	if(mutex_bf_done == SEM_FAILED) {
 		error("unable to create backfill done semaphore");
-		sem_unlink(BF_DONE_SEM_NAME);
 		return -1;
 	}
 
@@ -4875,35 +5082,153 @@ static void do_backfill() {
 	sem_wait(mutex_bf_done);
 }
 
+/* Run the schedulers due in this simulator helper cycle, once the epilogs of
+ * the jobs ended in it have been processed */
+static void _sim_helper_cycle(void)
+{
+	time_t current_time;
+
+	if (mutex_bf == NULL) {
+		if (open_BF_sync_semaphore() == -1) {
+			error("Opening backfill semaphore! this may affect "
+			      "backfill operations");
+		}
+	}
+	/* Epilogs of jobs terminated on simulated nodes are run here
+	 * rather than from their termination, which holds the job lock */
+	(void) sim_nodes_epilog_run(_sim_epilog_done);
+
+	/* Do not let the scheduler see nodes of the jobs ended in
+	 * this cycle until their epilogs have been processed */
+	_sim_epilog_wait();
+
+	current_time = time(NULL);
+	if (last_helper_schedule_time == 0 ||
+	    (current_time - last_helper_schedule_time) >
+	    HELPER_SCHEDULE_PERIOD_S) {
+		schedule(0);
+		last_helper_schedule_time = current_time;
+	}
+	if (last_helper_backfill_time == 0 ||
+	    (current_time - last_helper_backfill_time) >
+	    HELPER_BACKFILL_PERIOD_S) {
+		do_backfill();
+		last_helper_backfill_time = current_time;
+	}
+
+	/* Both timers fire once strictly more than their period elapsed */
+	sim_sync_set_next(SIM_SYNC_NEXT_SCHEDULE, last_helper_schedule_time +
+			  HELPER_SCHEDULE_PERIOD_S + 1);
+	sim_sync_set_next(SIM_SYNC_NEXT_BACKFILL, last_helper_backfill_time +
+			  HELPER_BACKFILL_PERIOD_S + 1);
+}
+
 static void _slurm_rpc_sim_helper_cycle(slurm_msg_t * msg)
 {
-		if (mutex_bf==NULL) {
-			if(open_BF_sync_semaphore()==-1) {
-				error("Opening backfill semaphore! this may affect backfill"
-					"operations");
-			}
+	sim_helper_msg_t *helper_msg = (sim_helper_msg_t *) msg->data;
+
+	info("Processing RPC: MESSAGE_SIM_HELPER_CYCLE for %d jobs",
+	     helper_msg->total_jobs_ended);
+	_sim_helper_cycle();
+
+	slurm_send_rc_msg(msg, SLURM_SUCCESS);
+}
+
+/*
+ * sim_helper_cycle_jobs - complete every batch job ended during a simulator
+ *	helper cycle under a single job write lock, then run the cycle itself.
+ *	Equivalent to one REQUEST_COMPLETE_BATCH_SCRIPT per job followed by
+ *	MESSAGE_SIM_HELPER_CYCLE.
+ * IN job_ids - ids of the jobs whose batch script ended
+ * IN job_cnt - count of entries in job_ids
+ * IN uid - user completing the jobs
+ */
+extern void sim_helper_cycle_jobs(uint32_t *job_ids, uint32_t job_cnt,
+				  uid_t uid)
+{
+	DEF_TIMERS;
+	/* Locks: Write job, write node */
+	slurmctld_lock_t job_write_lock = {
+		NO_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK };
+	struct job_record *job_ptr;
+	char *nodes;
+	uint32_t i, job_id, jobs_completed = 0;
+	int rc;
+
+	START_TIMER;
+	lock_slurmctld(job_write_lock);
+	for (i = 0; i < job_cnt; i++) {
+		job_id = job_ids[i];
+		job_ptr = find_job_record(job_id);
+		if (association_based_accounting && job_ptr &&
+		    (job_ptr->job_state != JOB_PENDING)) {
+			nodes = NULL;
+#ifdef HAVE_FRONT_END
+			nodes = job_ptr->nodes;
+#endif
+			_log_batch_step(job_ptr, NULL, 0, nodes);
 		}
-		if (finished_jobs_waiting_for_epilog > 0) {
-			usleep(finished_jobs_waiting_for_epilog*500000);
-			finished_jobs_waiting_for_epilog=0;
+		rc = job_complete(job_id, uid, false, false, 0);
+		if (rc == SLURM_SUCCESS) {
+			/* See _slurm_rpc_complete_batch_script() */
+			_sim_epilog_expect(job_id);
+			jobs_completed++;
+		} else if ((rc != ESLURM_ALREADY_DONE) &&
+			   (rc != ESLURM_INVALID_JOB_ID)) {
+			error("sim_helper_cycle_jobs JobId=%u: %s",
+			      job_id, slurm_strerror(rc));
 		}
+	}
+	unlock_slurmctld(job_write_lock);
+	slurmctld_diag_stats.jobs_completed += jobs_completed;
+	END_TIMER2("sim_helper_cycle_jobs");
+	debug2("sim_helper_cycle_jobs completed %u of %u jobs %s",
+	       jobs_completed, job_cnt, TIME_STR);
+
+	if (jobs_completed)
+		(void) schedule_job_save();	/* Has own locking */
+
+	_sim_helper_cycle();
+}
+
+static void _slurm_rpc_sim_helper_cycle_jobs(slurm_msg_t * msg)
+{
+	sim_helper_jobs_msg_t *helper_msg =
+		(sim_helper_jobs_msg_t *) msg->data;
+	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
+
+	debug2("Processing RPC: MESSAGE_SIM_HELPER_CYCLE_JOBS from uid=%u "
+	       "for %u jobs", uid, helper_msg->total_jobs_ended);
+	if (!validate_slurm_user(uid)) {
+		error("Security violation, SIM_HELPER_CYCLE_JOBS RPC "
+		      "from uid=%u", uid);
+		slurm_send_rc_msg(msg, ESLURM_USER_ID_MISSING);
+		return;
+	}
+
+	sim_helper_cycle_jobs(helper_msg->job_ids,
+			      helper_msg->total_jobs_ended, uid);
 
-        sim_helper_msg_t *helper_msg =
-                (sim_helper_msg_t *) msg->data;
-
-        info("Processing RPC: MESSAGE_SIM_HELPER_CYCLE for %d jobs",
-        		helper_msg->total_jobs_ended);
-        time_t current_time=time(NULL);
-        if (last_helper_schedule_time==0 ||
-           (current_time-last_helper_schedule_time)>HELPER_SCHEDULE_PERIOD_S) {
-        	schedule(0);
-        	last_helper_schedule_time=current_time;
-        }
-        if (last_helper_backfill_time==0 ||
-        	(current_time-last_helper_backfill_time)>HELPER_BACKFILL_PERIOD_S) {
-        	do_backfill();
-        	last_helper_backfill_time=current_time;
-        }
-
-        slurm_send_rc_msg(msg, SLURM_SUCCESS);
+	slurm_send_rc_msg(msg, SLURM_SUCCESS);
+}
+
+/* _slurm_rpc_sim_job - record the simulated run time of a job, sent by the
+ *	simulator manager when the compute nodes are simulated in-process */
+static void _slurm_rpc_sim_job(slurm_msg_t * msg)
+{
+	sim_job_msg_t *sim_job = (sim_job_msg_t *) msg->data;
+	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
+	int rc;
+
+	debug2("Processing RPC: REQUEST_SIM_JOB for job %u duration %u",
+	       sim_job->job_id, sim_job->duration);
+	if (!validate_slurm_user(uid)) {
+		error("Security violation, REQUEST_SIM_JOB RPC from uid=%u",
+		      uid);
+		slurm_send_rc_msg(msg, ESLURM_USER_ID_MISSING);
+		return;
+	}
+
+	rc = sim_event_set_duration(sim_job->job_id, sim_job->duration);
+	slurm_send_rc_msg(msg, rc);
 }
@@ -85,5 +85,18 @@ extern int slurm_fail_job(uint32_t job_id, uint16_t job_state);
  * strings in the array */
 extern char **xduparray(uint32_t size, char ** array);
 
+#ifdef SLURM_SIMULATOR
+/*
+ * sim_helper_cycle_jobs - complete every batch job ended during a simulator
+ *	helper cycle, then run the schedulers due in the cycle
+ * IN job_ids - ids of the jobs whose batch script ended
+ * IN job_cnt - count of entries in job_ids
+ * IN uid - user completing the jobs
+ * NOTE: Sets its own locks.
+ */
+extern void sim_helper_cycle_jobs(uint32_t *job_ids, uint32_t job_cnt,
+				  uid_t uid);
+#endif
+
 #endif /* !_HAVE_PROC_REQ_H */
 
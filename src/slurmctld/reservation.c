@@ -2963,16 +2963,14 @@ static int  _resize_resv(slurmctld_resv_t *resv_ptr, uint32_t node_cnt)
 			if (i > delta_node_cnt) {
 				tmp2_bitmap = bit_pick_cnt(tmp1_bitmap,
 							   delta_node_cnt);
-				bit_not(tmp2_bitmap);
-				bit_and(resv_ptr->node_bitmap, tmp2_bitmap);
+				bit_and_not(resv_ptr->node_bitmap,
+					    tmp2_bitmap);
 				FREE_NULL_BITMAP(tmp1_bitmap);
 				FREE_NULL_BITMAP(tmp2_bitmap);
 				delta_node_cnt = 0;	/* ALL DONE */
 			} else if (i) {
-				bit_not(idle_node_bitmap);
-				bit_and(resv_ptr->node_bitmap,
-					idle_node_bitmap);
-				bit_not(idle_node_bitmap);
+				bit_and_not(resv_ptr->node_bitmap,
+					    idle_node_bitmap);
 				resv_ptr->node_cnt = bit_set_count(
 						resv_ptr->node_bitmap);
 				delta_node_cnt = resv_ptr->node_cnt -
@@ -3067,9 +3065,7 @@ static int  _select_nodes(resv_desc_msg_t *resv_desc_ptr,
 				resv_ptr->full_nodes = 1;
 			}
 			if (resv_ptr->full_nodes) {
-				bit_not(resv_ptr->node_bitmap);
-				bit_and(node_bitmap, resv_ptr->node_bitmap);
-				bit_not(resv_ptr->node_bitmap);
+				bit_and_not(node_bitmap, resv_ptr->node_bitmap);
 			} else {
 				if (*core_bitmap == NULL)
 					_create_cluster_core_bitmap(core_bitmap);
@@ -3242,8 +3238,7 @@ static bitstr_t *_pick_idle_nodes(bitstr_t *avail_bitmap,
 			bit_or(ret_bitmap, tmp_bitmap);
 		else
 			ret_bitmap = bit_copy(tmp_bitmap);
-		bit_not(tmp_bitmap);
-		bit_and(avail_bitmap, tmp_bitmap);
+		bit_and_not(avail_bitmap, tmp_bitmap);
 		FREE_NULL_BITMAP(tmp_bitmap);
 	}
 
@@ -3368,9 +3363,7 @@ static bitstr_t *_pick_idle_node_cnt(bitstr_t *avail_bitmap,
 			continue;
 
 		if (!resv_desc_ptr->core_cnt) {
-			bit_not(job_ptr->node_bitmap);
-			bit_and(avail_bitmap, job_ptr->node_bitmap);
-			bit_not(job_ptr->node_bitmap);
+			bit_and_not(avail_bitmap, job_ptr->node_bitmap);
 		} else {
 			_check_job_compatibility(job_ptr, avail_bitmap,
 						 core_bitmap);
@@ -3802,9 +3795,7 @@ extern int job_test_resv(struct job_record *job_ptr, time_t *when,
 			    (res2_ptr->end_time   <= job_start_time) ||
 			    (!res2_ptr->full_nodes))
 				continue;
-			bit_not(res2_ptr->node_bitmap);
-			bit_and(*node_bitmap, res2_ptr->node_bitmap);
-			bit_not(res2_ptr->node_bitmap);
+			bit_and_not(*node_bitmap, res2_ptr->node_bitmap);
 		}
 		list_iterator_destroy(iter);
 
@@ -3870,9 +3861,8 @@ extern int job_test_resv(struct job_record *job_ptr, time_t *when,
 				     "will not share nodes",
 				     resv_ptr->name, job_ptr->job_id);
 #endif
-				bit_not(resv_ptr->node_bitmap);
-				bit_and(*node_bitmap, resv_ptr->node_bitmap);
-				bit_not(resv_ptr->node_bitmap);
+				bit_and_not(*node_bitmap,
+					    resv_ptr->node_bitmap);
 			} else {
 #if _DEBUG
 				info("job_test_resv: reservation %s uses "
@@ -3941,6 +3931,34 @@ extern time_t find_resv_end(time_t start_time)
 	return end_time;
 }
 
+/*
+ * Determine if job_test_resv() would advance the times of a daily or weekly
+ * reservation ended by some time, changing the reservation record
+ * IN when - time at which job_test_resv() may be called
+ * RET true if so
+ */
+extern bool resv_advance_due(time_t when)
+{
+	ListIterator iter;
+	slurmctld_resv_t *resv_ptr;
+	bool due = false;
+
+	if (!resv_list)
+		return due;
+
+	iter = list_iterator_create(resv_list);
+	while ((resv_ptr = (slurmctld_resv_t *) list_next(iter))) {
+		if ((resv_ptr->flags &
+		     (RESERVE_FLAG_DAILY | RESERVE_FLAG_WEEKLY)) &&
+		    (resv_ptr->end_time <= when)) {
+			due = true;
+			break;
+		}
+	}
+	list_iterator_destroy(iter);
+	return due;
+}
+
 /* Begin scan of all jobs for valid reservations */
 extern void begin_job_resv_check(void)
 {
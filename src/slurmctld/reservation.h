@@ -154,6 +154,14 @@ extern int job_test_resv(struct job_record *job_ptr, time_t *when,
  */
 extern time_t find_resv_end(time_t start_time);
 
+/*
+ * Determine if job_test_resv() would advance the times of a daily or weekly
+ * reservation ended by some time, changing the reservation record
+ * IN when - time at which job_test_resv() may be called
+ * RET true if so
+ */
+extern bool resv_advance_due(time_t when);
+
 /*
  * Determine if a job can start now based only upon its reservations
  *	specification, if any
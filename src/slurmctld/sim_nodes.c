@@ -0,0 +1,385 @@
+/*****************************************************************************\
+ *  sim_nodes.c - compute nodes simulated inside slurmctld
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#ifdef SLURM_SIMULATOR
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/hostlist.h"
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/pack.h"
+#include "src/common/read_config.h"
+#include "src/common/sim_event_queue.h"
+#include "src/common/sim_sync.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmctld/locks.h"
+#include "src/slurmctld/proc_req.h"
+#include "src/slurmctld/sim_nodes.h"
+#include "src/slurmctld/slurmctld.h"
+#include "src/slurmctld/state_save.h"
+
+typedef struct sim_epilog {
+	uint32_t job_id;
+	char *nodes;		/* nodes the job was terminated on */
+} sim_epilog_t;
+
+static pthread_mutex_t sim_nodes_mutex = PTHREAD_MUTEX_INITIALIZER;
+static List epilog_list = NULL;		/* sim_epilog_t, pending epilogs */
+static bool sim_nodes_stop = false;
+static pthread_t sim_nodes_thread = (pthread_t) 0;
+
+static void _epilog_free(void *x)
+{
+	sim_epilog_t *epilog = (sim_epilog_t *) x;
+
+	if (epilog) {
+		xfree(epilog->nodes);
+		xfree(epilog);
+	}
+}
+
+/* Build what slurmd would send to register name with its configured
+ * resources, config_ptr NULL for a front end node */
+static slurm_node_registration_status_msg_t *
+_build_reg_msg(char *name, struct config_record *config_ptr)
+{
+	slurm_node_registration_status_msg_t *reg_msg;
+
+	reg_msg = xmalloc(sizeof(slurm_node_registration_status_msg_t));
+	reg_msg->node_name = xstrdup(name);
+	reg_msg->version = xstrdup(SLURM_VERSION_STRING);
+	reg_msg->slurmd_start_time = time(NULL);
+	reg_msg->status = SLURM_SUCCESS;
+	reg_msg->hash_val = NO_VAL;
+	if (config_ptr) {
+		reg_msg->cpus = config_ptr->cpus;
+		reg_msg->boards = config_ptr->boards;
+		reg_msg->sockets = config_ptr->sockets;
+		reg_msg->cores = config_ptr->cores;
+		reg_msg->threads = config_ptr->threads;
+		reg_msg->real_memory = config_ptr->real_memory;
+		reg_msg->tmp_disk = config_ptr->tmp_disk;
+	}
+	/* No gres records */
+	reg_msg->gres_info = init_buf(16);
+	pack16(SLURM_PROTOCOL_VERSION, reg_msg->gres_info);
+	pack16(0, reg_msg->gres_info);
+	set_buf_offset(reg_msg->gres_info, 0);
+
+	return reg_msg;
+}
+
+/* See _slurm_rpc_node_registration() */
+static void _register_nodes(void)
+{
+	/* Locks: Read config, write job, write node */
+	slurmctld_lock_t job_write_lock = {
+		READ_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK };
+	slurm_node_registration_status_msg_t *reg_msg;
+	bool newly_up = false;
+	int i, rc;
+#ifdef HAVE_FRONT_END
+	front_end_record_t *front_end_ptr;
+#else
+	struct node_record *node_ptr;
+#endif
+
+	lock_slurmctld(job_write_lock);
+#ifdef HAVE_FRONT_END
+	for (i = 0, front_end_ptr = front_end_nodes; i < front_end_node_cnt;
+	     i++, front_end_ptr++) {
+		reg_msg = _build_reg_msg(front_end_ptr->name, NULL);
+		rc = validate_nodes_via_front_end(reg_msg,
+						  SLURM_PROTOCOL_VERSION,
+						  &newly_up);
+#else
+	for (i = 0, node_ptr = node_record_table_ptr; i < node_record_count;
+	     i++, node_ptr++) {
+		reg_msg = _build_reg_msg(node_ptr->name, node_ptr->config_ptr);
+		rc = validate_node_specs(reg_msg, SLURM_PROTOCOL_VERSION,
+					 &newly_up);
+#endif
+		if (rc) {
+			error("SIM: registration of node %s: %s",
+			      reg_msg->node_name, slurm_strerror(rc));
+		}
+		slurm_free_node_registration_status_msg(reg_msg);
+	}
+	unlock_slurmctld(job_write_lock);
+
+	if (newly_up)
+		queue_job_scheduler();
+}
+
+/* Stand-in for the slurmd simulator helper, one cycle per time step */
+static void *_sim_nodes_agent(void *args)
+{
+	uint32_t job_cnt, job_ids_size = 0;
+	uint32_t *job_ids = NULL;
+
+	info("SIM: in-process compute nodes starting");
+	while (!sim_nodes_stop) {
+		job_cnt = sim_event_pop_due(time(NULL), &job_ids,
+					    &job_ids_size);
+		sim_helper_cycle_jobs(job_ids, job_cnt,
+				      slurmctld_conf.slurm_user_id);
+
+		sim_sync_set_next(SIM_SYNC_NEXT_JOB_END, sim_event_next());
+		/* Keep the count of steps per simulated second: one for the
+		 * RPC service thread of the helper cycle and one for the
+		 * slurmd helper itself */
+		sim_sync_step(SIM_SYNC_SLURMCTLD);
+		sim_sync_step(SIM_SYNC_SLURMD);
+	}
+	info("SIM: in-process compute nodes finishing");
+
+	xfree(job_ids);
+	return NULL;
+}
+
+extern bool sim_nodes_enabled(void)
+{
+	static time_t config_update = 0;
+	static bool enabled = false;
+	char *sched_params;
+
+	if (config_update != slurmctld_conf.last_update) {
+		sched_params = slurm_get_sched_params();
+		enabled = (sched_params &&
+			   strstr(sched_params, "sim_local_nodes"));
+		xfree(sched_params);
+		config_update = slurmctld_conf.last_update;
+	}
+
+	return enabled;
+}
+
+extern int sim_nodes_start(void)
+{
+	pthread_attr_t thread_attr;
+
+	/* Stand in for slurmd in the synchronization segment as well */
+	sim_sync_attach(SIM_SYNC_SLURMD);
+	_register_nodes();
+
+	slurm_attr_init(&thread_attr);
+	if (pthread_attr_setdetachstate(&thread_attr,
+					PTHREAD_CREATE_DETACHED))
+		error("pthread_attr_setdetachstate error %m");
+	if (pthread_create(&sim_nodes_thread, &thread_attr,
+			   _sim_nodes_agent, NULL)) {
+		error("SIM: unable to start in-process nodes thread: %m");
+		slurm_attr_destroy(&thread_attr);
+		return SLURM_ERROR;
+	}
+	slurm_attr_destroy(&thread_attr);
+
+	return SLURM_SUCCESS;
+}
+
+extern void sim_nodes_fini(void)
+{
+	/* The thread is detached, it may be blocked in sim_sync_step() */
+	sim_nodes_stop = true;
+
+	slurm_mutex_lock(&sim_nodes_mutex);
+	if (epilog_list) {
+		list_destroy(epilog_list);
+		epilog_list = NULL;
+	}
+	slurm_mutex_unlock(&sim_nodes_mutex);
+}
+
+extern void sim_nodes_launch_job(uint32_t job_id)
+{
+	time_t when;
+
+	if (sim_event_add(job_id, time(NULL), &when) != SLURM_SUCCESS) {
+		info("SIM: No job_id event matching this job_id %u", job_id);
+		return;
+	}
+	debug3("SIM: Adding new event for job %u for future time %ld",
+	       job_id, when);
+	sim_sync_set_next(SIM_SYNC_NEXT_JOB_END, sim_event_next());
+}
+
+/* See simulator_rpc_terminate_job() in slurmd */
+static void _terminate_job(kill_job_msg_t *kill_job)
+{
+	sim_epilog_t *epilog;
+	bool requeue;
+
+	/* A requeued job is terminated in the PENDING state */
+	requeue = ((kill_job->job_state & JOB_STATE_BASE) == JOB_PENDING);
+	switch (sim_event_remove(kill_job->job_id, requeue)) {
+	case SIM_EVENT_NONE:
+		info("SIM: Error, no event found for completed job %u",
+		     kill_job->job_id);
+		return;
+	case SIM_EVENT_ENDED:
+		break;
+	default:
+		/* Cancelled or timed out before its batch script ended */
+		debug("SIM: job %u terminated before its end event",
+		      kill_job->job_id);
+		break;
+	}
+
+	/* The caller holds the job write lock, job_epilog_complete()
+	 * runs later from sim_nodes_epilog_run() */
+	epilog = xmalloc(sizeof(sim_epilog_t));
+	epilog->job_id = kill_job->job_id;
+	epilog->nodes = xstrdup(kill_job->nodes);
+	slurm_mutex_lock(&sim_nodes_mutex);
+	if (!epilog_list)
+		epilog_list = list_create(_epilog_free);
+	list_append(epilog_list, epilog);
+	slurm_mutex_unlock(&sim_nodes_mutex);
+}
+
+extern void sim_nodes_agent_request(agent_arg_t *agent_arg_ptr)
+{
+	switch (agent_arg_ptr->msg_type) {
+	case REQUEST_BATCH_JOB_LAUNCH:
+		sim_nodes_launch_job(((batch_job_launch_msg_t *)
+				      agent_arg_ptr->msg_args)->job_id);
+		break;
+	case REQUEST_KILL_TIMELIMIT:
+	case REQUEST_TERMINATE_JOB:
+		_terminate_job((kill_job_msg_t *) agent_arg_ptr->msg_args);
+		break;
+	default:
+		debug3("SIM: discarding %s to in-process nodes",
+		       rpc_num2string(agent_arg_ptr->msg_type));
+		break;
+	}
+}
+
+extern void sim_nodes_job_purged(struct job_record *job_ptr)
+{
+	agent_arg_t *agent_args;
+	kill_job_msg_t *kill_job;
+
+	if (sim_nodes_enabled()) {
+		(void) sim_event_remove(job_ptr->job_id, false);
+		return;
+	}
+
+	/* A job that ran lost its record when it was terminated */
+	if (job_ptr->node_bitmap || (node_record_count == 0))
+		return;
+
+	/* Every simulated node is served by the same slurmd. A termination
+	 * without nodes only drops the record, no epilog follows. */
+	agent_args = xmalloc(sizeof(agent_arg_t));
+	agent_args->msg_type = REQUEST_TERMINATE_JOB;
+	agent_args->retry = 0;
+	agent_args->protocol_version = SLURM_PROTOCOL_VERSION;
+#ifdef HAVE_FRONT_END
+	if (front_end_node_cnt)
+		agent_args->hostlist = hostlist_create(front_end_nodes[0].name);
+	else
+#endif
+	agent_args->hostlist = hostlist_create(node_record_table_ptr[0].name);
+	agent_args->node_count = 1;
+	kill_job = xmalloc(sizeof(kill_job_msg_t));
+	kill_job->job_id    = job_ptr->job_id;
+	kill_job->step_id   = NO_VAL;
+	kill_job->job_state = job_ptr->job_state;
+	kill_job->job_uid   = job_ptr->user_id;
+	kill_job->time      = time(NULL);
+	agent_args->msg_args = kill_job;
+	agent_queue_request(agent_args);
+}
+
+extern uint32_t sim_nodes_epilog_run(void (*epilog_done)(uint32_t job_id))
+{
+	/* Locks: Read configuration, write job, write node */
+	slurmctld_lock_t job_write_lock = {
+		READ_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK };
+	List run_list;
+	sim_epilog_t *epilog;
+	hostlist_t hl;
+	char *node_name;
+	uint32_t cnt = 0;
+
+	slurm_mutex_lock(&sim_nodes_mutex);
+	run_list = epilog_list;
+	epilog_list = NULL;
+	slurm_mutex_unlock(&sim_nodes_mutex);
+	if (!run_list)
+		return 0;
+
+	lock_slurmctld(job_write_lock);
+	while ((epilog = list_pop(run_list))) {
+		hl = hostlist_create(epilog->nodes);
+		while ((node_name = hostlist_shift(hl))) {
+			(void) job_epilog_complete(epilog->job_id, node_name,
+						   SLURM_SUCCESS);
+			if (epilog_done)
+				epilog_done(epilog->job_id);
+			free(node_name);
+#ifdef HAVE_FRONT_END
+			/* Just one epilog complete message is needed */
+			break;
+#endif
+		}
+		hostlist_destroy(hl);
+		_epilog_free(epilog);
+		cnt++;
+	}
+	unlock_slurmctld(job_write_lock);
+	list_destroy(run_list);
+
+	if (cnt) {
+		schedule_node_save();		/* Has own locking */
+		schedule_job_save();		/* Has own locking */
+	}
+
+	return cnt;
+}
+
+#endif	/* SLURM_SIMULATOR */
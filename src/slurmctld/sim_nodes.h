@@ -0,0 +1,88 @@
+/*****************************************************************************\
+ *  sim_nodes.h - compute nodes simulated inside slurmctld
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _HAVE_SIM_NODES_H
+#define _HAVE_SIM_NODES_H
+
+#include "src/slurmctld/agent.h"
+
+/*
+ * With SchedulerParameters=sim_local_nodes, the simulator runs without
+ * slurmd. slurmctld keeps the job end event queue itself: batch job launches
+ * and terminations become function calls instead of RPCs, and a thread of
+ * its own takes the place of the slurmd simulator helper. The simulator
+ * manager then sends REQUEST_SIM_JOB to slurmctld.
+ */
+
+/* Return true if the compute nodes are simulated in-process */
+extern bool sim_nodes_enabled(void);
+
+/*
+ * Register every node as a slurmd would and start the thread ending the
+ * simulated batch jobs
+ */
+extern int sim_nodes_start(void);
+
+/* Stop the thread ending the simulated batch jobs */
+extern void sim_nodes_fini(void);
+
+/* Queue the end event of a batch job launched now */
+extern void sim_nodes_launch_job(uint32_t job_id);
+
+/*
+ * Deliver an RPC meant for the compute nodes. Batch launches and job
+ * terminations are simulated, anything else is discarded.
+ * NOTE: agent_arg_ptr remains owned by the caller
+ */
+extern void sim_nodes_agent_request(agent_arg_t *agent_arg_ptr);
+
+/*
+ * Forget the simulated run time of a job whose record is being purged. Jobs
+ * that never ran (e.g. cancelled while pending) are never terminated on the
+ * nodes, so the end event queue would otherwise keep their duration forever.
+ * NOTE: Call with the job write lock held.
+ */
+extern void sim_nodes_job_purged(struct job_record *job_ptr);
+
+/*
+ * Run the epilogs of the jobs terminated since the last call
+ * IN epilog_done - if not NULL, called with the job ID for every epilog
+ *	complete message a slurmd would have sent
+ * RET count of jobs whose epilog completed
+ * NOTE: Sets its own locks, call without holding the job lock.
+ */
+extern uint32_t sim_nodes_epilog_run(void (*epilog_done)(uint32_t job_id));
+
+#endif /* !_HAVE_SIM_NODES_H */
@@ -0,0 +1,293 @@
+/*****************************************************************************\
+ *  sim_trace.c - binary trace of simulated job events
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#ifdef SLURM_SIMULATOR
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/fd.h"
+#include "src/common/log.h"
+#include "src/common/read_config.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmctld/locks.h"
+#include "src/slurmctld/sim_trace.h"
+#include "src/slurmctld/slurmctld.h"
+
+#define SIM_TRACE_PAD(len) \
+	(((len) + SIM_TRACE_ALIGN - 1) & ~(SIM_TRACE_ALIGN - 1))
+
+/* Records of one thread. Appending takes no lock, the buffer is only shared
+ * with other threads through the free list once its thread exits. */
+typedef struct trace_buf {
+	char *data;			/* SIM_TRACE_BUF_SIZE, on first use */
+	uint32_t used;
+	sim_trace_sched_t sched;
+	struct trace_buf *next_all;
+	struct trace_buf *next_free;
+} trace_buf_t;
+
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t trace_key;
+static bool trace_key_set = false;
+static trace_buf_t *all_bufs = NULL;	/* every buffer ever allocated */
+static trace_buf_t *free_bufs = NULL;	/* buffers of exited threads */
+static int trace_fd = -1;
+static uint64_t trace_seq = 0;
+
+static int _write_all(char *data, size_t len)
+{
+	ssize_t wrote;
+
+	while (len) {
+		wrote = write(trace_fd, data, len);
+		if (wrote < 0) {
+			if (errno == EINTR)
+				continue;
+			error("SIM: trace write: %m");
+			return SLURM_ERROR;
+		}
+		data += wrote;
+		len  -= wrote;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+/* The file is opened with O_APPEND, so a batch lands in one piece whatever
+ * the other threads write */
+static void _flush(trace_buf_t *buf)
+{
+	if (buf->used && (trace_fd >= 0))
+		(void) _write_all(buf->data, buf->used);
+	buf->used = 0;
+}
+
+/* pthread key destructor, hand the buffer of an exiting thread on */
+static void _release_buf(void *x)
+{
+	trace_buf_t *buf = (trace_buf_t *) x;
+
+	slurm_mutex_lock(&trace_mutex);
+	buf->next_free = free_bufs;
+	free_bufs = buf;
+	slurm_mutex_unlock(&trace_mutex);
+}
+
+static void _create_key(void)
+{
+	slurm_mutex_lock(&trace_mutex);
+	if (!trace_key_set) {
+		if (pthread_key_create(&trace_key, _release_buf))
+			fatal("SIM: pthread_key_create: %m");
+		trace_key_set = true;
+	}
+	slurm_mutex_unlock(&trace_mutex);
+}
+
+static trace_buf_t *_get_buf(void)
+{
+	trace_buf_t *buf;
+
+	if (!trace_key_set)
+		_create_key();
+	if ((buf = pthread_getspecific(trace_key)))
+		return buf;
+
+	slurm_mutex_lock(&trace_mutex);
+	if ((buf = free_bufs)) {
+		free_bufs = buf->next_free;
+	} else {
+		buf = xmalloc(sizeof(trace_buf_t));
+		buf->next_all = all_bufs;
+		all_bufs = buf;
+	}
+	slurm_mutex_unlock(&trace_mutex);
+
+	buf->next_free = NULL;
+	buf->sched = SIM_TRACE_SCHED_MAIN;
+	pthread_setspecific(trace_key, buf);
+
+	return buf;
+}
+
+extern int sim_trace_init(void)
+{
+	char *sched_params, *file_name;
+	sim_trace_hdr_t hdr;
+	struct stat stat_buf;
+	bool enabled;
+
+	if (trace_fd >= 0)
+		return SLURM_SUCCESS;
+
+	sched_params = slurm_get_sched_params();
+	enabled = (sched_params && strstr(sched_params, "sim_trace"));
+	xfree(sched_params);
+	if (!enabled)
+		return SLURM_SUCCESS;
+
+	_create_key();
+
+	file_name = slurm_get_state_save_location();
+	xstrcat(file_name, "/sim_trace");
+	trace_fd = open(file_name, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (trace_fd < 0) {
+		error("SIM: can't open trace file %s: %m", file_name);
+		xfree(file_name);
+		return SLURM_ERROR;
+	}
+	fd_set_close_on_exec(trace_fd);
+
+	/* A restarted slurmctld appends to the trace of its previous run */
+	if ((fstat(trace_fd, &stat_buf) == 0) && (stat_buf.st_size == 0)) {
+		memset(&hdr, 0, sizeof(sim_trace_hdr_t));
+		hdr.magic = SIM_TRACE_MAGIC;
+		hdr.version = SIM_TRACE_VERSION;
+		hdr.rec_size = sizeof(sim_trace_rec_t);
+		if (_write_all((char *) &hdr, sizeof(sim_trace_hdr_t))) {
+			(void) close(trace_fd);
+			trace_fd = -1;
+			xfree(file_name);
+			return SLURM_ERROR;
+		}
+	}
+	info("SIM: tracing job events to %s", file_name);
+	xfree(file_name);
+
+	return SLURM_SUCCESS;
+}
+
+extern void sim_trace_fini(void)
+{
+	/* Locks: Write job */
+	slurmctld_lock_t job_write_lock = {
+		NO_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK };
+	trace_buf_t *buf;
+
+	if (trace_fd < 0)
+		return;
+
+	/* Records are only appended with the job write lock held, so no
+	 * thread is using its buffer meanwhile */
+	lock_slurmctld(job_write_lock);
+	slurm_mutex_lock(&trace_mutex);
+	for (buf = all_bufs; buf; buf = buf->next_all)
+		_flush(buf);
+	slurm_mutex_unlock(&trace_mutex);
+	(void) close(trace_fd);
+	trace_fd = -1;
+	unlock_slurmctld(job_write_lock);
+}
+
+extern void sim_trace_job(sim_trace_event_t event,
+			  struct job_record *job_ptr)
+{
+	trace_buf_t *buf;
+	sim_trace_rec_t *rec;
+	char *nodes = NULL;
+	uint32_t nodes_len = 0, rec_len;
+
+	if (trace_fd < 0)
+		return;
+
+	buf = _get_buf();
+	if (!buf->data)
+		buf->data = xmalloc(SIM_TRACE_BUF_SIZE);
+
+	if ((event == SIM_TRACE_START) || (event == SIM_TRACE_REQUEUE) ||
+	    (event == SIM_TRACE_END)) {
+		nodes = job_ptr->nodes;
+		if (nodes)
+			nodes_len = strlen(nodes);
+	}
+	rec_len = sizeof(sim_trace_rec_t) + SIM_TRACE_PAD(nodes_len);
+	if (rec_len > (SIM_TRACE_BUF_SIZE - buf->used))
+		_flush(buf);
+	if (rec_len > SIM_TRACE_BUF_SIZE) {
+		error("SIM: trace record of job %u too long, node list lost",
+		      job_ptr->job_id);
+		nodes_len = 0;
+		rec_len = sizeof(sim_trace_rec_t);
+	}
+
+	rec = (sim_trace_rec_t *) (buf->data + buf->used);
+	memset(rec, 0, rec_len);
+	rec->seq = __sync_fetch_and_add(&trace_seq, 1);
+	rec->job_id = job_ptr->job_id;
+	rec->event = event;
+	rec->job_state = job_ptr->job_state;
+	rec->node_cnt = job_ptr->node_cnt;
+	rec->nodes_len = nodes_len;
+	switch (event) {
+	case SIM_TRACE_SUBMIT:
+		if (job_ptr->details)
+			rec->time = job_ptr->details->submit_time;
+		break;
+	case SIM_TRACE_ELIGIBLE:
+		if (job_ptr->details)
+			rec->time = job_ptr->details->begin_time;
+		break;
+	case SIM_TRACE_START:
+		rec->time = job_ptr->start_time;
+		rec->sched = buf->sched;
+		break;
+	default:
+		rec->time = job_ptr->end_time;
+		break;
+	}
+	if (nodes_len)
+		memcpy(rec + 1, nodes, nodes_len);
+	buf->used += rec_len;
+}
+
+extern void sim_trace_set_sched(sim_trace_sched_t sched)
+{
+	_get_buf()->sched = sched;
+}
+
+#endif	/* SLURM_SIMULATOR */
@@ -0,0 +1,116 @@
+/*****************************************************************************\
+ *  sim_trace.h - binary trace of simulated job events
+ *****************************************************************************
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifndef _HAVE_SIM_TRACE_H
+#define _HAVE_SIM_TRACE_H
+
+#include <stdint.h>
+
+#include "src/slurmctld/slurmctld.h"
+
+/*
+ * With SchedulerParameters=sim_trace, slurmctld appends a record for every
+ * job submission, eligibility, start, requeue and end to the file sim_trace
+ * in StateSaveLocation. Simulation results can then be read from it instead
+ * of the log files and the accounting database.
+ *
+ * The file holds a sim_trace_hdr_t then sim_trace_rec_t records, each one
+ * followed by its node list, padded to SIM_TRACE_ALIGN bytes. All values are
+ * in the byte order of slurmctld, as told by the magic number.
+ *
+ * Records are buffered per thread and written in batches, so the records of
+ * different threads interleave in the file by batch. Sort them on seq to get
+ * the order in which the events happened.
+ */
+#define SIM_TRACE_MAGIC		0x534c5452	/* "SLTR" */
+#define SIM_TRACE_VERSION	1
+#define SIM_TRACE_ALIGN		8
+#define SIM_TRACE_BUF_SIZE	(64 * 1024)
+
+typedef enum {
+	SIM_TRACE_SUBMIT,	/* time is the submit time */
+	SIM_TRACE_ELIGIBLE,	/* time is the begin time */
+	SIM_TRACE_START,	/* time is the start time, with node list */
+	SIM_TRACE_REQUEUE,	/* time is the end time, with node list */
+	SIM_TRACE_END		/* time is the end time, with node list */
+} sim_trace_event_t;
+
+typedef enum {
+	SIM_TRACE_SCHED_MAIN,		/* schedule() or at submission */
+	SIM_TRACE_SCHED_BACKFILL	/* backfill scheduler */
+} sim_trace_sched_t;
+
+typedef struct sim_trace_hdr {
+	uint32_t magic;		/* SIM_TRACE_MAGIC */
+	uint16_t version;	/* SIM_TRACE_VERSION */
+	uint16_t rec_size;	/* sizeof(sim_trace_rec_t) */
+} sim_trace_hdr_t;
+
+typedef struct sim_trace_rec {
+	uint64_t seq;		/* order of the event among all records */
+	int64_t  time;		/* simulated time of the event */
+	uint32_t job_id;
+	uint16_t event;		/* sim_trace_event_t */
+	uint16_t sched;		/* sim_trace_sched_t, for SIM_TRACE_START */
+	uint32_t job_state;	/* job state after the event */
+	uint32_t node_cnt;
+	uint32_t nodes_len;	/* length of the node list, without padding */
+	uint32_t reserved;
+} sim_trace_rec_t;
+
+/*
+ * Open the trace file if SchedulerParameters include sim_trace
+ * RET SLURM_SUCCESS, also if not configured, or SLURM_ERROR
+ */
+extern int sim_trace_init(void);
+
+/*
+ * Write out all buffered records and close the trace file
+ * NOTE: Sets its own locks, call without holding the job lock.
+ */
+extern void sim_trace_fini(void);
+
+/*
+ * Record an event of a job
+ * NOTE: Call with the job write lock held.
+ */
+extern void sim_trace_job(sim_trace_event_t event,
+			  struct job_record *job_ptr);
+
+/* Set which scheduler starts the jobs selected by the calling thread */
+extern void sim_trace_set_sched(sim_trace_sched_t sched);
+
+#endif /* !_HAVE_SIM_TRACE_H */
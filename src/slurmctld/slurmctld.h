@@ -555,6 +555,8 @@ struct job_record {
 	uint16_t job_state;		/* state of the job */
 	uint16_t kill_on_node_fail;	/* 1 if job should be killed on
 					 * node failure */
+	time_t last_update;		/* time of last update to the job
+					 * record, for SHOW_DELTA requests */
 	char *licenses;			/* licenses required by the job */
 	List license_list;		/* structure with license info */
 	uint16_t limit_set_max_cpus;	/* if max_cpus was set from
@@ -588,6 +590,8 @@ struct job_record {
 					 * for this job, used to insure
 					 * epilog is not re-run for job */
 	uint16_t other_port;		/* port for client communications */
+	struct job_pack_cache *pack_cache; /* last pack_job() output, see
+					 * _pack_job_cached() in job_mgr.c */
 	char *partition;		/* name of job partition(s) */
 	List part_ptr_list;		/* list of pointers to partition recs */
 	bool part_nodes_missing;	/* set if job's nodes removed from this
@@ -601,6 +605,10 @@ struct job_record {
 	uint32_t priority;		/* relative priority of the job,
 					 * zero == held (don't initiate) */
 	uint32_t *priority_array;	/* partition based priority */
+	struct prio_queue_rec *prio_queue_rec; /* first of its entries in
+					 * the partition priority queues,
+					 * see prio_queue.c (Internal use
+					 * only, don't save) */
 	priority_factors_object_t *prio_factors; /* cached value used
 						  * by sprio command */
 	uint32_t profile;		/* Acct_gather_profile option */
@@ -659,6 +667,10 @@ struct job_record {
 	struct wf_program_t *workflow_program;
 	struct wf_original_job_size_t *original_job_size;
 #endif
+#ifdef SLURM_SIMULATOR
+	time_t sim_eligible_time;	/* begin_time of the last
+					 * SIM_TRACE_ELIGIBLE record */
+#endif
 };
 
 /* Job dependency specification, used in "depend_list" within job_record */
@@ -1591,6 +1603,25 @@ extern void pack_job (struct job_record *dump_job_ptr, uint16_t show_flags,
 extern void pack_part (struct part_record *part_ptr, Buf buffer,
 		       uint16_t protocol_version);
 
+/*
+ * pack_job_delta - dump information for the jobs changed since last_update
+ *	in machine independent form (for network transmission), for a
+ *	client keeping the records of earlier dumps (SHOW_DELTA)
+ * OUT buffer_ptr - the pointer is set to the allocated buffer.
+ * OUT buffer_size - set to size of the buffer in bytes
+ * IN show_flags - job filtering options
+ * IN uid - uid of user making request (for partition filtering)
+ * IN last_update - time of the client's latest dump
+ * IN protocol_version - slurm protocol version of client
+ * global: job_list - global list of job records
+ * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ * NOTE: change _unpack_job_info_delta_msg() in common/slurm_protocol_pack.c
+ *	whenever the data format changes
+ */
+extern void pack_job_delta(char **buffer_ptr, int *buffer_size,
+			   uint16_t show_flags, uid_t uid, time_t last_update,
+			   uint16_t protocol_version);
+
 /*
  * pack_one_job - dump information for one jobs in
  *	machine independent form (for network transmission)
@@ -95,6 +95,8 @@
 #include "src/slurmd/common/task_plugin.h"
 
 #include "sim_events.h"
+#include "src/common/sim_sync.h"
+#include "src/common/sim_event_queue.h"
 
 #define _LIMIT_INFO 0
 
@@ -242,13 +244,6 @@ static pthread_mutex_t fini_mutex = PTHREAD_MUTEX_INITIALIZER;
 static uint32_t fini_job_id[FINI_JOB_CNT];
 static int next_fini_job_inx = 0;
 
-extern pthread_mutex_t simulator_mutex;
-extern simulator_event_t *head_simulator_event;
-extern volatile simulator_event_t *head_sim_completed_jobs;
-extern int total_sim_events;
-
-simulator_event_info_t *head_simulator_event_info;
-
 /* NUM_PARALLEL_SUSPEND controls the number of jobs suspended/resumed
  * at one time as well as the number of jobsteps per job that can be
  * suspended at one time */
@@ -493,65 +488,18 @@ static int _send_slurmd_conf_lite (int fd, slurmd_conf_t *cf)
 #ifdef SLURM_SIMULATOR
 
 int simulator_add_future_event(batch_job_launch_msg_t *req){
-	simulator_event_t  *new_event;
-	simulator_event_info_t *temp_ptr = head_simulator_event_info;
-	time_t now;
-
-	pthread_mutex_lock(&simulator_mutex);
-	now = time(NULL);
-
-	new_event = (simulator_event_t *)malloc(sizeof(simulator_event_t));
-	if(!new_event){
-		error("SIMULATOR: malloc fails for new_event\n");
-		pthread_mutex_unlock(&simulator_mutex);
-		return -1;
-	}
+	time_t when;
 
-	/* Checking job_id as expected */
-	while(temp_ptr){
-		if(temp_ptr->job_id == req->job_id)
-			break;
-		temp_ptr = temp_ptr->next;
-	}
-	if(!temp_ptr){
-		info("SIM: No job_id event matching this job_id %d\n", req->job_id);
-		pthread_mutex_unlock(&simulator_mutex);
+	if (sim_event_add(req->job_id, time(NULL), &when) != SLURM_SUCCESS) {
+		info("SIM: No job_id event matching this job_id %u",
+		     req->job_id);
 		return -1;
 	}
-	new_event->job_id = req->job_id;
-	new_event->type = REQUEST_COMPLETE_BATCH_SCRIPT;
-	new_event->when = now + temp_ptr->duration;
-	new_event->nodelist = strdup(req->nodes);
-	new_event->next = NULL;
-
-	total_sim_events++;
-	if(!head_simulator_event){
-		info("SIM: Adding new event for job %d when list is empty for future time %ld!", new_event->job_id, new_event->when);
-		head_simulator_event = new_event;
-	}else{
-		volatile simulator_event_t *node_temp = head_simulator_event;
-		info("SIM: Adding new event for job %d in the event listi for future time %ld", new_event->job_id, new_event->when);
-
-		if(head_simulator_event->when > new_event->when){
-			new_event->next = head_simulator_event;
-			head_simulator_event = new_event;
-			pthread_mutex_unlock(&simulator_mutex);
-			return 0;
-		}
+	debug3("SIM: Adding new event for job %u for future time %ld",
+	       req->job_id, when);
+	/* The launch may arrive after the helper reported its step */
+	sim_sync_set_next(SIM_SYNC_NEXT_JOB_END, sim_event_next());
 
-		while((node_temp->next) && (node_temp->next->when < new_event->when))
-			node_temp = node_temp->next;
-
-		if(node_temp->next){
-			new_event->next = node_temp->next;
-			node_temp->next = new_event;
-			pthread_mutex_unlock(&simulator_mutex);
-			return 0;
-		}
-		node_temp->next = new_event;
-	}
-
-	pthread_mutex_unlock(&simulator_mutex);
 	return 0;
 }
 
@@ -2270,32 +2218,13 @@ _rpc_sim_job(slurm_msg_t *msg)
 {
 	int        rc = SLURM_SUCCESS;
 	sim_job_msg_t *sim_job;
-	simulator_event_info_t *new;
-	static int last_job_id; /* Controlling failed submissions */
 
 	sim_job = (sim_job_msg_t *)msg->data;
 
-	info("SIM: Got info for jobid: %u with a duration of %u\n", sim_job->job_id, sim_job->duration);
+	debug2("SIM: Got info for jobid: %u with a duration of %u",
+	       sim_job->job_id, sim_job->duration);
 
-	if(sim_job->job_id != last_job_id){
-		new = (simulator_event_info_t *)calloc(1, sizeof(simulator_event_info_t));
-		if(!new){
-			info("SIM: _rpc_sim_job error in calloc\n");
-			return rc;
-		}
-
-		new->job_id = sim_job->job_id;
-		new->duration = sim_job->duration;
-
-		new->next = head_simulator_event_info;
-		head_simulator_event_info = new;
-
-		last_job_id = sim_job->job_id;
-	}
-	else{
-		info("SIM: Got an existent job_id. Updating duration for last job inserted\n");
-		head_simulator_event_info->duration = sim_job->duration;
-	}
+	rc = sim_event_set_duration(sim_job->job_id, sim_job->duration);
 
 	if (slurm_send_rc_msg(msg, rc) < 0) {
 		error("Error responding to sim_job: %m");
@@ -2619,56 +2548,43 @@ simulator_rpc_terminate_job(slurm_msg_t *rec_msg)
 	char *node_name;
 	int             rc     = SLURM_SUCCESS;
 	kill_job_msg_t *req_kill    = rec_msg->data;
-	volatile simulator_event_t *temp, *event_sim, *prev;
+	bool requeue;
 
 	/* First sending an OK to the controller */
 
-	info("simulator_rpc_terminate_job, jobid = %d", req_kill->job_id);
+	debug2("simulator_rpc_terminate_job, jobid = %u", req_kill->job_id);
 
 	slurm_send_rc_msg(rec_msg, SLURM_SUCCESS);
 
-	info("simulator_rpc_terminate_job, jobid = %d ready for sending message", req_kill->job_id);
-
-	pthread_mutex_lock(&simulator_mutex);
-
-	event_sim = head_sim_completed_jobs;
-
-	if((head_sim_completed_jobs) && (head_sim_completed_jobs->job_id == req_kill->job_id)){
-		head_sim_completed_jobs = head_sim_completed_jobs->next;
-	}else{
-
-		temp = head_sim_completed_jobs;
-		if(!temp){
-			info("SIM: Error, no event found for completed job %d T1\n", req_kill->job_id);
-			pthread_mutex_unlock(&simulator_mutex);
-			return;
-		}
-
-		while (temp) {
-			if (temp->job_id==req_kill->job_id) {
-				break;
-			}
-			prev=temp;
-			temp=temp->next;
-		}
-		if (temp) {
-			event_sim=temp;
-			prev->next=temp->next;
-		} else {
-			info("SIM: Error, no event found for completed job %d T2\n", req_kill->job_id);
-			pthread_mutex_unlock(&simulator_mutex);
-			return;
-		}
+	if (!req_kill->nodes) {
+		/* Job purged by slurmctld without ever being launched, see
+		 * sim_nodes_job_purged(). No epilog to run. */
+		(void) sim_event_remove(req_kill->job_id, false);
+		return;
+	}
+	/* A requeued job is terminated in the PENDING state */
+	requeue = ((req_kill->job_state & JOB_STATE_BASE) == JOB_PENDING);
+	switch (sim_event_remove(req_kill->job_id, requeue)) {
+	case SIM_EVENT_NONE:
+		info("SIM: Error, no event found for completed job %u",
+		     req_kill->job_id);
+		return;
+	case SIM_EVENT_ENDED:
+		break;
+	default:
+		/* Cancelled or timed out before its batch script ended */
+		debug("SIM: job %u terminated before its end event",
+		      req_kill->job_id);
+		break;
 	}
 
-	pthread_mutex_unlock(&simulator_mutex);
-
-	hl = hostlist_create(event_sim->nodelist);
+	hl = hostlist_create(req_kill->nodes);
 
 	/* With FRONTEND just one epilog complete message is needed */
 	node_name = hostlist_shift(hl);
 
-	info("SIM: Sending epilog complete message for job %d node %s", req_kill->job_id, node_name);
+	debug2("SIM: Sending epilog complete message for job %u node %s",
+	       req_kill->job_id, node_name);
 	slurm_msg_t_init(&msg);
 
 	req.job_id      = req_kill->job_id;
@@ -2681,8 +2597,9 @@ simulator_rpc_terminate_job(slurm_msg_t *rec_msg)
 	/* Let wait for an answer for simulation syncronization */
 	slurm_send_recv_controller_rc_msg(&msg, &rc);
 
+	if (node_name)
+		free(node_name);
 	hostlist_destroy(hl);
-	free((void*)event_sim);
 }
 
 static void
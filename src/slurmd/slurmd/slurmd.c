@@ -68,13 +68,6 @@
 
  #include <sys/syscall.h> /* SYS_gettid */
 
-#ifdef SLURM_SIMULATOR
-/* The following three lines are for some global synchronization logic
- * needed by the simulator.  The definitions should match what are in slurm_sim.h.
- */
-#include <semaphore.h>
-#endif
-
 #include "src/common/bitstring.h"
 #include "src/common/cpu_frequency.h"
 #include "src/common/daemonize.h"
@@ -120,6 +113,8 @@
 #ifdef SLURM_SIMULATOR
 #include "sim_events.h"
 #include "src/common/slurm_sim.h"
+#include "src/common/sim_sync.h"
+#include "src/common/sim_event_queue.h"
 #endif
 
 #define GETOPT_ARGS	"cCd:Df:hL:Mn:N:vV"
@@ -149,16 +144,6 @@ typedef struct connection {
 } conn_t;
 
 
-#ifdef SLURM_SIMULATOR
-volatile simulator_event_t *head_simulator_event;
-volatile simulator_event_t *head_sim_completed_jobs;
-int    total_sim_events = 0;
-char   SEM_NAME[]       = "serversem";
-sem_t* mutexserver      = SEM_FAILED;
-#endif
-
-pthread_mutex_t simulator_mutex  = PTHREAD_MUTEX_INITIALIZER;
-
 /*
  * static shutdown and reconfigure flags:
  */
@@ -470,8 +455,8 @@ _registration_engine(void *arg)
 	_decrement_thd_count();
 	debug("FINISH _registration_engine call..");
 #ifdef SLURM_SIMULATOR
-	debug("call signal_sim_mgr..");
-	signal_sim_mgr();
+	debug("signal sim_mgr..");
+	sim_sync_signal_mgr(SIGUSR2);
 #endif	
 
 	pthread_exit(NULL);
@@ -480,197 +465,85 @@ _registration_engine(void *arg)
 }
 
 #ifdef SLURM_SIMULATOR
-/* send signal to sim_mgr to continue */
-int signal_sim_mgr(){
-
-	pid_t pid_sim_mgr;
-	char output[10];
-	FILE *cmd = popen("pidof -s sim_mgr", "r");
-
-	fgets(output, 10, cmd);
-	pid_sim_mgr = strtoul(output, NULL, 10);
-	debug("SIM_MGR_PID: %lu\n", pid_sim_mgr);
-	kill(pid_sim_mgr, SIGUSR2);
-	pclose(cmd);
-	return 0;
-}
-
 static int
-_send_complete_batch_script_msg(uint32_t jobid, int err, int status)
+_send_sim_helper_cycle_jobs_msg(uint32_t *job_ids, uint32_t jobs_count)
 {
-       int             rc, i;
-       slurm_msg_t     req_msg;
-       complete_batch_script_msg_t req;
-
-       req.job_id      = jobid;
-       req.job_rc      = status;
-       req.slurm_rc    = err;
-
-       slurm_msg_t_init(&req_msg);
-       req.node_name   = NULL;
-       req_msg.msg_type= REQUEST_COMPLETE_BATCH_SCRIPT;
-       req_msg.data    = &req;
-
-       info("SIM: sending REQUEST_COMPLETE_BATCH_SCRIPT");
-
-       /* Note: these log messages don't go to slurmd.log from here */
-       for (i=0; i<=5; i++) {
-               struct timespec waiting;
-
-               if (slurm_send_recv_controller_rc_msg(&req_msg, &rc) == 0)
-                       break;
-               info("SIM: Retrying job complete RPC for %u",
-                    jobid);
-               waiting.tv_sec = 0;
-               waiting.tv_nsec = 10000000;
-               //usleep(10000);
-               nanosleep(&waiting, 0);
-       }
-       if (i > 5) {
-               sleep(10);
-               error("SIM: Unable to send job complete message: %m");
-               return SLURM_ERROR;
-       }
-
-       if ((rc == ESLURM_ALREADY_DONE) || (rc == ESLURM_INVALID_JOB_ID))
-               rc = SLURM_SUCCESS;
-       if (rc)
-               slurm_seterrno_ret(rc);
-
-       return SLURM_SUCCESS;
-}
-
-static int
-_send_sim_helper_cycle_msg(uint32_t jobs_count)
-{
-       int             rc, i;
-       slurm_msg_t     req_msg;
-       sim_helper_msg_t req;
-
-       req.total_jobs_ended = jobs_count;
-
-       slurm_msg_t_init(&req_msg);
-       req_msg.msg_type= MESSAGE_SIM_HELPER_CYCLE;
-       req_msg.data    = &req;
+	int             rc, i;
+	slurm_msg_t     req_msg;
+	sim_helper_jobs_msg_t req;
 
-       info("SIM: sending MESSAGE_SIM_HELPER_CYCLE");
+	req.total_jobs_ended = jobs_count;
+	req.job_ids          = job_ids;
 
-       /* Note: these log messages don't go to slurmd.log from here */
-       for (i=0; i<=5; i++) {
-               struct timespec waiting;
-
-               if (slurm_send_recv_controller_rc_msg(&req_msg, &rc) == 0)
-                       break;
-               info("SIM: Retrying message helper cycle RPC");
-               waiting.tv_sec = 0;
-               waiting.tv_nsec = 10000000;
-               //usleep(10000);
-               nanosleep(&waiting, 0);
-       }
-       if (i > 5) {
-               sleep(10);
-               error("SIM: Unable to send message helper cycle complete message: %m");
-               return SLURM_ERROR;
-       }
+	slurm_msg_t_init(&req_msg);
+	req_msg.msg_type = MESSAGE_SIM_HELPER_CYCLE_JOBS;
+	req_msg.data     = &req;
 
-       if ((rc == ESLURM_ALREADY_DONE) || (rc == ESLURM_INVALID_JOB_ID))
-               rc = SLURM_SUCCESS;
-       if (rc)
-               slurm_seterrno_ret(rc);
+	debug("SIM: sending MESSAGE_SIM_HELPER_CYCLE_JOBS for %u jobs",
+	      jobs_count);
 
-       return SLURM_SUCCESS;
-}
+	/* Note: these log messages don't go to slurmd.log from here */
+	for (i = 0; i <= 5; i++) {
+		struct timespec waiting;
 
-int
-open_global_sync_sem() {
-	int iter = 0;
-	while(mutexserver == SEM_FAILED && iter < 10) {
-		mutexserver = sem_open(SEM_NAME,0,0644,0);
-		if(mutexserver == SEM_FAILED) sleep(1);
-		++iter;
+		if (slurm_send_recv_controller_rc_msg(&req_msg, &rc) == 0)
+			break;
+		info("SIM: Retrying message helper cycle RPC");
+		waiting.tv_sec = 0;
+		waiting.tv_nsec = 10000000;
+		nanosleep(&waiting, 0);
 	}
-
-	if(mutexserver == SEM_FAILED)
-		return -1;
-	else
-		return 0;
-}
-
-void
-perform_global_sync() {
-	while(*global_sync_flag < 2 || *global_sync_flag > 4 ) {
-		usleep(1000);
+	if (i > 5) {
+		sleep(10);
+		error("SIM: Unable to send message helper cycle message: %m");
+		return SLURM_ERROR;
 	}
 
-	sem_wait(mutexserver);
-	*global_sync_flag += 1;
-	if(*global_sync_flag > 4) *global_sync_flag = 1;
-	sem_post(mutexserver);
-}
+	if (rc)
+		slurm_seterrno_ret(rc);
 
-void
-close_global_sync_sem() {
-	if(mutexserver != SEM_FAILED) sem_close(mutexserver);
+	return SLURM_SUCCESS;
 }
 
 void *
 _simulator_helper(void *arg)
 {
-	time_t now, last;
-	int jobs_ended;
+	time_t now, last, next_event;
+	uint32_t jobs_ended, job_ids_size = 0;
+	uint32_t *job_ids = NULL;
 
 	_increment_thd_count();
 
-	open_global_sync_sem();
+	sim_sync_attach(SIM_SYNC_SLURMD);
 
 	last = 0;
 	now = 0;
 	info("SIM: Simulator Helper starting...\n");
 	while (!_shutdown) {
 
-		jobs_ended = 0;
 		now = time(NULL);
-		info("now: %ld last: %ld diff: %ld", now, last, now - last);
-		pthread_mutex_lock(&simulator_mutex);
-		if(head_simulator_event)
-			info("Simulator Helper cycle: %ld, Next event at %ld, total_sim_events: %d\n", now, head_simulator_event->when, total_sim_events);
+		debug3("now: %ld last: %ld diff: %ld", now, last, now - last);
+		if ((next_event = sim_event_next()))
+			debug2("Simulator Helper cycle: %ld, Next event at %ld, "
+			       "total_sim_events: %d", now, next_event,
+			       sim_event_count());
 		else
-			info("Simulator Helper cycle: %ld, No events!!!\n", now);
-
-		while((head_simulator_event) && (now >= head_simulator_event->when)){
-			volatile simulator_event_t *aux;
-			int event_jid;
-			event_jid = head_simulator_event->job_id;
-			aux = head_simulator_event;
-			head_simulator_event = head_simulator_event->next;
-			aux->next = head_sim_completed_jobs;
-			head_sim_completed_jobs = aux;
-			total_sim_events--;
-			info("SIM: Sending JOB_COMPLETE_BATCH_SCRIPT for job %d", event_jid);
-			pthread_mutex_unlock(&simulator_mutex);
-			_send_complete_batch_script_msg(event_jid, SLURM_SUCCESS, 0);
-			pthread_mutex_lock(&simulator_mutex);
-			info("SIM: JOB_COMPLETE_BATCH_SCRIPT for job %d SENT", event_jid);
-			jobs_ended++;
+			debug2("Simulator Helper cycle: %ld, No events", now);
 
-		}
-		pthread_mutex_unlock(&simulator_mutex);
+		jobs_ended = sim_event_pop_due(now, &job_ids, &job_ids_size);
 		last = now;
-		if(jobs_ended){
-			/* Let's give some time to EPILOG_MESSAGE process to terminate  */
-			/* TODO: It should be done better with a counter of EPILOG messages processed */
-			usleep(1000);
-			_send_sim_helper_cycle_msg(jobs_ended);
-		} else {
-			_send_sim_helper_cycle_msg(0);
-		}
+		/* One RPC completes every job ended in this cycle, slurmctld
+		 * then holds the cycle until their epilogs are processed */
+		_send_sim_helper_cycle_jobs_msg(job_ids, jobs_ended);
 
-		perform_global_sync();
+		sim_sync_set_next(SIM_SYNC_NEXT_JOB_END, sim_event_next());
+		sim_sync_step(SIM_SYNC_SLURMD);
 
 	}
 	info("SIM: Simulator Helper finishing...");
 
-	close_global_sync_sem();
+	xfree(job_ids);
+	sim_sync_close(SIM_SYNC_SLURMD);
 	pthread_exit(0);
 	_decrement_thd_count();
 	return NULL;
@@ -1888,6 +1761,9 @@ _slurmd_fini(void)
 	cpu_freq_fini();
 	job_container_fini();
 	acct_gather_conf_destroy();
+#ifdef SLURM_SIMULATOR
+	sim_event_fini();
+#endif
 
 	return SLURM_SUCCESS;
 }
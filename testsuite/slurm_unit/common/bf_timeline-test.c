@@ -0,0 +1,390 @@
+/*****************************************************************************\
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+#include <check.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "src/common/bitstring.h"
+#include "src/common/xmalloc.h"
+#include "src/plugins/sched/backfill/bf_timeline.h"
+
+/*****************************************************************************
+ * DEFINITIONS
+ *****************************************************************************/
+
+#define NODE_CNT	16
+
+/* bf_timeline_log() is the only user of slurmctld's node table */
+char *bitmap2node_name(bitstr_t *bitmap)
+{
+	return xmalloc(1);	/* empty node list */
+}
+
+typedef struct slot_spec {
+	time_t begin_time;
+	time_t end_time;
+	int node_cnt;
+} slot_spec_t;
+
+/* Return a bitmap of all nodes but first to last, none cleared if first
+ * is negative */
+static bitstr_t *res_bitmap(int first, int last)
+{
+	bitstr_t *bitmap = bit_alloc(NODE_CNT);
+
+	bit_nset(bitmap, 0, NODE_CNT - 1);
+	if (first >= 0)
+		bit_nclear(bitmap, first, last);
+	return bitmap;
+}
+
+/* Return a bitmap of nodes first to last */
+static bitstr_t *use_bitmap(int first, int last)
+{
+	bitstr_t *bitmap = bit_alloc(NODE_CNT);
+
+	bit_nset(bitmap, first, last);
+	return bitmap;
+}
+
+/* Reserve all nodes but first to last from start_time to end_reserve */
+static void reserve(bf_timeline_t *timeline, time_t start_time,
+		    time_t end_reserve, int first, int last)
+{
+	bitstr_t *bitmap = res_bitmap(first, last);
+
+	bf_timeline_add(timeline, start_time, end_reserve, bitmap);
+	FREE_NULL_BITMAP(bitmap);
+}
+
+static void check_slots(bf_timeline_t *timeline, slot_spec_t *spec, int cnt)
+{
+	bf_slot_t *slot;
+	int i;
+
+	fail_unless(timeline->slot_cnt == cnt, "%d slots, expected %d",
+		    timeline->slot_cnt, cnt);
+	for (i = 0; i < cnt; ++i) {
+		slot = timeline->slots + i;
+		fail_unless((slot->begin_time == spec[i].begin_time) &&
+			    (slot->end_time == spec[i].end_time),
+			    "slot %d is [%ld,%ld), expected [%ld,%ld)", i,
+			    (long) slot->begin_time, (long) slot->end_time,
+			    (long) spec[i].begin_time,
+			    (long) spec[i].end_time);
+		fail_unless(slot->nodes->node_cnt == spec[i].node_cnt,
+			    "slot %d has %d nodes, expected %d", i,
+			    slot->nodes->node_cnt, spec[i].node_cnt);
+		fail_unless(bit_set_count(slot->nodes->bitmap) ==
+			    slot->nodes->node_cnt,
+			    "slot %d node count not cached", i);
+	}
+}
+
+/*****************************************************************************
+ * FIXTURE                                                                   *
+ *****************************************************************************/
+
+bf_timeline_t *g_timeline = NULL;
+
+/* all nodes available from 0 to 1000 */
+static void setup(void)
+{
+	bitstr_t *bitmap = res_bitmap(-1, -1);
+
+	g_timeline = bf_timeline_create(0, 1000, bitmap);
+	FREE_NULL_BITMAP(bitmap);
+}
+
+static void teardown(void)
+{
+	bf_timeline_destroy(g_timeline);
+}
+
+/*****************************************************************************
+ * UNIT TESTS                                                                *
+ ****************************************************************************/
+
+START_TEST(test_create)
+{
+	slot_spec_t spec[] = {{0, 1000, NODE_CNT}};
+	bitstr_t *bitmap = res_bitmap(-1, -1);
+	bf_timeline_t *timeline;
+
+	timeline = bf_timeline_create(0, 1000, bitmap);
+	check_slots(timeline, spec, 1);
+	fail_unless(timeline->slots[0].nodes->bitmap != bitmap,
+		    "timeline uses the caller's bitmap");
+	fail_unless(timeline->slots[0].nodes->ref_cnt == 1, "bad ref_cnt");
+	bf_timeline_destroy(timeline);
+	FREE_NULL_BITMAP(bitmap);
+}
+END_TEST
+
+START_TEST(test_split_share)
+{
+	slot_spec_t spec1[] = {{0, 100, 16}, {100, 200, 12}, {200, 1000, 16}};
+	slot_spec_t spec2[] = {{0, 100, 16}, {100, 200, 12}, {200, 300, 16},
+			       {300, 400, 12}, {400, 1000, 16}};
+	bf_timeline_t *timeline = g_timeline;
+	bf_nodes_t *orig_nodes = timeline->slots[0].nodes;
+
+	/* the slots around the reservation keep sharing the original
+	 * nodes, the reserved one gets its own copy */
+	reserve(timeline, 100, 200, 0, 3);
+	check_slots(timeline, spec1, 3);
+	fail_unless(timeline->slots[0].nodes == orig_nodes,
+		    "first slot lost its nodes");
+	fail_unless(timeline->slots[2].nodes == orig_nodes,
+		    "split slots do not share their nodes");
+	fail_unless(orig_nodes->ref_cnt == 2, "bad ref_cnt %d",
+		    orig_nodes->ref_cnt);
+	fail_unless(timeline->slots[1].nodes != orig_nodes,
+		    "reserved slot changed shared nodes");
+	fail_unless(timeline->slots[1].nodes->ref_cnt == 1, "bad ref_cnt");
+	fail_unless(!bit_test(timeline->slots[1].nodes->bitmap, 0) &&
+		    bit_test(timeline->slots[1].nodes->bitmap, 4),
+		    "bad nodes reserved");
+	fail_unless(bit_test(orig_nodes->bitmap, 0),
+		    "shared nodes changed by a reservation");
+
+	/* again within a shared slot, with other nodes */
+	reserve(timeline, 300, 400, 4, 7);
+	check_slots(timeline, spec2, 5);
+	fail_unless((timeline->slots[0].nodes == orig_nodes) &&
+		    (timeline->slots[2].nodes == orig_nodes) &&
+		    (timeline->slots[4].nodes == orig_nodes),
+		    "split slots do not share their nodes");
+	fail_unless(orig_nodes->ref_cnt == 3, "bad ref_cnt %d",
+		    orig_nodes->ref_cnt);
+	fail_unless(orig_nodes->node_cnt == NODE_CNT,
+		    "shared nodes changed by a reservation");
+	fail_unless(!bit_test(timeline->slots[3].nodes->bitmap, 4) &&
+		    bit_test(timeline->slots[3].nodes->bitmap, 0),
+		    "bad nodes reserved");
+
+	/* reserving no node splits nothing and copies nothing */
+	reserve(timeline, 50, 350, -1, -1);
+	check_slots(timeline, spec2, 5);
+	fail_unless(orig_nodes->ref_cnt == 3, "bad ref_cnt %d",
+		    orig_nodes->ref_cnt);
+}
+END_TEST
+
+START_TEST(test_span_shared)
+{
+	slot_spec_t spec[] = {{0, 50, 16}, {50, 100, 12}, {100, 200, 8},
+			      {200, 500, 12}, {500, 1000, 16}};
+	bf_timeline_t *timeline = g_timeline;
+	bf_nodes_t *orig_nodes = timeline->slots[0].nodes, *res_nodes;
+	int i;
+
+	reserve(timeline, 100, 200, 0, 3);
+	res_nodes = timeline->slots[1].nodes;
+
+	/* a reservation over both shared and unshared slots copies the
+	 * shared nodes it changes and changes the others in place */
+	reserve(timeline, 50, 500, 8, 11);
+	check_slots(timeline, spec, 5);
+	fail_unless(timeline->slots[2].nodes == res_nodes,
+		    "unshared nodes were copied");
+	fail_unless((timeline->slots[0].nodes == orig_nodes) &&
+		    (timeline->slots[4].nodes == orig_nodes),
+		    "slots outside the reservation lost their nodes");
+	fail_unless(orig_nodes->ref_cnt == 2, "bad ref_cnt %d",
+		    orig_nodes->ref_cnt);
+	fail_unless(orig_nodes->node_cnt == NODE_CNT,
+		    "shared nodes changed by a reservation");
+	for (i = 1; i < 4; ++i) {
+		fail_unless(timeline->slots[i].nodes->ref_cnt == 1,
+			    "slot %d nodes still shared", i);
+		fail_unless(!bit_test(timeline->slots[i].nodes->bitmap, 8),
+			    "slot %d nodes not reserved", i);
+	}
+}
+END_TEST
+
+START_TEST(test_merge)
+{
+	slot_spec_t spec1[] = {{0, 100, 16}, {100, 300, 12}, {300, 1000, 16}};
+	slot_spec_t spec2[] = {{0, 300, 12}, {300, 1000, 16}};
+	slot_spec_t spec3[] = {{0, 1000, 12}};
+	bf_timeline_t *timeline = g_timeline;
+	int i;
+
+	/* equal adjacent slots are merged, whether they share their
+	 * nodes or only have equal ones */
+	reserve(timeline, 100, 200, 0, 3);
+	reserve(timeline, 200, 300, 0, 3);
+	check_slots(timeline, spec1, 3);
+	reserve(timeline, 0, 100, 0, 3);
+	check_slots(timeline, spec2, 2);
+	for (i = 0; i < 2; ++i) {
+		fail_unless(timeline->slots[i].nodes->ref_cnt == 1,
+			    "slot %d bad ref_cnt %d", i,
+			    timeline->slots[i].nodes->ref_cnt);
+	}
+
+	/* a reservation past the end is clipped to the timeline and one
+	 * before its beginning starts with it */
+	reserve(timeline, 250, 2000, 0, 3);
+	check_slots(timeline, spec3, 1);
+	fail_unless(timeline->slots[0].nodes->ref_cnt == 1, "bad ref_cnt");
+	reserve(timeline, -100, 2000, 0, 3);
+	check_slots(timeline, spec3, 1);
+}
+END_TEST
+
+START_TEST(test_and)
+{
+	bf_timeline_t *timeline = g_timeline;
+	bitstr_t *avail;
+	time_t later_start;
+
+	reserve(timeline, 100, 200, 0, 3);
+	reserve(timeline, 300, 400, 4, 7);
+
+	avail = res_bitmap(-1, -1);
+	fail_unless(bf_timeline_and(timeline, 150, 250, 12, avail,
+				    &later_start), "enough nodes not found");
+	fail_unless(bit_set_count(avail) == 12, "bad nodes available");
+	fail_unless(!bit_test(avail, 0), "reserved node available");
+	fail_unless(later_start == 200, "bad later_start %ld",
+		    (long) later_start);
+	FREE_NULL_BITMAP(avail);
+
+	/* fails on counts, leaving the bitmap alone */
+	avail = res_bitmap(-1, -1);
+	fail_unless(!bf_timeline_and(timeline, 150, 350, 13, avail,
+				     &later_start), "too many nodes found");
+	fail_unless(bit_set_count(avail) == NODE_CNT,
+		    "failed test filtered nodes");
+	FREE_NULL_BITMAP(avail);
+
+	/* both reservations */
+	avail = res_bitmap(-1, -1);
+	fail_unless(bf_timeline_and(timeline, 150, 350, 12, avail,
+				    &later_start), "enough nodes not found");
+	fail_unless(bit_set_count(avail) == 8, "bad nodes available");
+	FREE_NULL_BITMAP(avail);
+
+	/* last slot, and past the end */
+	avail = res_bitmap(-1, -1);
+	fail_unless(bf_timeline_and(timeline, 500, 600, NODE_CNT, avail,
+				    &later_start), "enough nodes not found");
+	fail_unless(later_start == 0, "later_start after the last slot");
+	fail_unless(bf_timeline_and(timeline, 1000, 1100, NODE_CNT, avail,
+				    &later_start), "past the end failed");
+	fail_unless(later_start == 0, "later_start past the end");
+	fail_unless(bit_set_count(avail) == NODE_CNT,
+		    "nodes filtered past the end");
+	FREE_NULL_BITMAP(avail);
+}
+END_TEST
+
+START_TEST(test_overlap)
+{
+	bf_timeline_t *timeline = g_timeline;
+	bitstr_t *use;
+
+	reserve(timeline, 100, 200, 0, 3);
+	reserve(timeline, 300, 400, 4, 7);
+
+	/* reserved nodes, ends excluded */
+	use = use_bitmap(0, 0);
+	fail_unless(bf_timeline_overlap(timeline, 50, 150, use),
+		    "overlap on node 0 not found");
+	fail_unless(bf_timeline_overlap(timeline, 199, 300, use),
+		    "overlap on node 0 not found");
+	fail_unless(!bf_timeline_overlap(timeline, 0, 100, use),
+		    "overlap found before the reservation");
+	fail_unless(!bf_timeline_overlap(timeline, 200, 1000, use),
+		    "overlap found after the reservation");
+	FREE_NULL_BITMAP(use);
+
+	/* nodes reserved elsewhere */
+	use = use_bitmap(8, 15);
+	fail_unless(!bf_timeline_overlap(timeline, 0, 1000, use),
+		    "overlap found on free nodes");
+	FREE_NULL_BITMAP(use);
+	use = use_bitmap(4, 7);
+	fail_unless(!bf_timeline_overlap(timeline, 0, 300, use),
+		    "overlap found before the reservation");
+	fail_unless(bf_timeline_overlap(timeline, 0, 301, use),
+		    "overlap on nodes 4-7 not found");
+	FREE_NULL_BITMAP(use);
+
+	/* more nodes than available, found on counts */
+	use = use_bitmap(0, NODE_CNT - 1);
+	fail_unless(bf_timeline_overlap(timeline, 100, 200, use),
+		    "overlap on all nodes not found");
+	fail_unless(!bf_timeline_overlap(timeline, 400, 1000, use),
+		    "overlap found on all nodes");
+	FREE_NULL_BITMAP(use);
+}
+END_TEST
+
+/*****************************************************************************
+ * TEST SUITE                                                                *
+ ****************************************************************************/
+
+Suite* bf_timeline_suite(void)
+{
+	Suite* s = suite_create("bf_timeline");
+	TCase* tc_core = tcase_create("Core");
+	tcase_add_checked_fixture(tc_core, setup, teardown);
+	tcase_add_test(tc_core, test_create);
+	tcase_add_test(tc_core, test_split_share);
+	tcase_add_test(tc_core, test_span_shared);
+	tcase_add_test(tc_core, test_merge);
+	tcase_add_test(tc_core, test_and);
+	tcase_add_test(tc_core, test_overlap);
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+/*****************************************************************************
+ * TEST RUNNER                                                               *
+ ****************************************************************************/
+
+int main(void)
+{
+	int number_failed;
+	SRunner* sr = srunner_create(bf_timeline_suite());
+
+	srunner_run_all(sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
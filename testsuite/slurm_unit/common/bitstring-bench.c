@@ -0,0 +1,82 @@
+/* Micro-benchmark of src/common/bitstring.c
+ *
+ * Usage: bitstring-bench [bits [iterations]]
+ * Prints the average time per call of the bitmap operations the schedulers
+ * use most, on bitmaps of the given size (default 65536 bits, a large
+ * cluster's core bitmap).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <src/common/bitstring.h>
+#include <sys/time.h>
+
+static double _now_usec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000000.0) + tv.tv_usec;
+}
+
+#define BENCH(_name, _op) do {						\
+	double _start = _now_usec();					\
+	for (i = 0; i < iters; i++) {					\
+		_op;							\
+	}								\
+	printf("%-20s %10.1f nsec/call\n", _name,			\
+	       (_now_usec() - _start) * 1000.0 / iters);		\
+} while (0)
+
+int
+main(int argc, char *argv[])
+{
+	bitoff_t nbits = 65536, bit;
+	int iters = 10000, i;
+	volatile int32_t sink = 0;
+	bitstr_t *bs1, *bs2, *bs3;
+
+	if (argc > 1)
+		nbits = atoi(argv[1]);
+	if (argc > 2)
+		iters = atoi(argv[2]);
+	if ((nbits < 2) || (iters < 1)) {
+		fprintf(stderr, "Usage: %s [bits [iterations]]\n", argv[0]);
+		return 1;
+	}
+
+	/* Mostly allocated nodes with a free stretch near the end, as
+	 * bit_ffc() and bit_nffc() see them on a busy cluster */
+	bs1 = bit_alloc(nbits);
+	bs2 = bit_alloc(nbits);
+	bs3 = bit_alloc(nbits);
+	srandom(1);
+	for (bit = 0; bit < nbits; bit++) {
+		if ((bit < (nbits - nbits / 16)) || (random() % 4 == 0))
+			bit_set(bs1, bit);
+		if (random() % 2)
+			bit_set(bs2, bit);
+	}
+
+	printf("%d bits, %d iterations\n", (int) nbits, iters);
+	BENCH("bit_set_count", sink += bit_set_count(bs1));
+	BENCH("bit_set_count_range",
+	      sink += bit_set_count_range(bs1, 3, nbits - 3));
+	BENCH("bit_overlap", sink += bit_overlap(bs1, bs2));
+	BENCH("bit_super_set", sink += bit_super_set(bs2, bs1));
+	BENCH("bit_equal", sink += bit_equal(bs1, bs1));
+	BENCH("bit_ffs", sink += bit_ffs(bs3));
+	BENCH("bit_ffc", sink += bit_ffc(bs1));
+	BENCH("bit_fls", sink += bit_fls(bs3));
+	BENCH("bit_nffc", sink += bit_nffc(bs1, 2));
+	BENCH("bit_nffs", sink += bit_nffs(bs3, 2));
+	BENCH("bit_noc", sink += bit_noc(bs1, 2, nbits / 2));
+	BENCH("bit_copybits", bit_copybits(bs3, bs1));
+	BENCH("bit_and", bit_and(bs3, bs2));
+	BENCH("bit_or", bit_or(bs3, bs2));
+	BENCH("bit_not", bit_not(bs3));
+
+	bit_free(bs1);
+	bit_free(bs2);
+	bit_free(bs3);
+	return (sink == -1);
+}
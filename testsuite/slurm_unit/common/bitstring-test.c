@@ -185,6 +185,71 @@ main(int argc, char *argv[])
 		bit_free(bs);
 	}
 
+	note("Testing word boundaries");
+	{
+		bitstr_t *bs1 = bit_alloc(70);
+		bitstr_t *bs2 = bit_alloc(70);
+
+		bit_nset(bs1, 0, 4);
+		TEST(bit_ffc(bs1) == 5, "ffc");
+		bit_nset(bs1, 5, 69);
+		TEST(bit_ffc(bs1) == -1, "ffc");
+		TEST(bit_set_count(bs1) == 70, "count");
+		TEST(bit_set_count_range(bs1, 30, 67) == 37, "count range");
+
+		bit_not(bs1);			/* bits past 70 now set */
+		TEST(bit_set_count(bs1) == 0, "count after not");
+		TEST(bit_ffs(bs1) == -1, "ffs after not");
+		TEST(bit_fls(bs1) == -1, "fls after not");
+		TEST(bit_super_set(bs1, bs2), "super_set after not");
+		TEST(bit_equal(bs1, bs2), "equal after not");
+		TEST(bit_overlap(bs1, bs1) == 0, "overlap after not");
+
+		bit_nset(bs1, 31, 33);
+		bit_set(bs1, 69);
+		TEST(bit_noc(bs1, 40, 50) == -1, "noc");
+		TEST(bit_noc(bs1, 20, 50) == 0, "noc");
+		TEST(bit_noc(bs1, 35, 34) == 34, "noc");
+		TEST(bit_fls(bs1) == 69, "fls");
+
+		bit_free(bs1);
+		bit_free(bs2);
+	}
+
+	note("Testing fused operations and scratch bitmaps");
+	{
+		bitstr_t *bs1 = bit_alloc(70);
+		bitstr_t *bs2 = bit_alloc(70);
+		bitstr_t *bs3 = bit_alloc(70);
+
+		bit_nset(bs1, 10, 69);
+		bit_nset(bs2, 20, 65);
+		bit_copybits_and(bs3, bs1, bs2);
+		TEST(bit_set_count(bs3) == 46, "copybits_and");
+		TEST(bit_overlap_any(bs1, bs2), "overlap_any");
+		bit_and_not(bs1, bs2);
+		TEST(bit_set_count(bs1) == 14, "and_not");
+		TEST(bit_fls(bs1) == 69, "and_not");
+		TEST(!bit_overlap_any(bs1, bs2), "overlap_any");
+		bit_not(bs2);			/* bits past 70 now set */
+		TEST(!bit_overlap_any(bs2, bs3), "overlap_any after not");
+		bit_and_not(bs1, bs2);
+		TEST(bit_set_count(bs1) == 0, "and_not after not");
+
+		bit_free(bs3);
+		bs3 = bit_scratch_alloc(70);
+		TEST(bit_set_count(bs3) == 0, "scratch_alloc");
+		bit_set(bs3, 42);
+		bit_scratch_free(bs3);
+		bs3 = bit_scratch_alloc(70);
+		TEST(bit_size(bs3) == 70, "scratch_alloc reuse");
+		TEST(bit_set_count(bs3) == 0, "scratch_alloc reuse");
+		bit_scratch_free(bs3);
+
+		bit_free(bs1);
+		bit_free(bs2);
+	}
+
 	note("Testing bit_unfmt");
 	{
 		bitstr_t *bs = bit_alloc(1024);
@@ -0,0 +1,293 @@
+/*****************************************************************************\
+ *  Copyright (C) 2016 The Regents of the University of California.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/sim_event_queue.h"
+#include "src/common/xmalloc.h"
+
+/*****************************************************************************
+ * FIXTURE                                                                   *
+ *****************************************************************************/
+
+#define START_TIME	1000
+
+/* more jobs than records in one pool chunk, so the pool grows at least
+ * once and released records of several chunks get reused */
+#define MANY_JOBS	3000
+
+uint32_t *g_job_ids = NULL;
+uint32_t g_job_ids_size = 0;
+
+static void setup(void)
+{
+	g_job_ids = NULL;
+	g_job_ids_size = 0;
+}
+
+static void teardown(void)
+{
+	xfree(g_job_ids);
+	sim_event_fini();
+}
+
+/*****************************************************************************
+ * UNIT TESTS                                                                *
+ ****************************************************************************/
+
+START_TEST(test_pop_order)
+{
+	/* durations out of order, jobs 4 and 6 end at the same time */
+	uint32_t durations[] = {50, 10, 40, 30, 20, 30, 5};
+	uint32_t expected[] = {7, 2, 5, 4, 6, 3, 1};
+	int i, len = sizeof(durations)/sizeof(durations[0]);
+	uint32_t cnt, popped = 0;
+	time_t when, now;
+
+	for (i = 0; i < len; ++i) {
+		fail_unless(sim_event_set_duration(i + 1, durations[i]) ==
+			    SLURM_SUCCESS, "sim_event_set_duration failed");
+	}
+	fail_unless(sim_event_count() == 0, "pending jobs were queued");
+	fail_unless(sim_event_next() == 0, "empty queue has a next event");
+
+	for (i = 0; i < len; ++i) {
+		fail_unless(sim_event_add(i + 1, START_TIME, &when) ==
+			    SLURM_SUCCESS, "sim_event_add failed");
+		fail_unless(when == START_TIME + durations[i],
+			    "bad end time for job %d", i + 1);
+	}
+	fail_unless(sim_event_count() == len, "bad count of queued events");
+	fail_unless(sim_event_next() == START_TIME + 5, "bad next event");
+
+	/* nothing is due before the first end time */
+	cnt = sim_event_pop_due(START_TIME + 4, &g_job_ids, &g_job_ids_size);
+	fail_unless(cnt == 0, "popped an event not due yet");
+
+	/* pop one second at a time, events come out by end time and in
+	 * queue order for the same end time */
+	for (now = START_TIME; now <= START_TIME + 50; ++now) {
+		cnt = sim_event_pop_due(now, &g_job_ids, &g_job_ids_size);
+		for (i = 0; i < cnt; ++i, ++popped) {
+			fail_unless(g_job_ids[i] == expected[popped],
+				    "popped job %u, expected job %u",
+				    g_job_ids[i], expected[popped]);
+		}
+		if (popped < len) {
+			fail_unless(sim_event_next() > now,
+				    "next event is already due");
+		}
+	}
+	fail_unless(popped == len, "not all events were popped");
+	fail_unless(sim_event_count() == 0, "queue not empty");
+	fail_unless(sim_event_next() == 0, "empty queue has a next event");
+
+	/* a late call pops everything due at once, still in order */
+	for (i = 0; i < len; ++i)
+		sim_event_add(i + 1, START_TIME, NULL);
+	cnt = sim_event_pop_due(START_TIME + 100, &g_job_ids,
+				&g_job_ids_size);
+	fail_unless(cnt == len, "bad count of popped events");
+	for (i = 0; i < len; ++i) {
+		fail_unless(g_job_ids[i] == expected[i],
+			    "popped job %u, expected job %u",
+			    g_job_ids[i], expected[i]);
+	}
+}
+END_TEST
+
+START_TEST(test_remove)
+{
+	uint32_t job_id, cnt;
+	int i;
+
+	/* unknown jobs */
+	fail_unless(sim_event_remove(1, false) == SIM_EVENT_NONE,
+		    "removed an unknown job");
+	fail_unless(sim_event_add(1, START_TIME, NULL) == SLURM_ERROR,
+		    "queued a job without duration");
+
+	for (job_id = 1; job_id <= 20; ++job_id)
+		sim_event_set_duration(job_id, job_id * 10);
+
+	/* pending job */
+	fail_unless(sim_event_remove(20, false) == SIM_EVENT_PENDING,
+		    "job 20 not pending");
+	fail_unless(sim_event_remove(20, false) == SIM_EVENT_NONE,
+		    "job 20 still known after removal");
+
+	for (job_id = 1; job_id <= 19; ++job_id)
+		sim_event_add(job_id, START_TIME, NULL);
+
+	/* remove queued jobs from the head, middle and tail of the heap */
+	fail_unless(sim_event_remove(1, false) == SIM_EVENT_QUEUED,
+		    "job 1 not queued");
+	fail_unless(sim_event_remove(10, false) == SIM_EVENT_QUEUED,
+		    "job 10 not queued");
+	fail_unless(sim_event_remove(19, false) == SIM_EVENT_QUEUED,
+		    "job 19 not queued");
+	fail_unless(sim_event_count() == 16, "bad count after removal");
+	fail_unless(sim_event_next() == START_TIME + 20, "bad next event");
+
+	/* requeue keeps the duration */
+	fail_unless(sim_event_remove(5, true) == SIM_EVENT_QUEUED,
+		    "job 5 not queued");
+	fail_unless(sim_event_remove(5, true) == SIM_EVENT_PENDING,
+		    "requeued job 5 not pending");
+	fail_unless(sim_event_count() == 15, "bad count after requeue");
+
+	/* pop everything, removed jobs never come out */
+	cnt = sim_event_pop_due(START_TIME + 1000, &g_job_ids,
+				&g_job_ids_size);
+	fail_unless(cnt == 15, "bad count of popped events");
+	for (i = 0; i < cnt; ++i) {
+		fail_unless((g_job_ids[i] != 1) && (g_job_ids[i] != 10) &&
+			    (g_job_ids[i] != 19) && (g_job_ids[i] != 5),
+			    "popped removed job %u", g_job_ids[i]);
+		if (i > 0) {
+			fail_unless(g_job_ids[i] > g_job_ids[i - 1],
+				    "events popped out of order");
+		}
+	}
+
+	/* ended jobs are found until slurmctld terminates them */
+	fail_unless(sim_event_remove(2, false) == SIM_EVENT_ENDED,
+		    "job 2 not ended");
+	fail_unless(sim_event_remove(2, false) == SIM_EVENT_NONE,
+		    "job 2 still known after removal");
+
+	/* the requeued job runs again with its old duration */
+	fail_unless(sim_event_add(5, START_TIME + 2000, NULL) == SLURM_SUCCESS,
+		    "requeued job 5 lost its duration");
+	fail_unless(sim_event_next() == START_TIME + 2050,
+		    "requeued job 5 has a bad end time");
+}
+END_TEST
+
+START_TEST(test_pool_reuse)
+{
+	uint32_t job_id, base, cnt;
+	int round;
+
+	for (round = 0; round < 4; ++round) {
+		base = round * MANY_JOBS;
+
+		/* queue every other job so released records come from
+		 * both the pending and queued states */
+		for (job_id = base + 1; job_id <= base + MANY_JOBS; ++job_id) {
+			sim_event_set_duration(job_id, round + 1);
+			if (job_id % 2)
+				sim_event_add(job_id, START_TIME, NULL);
+		}
+		fail_unless(sim_event_count() == MANY_JOBS / 2,
+			    "bad count of queued events in round %d", round);
+
+		for (job_id = base + 1; job_id <= base + MANY_JOBS; ++job_id) {
+			fail_unless(sim_event_remove(job_id, false) ==
+				    ((job_id % 2) ? SIM_EVENT_QUEUED :
+				     SIM_EVENT_PENDING),
+				    "job %u in a bad state", job_id);
+		}
+		fail_unless(sim_event_count() == 0,
+			    "queue not empty in round %d", round);
+		fail_unless(sim_event_next() == 0,
+			    "empty queue has a next event in round %d", round);
+
+		/* jobs of the previous round are gone for good */
+		if (round) {
+			fail_unless(sim_event_remove(base, false) ==
+				    SIM_EVENT_NONE,
+				    "job %u of the last round still known",
+				    base);
+		}
+	}
+
+	/* a recycled record carries nothing of the job it held before,
+	 * including a job id registered again */
+	sim_event_set_duration(1, 7);
+	fail_unless(sim_event_count() == 0, "recycled record still queued");
+	sim_event_add(1, START_TIME, NULL);
+	fail_unless(sim_event_next() == START_TIME + 7,
+		    "recycled record kept an old duration");
+	cnt = sim_event_pop_due(START_TIME + 7, &g_job_ids, &g_job_ids_size);
+	fail_unless((cnt == 1) && (g_job_ids[0] == 1),
+		    "recycled record not popped");
+	fail_unless(sim_event_remove(1, false) == SIM_EVENT_ENDED,
+		    "recycled record in a bad state");
+
+	/* the queue is usable again after all memory is released */
+	sim_event_fini();
+	fail_unless(sim_event_remove(2, false) == SIM_EVENT_NONE,
+		    "job known after sim_event_fini");
+	sim_event_set_duration(2, 3);
+	fail_unless(sim_event_add(2, START_TIME, NULL) == SLURM_SUCCESS,
+		    "sim_event_add failed after sim_event_fini");
+	fail_unless(sim_event_next() == START_TIME + 3,
+		    "bad next event after sim_event_fini");
+}
+END_TEST
+
+/*****************************************************************************
+ * TEST SUITE                                                                *
+ ****************************************************************************/
+
+Suite* sim_event_queue_suite(void)
+{
+	Suite* s = suite_create("sim_event_queue");
+	TCase* tc_core = tcase_create("Core");
+	tcase_add_checked_fixture(tc_core, setup, teardown);
+	tcase_add_test(tc_core, test_pop_order);
+	tcase_add_test(tc_core, test_remove);
+	tcase_add_test(tc_core, test_pool_reuse);
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+/*****************************************************************************
+ * TEST RUNNER                                                               *
+ ****************************************************************************/
+
+int main(void)
+{
+	int number_failed;
+	SRunner* sr = srunner_create(sim_event_queue_suite());
+
+	srunner_run_all(sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}